@@ -16,8 +16,12 @@ target_sources(
     utility/FFmpegShared.hpp
     utility/GoLiveAPI_CensoredJson.cpp
     utility/GoLiveAPI_CensoredJson.hpp
+    utility/GoLiveAPI_ConfigCache.cpp
+    utility/GoLiveAPI_ConfigCache.hpp
     utility/GoLiveAPI_Network.cpp
     utility/GoLiveAPI_Network.hpp
+    utility/GoLiveAPI_Planner.cpp
+    utility/GoLiveAPI_Planner.hpp
     utility/GoLiveAPI_PostData.cpp
     utility/GoLiveAPI_PostData.hpp
     utility/item-widget-helpers.cpp
@@ -0,0 +1,208 @@
+#include "GoLiveAPI_ConfigCache.hpp"
+
+#include <OBSApp.hpp>
+
+#include <obs.h>
+#include <util/platform.h>
+#include <util/util.hpp>
+
+#include <QDateTime>
+#include <QString>
+
+#include <algorithm>
+#include <mutex>
+
+using json = nlohmann::json;
+
+/* A cached config is only read when the go live request itself fails, and is
+ * replaced by every successful one.  The age limit bounds how outdated that
+ * offline fallback may be, as the server can change its configs at any time.
+ * Measured encoder capacity only goes stale through driver and encoder updates
+ * its hash doesn't cover. */
+static constexpr int64_t CONFIG_MAX_AGE = 7 * 24 * 60 * 60;
+static constexpr int64_t CAPACITY_MAX_AGE = 30 * 24 * 60 * 60;
+
+static std::mutex cache_mutex;
+
+static std::string hash_json(const json &data)
+{
+	auto text = data.dump();
+	BPtr<char> hash = os_hash_sha256(text.data(), text.size());
+	return hash ? std::string(hash.Get()) : std::string();
+}
+
+std::string GoLiveCapabilitiesHash(const QString &url, const GoLiveApi::PostData &post_data)
+{
+	json data = post_data;
+	data["url"] = url.toStdString();
+	data["capabilities"]["memory"].erase("free");
+
+	auto &codecs = data["client"]["supported_codecs"];
+	std::sort(codecs.begin(), codecs.end());
+
+	return hash_json(data);
+}
+
+std::string EncoderCapacityHash(const GoLiveApi::PostData &post_data)
+{
+	json data;
+	data["capabilities"] = post_data.capabilities;
+	data["capabilities"]["memory"].erase("free");
+	data["capabilities"]["cpu"].erase("speed");
+
+	const char *id;
+	auto &encoders = data["encoders"] = json::array();
+	for (size_t i = 0; obs_enum_encoder_types(i, &id); i++) {
+		if (obs_get_encoder_type(id) == OBS_ENCODER_VIDEO)
+			encoders.push_back(id);
+	}
+	std::sort(encoders.begin(), encoders.end());
+
+	return hash_json(data);
+}
+
+static std::string cache_dir()
+{
+	char path[512];
+	if (GetAppConfigPath(path, sizeof(path), "obs-studio/multitrack_video_cache") <= 0)
+		return {};
+
+	return path;
+}
+
+static std::string cache_path(const std::string &capabilities_hash)
+{
+	auto dir = cache_dir();
+	if (dir.empty() || capabilities_hash.empty())
+		return {};
+
+	return dir + "/" + capabilities_hash + ".json";
+}
+
+static json load_cache_entry(const std::string &path)
+{
+	BPtr<char> text = os_quick_read_utf8_file(path.c_str());
+	if (!text)
+		return json::object();
+
+	try {
+		auto data = json::parse(text.Get());
+		if (data.is_object())
+			return data;
+	} catch (const json::exception &e) {
+		blog(LOG_WARNING, "Failed to parse go live cache '%s': %s", path.c_str(), e.what());
+	}
+
+	return json::object();
+}
+
+static std::optional<json> load_cached(const std::string &capabilities_hash, const char *key, int64_t max_age)
+{
+	auto path = cache_path(capabilities_hash);
+	if (path.empty())
+		return std::nullopt;
+
+	const std::lock_guard lock{cache_mutex};
+	auto data = load_cache_entry(path);
+
+	auto value = data.find(key);
+	auto saved = data.find(std::string(key) + "_saved");
+	if (value == data.end() || saved == data.end() || !saved->is_number_integer())
+		return std::nullopt;
+
+	auto age = QDateTime::currentSecsSinceEpoch() - saved->get<int64_t>();
+	if (age < 0 || age > max_age)
+		return std::nullopt;
+
+	return *value;
+}
+
+static void store_cached(const std::string &capabilities_hash, const char *key, std::optional<json> value)
+{
+	auto path = cache_path(capabilities_hash);
+	if (path.empty())
+		return;
+
+	const std::lock_guard lock{cache_mutex};
+	os_mkdirs(cache_dir().c_str());
+
+	auto data = load_cache_entry(path);
+	if (value) {
+		data[key] = std::move(*value);
+		data[std::string(key) + "_saved"] = QDateTime::currentSecsSinceEpoch();
+	} else {
+		if (!data.erase(key))
+			return;
+		data.erase(std::string(key) + "_saved");
+	}
+
+	auto text = data.dump();
+	if (!os_quick_write_utf8_file_safe(path.c_str(), text.c_str(), text.size(), false, "tmp", nullptr))
+		blog(LOG_WARNING, "Failed to write go live cache '%s'", path.c_str());
+}
+
+std::optional<GoLiveApi::Config> LoadCachedGoLiveConfig(const std::string &capabilities_hash)
+{
+	auto data = load_cached(capabilities_hash, "config", CONFIG_MAX_AGE);
+	if (!data)
+		return std::nullopt;
+
+	try {
+		GoLiveApi::Config config = *data;
+		if (config.encoder_configurations.empty())
+			return std::nullopt;
+
+		return config;
+	} catch (const json::exception &e) {
+		blog(LOG_WARNING, "Failed to parse cached go live config: %s", e.what());
+		return std::nullopt;
+	}
+}
+
+void StoreCachedGoLiveConfig(const std::string &capabilities_hash, const GoLiveApi::Config &config)
+{
+	if (config.encoder_configurations.empty())
+		return;
+	if (config.status && config.status->result != GoLiveApi::StatusResult::Success)
+		return;
+
+	/* Stream keys handed out by the server are not written to disk, and a
+	 * config without them would not work. */
+	for (auto &endpoint : config.ingest_endpoints) {
+		if (endpoint.authentication && !endpoint.authentication->empty())
+			return;
+	}
+
+	/* The config ID identifies a single go live request to the server,
+	 * it must not be reused when the cached config stands in for one. */
+	GoLiveApi::Config cached = config;
+	cached.status.reset();
+	cached.meta.config_id.clear();
+
+	store_cached(capabilities_hash, "config", json(cached));
+}
+
+void EvictCachedGoLiveConfig(const std::string &capabilities_hash)
+{
+	store_cached(capabilities_hash, "config", std::nullopt);
+}
+
+std::optional<std::vector<GoLiveApi::EncoderCapacity>> LoadCachedEncoderCapacity(const std::string &capacity_hash)
+{
+	auto data = load_cached(capacity_hash, "encoder_capacity", CAPACITY_MAX_AGE);
+	if (!data)
+		return std::nullopt;
+
+	try {
+		return data->get<std::vector<GoLiveApi::EncoderCapacity>>();
+	} catch (const json::exception &e) {
+		blog(LOG_WARNING, "Failed to parse cached encoder capacity: %s", e.what());
+		return std::nullopt;
+	}
+}
+
+void StoreCachedEncoderCapacity(const std::string &capacity_hash,
+				const std::vector<GoLiveApi::EncoderCapacity> &capacity)
+{
+	store_cached(capacity_hash, "encoder_capacity", json(capacity));
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "models/multitrack-video.hpp"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+class QString;
+
+/** Identifies the configs that apply to a go live request: a hash of the
+ * config URL and the request without volatile system state. */
+std::string GoLiveCapabilitiesHash(const QString &url, const GoLiveApi::PostData &post_data);
+
+/** Identifies the measured encoder capacity: a hash of the hardware and the
+ * available video encoders, independent of the service and stream key. */
+std::string EncoderCapacityHash(const GoLiveApi::PostData &post_data);
+
+std::optional<GoLiveApi::Config> LoadCachedGoLiveConfig(const std::string &capabilities_hash);
+void StoreCachedGoLiveConfig(const std::string &capabilities_hash, const GoLiveApi::Config &config);
+void EvictCachedGoLiveConfig(const std::string &capabilities_hash);
+
+std::optional<std::vector<GoLiveApi::EncoderCapacity>> LoadCachedEncoderCapacity(const std::string &capacity_hash);
+void StoreCachedEncoderCapacity(const std::string &capacity_hash,
+				const std::vector<GoLiveApi::EncoderCapacity> &capacity);
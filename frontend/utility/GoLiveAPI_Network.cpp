@@ -1,5 +1,6 @@
 #include "GoLiveAPI_Network.hpp"
 #include "GoLiveAPI_CensoredJson.hpp"
+#include "GoLiveAPI_ConfigCache.hpp"
 
 #include <OBSApp.hpp>
 #include <utility/MultitrackVideoError.hpp>
@@ -67,36 +68,61 @@ void HandleGoLiveApiErrors(QWidget *parent, const json &raw_json, const GoLiveAp
 	}
 }
 
-GoLiveApi::Config DownloadGoLiveConfig(QWidget *parent, QString url, const GoLiveApi::PostData &post_data,
-				       const QString &multitrack_video_name)
+static bool PostGoLiveRequest(const QString &url, const GoLiveApi::PostData &post_data, std::string &response,
+			      std::string &error)
 {
 	json post_data_json = post_data;
 	blog(LOG_INFO, "Go live POST data: %s", censoredJson(post_data_json).toUtf8().constData());
 
+	std::vector<std::string> headers;
+	headers.push_back("Content-Type: application/json");
+	return GetRemoteFile(url.toLocal8Bit(), response,
+			     error, // out params
+			     nullptr,
+			     nullptr, // out params (response code and content type)
+			     "POST", post_data_json.dump().c_str(), headers,
+			     nullptr, // signature
+			     5);      // timeout in seconds
+}
+
+GoLiveApi::Config DownloadGoLiveConfig(QWidget *parent, QString url, const GoLiveApi::PostData &post_data,
+				       const QString &multitrack_video_name,
+				       const std::function<std::optional<GoLiveApi::Config>()> &offline_plan)
+{
 	if (url.isEmpty())
 		throw MultitrackVideoError::critical(QTStr("FailedToStartStream.MissingConfigURL"));
 
 	std::string encodeConfigText;
 	std::string libraryError;
 
-	std::vector<std::string> headers;
-	headers.push_back("Content-Type: application/json");
-	bool encodeConfigDownloadedOk = GetRemoteFile(url.toLocal8Bit(), encodeConfigText,
-						      libraryError, // out params
-						      nullptr,
-						      nullptr, // out params (response code and content type)
-						      "POST", post_data_json.dump().c_str(), headers,
-						      nullptr, // signature
-						      5);      // timeout in seconds
-
-	if (!encodeConfigDownloadedOk)
+	bool encodeConfigDownloadedOk = PostGoLiveRequest(url, post_data, encodeConfigText, libraryError);
+
+	if (!encodeConfigDownloadedOk) {
+		blog(LOG_WARNING, "Go live config request failed: %s", libraryError.c_str());
+
+		if (offline_plan) {
+			if (auto config = offline_plan()) {
+				blog(LOG_INFO, "Using locally planned go live config");
+				return *config;
+			}
+		}
+
 		throw MultitrackVideoError::warning(
 			QTStr("FailedToStartStream.ConfigRequestFailed").arg(url, libraryError.c_str()));
+	}
 	try {
 		auto data = json::parse(encodeConfigText);
 		blog(LOG_INFO, "Go live response data: %s", censoredJson(data, true).toUtf8().constData());
 		GoLiveApi::Config config = data;
+
+		/* a config the server no longer hands out must not be used
+		 * when it can't be reached later on */
+		auto cache_hash = GoLiveCapabilitiesHash(url, post_data);
+		if (config.status && config.status->result != GoLiveApi::StatusResult::Success)
+			EvictCachedGoLiveConfig(cache_hash);
+
 		HandleGoLiveApiErrors(parent, data, config);
+		StoreCachedGoLiveConfig(cache_hash, config);
 		return config;
 
 	} catch (const json::exception &e) {
@@ -6,10 +6,17 @@
 
 #include <QString>
 
+#include <functional>
+#include <optional>
+
 /** Returns either GO_LIVE_API_PRODUCTION_URL or a command line override. */
 QString MultitrackVideoAutoConfigURL(obs_service_t *service);
 
 class QWidget;
 
+/** Requests the go live config and caches it, a cached config is dropped
+ * once the server rejects the request.  If the request fails and
+ * offline_plan returns a config, that config is used instead. */
 GoLiveApi::Config DownloadGoLiveConfig(QWidget *parent, QString url, const GoLiveApi::PostData &post_data,
-				       const QString &multitrack_video_name);
+				       const QString &multitrack_video_name,
+				       const std::function<std::optional<GoLiveApi::Config>()> &offline_plan = {});
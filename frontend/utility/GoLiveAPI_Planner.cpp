@@ -0,0 +1,397 @@
+#include "GoLiveAPI_Planner.hpp"
+
+#include <obs.hpp>
+#include <util/dstr.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+using json = nlohmann::json;
+
+/* H.264 is accepted by every ingest, hardware encoders are preferred. */
+static const char *planner_encoders[] = {
+	"obs_nvenc_h264_tex",
+	"h264_texture_amf",
+	"obs_qsv11_v2",
+	"com.apple.videotoolbox.videoencoder.ave.avc",
+	"ffmpeg_vaapi_tex",
+	"obs_x264",
+};
+
+/* Short side of the rungs below the canvas output resolution */
+static const uint32_t rung_sizes[] = {1080, 720, 480, 360};
+
+static constexpr uint32_t DEFAULT_MAX_VIDEO_TRACKS = 3;
+static constexpr uint64_t DEFAULT_MAX_AGGREGATE_BITRATE = 10000;
+static constexpr uint32_t MIN_TRACK_BITRATE = 300;
+static constexpr uint32_t MAX_TRACK_BITRATE = 6000;
+static constexpr double BITS_PER_PIXEL = 0.06;
+
+static constexpr auto BENCHMARK_WARMUP = std::chrono::milliseconds(500);
+static constexpr auto BENCHMARK_DURATION = std::chrono::seconds(2);
+static constexpr auto BENCHMARK_STOP_TIMEOUT = std::chrono::seconds(5);
+static constexpr auto BENCHMARK_CANCEL_POLL = std::chrono::milliseconds(50);
+
+/* Used until the encoders have been measured: a single 1080p60 track for
+ * hardware encoders, and 720p30 for x264. */
+static constexpr uint64_t DEFAULT_HARDWARE_PIXEL_RATE = 1920ULL * 1080 * 60;
+static constexpr uint64_t DEFAULT_SOFTWARE_PIXEL_RATE = 1280ULL * 720 * 30;
+
+/* An encoder that keeps up is assumed to manage at most this many times the
+ * measured load, based on how much of each frame interval it was busy. */
+static constexpr double MAX_HEADROOM = 2.0;
+
+struct Rung {
+	uint32_t canvas_index;
+	uint32_t width;
+	uint32_t height;
+	media_frames_per_second framerate;
+	uint32_t bitrate;
+
+	double FrameRate() const { return (double)framerate.numerator / (double)framerate.denominator; }
+	uint64_t PixelRate() const { return (uint64_t)((double)width * height * FrameRate()); }
+};
+
+static std::vector<Rung> canvas_rungs(const GoLiveApi::Canvas &canvas, uint32_t canvas_index)
+{
+	std::vector<Rung> rungs;
+	uint32_t short_side = std::min(canvas.width, canvas.height);
+
+	if (!short_side || !canvas.framerate.numerator || !canvas.framerate.denominator)
+		return rungs;
+
+	auto add_rung = [&](uint32_t size) {
+		Rung rung = {canvas_index, 0, 0, canvas.framerate, 0};
+		rung.width = (uint32_t)((uint64_t)canvas.width * size / short_side) & ~1u;
+		rung.height = (uint32_t)((uint64_t)canvas.height * size / short_side) & ~1u;
+		if (!rung.width || !rung.height)
+			return;
+
+		/* lower rungs don't benefit from high frame rates */
+		if (!rungs.empty() && size <= 480 && rung.FrameRate() > 30.0)
+			rung.framerate.denominator *= 2;
+
+		auto bitrate = (uint32_t)((double)rung.PixelRate() * BITS_PER_PIXEL / 1000.0);
+		rung.bitrate = std::clamp(bitrate, MIN_TRACK_BITRATE, MAX_TRACK_BITRATE);
+		rungs.push_back(rung);
+	};
+
+	add_rung(short_side);
+	for (auto size : rung_sizes) {
+		if (size < short_side)
+			add_rung(size);
+	}
+
+	return rungs;
+}
+
+/* Takes the best fitting rung of each canvas in turn, so extra canvases get a
+ * track before the main canvas gets a second one. */
+static std::vector<Rung> plan_ladder(const GoLiveApi::Preferences &preferences, uint64_t max_pixel_rate)
+{
+	std::vector<std::vector<Rung>> canvases;
+	for (size_t i = 0; i < preferences.canvases.size(); i++)
+		canvases.push_back(canvas_rungs(preferences.canvases[i], (uint32_t)i));
+
+	uint32_t max_tracks = std::min(preferences.maximum_video_tracks.value_or(DEFAULT_MAX_VIDEO_TRACKS),
+				       static_cast<uint32_t>(MAX_OUTPUT_VIDEO_ENCODERS));
+	uint64_t max_bitrate = preferences.maximum_aggregate_bitrate.value_or(DEFAULT_MAX_AGGREGATE_BITRATE);
+
+	std::vector<size_t> next(canvases.size(), 0);
+	std::vector<Rung> ladder;
+	uint64_t pixel_rate = 0;
+	uint64_t bitrate = 0;
+
+	for (bool added = true; added && ladder.size() < max_tracks;) {
+		added = false;
+
+		for (size_t i = 0; i < canvases.size() && ladder.size() < max_tracks; i++) {
+			auto &rungs = canvases[i];
+
+			for (; next[i] < rungs.size(); next[i]++) {
+				auto &rung = rungs[next[i]];
+				if (pixel_rate + rung.PixelRate() > max_pixel_rate ||
+				    bitrate + rung.bitrate > max_bitrate)
+					continue;
+
+				pixel_rate += rung.PixelRate();
+				bitrate += rung.bitrate;
+				ladder.push_back(rung);
+				added = true;
+				next[i]++;
+				break;
+			}
+		}
+	}
+
+	std::stable_sort(ladder.begin(), ladder.end(),
+			 [](const Rung &a, const Rung &b) { return a.canvas_index < b.canvas_index; });
+	return ladder;
+}
+
+static uint64_t ladder_pixel_rate(const std::vector<Rung> &ladder)
+{
+	uint64_t pixel_rate = 0;
+	for (auto &rung : ladder)
+		pixel_rate += rung.PixelRate();
+	return pixel_rate;
+}
+
+static json rung_settings(const Rung &rung)
+{
+	return {
+		{"rate_control", "CBR"},
+		{"bitrate", rung.bitrate},
+		{"keyint_sec", 2},
+	};
+}
+
+static uint32_t frame_rate_divisor(const obs_video_info &ovi, const media_frames_per_second &fps)
+{
+	auto target = (uint64_t)fps.numerator * ovi.fps_den;
+	auto source = (uint64_t)ovi.fps_num * fps.denominator;
+	return std::max(1u, static_cast<uint32_t>(source / target));
+}
+
+/* returns false if cancel was set before the duration passed */
+static bool sleep_unless_cancelled(const std::atomic_bool &cancel, std::chrono::milliseconds duration)
+{
+	auto end = std::chrono::steady_clock::now() + duration;
+
+	while (!cancel) {
+		auto now = std::chrono::steady_clock::now();
+		if (now >= end)
+			return true;
+
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(end - now,
+											  BENCHMARK_CANCEL_POLL));
+	}
+
+	return false;
+}
+
+/* Encodes the main canvas with the ladder through a null output, returns the
+ * pixel rate the encoder is estimated to sustain. */
+static std::optional<uint64_t> benchmark_encoder(const char *encoder_id, const std::vector<Rung> &ladder,
+						 const std::atomic_bool &cancel)
+{
+	obs_video_info ovi;
+	if (!obs_get_video_info(&ovi))
+		return std::nullopt;
+
+	OBSOutputAutoRelease output = obs_output_create("null_output", "go live planner benchmark", nullptr, nullptr);
+	OBSEncoderAutoRelease audio_encoder =
+		obs_audio_encoder_create("ffmpeg_aac", "go live planner benchmark audio", nullptr, 0, nullptr);
+	if (!output || !audio_encoder)
+		return std::nullopt;
+
+	std::vector<OBSEncoderAutoRelease> video_encoders;
+	DStr name;
+
+	for (size_t i = 0; i < ladder.size(); i++) {
+		auto &rung = ladder[i];
+
+		dstr_printf(name, "go live planner benchmark %zu", i);
+		OBSDataAutoRelease settings = obs_data_create_from_json(rung_settings(rung).dump().c_str());
+		OBSEncoderAutoRelease encoder = obs_video_encoder_create(encoder_id, name, settings, nullptr);
+		if (!encoder)
+			return std::nullopt;
+
+		obs_encoder_set_video(encoder, obs_get_video());
+		obs_encoder_set_scaled_size(encoder, rung.width, rung.height);
+		obs_encoder_set_gpu_scale_type(encoder, OBS_SCALE_BICUBIC);
+		obs_encoder_set_frame_rate_divisor(encoder, frame_rate_divisor(ovi, rung.framerate));
+
+		obs_output_set_video_encoder2(output, encoder, i);
+		video_encoders.emplace_back(std::move(encoder));
+	}
+
+	obs_encoder_set_audio(audio_encoder, obs_get_audio());
+	obs_output_set_audio_encoder(output, audio_encoder, 0);
+	obs_output_set_media(output, obs_get_video(), obs_get_audio());
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopped = false;
+
+	auto on_stopped = [&]() {
+		std::unique_lock lock(mutex);
+		stopped = true;
+		cv.notify_one();
+	};
+	using on_stopped_t = decltype(on_stopped);
+
+	auto pre_on_stopped = [](void *data, calldata_t *) {
+		on_stopped_t &on_stopped = *static_cast<on_stopped_t *>(data);
+		on_stopped();
+	};
+
+	OBSSignal deactivate{obs_output_get_signal_handler(output), "deactivate", pre_on_stopped, &on_stopped};
+
+	if (!obs_output_start(output)) {
+		blog(LOG_WARNING, "Go live planner: Failed to start benchmark for '%s'", encoder_id);
+		return std::nullopt;
+	}
+
+	bool completed = sleep_unless_cancelled(cancel, BENCHMARK_WARMUP);
+	for (auto &encoder : video_encoders)
+		obs_encoder_reset_stats(encoder);
+
+	auto start = std::chrono::steady_clock::now();
+	completed = completed && sleep_unless_cancelled(cancel, BENCHMARK_DURATION);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double achieved = 1.0;
+	double headroom = MAX_HEADROOM;
+
+	for (size_t i = 0; completed && i < ladder.size(); i++) {
+		obs_encoder_stats stats = {};
+		if (!obs_encoder_get_stats(video_encoders[i], &stats))
+			continue;
+
+		/* frames skipped as duplicates were kept up with as well */
+		double fps = ladder[i].FrameRate();
+		double expected = seconds * fps;
+		double handled = (double)(stats.total_packets + stats.duplicate_frames);
+		if (expected >= 1.0)
+			achieved = std::min(achieved, handled / expected);
+
+		if (stats.encode_call_p99_ns)
+			headroom = std::min(headroom, 1e9 / fps / (double)stats.encode_call_p99_ns);
+	}
+
+	obs_output_stop(output);
+
+	std::unique_lock lock(mutex);
+	if (!cv.wait_for(lock, BENCHMARK_STOP_TIMEOUT, [&] { return stopped; }))
+		obs_output_force_stop(output);
+	lock.unlock();
+
+	if (!completed)
+		return std::nullopt;
+
+	/* Skipped frames mean the encoder was overloaded, scale the load down
+	 * with some margin.  Otherwise scale it up by how idle it was. */
+	double pixel_rate = (double)ladder_pixel_rate(ladder);
+	if (achieved < 0.95)
+		return (uint64_t)(pixel_rate * achieved * 0.8);
+
+	return (uint64_t)(pixel_rate * std::clamp(headroom, 1.0, MAX_HEADROOM));
+}
+
+std::optional<std::vector<GoLiveApi::EncoderCapacity>> MeasureEncoderCapacity(const GoLiveApi::PostData &post_data,
+									      const std::atomic_bool &cancel)
+{
+	std::vector<GoLiveApi::EncoderCapacity> capacity;
+
+	auto ladder = plan_ladder(post_data.preferences, UINT64_MAX);
+	ladder.erase(std::remove_if(ladder.begin(), ladder.end(),
+				    [](const Rung &rung) { return rung.canvas_index != 0; }),
+		     ladder.end());
+	if (ladder.empty())
+		return capacity;
+
+	auto required = ladder_pixel_rate(ladder);
+
+	for (auto encoder_id : planner_encoders) {
+		if (!obs_get_encoder_codec(encoder_id))
+			continue;
+
+		auto pixel_rate = benchmark_encoder(encoder_id, ladder, cancel);
+		if (cancel)
+			return std::nullopt;
+		if (!pixel_rate)
+			continue;
+
+		blog(LOG_INFO, "Go live planner: '%s' sustains %" PRIu64 " of %" PRIu64 " pixels/s", encoder_id,
+		     *pixel_rate, required);
+		capacity.push_back({encoder_id, *pixel_rate});
+
+		if (*pixel_rate >= required)
+			break;
+	}
+
+	return capacity;
+}
+
+std::vector<GoLiveApi::EncoderCapacity> DefaultEncoderCapacity()
+{
+	for (auto encoder_id : planner_encoders) {
+		if (!obs_get_encoder_codec(encoder_id))
+			continue;
+
+		bool software = strcmp(encoder_id, "obs_x264") == 0;
+		return {{encoder_id, software ? DEFAULT_SOFTWARE_PIXEL_RATE : DEFAULT_HARDWARE_PIXEL_RATE}};
+	}
+
+	return {};
+}
+
+std::optional<GoLiveApi::Config> PlanGoLiveConfig(const GoLiveApi::PostData &post_data,
+						  const std::vector<GoLiveApi::EncoderCapacity> &capacity)
+{
+	auto required = ladder_pixel_rate(plan_ladder(post_data.preferences, UINT64_MAX));
+
+	/* the first encoder (in order of preference) able to carry the whole
+	 * ladder, otherwise the most capable one */
+	const GoLiveApi::EncoderCapacity *encoder = nullptr;
+	for (auto &entry : capacity) {
+		if (!obs_get_encoder_codec(entry.encoder_id.c_str()))
+			continue;
+
+		if (!encoder || (encoder->max_pixel_rate < required && entry.max_pixel_rate > encoder->max_pixel_rate))
+			encoder = &entry;
+	}
+
+	if (!encoder) {
+		blog(LOG_WARNING, "Go live planner: No measured encoder available");
+		return std::nullopt;
+	}
+
+	auto ladder = plan_ladder(post_data.preferences, encoder->max_pixel_rate);
+	if (ladder.empty()) {
+		blog(LOG_WARNING, "Go live planner: No track fits the limits");
+		return std::nullopt;
+	}
+
+	GoLiveApi::Config config;
+	config.meta.service = post_data.service;
+	config.meta.schema_version = post_data.schema_version;
+
+	for (auto &rung : ladder) {
+		GoLiveApi::VideoEncoderConfiguration video;
+		video.type = encoder->encoder_id;
+		video.width = rung.width;
+		video.height = rung.height;
+		video.framerate = rung.framerate;
+		video.settings = rung_settings(rung);
+		video.settings["profile"] = "high";
+		video.canvas_index = rung.canvas_index;
+
+		blog(LOG_INFO, "Go live planner: %ux%u@%.2f %u kbps on canvas %u with '%s'", rung.width, rung.height,
+		     rung.FrameRate(), rung.bitrate, rung.canvas_index, encoder->encoder_id.c_str());
+		config.encoder_configurations.push_back(std::move(video));
+	}
+
+	const auto &preferences = post_data.preferences;
+
+	GoLiveApi::AudioEncoderConfiguration audio;
+	audio.codec = "aac";
+	audio.track_id = 1;
+	audio.channels = preferences.audio_channels ? preferences.audio_channels : 2;
+	audio.settings = json::object();
+	audio.settings["bitrate"] = 80 * audio.channels;
+	config.audio_configurations.live.push_back(audio);
+
+	if (preferences.vod_track_audio) {
+		audio.track_id = 2;
+		config.audio_configurations.vod = {audio};
+	}
+
+	return config;
+}
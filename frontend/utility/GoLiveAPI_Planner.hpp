@@ -0,0 +1,25 @@
+#pragma once
+
+#include "models/multitrack-video.hpp"
+
+#include <atomic>
+#include <optional>
+#include <vector>
+
+/** Briefly runs the ladder PlanGoLiveConfig would use for the main canvas on
+ * each available H.264 encoder, and estimates the pixel rate each one can
+ * sustain.  Stops at the first encoder able to carry the whole ladder.  Blocks
+ * for a few seconds per encoder, must not be called from the UI thread.
+ * Returns std::nullopt soon after cancel is set. */
+std::optional<std::vector<GoLiveApi::EncoderCapacity>> MeasureEncoderCapacity(const GoLiveApi::PostData &post_data,
+									      const std::atomic_bool &cancel);
+
+/** A conservative guess at the capacity of the preferred available encoder,
+ * for planning before MeasureEncoderCapacity has run.  Does not block. */
+std::vector<GoLiveApi::EncoderCapacity> DefaultEncoderCapacity();
+
+/** Builds a config for the canvases in post_data without the go live server,
+ * within the given encoder capacity and the track count and aggregate
+ * bitrate preferences.  Ingest endpoints are left to the caller. */
+std::optional<GoLiveApi::Config> PlanGoLiveConfig(const GoLiveApi::PostData &post_data,
+						  const std::vector<GoLiveApi::EncoderCapacity> &capacity);
@@ -1,13 +1,16 @@
 #include "MultitrackVideoError.hpp"
 #include "MultitrackVideoOutput.hpp"
 #include "models/multitrack-video.hpp"
+#include "GoLiveAPI_ConfigCache.hpp"
 #include "GoLiveAPI_Network.hpp"
+#include "GoLiveAPI_Planner.hpp"
 #include "GoLiveAPI_PostData.hpp"
 
 #include <OBSApp.hpp>
 
 #include <bpm.h>
 #include <util/dstr.hpp>
+#include <util/threading.h>
 #include <libavformat/avformat.h>
 #include <utility/RemoteTextThread.hpp>
 
@@ -17,6 +20,7 @@
 #include <QUrl>
 #include <QUrlQuery>
 
+#include <chrono>
 #include <cinttypes>
 
 using json = nlohmann::json;
@@ -32,6 +36,9 @@ static const char *av1_main = "Main";
 // Maximum reconnect attempts with an invalid key error before giving up (roughly 30 seconds with default start value)
 static constexpr uint8_t MAX_RECONNECT_ATTEMPTS = 5;
 
+// Time for the encoders of a stopped stream to be released before measuring encoder capacity
+static constexpr auto CAPACITY_BENCHMARK_DELAY = std::chrono::seconds(10);
+
 Qt::ConnectionType BlockingConnectionTypeFor(QObject *object)
 {
 	return object->thread() == QThread::currentThread() ? Qt::DirectConnection : Qt::BlockingQueuedConnection;
@@ -291,6 +298,9 @@ static OBSEncoderAutoRelease create_video_encoder(DStr &name_buffer, size_t enco
 		obs_data_set_int(encoder_settings, "profile", vaapi_profile);
 	}
 	obs_data_set_bool(encoder_settings, "disable_scenecut", true);
+	/* encoders that support it (x264) reuse the frame type decisions of
+	 * the largest track, which keeps keyframes aligned */
+	obs_data_set_bool(encoder_settings, "share_analysis", true);
 
 	OBSEncoderAutoRelease video_encoder =
 		obs_video_encoder_create(encoder_type, name_buffer, encoder_settings, nullptr);
@@ -442,6 +452,9 @@ void MultitrackVideoOutput::PrepareStreaming(
 
 	restart_on_error = false;
 
+	/* The encoders are about to be needed for the stream */
+	StopCapacityBenchmark();
+
 	std::optional<GoLiveApi::Config> go_live_config;
 	std::optional<GoLiveApi::Config> custom;
 	bool is_custom_config = custom_config.has_value();
@@ -504,7 +517,41 @@ void MultitrackVideoOutput::PrepareStreaming(
 		auto go_live_post = constructGoLivePost(stream_key, maximum_aggregate_bitrate, maximum_video_tracks,
 							vod_track_mixer.has_value(), canvases);
 
-		go_live_config = DownloadGoLiveConfig(parent, auto_config_url, go_live_post, multitrack_video_name);
+		/* Without the go live server, fall back to the last config it
+		 * handed out for this setup, or plan one locally */
+		auto offline_plan = [&]() -> std::optional<GoLiveApi::Config> {
+			if (auto config = LoadCachedGoLiveConfig(GoLiveCapabilitiesHash(auto_config_url, go_live_post))) {
+				blog(LOG_INFO, "Using cached go live config");
+				return config;
+			}
+
+			auto capacity = LoadCachedEncoderCapacity(EncoderCapacityHash(go_live_post));
+			if (!capacity) {
+				blog(LOG_INFO, "Encoder capacity not measured yet, planning with defaults");
+				capacity = DefaultEncoderCapacity();
+
+				const std::lock_guard benchmark_lock{benchmark_mutex};
+				benchmark_post_data = go_live_post;
+			}
+
+			auto config = PlanGoLiveConfig(go_live_post, *capacity);
+			if (!config || rtmp_url.has_value())
+				return config;
+
+			const char *server_url = obs_service_get_connect_info(service, OBS_SERVICE_CONNECT_INFO_SERVER_URL);
+			std::string server = server_url ? server_url : "";
+			if (server.empty() || server == "auto")
+				return std::nullopt;
+
+			GoLiveApi::IngestEndpoint endpoint;
+			endpoint.protocol = qstrnicmp(server.c_str(), "rtmps", 5) == 0 ? "RTMPS" : "RTMP";
+			endpoint.url_template = server;
+			config->ingest_endpoints.push_back(std::move(endpoint));
+			return config;
+		};
+
+		go_live_config =
+			DownloadGoLiveConfig(parent, auto_config_url, go_live_post, multitrack_video_name, offline_plan);
 	}
 
 	if (custom_config.has_value()) {
@@ -906,6 +953,57 @@ std::optional<MultitrackVideoOutput::OBSOutputObjects> MultitrackVideoOutput::ta
 	return val;
 }
 
+MultitrackVideoOutput::~MultitrackVideoOutput()
+{
+	StopCapacityBenchmark();
+}
+
+void MultitrackVideoOutput::StartCapacityBenchmark()
+{
+	const std::lock_guard benchmark_lock{benchmark_mutex};
+	if (!benchmark_post_data || benchmark_thread.joinable())
+		return;
+
+	benchmark_cancel = false;
+	benchmark_thread = std::thread([this, post_data = std::move(*benchmark_post_data)] {
+		os_set_thread_name("multitrack video: encoder capacity benchmark");
+
+		{
+			std::unique_lock lock{benchmark_mutex};
+			benchmark_cv.wait_for(lock, CAPACITY_BENCHMARK_DELAY, [&] { return !!benchmark_cancel; });
+		}
+
+		std::optional<std::vector<GoLiveApi::EncoderCapacity>> capacity;
+		if (!benchmark_cancel)
+			capacity = MeasureEncoderCapacity(post_data, benchmark_cancel);
+
+		if (capacity && !capacity->empty()) {
+			StoreCachedEncoderCapacity(EncoderCapacityHash(post_data), *capacity);
+			return;
+		}
+
+		/* measure after the next stream instead */
+		const std::lock_guard benchmark_lock{benchmark_mutex};
+		if (!benchmark_post_data)
+			benchmark_post_data = post_data;
+	});
+	benchmark_post_data.reset();
+}
+
+void MultitrackVideoOutput::StopCapacityBenchmark()
+{
+	std::thread thread;
+	{
+		const std::lock_guard benchmark_lock{benchmark_mutex};
+		benchmark_cancel = true;
+		thread = std::move(benchmark_thread);
+	}
+
+	benchmark_cv.notify_all();
+	if (thread.joinable())
+		thread.join();
+}
+
 void MultitrackVideoOutput::ReleaseOnMainThread(std::optional<OBSOutputObjects> objects)
 {
 
@@ -941,6 +1039,7 @@ void StreamStopHandler(void *arg, calldata_t *data)
 	bpm_destroy(static_cast<obs_output_t *>(calldata_ptr(data, "output")));
 
 	MultitrackVideoOutput::ReleaseOnMainThread(self->take_current());
+	self->StartCapacityBenchmark();
 }
 
 void RecordingStartHandler(void * /* arg */, calldata_t * /* data */)
@@ -1,12 +1,17 @@
 #pragma once
 
+#include "models/multitrack-video.hpp"
+
 #include <obs.hpp>
 #include <util/config-file.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
 class QString;
@@ -22,6 +27,8 @@ bool MultitrackVideoDeveloperModeEnabled();
 
 struct MultitrackVideoOutput {
 public:
+	~MultitrackVideoOutput();
+
 	void PrepareStreaming(QWidget *parent, const char *service_name, obs_service_t *service,
 			      const std::optional<std::string> &rtmp_url, const QString &stream_key,
 			      const char *audio_encoder_id, std::optional<uint32_t> maximum_aggregate_bitrate,
@@ -56,6 +63,9 @@ private:
 
 	static void ReleaseOnMainThread(std::optional<OBSOutputObjects> objects);
 
+	void StartCapacityBenchmark();
+	void StopCapacityBenchmark();
+
 	std::mutex current_mutex;
 	std::optional<OBSOutputObjects> current;
 
@@ -65,6 +75,14 @@ private:
 	bool restart_on_error = false;
 	uint8_t reconnect_attempts = 0;
 
+	/* Encoder capacity missing from the cache is measured after the stream
+	 * that had to do without it, never while going live */
+	std::mutex benchmark_mutex;
+	std::condition_variable benchmark_cv;
+	std::optional<GoLiveApi::PostData> benchmark_post_data;
+	std::thread benchmark_thread;
+	std::atomic_bool benchmark_cancel = false;
+
 	friend void StreamStartHandler(void *arg, calldata_t *data);
 	friend void StreamStopHandler(void *arg, calldata_t *data);
 	friend void RecordingStartHandler(void *arg, calldata_t *data);
@@ -292,4 +292,15 @@ struct Config {
 	NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Config, meta, status, ingest_endpoints, encoder_configurations,
 						    audio_configurations)
 };
+
+// Local planning
+
+/* Measured throughput of a video encoder, used to plan a config when the go
+ * live server can't be reached */
+struct EncoderCapacity {
+	string encoder_id;
+	uint64_t max_pixel_rate; // pixels per second the encoder keeps up with
+
+	NLOHMANN_DEFINE_TYPE_INTRUSIVE(EncoderCapacity, encoder_id, max_pixel_rate)
+};
 } // namespace GoLiveApi
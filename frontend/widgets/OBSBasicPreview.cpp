@@ -27,6 +27,8 @@ OBSBasicPreview::~OBSBasicPreview()
 		gs_vertexbuffer_destroy(rectFill);
 	if (circleFill)
 		gs_vertexbuffer_destroy(circleFill);
+	if (handleBatch)
+		gs_sprite_batch_destroy(handleBatch);
 	if (stripedLineEffect)
 		gs_effect_destroy(stripedLineEffect);
 
@@ -1659,7 +1661,7 @@ static void DrawLine(float x1, float y1, float x2, float y2, float thickness, ve
 	gs_matrix_pop();
 }
 
-static void DrawSquareAtPos(float x, float y, float pixelRatio)
+static void AddSquareAtPos(gs_sprite_batch_t *batch, float x, float y, float pixelRatio)
 {
 	struct vec3 pos;
 	vec3_set(&pos, x, y, 0.0f);
@@ -1668,14 +1670,11 @@ static void DrawSquareAtPos(float x, float y, float pixelRatio)
 	gs_matrix_get(&matrix);
 	vec3_transform(&pos, &pos, &matrix);
 
+	const float radius = HANDLE_RADIUS * pixelRatio;
+
 	gs_matrix_push();
 	gs_matrix_identity();
-	gs_matrix_translate(&pos);
-
-	gs_matrix_translate3f(-HANDLE_RADIUS * pixelRatio, -HANDLE_RADIUS * pixelRatio, 0.0f);
-	gs_matrix_scale3f(HANDLE_RADIUS * pixelRatio * 2, HANDLE_RADIUS * pixelRatio * 2, 1.0f);
-	gs_draw(GS_TRISTRIP, 0, 0);
-
+	gs_sprite_batch_add(batch, pos.x - radius, pos.y - radius, radius * 2, radius * 2, nullptr, 0xFFFFFFFF);
 	gs_matrix_pop();
 }
 
@@ -2011,14 +2010,19 @@ bool OBSBasicPreview::DrawSelectedItem(obs_scene_t *, obs_sceneitem_t *item, voi
 	gs_effect_set_vec4(colParam, &red);
 
 	if (selected) {
-		DrawSquareAtPos(0.0f, 0.0f, pixelRatio);
-		DrawSquareAtPos(0.0f, 1.0f, pixelRatio);
-		DrawSquareAtPos(1.0f, 0.0f, pixelRatio);
-		DrawSquareAtPos(1.0f, 1.0f, pixelRatio);
-		DrawSquareAtPos(0.5f, 0.0f, pixelRatio);
-		DrawSquareAtPos(0.0f, 0.5f, pixelRatio);
-		DrawSquareAtPos(0.5f, 1.0f, pixelRatio);
-		DrawSquareAtPos(1.0f, 0.5f, pixelRatio);
+		if (!prev->handleBatch)
+			prev->handleBatch = gs_sprite_batch_create(8);
+
+		AddSquareAtPos(prev->handleBatch, 0.0f, 0.0f, pixelRatio);
+		AddSquareAtPos(prev->handleBatch, 0.0f, 1.0f, pixelRatio);
+		AddSquareAtPos(prev->handleBatch, 1.0f, 0.0f, pixelRatio);
+		AddSquareAtPos(prev->handleBatch, 1.0f, 1.0f, pixelRatio);
+		AddSquareAtPos(prev->handleBatch, 0.5f, 0.0f, pixelRatio);
+		AddSquareAtPos(prev->handleBatch, 0.0f, 0.5f, pixelRatio);
+		AddSquareAtPos(prev->handleBatch, 0.5f, 1.0f, pixelRatio);
+		AddSquareAtPos(prev->handleBatch, 1.0f, 0.5f, pixelRatio);
+		gs_sprite_batch_draw(prev->handleBatch);
+		gs_sprite_batch_clear(prev->handleBatch);
 
 		if (!prev->circleFill) {
 			gs_render_start(true);
@@ -55,6 +55,7 @@ private:
 	gs_texture_t *overflow = nullptr;
 	gs_vertbuffer_t *rectFill = nullptr;
 	gs_vertbuffer_t *circleFill = nullptr;
+	gs_sprite_batch_t *handleBatch = nullptr;
 	gs_effect_t *solidEffect = nullptr;
 	gs_effect_t *stripedLineEffect = nullptr;
 
@@ -18,6 +18,8 @@
 
 #include "../util/bmem.h"
 #include "../util/base.h"
+#include "../util/threading.h"
+#include "../util/platform.h"
 
 #include "calldata.h"
 
@@ -236,3 +238,190 @@ bool calldata_get_string(const calldata_t *data, const char *name, const char **
 	*str = cd_serialize_string(&pos);
 	return true;
 }
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ *   The template stack of a signature holds every declared parameter zeroed,
+ * followed by a hidden parameter holding the signature id:
+ *
+ *     [param1] [...] [size_t 12] ["__signature"] [size_t 8] [uint64_t id]
+ *     [size_t 0]
+ *
+ *   Parameters only move when one of them is set with a different size, in
+ * which case the id moves as well and the calldata no longer matches the
+ * signature.  Parameters added afterwards go after the id.
+ */
+
+#define SIGNATURE_MARKER "__signature"
+
+enum {
+	SIGNATURE_UNINITIALIZED,
+	SIGNATURE_INITIALIZING,
+	SIGNATURE_READY,
+	SIGNATURE_INVALID,
+};
+
+static size_t param_type_size(enum call_param_type type)
+{
+	switch (type) {
+	case CALL_PARAM_TYPE_INT:
+		return sizeof(long long);
+	case CALL_PARAM_TYPE_FLOAT:
+		return sizeof(double);
+	case CALL_PARAM_TYPE_BOOL:
+		return sizeof(bool);
+	case CALL_PARAM_TYPE_PTR:
+		return sizeof(void *);
+	case CALL_PARAM_TYPE_VOID:
+	case CALL_PARAM_TYPE_STRING:
+		break;
+	}
+
+	return 0;
+}
+
+static inline uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static bool signature_build(struct calldata_signature *sig)
+{
+	uint8_t *pos = sig->stack;
+	uint8_t *end = sig->stack + sizeof(sig->stack);
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	size_t marker_size = sizeof(SIGNATURE_MARKER);
+	size_t i;
+
+	for (i = 0; i < CALLDATA_SIGNATURE_MAX_PARAMS && sig->params[i].name; i++) {
+		const struct calldata_param *param = &sig->params[i];
+		size_t name_size = strlen(param->name) + 1;
+		size_t size = param_type_size(param->type);
+
+		if (name_size == 1 || !size) {
+			blog(LOG_ERROR, "calldata_init_signature: Parameter '%s' must have a name and a fixed size",
+			     param->name);
+			return false;
+		}
+		if ((size_t)(end - pos) < sizeof(size_t) * 2 + name_size + size)
+			goto too_large;
+
+		cd_copy_string(&pos, param->name, name_size);
+		memcpy(pos, &size, sizeof(size_t));
+		pos += sizeof(size_t);
+		sig->offsets[i] = pos - sig->stack;
+		memset(pos, 0, size);
+		pos += size;
+
+		hash = hash_bytes(hash, param->name, name_size);
+		hash = hash_bytes(hash, &param->type, sizeof(param->type));
+	}
+
+	if ((size_t)(end - pos) < sizeof(size_t) * 3 + marker_size + sizeof(uint64_t))
+		goto too_large;
+
+	sig->num_params = i;
+	sig->id = hash;
+
+	cd_copy_string(&pos, SIGNATURE_MARKER, marker_size);
+	memcpy(pos, &(size_t){sizeof(uint64_t)}, sizeof(size_t));
+	pos += sizeof(size_t);
+	sig->id_offset = pos - sig->stack;
+	memcpy(pos, &hash, sizeof(uint64_t));
+	pos += sizeof(uint64_t);
+	memset(pos, 0, sizeof(size_t));
+	pos += sizeof(size_t);
+
+	sig->size = pos - sig->stack;
+	return true;
+
+too_large:
+	blog(LOG_ERROR, "calldata_init_signature: Signature exceeds %d bytes", CALLDATA_SIGNATURE_STACK_SIZE);
+	return false;
+}
+
+static bool signature_ready(struct calldata_signature *sig)
+{
+	long state = os_atomic_load_long(&sig->state);
+
+	while (state != SIGNATURE_READY && state != SIGNATURE_INVALID) {
+		if (os_atomic_compare_swap_long(&sig->state, SIGNATURE_UNINITIALIZED, SIGNATURE_INITIALIZING)) {
+			state = signature_build(sig) ? SIGNATURE_READY : SIGNATURE_INVALID;
+			os_atomic_set_long(&sig->state, state);
+			break;
+		}
+
+		os_sleep_ms(0);
+		state = os_atomic_load_long(&sig->state);
+	}
+
+	return state == SIGNATURE_READY;
+}
+
+void calldata_init_signature(calldata_t *data, struct calldata_signature *sig, uint8_t *stack, size_t size)
+{
+	calldata_init_fixed(data, stack, size);
+
+	if (!signature_ready(sig))
+		return;
+	if (sig->size >= size) {
+		blog(LOG_ERROR, "calldata_init_signature: Stack too small for signature");
+		return;
+	}
+
+	memcpy(stack, sig->stack, sig->size);
+	data->size = sig->size;
+}
+
+bool calldata_has_signature(const calldata_t *data, struct calldata_signature *sig)
+{
+	if (!data || !data->stack || !signature_ready(sig) || data->size < sig->size)
+		return false;
+
+	return memcmp(data->stack + sig->id_offset, &sig->id, sizeof(uint64_t)) == 0 &&
+	       memcmp(data->stack + sig->id_offset - sizeof(size_t) - sizeof(SIGNATURE_MARKER), SIGNATURE_MARKER,
+		      sizeof(SIGNATURE_MARKER)) == 0;
+}
+
+static inline bool sig_param_valid(struct calldata_signature *sig, size_t idx, enum call_param_type type)
+{
+	if (idx >= CALLDATA_SIGNATURE_MAX_PARAMS || !sig->params[idx].name || sig->params[idx].type != type) {
+		blog(LOG_ERROR, "calldata_sig: Parameter %zu does not exist or is not of the requested type", idx);
+		return false;
+	}
+
+	return true;
+}
+
+bool calldata_sig_get_data(const calldata_t *data, struct calldata_signature *sig, size_t idx,
+			   enum call_param_type type, void *out, size_t size)
+{
+	if (!data || !sig || !sig_param_valid(sig, idx, type))
+		return false;
+
+	if (!calldata_has_signature(data, sig))
+		return calldata_get_data(data, sig->params[idx].name, out, size);
+
+	memcpy(out, data->stack + sig->offsets[idx], size);
+	return true;
+}
+
+void calldata_sig_set_data(calldata_t *data, struct calldata_signature *sig, size_t idx, enum call_param_type type,
+			   const void *in, size_t size)
+{
+	if (!data || !sig || !sig_param_valid(sig, idx, type))
+		return;
+
+	if (!calldata_has_signature(data, sig)) {
+		calldata_set_data(data, sig->params[idx].name, in, size);
+		return;
+	}
+
+	memcpy(data->stack + sig->offsets[idx], in, size);
+}
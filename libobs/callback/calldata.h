@@ -190,6 +190,136 @@ static inline void calldata_set_string(calldata_t *data, const char *name, const
 		calldata_set_data(data, name, NULL, 0);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Signatures
+ *
+ *   A signature declares the parameters of a frequently emitted signal or
+ * procedure up front.  Calldata initialized from a signature already contains
+ * every parameter at a precomputed offset, so the calldata_sig_* functions set
+ * and get them by index without any name lookups or allocations.
+ *
+ *   Only fixed-size types (int, float, bool and ptr) can be declared.  The
+ * calldata remains a regular calldata: handlers using the name-based
+ * functions keep working, and the calldata_sig_* functions fall back to name
+ * lookups when given calldata that was not initialized from an equivalent
+ * signature.
+ *
+ *   Signatures are identified by their contents, so a plugin declaring the
+ * same parameter list as libobs takes the fast path as well.  They must have
+ * static storage duration.
+ *
+ *   static struct calldata_signature source_signature =
+ *           CALLDATA_SIGNATURE({"source", CALL_PARAM_TYPE_PTR});
+ *
+ *   uint8_t stack[CALLDATA_SIGNATURE_STACK_SIZE];
+ *   calldata_t cd;
+ *   calldata_init_signature(&cd, &source_signature, stack, sizeof(stack));
+ *   calldata_sig_set_ptr(&cd, &source_signature, 0, source);
+ */
+
+#define CALLDATA_SIGNATURE_MAX_PARAMS 8
+#define CALLDATA_SIGNATURE_STACK_SIZE 256
+
+struct calldata_param {
+	const char *name;
+	enum call_param_type type;
+};
+
+struct calldata_signature {
+	struct calldata_param params[CALLDATA_SIGNATURE_MAX_PARAMS];
+
+	/* computed on first use */
+	volatile long state;
+	uint64_t id;
+	size_t num_params;
+	size_t size;
+	size_t id_offset;
+	size_t offsets[CALLDATA_SIGNATURE_MAX_PARAMS];
+	uint8_t stack[CALLDATA_SIGNATURE_STACK_SIZE];
+};
+
+#define CALLDATA_SIGNATURE(...) {{__VA_ARGS__}}
+
+EXPORT void calldata_init_signature(calldata_t *data, struct calldata_signature *sig, uint8_t *stack, size_t size);
+EXPORT bool calldata_has_signature(const calldata_t *data, struct calldata_signature *sig);
+
+EXPORT bool calldata_sig_get_data(const calldata_t *data, struct calldata_signature *sig, size_t idx,
+				  enum call_param_type type, void *out, size_t size);
+EXPORT void calldata_sig_set_data(calldata_t *data, struct calldata_signature *sig, size_t idx,
+				  enum call_param_type type, const void *in, size_t size);
+
+static inline bool calldata_sig_get_int(const calldata_t *data, struct calldata_signature *sig, size_t idx,
+					long long *val)
+{
+	return calldata_sig_get_data(data, sig, idx, CALL_PARAM_TYPE_INT, val, sizeof(*val));
+}
+
+static inline bool calldata_sig_get_float(const calldata_t *data, struct calldata_signature *sig, size_t idx,
+					  double *val)
+{
+	return calldata_sig_get_data(data, sig, idx, CALL_PARAM_TYPE_FLOAT, val, sizeof(*val));
+}
+
+static inline bool calldata_sig_get_bool(const calldata_t *data, struct calldata_signature *sig, size_t idx,
+					 bool *val)
+{
+	return calldata_sig_get_data(data, sig, idx, CALL_PARAM_TYPE_BOOL, val, sizeof(*val));
+}
+
+static inline bool calldata_sig_get_ptr(const calldata_t *data, struct calldata_signature *sig, size_t idx,
+					void *p_ptr)
+{
+	return calldata_sig_get_data(data, sig, idx, CALL_PARAM_TYPE_PTR, p_ptr, sizeof(void *));
+}
+
+static inline long long calldata_sig_int(const calldata_t *data, struct calldata_signature *sig, size_t idx)
+{
+	long long val = 0;
+	calldata_sig_get_int(data, sig, idx, &val);
+	return val;
+}
+
+static inline double calldata_sig_float(const calldata_t *data, struct calldata_signature *sig, size_t idx)
+{
+	double val = 0.0;
+	calldata_sig_get_float(data, sig, idx, &val);
+	return val;
+}
+
+static inline bool calldata_sig_bool(const calldata_t *data, struct calldata_signature *sig, size_t idx)
+{
+	bool val = false;
+	calldata_sig_get_bool(data, sig, idx, &val);
+	return val;
+}
+
+static inline void *calldata_sig_ptr(const calldata_t *data, struct calldata_signature *sig, size_t idx)
+{
+	void *val = NULL;
+	calldata_sig_get_ptr(data, sig, idx, &val);
+	return val;
+}
+
+static inline void calldata_sig_set_int(calldata_t *data, struct calldata_signature *sig, size_t idx, long long val)
+{
+	calldata_sig_set_data(data, sig, idx, CALL_PARAM_TYPE_INT, &val, sizeof(val));
+}
+
+static inline void calldata_sig_set_float(calldata_t *data, struct calldata_signature *sig, size_t idx, double val)
+{
+	calldata_sig_set_data(data, sig, idx, CALL_PARAM_TYPE_FLOAT, &val, sizeof(val));
+}
+
+static inline void calldata_sig_set_bool(calldata_t *data, struct calldata_signature *sig, size_t idx, bool val)
+{
+	calldata_sig_set_data(data, sig, idx, CALL_PARAM_TYPE_BOOL, &val, sizeof(val));
+}
+
+static inline void calldata_sig_set_ptr(calldata_t *data, struct calldata_signature *sig, size_t idx, void *ptr)
+{
+	calldata_sig_set_data(data, sig, idx, CALL_PARAM_TYPE_PTR, &ptr, sizeof(ptr));
+}
+
 #ifdef __cplusplus
 }
 #endif
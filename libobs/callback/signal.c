@@ -16,24 +16,287 @@
 
 #include "../util/darray.h"
 #include "../util/threading.h"
+#include "../util/platform.h"
 
 #include "decl.h"
 #include "signal.h"
 
 struct signal_callback {
-	signal_callback_t callback;
+	union {
+		signal_callback_t callback;
+		global_signal_callback_t global_callback;
+	};
 	void *data;
-	bool remove;
+	volatile bool remove;
 	bool keep_ref;
 };
 
+/* immutable, replaced as a whole whenever a callback is connected or
+ * disconnected */
+struct callback_snapshot {
+	size_t num;
+	struct signal_callback *callbacks[];
+};
+
+/*
+ * Callbacks are emitted from the current snapshot without taking any locks.
+ * Emitting threads count themselves in one of two reader counters, and
+ * replaced snapshots and callbacks are only freed once both counters have
+ * been seen at zero after they were replaced, which means no emit can still
+ * be using them.  The epoch selects the counter new emits use, so that the
+ * one being waited on drains.
+ */
+struct callback_list {
+	struct callback_snapshot *volatile snapshot;
+	volatile long epoch;
+	volatile long readers[2];
+
+	/* serializes connect and disconnect */
+	pthread_mutex_t mutex;
+	DARRAY(void *) retired;
+};
+
+struct emit_frame {
+	struct callback_list *list;
+	struct emit_frame *prev;
+	bool removed;
+};
+
+static THREAD_LOCAL struct emit_frame *current_emit = NULL;
+static THREAD_LOCAL struct signal_callback *current_cb = NULL;
+
+static inline bool callback_list_init(struct callback_list *list)
+{
+	memset(list, 0, sizeof(*list));
+	return pthread_mutex_init(&list->mutex, NULL) == 0;
+}
+
+static void callback_list_free(struct callback_list *list)
+{
+	struct callback_snapshot *snapshot = list->snapshot;
+
+	if (snapshot) {
+		for (size_t i = 0; i < snapshot->num; i++)
+			bfree(snapshot->callbacks[i]);
+		bfree(snapshot);
+	}
+
+	for (size_t i = 0; i < list->retired.num; i++)
+		bfree(list->retired.array[i]);
+	da_free(list->retired);
+
+	pthread_mutex_destroy(&list->mutex);
+}
+
+static inline struct callback_snapshot *get_snapshot(struct callback_list *list)
+{
+	return os_atomic_load_ptr((void *const volatile *)&list->snapshot);
+}
+
+static inline bool emitting(struct callback_list *list)
+{
+	for (struct emit_frame *frame = current_emit; frame; frame = frame->prev) {
+		if (frame->list == list)
+			return true;
+	}
+
+	return false;
+}
+
+static bool readers_done(struct callback_list *list, bool wait)
+{
+	for (long idx = 0; idx < 2; idx++) {
+		os_atomic_store_long(&list->epoch, idx ^ 1);
+
+		while (os_atomic_load_long(&list->readers[idx]) != 0) {
+			if (!wait)
+				return false;
+			os_sleep_ms(0);
+		}
+	}
+
+	return true;
+}
+
+/* frees replaced snapshots and callbacks, waiting for emits that may still be
+ * using them if requested.  Can't wait from within an emit of the same list,
+ * as it would wait for itself, in which case they are freed later. */
+static void callback_list_reclaim(struct callback_list *list, bool wait)
+{
+	DARRAY(void *) garbage;
+
+	da_init(garbage);
+
+	pthread_mutex_lock(&list->mutex);
+	da_move(garbage, list->retired);
+	pthread_mutex_unlock(&list->mutex);
+
+	if (!garbage.num)
+		return;
+
+	if (readers_done(list, wait && !emitting(list))) {
+		for (size_t i = 0; i < garbage.num; i++)
+			bfree(garbage.array[i]);
+	} else {
+		pthread_mutex_lock(&list->mutex);
+		da_push_back_da(list->retired, garbage);
+		pthread_mutex_unlock(&list->mutex);
+	}
+
+	da_free(garbage);
+}
+
+/* list mutex must be held.  new_cb is appended, callbacks marked for removal
+ * are left out and retired along with the current snapshot.  Returns the
+ * number of removed callbacks that held a handler reference. */
+static long callback_list_replace(struct callback_list *list, struct signal_callback *new_cb)
+{
+	struct callback_snapshot *old = get_snapshot(list);
+	struct callback_snapshot *snapshot;
+	size_t num = old ? old->num : 0;
+	long removed_refs = 0;
+
+	snapshot = bmalloc(sizeof(*snapshot) + (num + 1) * sizeof(struct signal_callback *));
+	snapshot->num = 0;
+
+	for (size_t i = 0; i < num; i++) {
+		struct signal_callback *cb = old->callbacks[i];
+
+		if (os_atomic_load_bool(&cb->remove)) {
+			if (cb->keep_ref)
+				removed_refs++;
+			da_push_back(list->retired, &cb);
+		} else {
+			snapshot->callbacks[snapshot->num++] = cb;
+		}
+	}
+
+	if (new_cb)
+		snapshot->callbacks[snapshot->num++] = new_cb;
+
+	if (!snapshot->num) {
+		bfree(snapshot);
+		snapshot = NULL;
+	}
+
+	os_atomic_store_ptr((void *volatile *)&list->snapshot, snapshot);
+	if (old)
+		da_push_back(list->retired, &old);
+
+	return removed_refs;
+}
+
+static inline struct signal_callback *callback_list_find(struct callback_list *list, void *callback, void *data)
+{
+	struct callback_snapshot *snapshot = get_snapshot(list);
+
+	for (size_t i = 0; snapshot && i < snapshot->num; i++) {
+		struct signal_callback *cb = snapshot->callbacks[i];
+
+		if ((void *)cb->callback == callback && cb->data == data && !os_atomic_load_bool(&cb->remove))
+			return cb;
+	}
+
+	return NULL;
+}
+
+/* returns the number of removed callbacks that held a handler reference, as
+ * callbacks that removed themselves during an emit are left out as well */
+static long callback_list_connect(struct callback_list *list, const struct signal_callback *cb_data)
+{
+	long removed_refs = 0;
+
+	pthread_mutex_lock(&list->mutex);
+
+	if (cb_data->keep_ref || !callback_list_find(list, (void *)cb_data->callback, cb_data->data)) {
+		struct signal_callback *cb = bmalloc(sizeof(struct signal_callback));
+		*cb = *cb_data;
+		removed_refs = callback_list_replace(list, cb);
+	}
+
+	pthread_mutex_unlock(&list->mutex);
+
+	callback_list_reclaim(list, false);
+	return removed_refs;
+}
+
+/* once this returns the callback is no longer being called, unless it is
+ * disconnected from within an emit of the same signal */
+static long callback_list_disconnect(struct callback_list *list, void *callback, void *data)
+{
+	struct signal_callback *cb;
+	long removed_refs = 0;
+
+	pthread_mutex_lock(&list->mutex);
+
+	cb = callback_list_find(list, callback, data);
+	if (cb) {
+		os_atomic_store_bool(&cb->remove, true);
+		removed_refs = callback_list_replace(list, NULL);
+	}
+
+	pthread_mutex_unlock(&list->mutex);
+
+	if (cb)
+		callback_list_reclaim(list, true);
+	return removed_refs;
+}
+
+/* removes callbacks that removed themselves during an emit */
+static long callback_list_remove_flagged(struct callback_list *list)
+{
+	long removed_refs;
+
+	pthread_mutex_lock(&list->mutex);
+	removed_refs = callback_list_replace(list, NULL);
+	pthread_mutex_unlock(&list->mutex);
+
+	callback_list_reclaim(list, false);
+	return removed_refs;
+}
+
+static long callback_list_emit(struct callback_list *list, const char *signal, calldata_t *params, bool global)
+{
+	struct emit_frame frame = {list, current_emit, false};
+	struct signal_callback *prev_cb = current_cb;
+	struct callback_snapshot *snapshot;
+	long idx = os_atomic_load_long(&list->epoch) & 1;
+
+	os_atomic_inc_long(&list->readers[idx]);
+
+	snapshot = get_snapshot(list);
+	if (snapshot) {
+		current_emit = &frame;
+
+		for (size_t i = 0; i < snapshot->num; i++) {
+			struct signal_callback *cb = snapshot->callbacks[i];
+
+			if (os_atomic_load_bool(&cb->remove))
+				continue;
+
+			current_cb = cb;
+			if (global)
+				cb->global_callback(cb->data, signal, params);
+			else
+				cb->callback(cb->data, params);
+		}
+
+		current_cb = prev_cb;
+		current_emit = frame.prev;
+	}
+
+	os_atomic_dec_long(&list->readers[idx]);
+
+	return frame.removed ? callback_list_remove_flagged(list) : 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
 struct signal_info {
 	struct decl_info func;
-	DARRAY(struct signal_callback) callbacks;
-	pthread_mutex_t mutex;
-	bool signalling;
+	struct callback_list callbacks;
 
-	struct signal_info *next;
+	struct signal_info *volatile next;
 };
 
 static inline struct signal_info *signal_info_create(struct decl_info *info)
@@ -41,10 +304,8 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 	struct signal_info *si = bmalloc(sizeof(struct signal_info));
 	si->func = *info;
 	si->next = NULL;
-	si->signalling = false;
-	da_init(si->callbacks);
 
-	if (pthread_mutex_init_recursive(&si->mutex) != 0) {
+	if (!callback_list_init(&si->callbacks)) {
 		blog(LOG_ERROR, "Could not create signal");
 
 		decl_info_free(&si->func);
@@ -58,52 +319,41 @@ static inline struct signal_info *signal_info_create(struct decl_info *info)
 static inline void signal_info_destroy(struct signal_info *si)
 {
 	if (si) {
-		pthread_mutex_destroy(&si->mutex);
+		callback_list_free(&si->callbacks);
 		decl_info_free(&si->func);
-		da_free(si->callbacks);
 		bfree(si);
 	}
 }
 
-static inline size_t signal_get_callback_idx(struct signal_info *si, signal_callback_t callback, void *data)
-{
-	for (size_t i = 0; i < si->callbacks.num; i++) {
-		struct signal_callback *sc = si->callbacks.array + i;
-
-		if (sc->callback == callback && sc->data == data)
-			return i;
-	}
-
-	return DARRAY_INVALID;
-}
-
-struct global_callback_info {
-	global_signal_callback_t callback;
-	void *data;
-	long signaling;
-	bool remove;
-};
-
 struct signal_handler {
-	struct signal_info *first;
+	struct signal_info *volatile first;
 	pthread_mutex_t mutex;
 	volatile long refs;
 
-	DARRAY(struct global_callback_info) global_callbacks;
-	pthread_mutex_t global_callbacks_mutex;
+	struct callback_list global_callbacks;
 };
 
+static inline struct signal_info *next_signal(struct signal_info *volatile *next)
+{
+	return os_atomic_load_ptr((void *const volatile *)next);
+}
+
+/* signals are only ever appended, so the list can be searched without
+ * holding the handler mutex */
 static struct signal_info *getsignal(signal_handler_t *handler, const char *name, struct signal_info **p_last)
 {
 	struct signal_info *signal, *last = NULL;
 
-	signal = handler->first;
+	if (!handler)
+		return NULL;
+
+	signal = next_signal(&handler->first);
 	while (signal != NULL) {
 		if (strcmp(signal->func.name, name) == 0)
 			break;
 
 		last = signal;
-		signal = signal->next;
+		signal = next_signal(&signal->next);
 	}
 
 	if (p_last)
@@ -124,7 +374,7 @@ signal_handler_t *signal_handler_create(void)
 		bfree(handler);
 		return NULL;
 	}
-	if (pthread_mutex_init_recursive(&handler->global_callbacks_mutex) != 0) {
+	if (!callback_list_init(&handler->global_callbacks)) {
 		blog(LOG_ERROR, "Couldn't create signal handler global "
 				"callbacks mutex!");
 		pthread_mutex_destroy(&handler->mutex);
@@ -144,17 +394,31 @@ static void signal_handler_actually_destroy(signal_handler_t *handler)
 		sig = next;
 	}
 
-	da_free(handler->global_callbacks);
-	pthread_mutex_destroy(&handler->global_callbacks_mutex);
+	callback_list_free(&handler->global_callbacks);
 	pthread_mutex_destroy(&handler->mutex);
 	bfree(handler);
 }
 
-void signal_handler_destroy(signal_handler_t *handler)
+/* emits hold a reference as well, so the handler is only destroyed once the
+ * last emit using it has finished */
+static void signal_handler_release(signal_handler_t *handler, long refs)
 {
-	if (handler && os_atomic_dec_long(&handler->refs) == 0) {
+	long prev = os_atomic_load_long(&handler->refs);
+
+	if (refs <= 0)
+		return;
+
+	while (!os_atomic_compare_exchange_long(&handler->refs, &prev, prev - refs))
+		;
+
+	if (prev == refs)
 		signal_handler_actually_destroy(handler);
-	}
+}
+
+void signal_handler_destroy(signal_handler_t *handler)
+{
+	if (handler)
+		signal_handler_release(handler, 1);
 }
 
 bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
@@ -178,9 +442,9 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 	} else {
 		sig = signal_info_create(&func);
 		if (!last)
-			handler->first = sig;
+			os_atomic_store_ptr((void *volatile *)&handler->first, sig);
 		else
-			last->next = sig;
+			os_atomic_store_ptr((void *volatile *)&last->next, sig);
 	}
 
 	pthread_mutex_unlock(&handler->mutex);
@@ -191,17 +455,13 @@ bool signal_handler_add(signal_handler_t *handler, const char *signal_decl)
 static void signal_handler_connect_internal(signal_handler_t *handler, const char *signal, signal_callback_t callback,
 					    void *data, bool keep_ref)
 {
-	struct signal_info *sig, *last;
-	struct signal_callback cb_data = {callback, data, false, keep_ref};
-	size_t idx;
+	struct signal_info *sig;
+	struct signal_callback cb_data = {.callback = callback, .data = data, .keep_ref = keep_ref};
 
 	if (!handler)
 		return;
 
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, signal, &last);
-	pthread_mutex_unlock(&handler->mutex);
-
+	sig = getsignal(handler, signal, NULL);
 	if (!sig) {
 		blog(LOG_WARNING,
 		     "signal_handler_connect: "
@@ -212,16 +472,10 @@ static void signal_handler_connect_internal(signal_handler_t *handler, const cha
 
 	/* -------------- */
 
-	pthread_mutex_lock(&sig->mutex);
-
 	if (keep_ref)
 		os_atomic_inc_long(&handler->refs);
 
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (keep_ref || idx == DARRAY_INVALID)
-		da_push_back(sig->callbacks, &cb_data);
-
-	pthread_mutex_unlock(&sig->mutex);
+	signal_handler_release(handler, callback_list_connect(&sig->callbacks, &cb_data));
 }
 
 void signal_handler_connect(signal_handler_t *handler, const char *signal, signal_callback_t callback, void *data)
@@ -234,158 +488,54 @@ void signal_handler_connect_ref(signal_handler_t *handler, const char *signal, s
 	signal_handler_connect_internal(handler, signal, callback, data, true);
 }
 
-static inline struct signal_info *getsignal_locked(signal_handler_t *handler, const char *name)
-{
-	struct signal_info *sig;
-
-	if (!handler)
-		return NULL;
-
-	pthread_mutex_lock(&handler->mutex);
-	sig = getsignal(handler, name, NULL);
-	pthread_mutex_unlock(&handler->mutex);
-
-	return sig;
-}
-
 void signal_handler_disconnect(signal_handler_t *handler, const char *signal, signal_callback_t callback, void *data)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
-	bool keep_ref = false;
-	size_t idx;
+	struct signal_info *sig = getsignal(handler, signal, NULL);
 
 	if (!sig)
 		return;
 
-	pthread_mutex_lock(&sig->mutex);
-
-	idx = signal_get_callback_idx(sig, callback, data);
-	if (idx != DARRAY_INVALID) {
-		if (sig->signalling) {
-			sig->callbacks.array[idx].remove = true;
-		} else {
-			keep_ref = sig->callbacks.array[idx].keep_ref;
-			da_erase(sig->callbacks, idx);
-		}
-	}
-
-	pthread_mutex_unlock(&sig->mutex);
-
-	if (keep_ref && os_atomic_dec_long(&handler->refs) == 0) {
-		signal_handler_actually_destroy(handler);
-	}
+	signal_handler_release(handler, callback_list_disconnect(&sig->callbacks, (void *)callback, data));
 }
 
-static THREAD_LOCAL struct signal_callback *current_signal_cb = NULL;
-static THREAD_LOCAL struct global_callback_info *current_global_cb = NULL;
-
 void signal_handler_remove_current(void)
 {
-	if (current_signal_cb)
-		current_signal_cb->remove = true;
-	else if (current_global_cb)
-		current_global_cb->remove = true;
+	if (current_cb) {
+		os_atomic_store_bool(&current_cb->remove, true);
+		current_emit->removed = true;
+	}
 }
 
 void signal_handler_signal(signal_handler_t *handler, const char *signal, calldata_t *params)
 {
-	struct signal_info *sig = getsignal_locked(handler, signal);
-	long remove_refs = 0;
+	struct signal_info *sig = getsignal(handler, signal, NULL);
+	long remove_refs;
 
 	if (!sig)
 		return;
 
-	pthread_mutex_lock(&sig->mutex);
-	sig->signalling = true;
-
-	for (size_t i = 0; i < sig->callbacks.num; i++) {
-		struct signal_callback *cb = sig->callbacks.array + i;
-		if (!cb->remove) {
-			current_signal_cb = cb;
-			cb->callback(cb->data, params);
-			current_signal_cb = NULL;
-		}
-	}
-
-	for (size_t i = sig->callbacks.num; i > 0; i--) {
-		struct signal_callback *cb = sig->callbacks.array + i - 1;
-		if (cb->remove) {
-			if (cb->keep_ref)
-				remove_refs++;
-
-			da_erase(sig->callbacks, i - 1);
-		}
-	}
-
-	sig->signalling = false;
-	pthread_mutex_unlock(&sig->mutex);
+	os_atomic_inc_long(&handler->refs);
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
+	remove_refs = callback_list_emit(&sig->callbacks, signal, params, false);
+	callback_list_emit(&handler->global_callbacks, signal, params, true);
 
-	if (handler->global_callbacks.num) {
-		for (size_t i = 0; i < handler->global_callbacks.num; i++) {
-			struct global_callback_info *cb = handler->global_callbacks.array + i;
-
-			if (!cb->remove) {
-				cb->signaling++;
-				current_global_cb = cb;
-				cb->callback(cb->data, signal, params);
-				current_global_cb = NULL;
-				cb->signaling--;
-			}
-		}
-
-		for (size_t i = handler->global_callbacks.num; i > 0; i--) {
-			struct global_callback_info *cb = handler->global_callbacks.array + (i - 1);
-
-			if (cb->remove && !cb->signaling)
-				da_erase(handler->global_callbacks, i - 1);
-		}
-	}
-
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
-
-	if (remove_refs) {
-		os_atomic_set_long(&handler->refs, os_atomic_load_long(&handler->refs) - remove_refs);
-	}
+	signal_handler_release(handler, remove_refs + 1);
 }
 
 void signal_handler_connect_global(signal_handler_t *handler, global_signal_callback_t callback, void *data)
 {
-	struct global_callback_info cb_data = {callback, data, 0, false};
-	size_t idx;
+	struct signal_callback cb_data = {.global_callback = callback, .data = data};
 
 	if (!handler || !callback)
 		return;
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
-
-	idx = da_find(handler->global_callbacks, &cb_data, 0);
-	if (idx == DARRAY_INVALID)
-		da_push_back(handler->global_callbacks, &cb_data);
-
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	callback_list_connect(&handler->global_callbacks, &cb_data);
 }
 
 void signal_handler_disconnect_global(signal_handler_t *handler, global_signal_callback_t callback, void *data)
 {
-	struct global_callback_info cb_data = {callback, data, 0, false};
-	size_t idx;
-
 	if (!handler || !callback)
 		return;
 
-	pthread_mutex_lock(&handler->global_callbacks_mutex);
-
-	idx = da_find(handler->global_callbacks, &cb_data, 0);
-	if (idx != DARRAY_INVALID) {
-		struct global_callback_info *cb = handler->global_callbacks.array + idx;
-
-		if (cb->signaling)
-			cb->remove = true;
-		else
-			da_erase(handler->global_callbacks, idx);
-	}
-
-	pthread_mutex_unlock(&handler->global_callbacks_mutex);
+	callback_list_disconnect(&handler->global_callbacks, (void *)callback, data);
 }
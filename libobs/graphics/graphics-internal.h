@@ -297,6 +297,16 @@ struct blend_state {
 	enum gs_blend_op_type op;
 };
 
+struct gs_texture_pool_entry {
+	gs_texture_t *tex;
+	gs_zstencil_t *zs;
+	uint32_t cx, cy;
+	enum gs_color_format format;
+	enum gs_zstencil_format zsformat;
+	uint64_t last_used_frame;
+	bool in_use;
+};
+
 struct graphics_subsystem {
 	void *module;
 	gs_device_t *device;
@@ -332,4 +342,19 @@ struct graphics_subsystem {
 	DARRAY(struct blend_state) blend_state_stack;
 
 	bool linear_srgb;
+	uint64_t draw_calls;
+
+	pthread_mutex_t texture_pool_mutex;
+	DARRAY(struct gs_texture_pool_entry) texture_pool;
+	uint64_t texture_pool_frame;
+	uint64_t texture_pool_hits;
+	uint64_t texture_pool_misses;
+	uint64_t texture_pool_evictions;
 };
+
+extern gs_texture_t *gs_texture_pool_acquire(graphics_t *graphics, uint32_t cx, uint32_t cy,
+					     enum gs_color_format format, enum gs_zstencil_format zsformat,
+					     gs_zstencil_t **zs);
+extern void gs_texture_pool_release(graphics_t *graphics, gs_texture_t *tex);
+extern void gs_texture_pool_tick(graphics_t *graphics);
+extern void gs_texture_pool_free(graphics_t *graphics);
@@ -176,6 +176,8 @@ static bool graphics_init(struct graphics_subsystem *graphics)
 		return false;
 	if (pthread_mutex_init(&graphics->effect_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&graphics->texture_pool_mutex, NULL) != 0)
+		return false;
 
 	graphics->exports.device_blend_function_separate(graphics->device, GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA,
 							 GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
@@ -202,6 +204,7 @@ int gs_create(graphics_t **pgraphics, const char *module, uint32_t adapter)
 	graphics_t *graphics = bzalloc(sizeof(struct graphics_subsystem));
 	pthread_mutex_init_value(&graphics->mutex);
 	pthread_mutex_init_value(&graphics->effect_mutex);
+	pthread_mutex_init_value(&graphics->texture_pool_mutex);
 
 	graphics->module = os_dlopen(module);
 	if (!graphics->module) {
@@ -251,6 +254,8 @@ void gs_destroy(graphics_t *graphics)
 			effect = next;
 		}
 
+		gs_texture_pool_free(graphics);
+
 		graphics->exports.gs_vertexbuffer_destroy(graphics->subregion_buffer);
 		graphics->exports.gs_vertexbuffer_destroy(graphics->flipped_sprite_buffer);
 		graphics->exports.gs_vertexbuffer_destroy(graphics->sprite_buffer);
@@ -262,6 +267,8 @@ void gs_destroy(graphics_t *graphics)
 
 	pthread_mutex_destroy(&graphics->mutex);
 	pthread_mutex_destroy(&graphics->effect_mutex);
+	pthread_mutex_destroy(&graphics->texture_pool_mutex);
+	da_free(graphics->texture_pool);
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
 	da_free(graphics->blend_state_stack);
@@ -1917,6 +1924,7 @@ void gs_begin_frame(void)
 		return;
 
 	graphics->exports.device_begin_frame(graphics->device);
+	gs_texture_pool_tick(graphics);
 }
 
 void gs_begin_scene(void)
@@ -1936,9 +1944,20 @@ void gs_draw(enum gs_draw_mode draw_mode, uint32_t start_vert, uint32_t num_vert
 	if (!gs_valid("gs_draw"))
 		return;
 
+	graphics->draw_calls++;
 	graphics->exports.device_draw(graphics->device, draw_mode, start_vert, num_verts);
 }
 
+uint64_t gs_get_draw_call_count(void)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_get_draw_call_count"))
+		return 0;
+
+	return graphics->draw_calls;
+}
+
 void gs_end_scene(void)
 {
 	graphics_t *graphics = thread_graphics;
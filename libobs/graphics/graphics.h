@@ -455,6 +455,53 @@ EXPORT void gs_texrender_reset(gs_texrender_t *texrender);
 EXPORT gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender);
 EXPORT enum gs_color_format gs_texrender_get_format(const gs_texrender_t *texrender);
 
+/**
+ * Creates a texture renderer that borrows its render target from the
+ * graphics subsystem's shared texture pool on gs_texrender_begin instead of
+ * owning it.  The target is returned to the pool on gs_texrender_reset, so
+ * the texture is only valid until the texrender is next reset.
+ */
+EXPORT gs_texrender_t *gs_texrender_create_pooled(enum gs_color_format format, enum gs_zstencil_format zsformat);
+
+/* ---------------------------------------------------
+ * sprite batch helper functions
+ * --------------------------------------------------- */
+
+struct gs_sprite_batch;
+typedef struct gs_sprite_batch gs_sprite_batch_t;
+
+EXPORT gs_sprite_batch_t *gs_sprite_batch_create(uint32_t max_quads);
+EXPORT void gs_sprite_batch_destroy(gs_sprite_batch_t *batch);
+
+/**
+ * Adds a quad transformed by the current matrix.  uv is (u1, v1, u2, v2) and
+ * may be NULL for the full texture.  color is used by techniques that take
+ * a vertex color.
+ */
+EXPORT void gs_sprite_batch_add(gs_sprite_batch_t *batch, float x, float y, float cx, float cy, const struct vec4 *uv,
+				uint32_t color);
+EXPORT uint32_t gs_sprite_batch_get_count(const gs_sprite_batch_t *batch);
+EXPORT void gs_sprite_batch_clear(gs_sprite_batch_t *batch);
+
+/**
+ * Draws all added quads with a single draw call using the current effect.
+ * The quads are kept so every pass of a technique can draw them, call
+ * gs_sprite_batch_clear() before adding the quads of the next frame.
+ */
+EXPORT void gs_sprite_batch_draw(gs_sprite_batch_t *batch);
+
+struct gs_texture_pool_stats {
+	uint64_t vram_bytes;
+	uint64_t vram_in_use_bytes;
+	uint32_t textures;
+	uint32_t textures_in_use;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+};
+
+EXPORT void gs_get_texture_pool_stats(struct gs_texture_pool_stats *stats);
+
 /* ---------------------------------------------------
  * graphics subsystem
  * --------------------------------------------------- */
@@ -681,6 +728,7 @@ EXPORT void gs_stage_texture(gs_stagesurf_t *dst, gs_texture_t *src);
 EXPORT void gs_begin_frame(void);
 EXPORT void gs_begin_scene(void);
 EXPORT void gs_draw(enum gs_draw_mode draw_mode, uint32_t start_vert, uint32_t num_verts);
+EXPORT uint64_t gs_get_draw_call_count(void);
 EXPORT void gs_end_scene(void);
 
 #define GS_CLEAR_COLOR (1 << 0)
@@ -0,0 +1,159 @@
+/*
+ *   Collects quads that share the same effect, technique, blend state and
+ * texture (e.g. a texture atlas) into a single dynamic vertex buffer so that
+ * they can be drawn with one draw call.  Quads are transformed by the
+ * current matrix on the CPU when they're added, so the matrix may change
+ * freely between additions.
+ */
+
+#include "graphics.h"
+#include "matrix4.h"
+#include "vec2.h"
+#include "vec3.h"
+#include "vec4.h"
+
+#define VERTS_PER_QUAD 6
+
+struct gs_sprite_batch {
+	gs_vertbuffer_t *vb;
+	uint32_t capacity;
+	uint32_t num_quads;
+};
+
+static gs_vertbuffer_t *create_batch_vb(uint32_t quads)
+{
+	struct gs_vb_data *vbd = gs_vbdata_create();
+	size_t num = (size_t)quads * VERTS_PER_QUAD;
+
+	vbd->num = num;
+	vbd->points = bzalloc(sizeof(struct vec3) * num);
+	vbd->colors = bzalloc(sizeof(uint32_t) * num);
+	vbd->num_tex = 1;
+	vbd->tvarray = bzalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray[0].width = 2;
+	vbd->tvarray[0].array = bzalloc(sizeof(struct vec2) * num);
+
+	return gs_vertexbuffer_create(vbd, GS_DYNAMIC);
+}
+
+gs_sprite_batch_t *gs_sprite_batch_create(uint32_t max_quads)
+{
+	struct gs_sprite_batch *batch;
+
+	if (!max_quads)
+		max_quads = 64;
+
+	batch = bzalloc(sizeof(struct gs_sprite_batch));
+	batch->vb = create_batch_vb(max_quads);
+	if (!batch->vb) {
+		bfree(batch);
+		return NULL;
+	}
+
+	batch->capacity = max_quads;
+	return batch;
+}
+
+void gs_sprite_batch_destroy(gs_sprite_batch_t *batch)
+{
+	if (batch) {
+		gs_vertexbuffer_destroy(batch->vb);
+		bfree(batch);
+	}
+}
+
+static bool grow_batch(gs_sprite_batch_t *batch)
+{
+	uint32_t new_capacity = batch->capacity * 2;
+	gs_vertbuffer_t *new_vb = create_batch_vb(new_capacity);
+	if (!new_vb)
+		return false;
+
+	struct gs_vb_data *src = gs_vertexbuffer_get_data(batch->vb);
+	struct gs_vb_data *dst = gs_vertexbuffer_get_data(new_vb);
+	size_t num = (size_t)batch->num_quads * VERTS_PER_QUAD;
+
+	memcpy(dst->points, src->points, sizeof(struct vec3) * num);
+	memcpy(dst->colors, src->colors, sizeof(uint32_t) * num);
+	memcpy(dst->tvarray[0].array, src->tvarray[0].array, sizeof(struct vec2) * num);
+
+	gs_vertexbuffer_destroy(batch->vb);
+	batch->vb = new_vb;
+	batch->capacity = new_capacity;
+	return true;
+}
+
+void gs_sprite_batch_add(gs_sprite_batch_t *batch, float x, float y, float cx, float cy, const struct vec4 *uv,
+			 uint32_t color)
+{
+	static const uint8_t corner_order[VERTS_PER_QUAD] = {0, 1, 2, 1, 3, 2};
+	struct matrix4 transform;
+	struct vec3 corners[4];
+	struct vec2 uvs[4];
+
+	if (!batch)
+		return;
+	if (batch->num_quads == batch->capacity && !grow_batch(batch))
+		return;
+
+	gs_matrix_get(&transform);
+
+	vec3_set(&corners[0], x, y, 0.0f);
+	vec3_set(&corners[1], x + cx, y, 0.0f);
+	vec3_set(&corners[2], x, y + cy, 0.0f);
+	vec3_set(&corners[3], x + cx, y + cy, 0.0f);
+	for (size_t i = 0; i < 4; i++)
+		vec3_transform(&corners[i], &corners[i], &transform);
+
+	if (uv) {
+		vec2_set(&uvs[0], uv->x, uv->y);
+		vec2_set(&uvs[1], uv->z, uv->y);
+		vec2_set(&uvs[2], uv->x, uv->w);
+		vec2_set(&uvs[3], uv->z, uv->w);
+	} else {
+		vec2_set(&uvs[0], 0.0f, 0.0f);
+		vec2_set(&uvs[1], 1.0f, 0.0f);
+		vec2_set(&uvs[2], 0.0f, 1.0f);
+		vec2_set(&uvs[3], 1.0f, 1.0f);
+	}
+
+	struct gs_vb_data *data = gs_vertexbuffer_get_data(batch->vb);
+	struct vec2 *tex_verts = data->tvarray[0].array;
+	size_t start = (size_t)batch->num_quads * VERTS_PER_QUAD;
+
+	for (size_t i = 0; i < VERTS_PER_QUAD; i++) {
+		uint8_t corner = corner_order[i];
+		vec3_copy(&data->points[start + i], &corners[corner]);
+		vec2_copy(&tex_verts[start + i], &uvs[corner]);
+		data->colors[start + i] = color;
+	}
+
+	batch->num_quads++;
+}
+
+uint32_t gs_sprite_batch_get_count(const gs_sprite_batch_t *batch)
+{
+	return batch ? batch->num_quads : 0;
+}
+
+void gs_sprite_batch_clear(gs_sprite_batch_t *batch)
+{
+	if (batch)
+		batch->num_quads = 0;
+}
+
+void gs_sprite_batch_draw(gs_sprite_batch_t *batch)
+{
+	if (!batch || !batch->num_quads)
+		return;
+
+	gs_vertexbuffer_flush(batch->vb);
+	gs_load_vertexbuffer(batch->vb);
+	gs_load_indexbuffer(NULL);
+
+	/* vertices have already been transformed when they were added */
+	gs_matrix_push();
+	gs_matrix_identity();
+	gs_draw(GS_TRIS, 0, batch->num_quads * VERTS_PER_QUAD);
+	gs_matrix_pop();
+}
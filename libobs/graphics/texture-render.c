@@ -21,7 +21,11 @@
  */
 
 #include <assert.h>
-#include "graphics.h"
+#include "graphics-internal.h"
+
+/* pooled render targets that haven't been used for this many frames are
+ * destroyed */
+#define TEXTURE_POOL_MAX_IDLE_FRAMES 120
 
 struct gs_texture_render {
 	gs_texture_t *target, *prev_target;
@@ -34,8 +38,160 @@ struct gs_texture_render {
 	enum gs_zstencil_format zsformat;
 
 	bool rendered;
+
+	/* if set, target/zs are borrowed from the graphics texture pool */
+	graphics_t *pool;
 };
 
+static inline uint64_t zstencil_bpp(enum gs_zstencil_format zsformat)
+{
+	switch (zsformat) {
+	case GS_Z16:
+		return 16;
+	case GS_Z24_S8:
+	case GS_Z32F:
+		return 32;
+	case GS_Z32F_S8X24:
+		return 64;
+	case GS_ZS_NONE:
+		return 0;
+	}
+
+	return 0;
+}
+
+static inline uint64_t pool_entry_size(const struct gs_texture_pool_entry *entry)
+{
+	uint64_t bpp = gs_get_format_bpp(entry->format) + zstencil_bpp(entry->zsformat);
+	return (uint64_t)entry->cx * entry->cy * bpp / 8;
+}
+
+gs_texture_t *gs_texture_pool_acquire(graphics_t *graphics, uint32_t cx, uint32_t cy, enum gs_color_format format,
+				      enum gs_zstencil_format zsformat, gs_zstencil_t **zs)
+{
+	struct gs_texture_pool_entry entry = {0};
+
+	pthread_mutex_lock(&graphics->texture_pool_mutex);
+	for (size_t i = 0; i < graphics->texture_pool.num; i++) {
+		struct gs_texture_pool_entry *cur = &graphics->texture_pool.array[i];
+
+		if (!cur->in_use && cur->cx == cx && cur->cy == cy && cur->format == format &&
+		    cur->zsformat == zsformat) {
+			cur->in_use = true;
+			cur->last_used_frame = graphics->texture_pool_frame;
+			graphics->texture_pool_hits++;
+			*zs = cur->zs;
+
+			pthread_mutex_unlock(&graphics->texture_pool_mutex);
+			return cur->tex;
+		}
+	}
+	graphics->texture_pool_misses++;
+	pthread_mutex_unlock(&graphics->texture_pool_mutex);
+
+	entry.tex = gs_texture_create(cx, cy, format, 1, NULL, GS_RENDER_TARGET);
+	if (!entry.tex)
+		return NULL;
+
+	if (zsformat != GS_ZS_NONE) {
+		entry.zs = gs_zstencil_create(cx, cy, zsformat);
+		if (!entry.zs) {
+			gs_texture_destroy(entry.tex);
+			return NULL;
+		}
+	}
+
+	entry.cx = cx;
+	entry.cy = cy;
+	entry.format = format;
+	entry.zsformat = zsformat;
+	entry.in_use = true;
+
+	pthread_mutex_lock(&graphics->texture_pool_mutex);
+	entry.last_used_frame = graphics->texture_pool_frame;
+	da_push_back(graphics->texture_pool, &entry);
+	pthread_mutex_unlock(&graphics->texture_pool_mutex);
+
+	*zs = entry.zs;
+	return entry.tex;
+}
+
+void gs_texture_pool_release(graphics_t *graphics, gs_texture_t *tex)
+{
+	pthread_mutex_lock(&graphics->texture_pool_mutex);
+	for (size_t i = 0; i < graphics->texture_pool.num; i++) {
+		struct gs_texture_pool_entry *cur = &graphics->texture_pool.array[i];
+
+		if (cur->tex == tex) {
+			cur->in_use = false;
+			cur->last_used_frame = graphics->texture_pool_frame;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&graphics->texture_pool_mutex);
+}
+
+void gs_texture_pool_tick(graphics_t *graphics)
+{
+	DARRAY(struct gs_texture_pool_entry) expired;
+	da_init(expired);
+
+	pthread_mutex_lock(&graphics->texture_pool_mutex);
+	graphics->texture_pool_frame++;
+
+	for (size_t i = graphics->texture_pool.num; i > 0; i--) {
+		struct gs_texture_pool_entry *cur = &graphics->texture_pool.array[i - 1];
+
+		if (!cur->in_use && graphics->texture_pool_frame - cur->last_used_frame > TEXTURE_POOL_MAX_IDLE_FRAMES) {
+			da_push_back(expired, cur);
+			da_erase(graphics->texture_pool, i - 1);
+			graphics->texture_pool_evictions++;
+		}
+	}
+	pthread_mutex_unlock(&graphics->texture_pool_mutex);
+
+	for (size_t i = 0; i < expired.num; i++) {
+		gs_texture_destroy(expired.array[i].tex);
+		gs_zstencil_destroy(expired.array[i].zs);
+	}
+	da_free(expired);
+}
+
+void gs_texture_pool_free(graphics_t *graphics)
+{
+	for (size_t i = 0; i < graphics->texture_pool.num; i++) {
+		gs_texture_destroy(graphics->texture_pool.array[i].tex);
+		gs_zstencil_destroy(graphics->texture_pool.array[i].zs);
+	}
+	da_free(graphics->texture_pool);
+}
+
+void gs_get_texture_pool_stats(struct gs_texture_pool_stats *stats)
+{
+	graphics_t *graphics = gs_get_context();
+
+	memset(stats, 0, sizeof(*stats));
+	if (!graphics)
+		return;
+
+	pthread_mutex_lock(&graphics->texture_pool_mutex);
+	for (size_t i = 0; i < graphics->texture_pool.num; i++) {
+		const struct gs_texture_pool_entry *cur = &graphics->texture_pool.array[i];
+		uint64_t size = pool_entry_size(cur);
+
+		stats->textures++;
+		stats->vram_bytes += size;
+		if (cur->in_use) {
+			stats->textures_in_use++;
+			stats->vram_in_use_bytes += size;
+		}
+	}
+	stats->hits = graphics->texture_pool_hits;
+	stats->misses = graphics->texture_pool_misses;
+	stats->evictions = graphics->texture_pool_evictions;
+	pthread_mutex_unlock(&graphics->texture_pool_mutex);
+}
+
 gs_texrender_t *gs_texrender_create(enum gs_color_format format, enum gs_zstencil_format zsformat)
 {
 	struct gs_texture_render *texrender;
@@ -46,15 +202,55 @@ gs_texrender_t *gs_texrender_create(enum gs_color_format format, enum gs_zstenci
 	return texrender;
 }
 
+gs_texrender_t *gs_texrender_create_pooled(enum gs_color_format format, enum gs_zstencil_format zsformat)
+{
+	graphics_t *graphics = gs_get_context();
+	if (!graphics)
+		return NULL;
+
+	gs_texrender_t *texrender = gs_texrender_create(format, zsformat);
+	texrender->pool = graphics;
+	return texrender;
+}
+
+static void texrender_release_pooled(gs_texrender_t *texrender)
+{
+	if (texrender->target)
+		gs_texture_pool_release(texrender->pool, texrender->target);
+
+	texrender->target = NULL;
+	texrender->zs = NULL;
+	texrender->cx = 0;
+	texrender->cy = 0;
+}
+
 void gs_texrender_destroy(gs_texrender_t *texrender)
 {
 	if (texrender) {
-		gs_texture_destroy(texrender->target);
-		gs_zstencil_destroy(texrender->zs);
+		if (texrender->pool) {
+			texrender_release_pooled(texrender);
+		} else {
+			gs_texture_destroy(texrender->target);
+			gs_zstencil_destroy(texrender->zs);
+		}
 		bfree(texrender);
 	}
 }
 
+static bool texrender_acquire_pooled(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
+{
+	texrender_release_pooled(texrender);
+
+	texrender->target =
+		gs_texture_pool_acquire(texrender->pool, cx, cy, texrender->format, texrender->zsformat, &texrender->zs);
+	if (!texrender->target)
+		return false;
+
+	texrender->cx = cx;
+	texrender->cy = cy;
+	return true;
+}
+
 static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
 {
 	if (!texrender)
@@ -98,9 +294,14 @@ bool gs_texrender_begin_with_color_space(gs_texrender_t *texrender, uint32_t cx,
 	if (!cx || !cy)
 		return false;
 
-	if (texrender->cx != cx || texrender->cy != cy)
+	if (texrender->pool) {
+		if (!texrender->target || texrender->cx != cx || texrender->cy != cy)
+			if (!texrender_acquire_pooled(texrender, cx, cy))
+				return false;
+	} else if (texrender->cx != cx || texrender->cy != cy) {
 		if (!texrender_resetbuffer(texrender, cx, cy))
 			return false;
+	}
 
 	if (!texrender->target)
 		return false;
@@ -136,8 +337,14 @@ void gs_texrender_end(gs_texrender_t *texrender)
 
 void gs_texrender_reset(gs_texrender_t *texrender)
 {
-	if (texrender)
+	if (texrender) {
 		texrender->rendered = false;
+
+		/* hand the borrowed target back so that it can be reused by
+		 * other pooled texrenders until this one is rendered again */
+		if (texrender->pool)
+			texrender_release_pooled(texrender);
+	}
 }
 
 gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender)
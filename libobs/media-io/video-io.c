@@ -33,18 +33,53 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
 #define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
+#define MAX_POOLED_FRAMES (MAX_CONVERT_BUFFERS + MAX_CACHE_SIZE)
 
 struct cached_frame_info {
 	struct video_data frame;
 	int skipped;
 	int count;
+	long holds;
 };
 
-struct video_input {
+/* A scaled frame.  Frames held by inputs are skipped when the rung picks the
+ * next frame to scale into, and outlive their rung if it is destroyed while
+ * they are still held. */
+struct pooled_frame {
+	struct video_frame frame;
+	struct video_rung *rung;
+	long holds;
+};
+
+/* Scaled versions of the output are shared between all inputs that want the
+ * same size and format, and each is scaled from the nearest larger one with
+ * the same format instead of from the full resolution frame.  Every rung has
+ * a thread of its own so independent rungs are scaled in parallel. */
+struct video_rung {
+	struct video_output *video;
 	struct video_scale_info conversion;
+	struct video_rung *source;
 	video_scaler_t *scaler;
-	struct video_frame frame[MAX_CONVERT_BUFFERS];
-	int cur_frame;
+	DARRAY(struct pooled_frame *) frames;
+	struct pooled_frame *cur;
+	long refs;
+	const char *profile_name;
+
+	bool needed;
+	bool success;
+	const struct video_data *input;
+
+	pthread_t thread;
+	bool thread_active;
+	bool stop;
+	os_sem_t *start_sem;
+	os_event_t *done_event;
+};
+
+struct video_input {
+	struct video_scale_info conversion;
+	struct video_rung *rung;
+	bool skip;
 
 	// allow outputting at fractions of main composition FPS,
 	// e.g. 60 FPS with frame_rate_divisor = 1 turns into 30 FPS
@@ -60,13 +95,6 @@ struct video_input {
 	void *param;
 };
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
-
 struct video_output {
 	struct video_output_info info;
 
@@ -81,46 +109,457 @@ struct video_output {
 
 	pthread_mutex_t input_mutex;
 	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_rung *) rungs;
+
+	/* every scaled frame of every rung, plus held frames of destroyed
+	 * rungs */
+	pthread_mutex_t pool_mutex;
+	DARRAY(struct pooled_frame *) pool;
 
 	size_t available_frames;
 	size_t first_added;
 	size_t last_added;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
 
+	/* frames that have been output but are still held by inputs, oldest
+	 * first, ending at first_added */
+	size_t first_held;
+	size_t held_frames;
+
 	struct video_output *parent;
 
 	volatile bool raw_active;
 	volatile long gpu_refs;
+	volatile long duplicate_refs;
 };
 
 /* ------------------------------------------------------------------------- */
 
+static struct pooled_frame *pooled_frame_create(struct video_rung *rung)
+{
+	const struct video_scale_info *info = &rung->conversion;
+	struct pooled_frame *pf = bzalloc(sizeof(struct pooled_frame));
+
+	pf->rung = rung;
+	video_frame_init(&pf->frame, info->format, info->width, info->height);
+	return pf;
+}
+
+static inline void pooled_frame_free(struct pooled_frame *pf)
+{
+	video_frame_free(&pf->frame);
+	bfree(pf);
+}
+
+/* picks the frame after the current one that no input holds, so frames are
+ * still reused in order as long as nothing is held.  the pool only grows
+ * while inputs hold on to frames */
+static struct pooled_frame *rung_next_frame(struct video_rung *rung)
+{
+	struct video_output *video = rung->video;
+	struct pooled_frame *pf = NULL;
+	size_t num = rung->frames.num;
+	size_t start = 0;
+
+	pthread_mutex_lock(&video->pool_mutex);
+
+	for (size_t i = 0; i < num; i++) {
+		if (rung->frames.array[i] == rung->cur) {
+			start = i + 1;
+			break;
+		}
+	}
+	for (size_t i = 0; i < num; i++) {
+		struct pooled_frame *next = rung->frames.array[(start + i) % num];
+		if (!next->holds && next != rung->cur) {
+			pf = next;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&video->pool_mutex);
+
+	if (pf || num >= MAX_POOLED_FRAMES)
+		return pf;
+
+	pf = pooled_frame_create(rung);
+
+	pthread_mutex_lock(&video->pool_mutex);
+	da_push_back(rung->frames, &pf);
+	da_push_back(video->pool, &pf);
+	pthread_mutex_unlock(&video->pool_mutex);
+
+	return pf;
+}
+
+static void scale_rung(struct video_rung *rung)
+{
+	const uint8_t *const *input = (const uint8_t *const *)rung->input->data;
+	const uint32_t *linesize = rung->input->linesize;
+
+	if (rung->source) {
+		struct video_rung *source = rung->source;
+
+		if (!source->success) {
+			rung->success = false;
+			return;
+		}
+
+		input = (const uint8_t *const *)source->cur->frame.data;
+		linesize = source->cur->frame.linesize;
+	}
+
+	struct pooled_frame *pf = rung_next_frame(rung);
+	if (!pf) {
+		blog(LOG_WARNING, "video-io: All %d scaled frames are held, dropping frame", MAX_POOLED_FRAMES);
+		rung->success = false;
+		return;
+	}
+
+	rung->cur = pf;
+
+	struct video_frame *frame = &pf->frame;
+
+	profile_start(rung->profile_name);
+	rung->success = rung->scaler && video_scaler_scale(rung->scaler, frame->data, frame->linesize, input, linesize);
+	profile_end(rung->profile_name);
+
+	if (!rung->success)
+		blog(LOG_WARNING, "video-io: Could not scale frame!");
+}
+
+static void *rung_thread(void *param)
+{
+	struct video_rung *rung = param;
+
+	os_set_thread_name("video-io: scale thread");
+
+	while (os_sem_wait(rung->start_sem) == 0) {
+		if (rung->stop)
+			break;
+
+		scale_rung(rung);
+		os_event_signal(rung->done_event);
+
+		profile_reenable_thread();
+	}
+
+	return NULL;
+}
+
+static void mark_rung_needed(struct video_rung *rung)
+{
+	for (; rung && !rung->needed; rung = rung->source)
+		rung->needed = true;
+}
+
+/* rungs are sorted largest first, so sources always come before the rungs
+ * scaled from them */
+static void scale_rungs(struct video_output *video, const struct video_data *input)
+{
+	size_t needed = 0;
+	bool threaded = true;
+
+	for (size_t i = 0; i < video->rungs.num; i++) {
+		struct video_rung *rung = video->rungs.array[i];
+		if (!rung->needed)
+			continue;
+
+		rung->input = input;
+		threaded = threaded && rung->thread_active;
+		needed++;
+	}
+
+	if (needed == 0)
+		return;
+
+	if (needed == 1 || !threaded) {
+		for (size_t i = 0; i < video->rungs.num; i++) {
+			struct video_rung *rung = video->rungs.array[i];
+			if (rung->needed)
+				scale_rung(rung);
+		}
+
+	} else {
+		for (size_t i = 0; i < video->rungs.num; i++) {
+			struct video_rung *rung = video->rungs.array[i];
+			if (rung->needed)
+				os_event_reset(rung->done_event);
+		}
+		/* rungs scaled from the output frame all start right away, the
+		 * others once their source is done */
+		for (size_t i = 0; i < video->rungs.num; i++) {
+			struct video_rung *rung = video->rungs.array[i];
+			if (rung->needed && !rung->source)
+				os_sem_post(rung->start_sem);
+		}
+		for (size_t i = 0; i < video->rungs.num; i++) {
+			struct video_rung *rung = video->rungs.array[i];
+			if (rung->needed && rung->source) {
+				os_event_wait(rung->source->done_event);
+				os_sem_post(rung->start_sem);
+			}
+		}
+		for (size_t i = 0; i < video->rungs.num; i++) {
+			struct video_rung *rung = video->rungs.array[i];
+			if (rung->needed)
+				os_event_wait(rung->done_event);
+		}
+	}
+
+	for (size_t i = 0; i < video->rungs.num; i++)
+		video->rungs.array[i]->needed = false;
+}
+
 static inline bool scale_video_output(struct video_input *input, struct video_data *data)
 {
-	bool success = true;
+	struct video_rung *rung = input->rung;
 
-	if (input->scaler) {
-		struct video_frame *frame;
+	if (!rung)
+		return true;
+	if (!rung->success)
+		return false;
+
+	struct video_frame *frame = &rung->cur->frame;
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		data->data[i] = frame->data[i];
+		data->linesize[i] = frame->linesize[i];
+	}
 
-		frame = &input->frame[input->cur_frame];
+	return true;
+}
 
-		success = video_scaler_scale(input->scaler, frame->data, frame->linesize,
-					     (const uint8_t *const *)data->data, data->linesize);
+static inline uint64_t rung_area(const struct video_rung *rung)
+{
+	return (uint64_t)rung->conversion.width * rung->conversion.height;
+}
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i] = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
+static bool same_conversion(const struct video_scale_info *a, const struct video_scale_info *b)
+{
+	return a->format == b->format && a->width == b->width && a->height == b->height && a->range == b->range &&
+	       a->colorspace == b->colorspace;
+}
+
+static bool can_scale_from(const struct video_rung *source, const struct video_rung *rung)
+{
+	const struct video_scale_info *src = &source->conversion;
+	const struct video_scale_info *dst = &rung->conversion;
+
+	return src->format == dst->format && src->range == dst->range && src->colorspace == dst->colorspace &&
+	       src->width >= dst->width && src->height >= dst->height &&
+	       (src->width != dst->width || src->height != dst->height);
+}
+
+static int rung_compare(const void *a, const void *b)
+{
+	uint64_t area_a = rung_area(*(struct video_rung *const *)a);
+	uint64_t area_b = rung_area(*(struct video_rung *const *)b);
+
+	return area_a < area_b ? 1 : (area_a > area_b ? -1 : 0);
+}
+
+static int video_rung_init_scaler(struct video_output *video, struct video_rung *rung, struct video_rung *source)
+{
+	struct video_scale_info from = {.format = video->info.format,
+					.width = video->info.width,
+					.height = video->info.height,
+					.range = video->info.range,
+					.colorspace = video->info.colorspace};
+
+	if (source)
+		from = source->conversion;
+
+	video_scaler_destroy(rung->scaler);
+	rung->scaler = NULL;
+	rung->source = source;
+
+	return video_scaler_create(&rung->scaler, &rung->conversion, &from, VIDEO_SCALE_FAST_BILINEAR);
+}
+
+/* (re)links every rung to the nearest larger rung it can be scaled from */
+static int video_pyramid_update(struct video_output *video)
+{
+	int ret = VIDEO_SCALER_SUCCESS;
+
+	qsort(video->rungs.array, video->rungs.num, sizeof(struct video_rung *), rung_compare);
+
+	for (size_t i = 0; i < video->rungs.num; i++) {
+		struct video_rung *rung = video->rungs.array[i];
+		struct video_rung *source = NULL;
+
+		for (size_t j = 0; j < i; j++) {
+			struct video_rung *larger = video->rungs.array[j];
+			if (larger->scaler && can_scale_from(larger, rung) &&
+			    (!source || rung_area(larger) < rung_area(source)))
+				source = larger;
+		}
+
+		if (rung->scaler && rung->source == source)
+			continue;
+
+		int rung_ret = video_rung_init_scaler(video, rung, source);
+		if (rung_ret != VIDEO_SCALER_SUCCESS && source)
+			rung_ret = video_rung_init_scaler(video, rung, NULL);
+		if (rung_ret != VIDEO_SCALER_SUCCESS)
+			ret = rung_ret;
+	}
+
+	return ret;
+}
+
+static void video_rung_destroy(struct video_output *video, struct video_rung *rung)
+{
+	if (rung->thread_active) {
+		rung->stop = true;
+		os_sem_post(rung->start_sem);
+		pthread_join(rung->thread, NULL);
+	}
+
+	os_sem_destroy(rung->start_sem);
+	os_event_destroy(rung->done_event);
+
+	/* frames that are still held are freed once they are released */
+	pthread_mutex_lock(&video->pool_mutex);
+	for (size_t i = 0; i < rung->frames.num; i++) {
+		struct pooled_frame *pf = rung->frames.array[i];
+
+		pf->rung = NULL;
+		if (!pf->holds) {
+			da_erase_item(video->pool, &pf);
+			pooled_frame_free(pf);
+		}
+	}
+	pthread_mutex_unlock(&video->pool_mutex);
+
+	da_free(rung->frames);
+	video_scaler_destroy(rung->scaler);
+	bfree(rung);
+}
+
+static void video_rung_release(struct video_output *video, struct video_rung *rung)
+{
+	if (!rung || --rung->refs > 0)
+		return;
+
+	da_erase_item(video->rungs, &rung);
+
+	for (size_t i = 0; i < video->rungs.num; i++) {
+		struct video_rung *other = video->rungs.array[i];
+		if (other->source == rung) {
+			video_scaler_destroy(other->scaler);
+			other->scaler = NULL;
+			other->source = NULL;
+		}
+	}
+
+	video_rung_destroy(video, rung);
+	video_pyramid_update(video);
+}
+
+static struct video_rung *video_rung_get(struct video_output *video, const struct video_scale_info *conversion)
+{
+	struct video_rung *rung;
+
+	for (size_t i = 0; i < video->rungs.num; i++) {
+		rung = video->rungs.array[i];
+		if (same_conversion(&rung->conversion, conversion)) {
+			rung->refs++;
+			return rung;
+		}
+	}
+
+	rung = bzalloc(sizeof(struct video_rung));
+	rung->video = video;
+	rung->conversion = *conversion;
+	rung->refs = 1;
+	rung->profile_name = profile_store_name(obs_get_profiler_name_store(), "video_scale(%ux%u)",
+						conversion->width, conversion->height);
+
+	pthread_mutex_lock(&video->pool_mutex);
+	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++) {
+		struct pooled_frame *pf = pooled_frame_create(rung);
+		da_push_back(rung->frames, &pf);
+		da_push_back(video->pool, &pf);
+	}
+	pthread_mutex_unlock(&video->pool_mutex);
+
+	if (os_sem_init(&rung->start_sem, 0) == 0 && os_event_init(&rung->done_event, OS_EVENT_TYPE_MANUAL) == 0)
+		rung->thread_active = pthread_create(&rung->thread, NULL, rung_thread, rung) == 0;
+
+	da_push_back(video->rungs, &rung);
+
+	int ret = video_pyramid_update(video);
+	if (!rung->scaler) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_ERROR, "video_input_init: Bad "
+					"scale conversion type");
+		else
+			blog(LOG_ERROR, "video_input_init: Failed to "
+					"create scaler");
+
+		video_rung_release(video, rung);
+		return NULL;
+	}
+
+	return rung;
+}
+
+static inline void video_input_free(struct video_output *video, struct video_input *input)
+{
+	video_rung_release(video, input->rung);
+	input->rung = NULL;
+}
+
+static inline uint64_t hash_mix(uint64_t hash, uint64_t val)
+{
+	hash = (hash ^ val) * 0x9E3779B97F4A7C15ULL;
+	return hash ^ (hash >> 29);
+}
+
+/* hashes the visible part of every plane, four lanes at a time.  padding at
+ * the end of each line is left out since it differs between cached frames */
+static uint64_t hash_frame(const struct video_output *video, const struct video_data *frame)
+{
+	uint32_t widths[MAX_AV_PLANES] = {0};
+	uint32_t heights[MAX_AV_PLANES] = {0};
+	uint64_t lanes[4] = {1, 2, 3, 4};
+
+	video_frame_get_linesizes(widths, video->info.format, video->info.width);
+	video_frame_get_plane_heights(heights, video->info.format, video->info.height);
+
+	for (size_t plane = 0; plane < MAX_AV_PLANES; plane++) {
+		for (uint32_t y = 0; y < heights[plane]; y++) {
+			const uint8_t *line = frame->data[plane] + (size_t)y * frame->linesize[plane];
+			uint32_t x = 0;
+
+			for (; x + sizeof(lanes) <= widths[plane]; x += sizeof(lanes)) {
+				for (size_t i = 0; i < 4; i++) {
+					uint64_t val;
+					memcpy(&val, line + x + i * sizeof(val), sizeof(val));
+					lanes[i] = hash_mix(lanes[i], val);
+				}
 			}
-		} else {
-			blog(LOG_WARNING, "video-io: Could not scale frame!");
+			for (; x < widths[plane]; x++)
+				lanes[0] = hash_mix(lanes[0], line[x]);
 		}
 	}
 
-	return success;
+	return hash_mix(hash_mix(lanes[0], lanes[1]), hash_mix(lanes[2], lanes[3])) | 1;
+}
+
+/* makes output frames available again once nothing holds them, in the
+ * order they were output.  data_mutex must be locked */
+static void retire_frames(struct video_output *video)
+{
+	while (video->held_frames && !video->cache[video->first_held].holds) {
+		if (++video->first_held == video->info.cache_size)
+			video->first_held = 0;
+		video->held_frames--;
+
+		if (++video->available_frames == video->info.cache_size)
+			video->last_added = video->first_added;
+	}
 }
 
 static inline bool video_output_cur_frame(struct video_output *video)
@@ -137,22 +576,38 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	pthread_mutex_unlock(&video->data_mutex);
 
+	/* a frame that is output more than once is only hashed the first
+	 * time */
+	if (!os_atomic_load_long(&video->duplicate_refs))
+		frame_info->frame.hash = 0;
+	else if (!frame_info->frame.hash)
+		frame_info->frame.hash = hash_frame(video, &frame_info->frame);
+
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
 		struct video_input *input = video->inputs.array + i;
-		struct video_data frame = frame_info->frame;
 
 		// an explicit counter is used instead of remainder calculation
 		// to allow multiple encoders started at the same time to start on
 		// the same frame
-		uint32_t skip = input->frame_rate_divisor_counter++;
+		input->skip = input->frame_rate_divisor_counter++ != 0;
 		if (input->frame_rate_divisor_counter == input->frame_rate_divisor)
 			input->frame_rate_divisor_counter = 0;
 
-		if (skip)
+		if (!input->skip)
+			mark_rung_needed(input->rung);
+	}
+
+	scale_rungs(video, &frame_info->frame);
+
+	for (size_t i = 0; i < video->inputs.num; i++) {
+		struct video_input *input = video->inputs.array + i;
+		struct video_data frame = frame_info->frame;
+
+		if (input->skip)
 			continue;
 
 		if (scale_video_output(input, &frame))
@@ -173,8 +628,8 @@ static inline bool video_output_cur_frame(struct video_output *video)
 		if (++video->first_added == video->info.cache_size)
 			video->first_added = 0;
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+		video->held_frames++;
+		retire_frames(video);
 	} else if (skipped) {
 		--frame_info->skipped;
 		os_atomic_inc_long(&video->skipped_frames);
@@ -254,18 +709,22 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail0;
 	if (pthread_mutex_init_recursive(&out->input_mutex) != 0)
 		goto fail1;
-	if (os_sem_init(&out->update_semaphore, 0) != 0)
+	if (pthread_mutex_init(&out->pool_mutex, NULL) != 0)
 		goto fail2;
-	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
+	if (os_sem_init(&out->update_semaphore, 0) != 0)
 		goto fail3;
+	if (pthread_create(&out->thread, NULL, video_thread, out) != 0)
+		goto fail4;
 
 	init_cache(out);
 
 	*video = out;
 	return VIDEO_OUTPUT_SUCCESS;
 
-fail3:
+fail4:
 	os_sem_destroy(out->update_semaphore);
+fail3:
+	pthread_mutex_destroy(&out->pool_mutex);
 fail2:
 	pthread_mutex_destroy(&out->input_mutex);
 fail1:
@@ -285,8 +744,13 @@ void video_output_close(video_t *video)
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_free(video, &video->inputs.array[i]);
 	da_free(video->inputs);
+	da_free(video->rungs);
+
+	for (size_t i = 0; i < video->pool.num; i++)
+		pooled_frame_free(video->pool.array[i]);
+	da_free(video->pool);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame *)&video->cache[i]);
@@ -295,6 +759,7 @@ void video_output_close(video_t *video)
 	os_sem_destroy(video->update_semaphore);
 	pthread_mutex_destroy(&video->data_mutex);
 	pthread_mutex_destroy(&video->input_mutex);
+	pthread_mutex_destroy(&video->pool_mutex);
 
 	bfree(video);
 }
@@ -343,27 +808,9 @@ static inline bool video_input_init(struct video_input *input, struct video_outp
 	    input->conversion.format != video->info.format ||
 	    !match_range(input->conversion.range, video->info.range) ||
 	    !match_space(input->conversion.colorspace, video->info.colorspace)) {
-		struct video_scale_info from = {.format = video->info.format,
-						.width = video->info.width,
-						.height = video->info.height,
-						.range = video->info.range,
-						.colorspace = video->info.colorspace};
-
-		int ret = video_scaler_create(&input->scaler, &input->conversion, &from, VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_ERROR, "video_input_init: Bad "
-						"scale conversion type");
-			else
-				blog(LOG_ERROR, "video_input_init: Failed to "
-						"create scaler");
-
+		input->rung = video_rung_get(video, &input->conversion);
+		if (!input->rung)
 			return false;
-		}
-
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i], input->conversion.format, input->conversion.width,
-					 input->conversion.height);
 	}
 
 	return true;
@@ -478,7 +925,7 @@ bool video_output_disconnect2(video_t *video, void (*callback)(void *param, stru
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		video_input_free(video, video->inputs.array + idx);
 		da_erase(video->inputs, idx);
 
 		if (video->inputs.num == 0) {
@@ -518,7 +965,15 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame, int coun
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	if (video->available_frames == 0) {
+	if (video->available_frames == 0 && video->held_frames == video->info.cache_size) {
+		/* nothing left to repeat, every frame is held */
+		for (int i = 0; i < count; i++) {
+			os_atomic_inc_long(&video->skipped_frames);
+			os_atomic_inc_long(&video->total_frames);
+		}
+		locked = false;
+
+	} else if (video->available_frames == 0) {
 		video->cache[video->last_added].count += count;
 		video->cache[video->last_added].skipped += count;
 		locked = false;
@@ -531,6 +986,7 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame, int coun
 
 		cfi = &video->cache[video->last_added];
 		cfi->frame.timestamp = timestamp;
+		cfi->frame.hash = 0;
 		cfi->count = count;
 		cfi->skipped = 0;
 
@@ -559,6 +1015,93 @@ void video_output_unlock_frame(video_t *video)
 	pthread_mutex_unlock(&video->data_mutex);
 }
 
+bool video_output_hold_frame(video_t *video, const struct video_data *frame)
+{
+	struct cached_frame_info *cfi;
+	bool held = false;
+
+	if (!video || !frame)
+		return false;
+
+	video = get_root(video);
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	cfi = &video->cache[video->first_added];
+	if (cfi->frame.data[0] == frame->data[0]) {
+		cfi->holds++;
+		held = true;
+	}
+
+	pthread_mutex_unlock(&video->data_mutex);
+
+	if (held)
+		return true;
+
+	pthread_mutex_lock(&video->pool_mutex);
+
+	for (size_t i = 0; i < video->pool.num; i++) {
+		struct pooled_frame *pf = video->pool.array[i];
+		if (pf->rung && pf->rung->cur == pf && pf->frame.data[0] == frame->data[0]) {
+			pf->holds++;
+			held = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&video->pool_mutex);
+
+	return held;
+}
+
+static bool release_pooled_frame(struct video_output *video, const struct video_data *frame)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&video->pool_mutex);
+
+	for (size_t i = 0; i < video->pool.num; i++) {
+		struct pooled_frame *pf = video->pool.array[i];
+		if (pf->holds && pf->frame.data[0] == frame->data[0]) {
+			if (--pf->holds == 0 && !pf->rung) {
+				da_erase(video->pool, i);
+				pooled_frame_free(pf);
+			}
+			found = true;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&video->pool_mutex);
+
+	return found;
+}
+
+void video_output_release_frame(video_t *video, const struct video_data *frame)
+{
+	if (!video || !frame)
+		return;
+
+	video = get_root(video);
+
+	if (release_pooled_frame(video, frame))
+		return;
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	for (size_t i = 0; i < video->info.cache_size; i++) {
+		struct cached_frame_info *cfi = &video->cache[i];
+		if (cfi->holds && cfi->frame.data[0] == frame->data[0]) {
+			cfi->holds--;
+			break;
+		}
+	}
+
+	retire_frames(video);
+
+	pthread_mutex_unlock(&video->data_mutex);
+}
+
 uint64_t video_output_get_frame_time(const video_t *video)
 {
 	return video ? video->frame_time : 0;
@@ -657,6 +1200,18 @@ void video_output_inc_texture_skipped_frames(video_t *video)
 	os_atomic_inc_long(&get_root(video)->skipped_frames);
 }
 
+void video_output_inc_duplicate_detection(video_t *video)
+{
+	if (video)
+		os_atomic_inc_long(&get_root(video)->duplicate_refs);
+}
+
+void video_output_dec_duplicate_detection(video_t *video)
+{
+	if (video)
+		os_atomic_dec_long(&get_root(video)->duplicate_refs);
+}
+
 video_t *video_output_create_with_frame_rate_divisor(video_t *video, uint32_t divisor)
 {
 	// `divisor == 1` would result in the same frame rate,
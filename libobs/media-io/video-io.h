@@ -122,6 +122,10 @@ struct video_data {
 	uint8_t *data[MAX_AV_PLANES];
 	uint32_t linesize[MAX_AV_PLANES];
 	uint64_t timestamp;
+
+	/* hash of the frame's content, never 0 while duplicate detection is
+	 * enabled and always 0 otherwise */
+	uint64_t hash;
 };
 
 struct video_output_info {
@@ -313,6 +317,15 @@ EXPORT bool video_output_active(const video_t *video);
 EXPORT const struct video_output_info *video_output_get_info(const video_t *video);
 EXPORT bool video_output_lock_frame(video_t *video, struct video_frame *frame, int count, uint64_t timestamp);
 EXPORT void video_output_unlock_frame(video_t *video);
+
+/* Keeps a frame passed to an input callback from being reused once the
+ * callback returns, so it can be processed on another thread.  Scaled frames
+ * are refcounted, so inputs sharing a conversion can all hold the same frame.
+ * Must be called from the callback, returns false if the frame can not be
+ * held.  Every held frame must be released with video_output_release_frame. */
+EXPORT bool video_output_hold_frame(video_t *video, const struct video_data *frame);
+EXPORT void video_output_release_frame(video_t *video, const struct video_data *frame);
+
 EXPORT uint64_t video_output_get_frame_time(const video_t *video);
 EXPORT void video_output_stop(video_t *video);
 EXPORT bool video_output_stopped(video_t *video);
@@ -325,6 +338,11 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+/* While enabled, every frame is hashed once before it is output, so inputs
+ * can tell when its content has not changed */
+EXPORT void video_output_inc_duplicate_detection(video_t *video);
+EXPORT void video_output_dec_duplicate_detection(video_t *video);
+
 extern void video_output_inc_texture_encoders(video_t *video);
 extern void video_output_dec_texture_encoders(video_t *video);
 extern void video_output_inc_texture_frames(video_t *video);
@@ -217,7 +217,7 @@ static void fader_source_volume_changed(void *vptr, calldata_t *calldata)
 		return;
 	}
 
-	const float mul = (float)calldata_float(calldata, "volume");
+	const float mul = (float)calldata_sig_float(calldata, &obs_source_volume_signature, 1);
 	const float db = mul_to_db(mul);
 	fader->cur_db = db;
 
@@ -232,7 +232,7 @@ static void volmeter_source_volume_changed(void *vptr, calldata_t *calldata)
 
 	pthread_mutex_lock(&volmeter->mutex);
 
-	float mul = (float)calldata_float(calldata, "volume");
+	float mul = (float)calldata_sig_float(calldata, &obs_source_volume_signature, 1);
 	volmeter->cur_db = mul_to_db(mul);
 
 	pthread_mutex_unlock(&volmeter->mutex);
@@ -0,0 +1,556 @@
+#include "util/bmem.h"
+#include "util/darray.h"
+#include "util/dstr.h"
+#include "util/platform.h"
+#include "util/uthash.h"
+#include "util/array-serializer.h"
+#include "obs-data.h"
+
+/*
+ * Binary obs_data format
+ *
+ *   All values are little endian, offsets are relative to the start of the
+ * file.  Objects are written after their children, so every child offset is
+ * lower than the offset of the object that refers to it.
+ *
+ *   header:
+ *     char     magic[4]         "OBSB"
+ *     uint16   version
+ *     uint16   flags            (reserved, 0)
+ *     uint32   file_size
+ *     uint32   root             offset of the root object
+ *     uint32   string_count
+ *     uint32   string_offsets   offset of uint32[string_count], relative to
+ *                               string_data
+ *     uint32   string_data      offset of the null-terminated strings
+ *     uint32   string_data_size
+ *
+ *   object:
+ *     uint32   count
+ *     entry    entries[count]
+ *
+ *   entry (16 bytes):
+ *     uint32   name             string index
+ *     uint8    type             enum obs_data_type
+ *     uint8    num_type         enum obs_data_number_type
+ *     uint16   reserved
+ *     uint64   value            string index, integer, double bits, bool,
+ *                               or offset of an object or array
+ *
+ *   array:
+ *     uint32   count
+ *     uint32   objects[count]   object offsets
+ *
+ *   Keys and string values are interned in a single string table, so the
+ * repeated setting names of a scene collection are only stored once.  Only
+ * user values are stored, like obs_data_get_json.
+ */
+
+#define BINARY_MAGIC "OBSB"
+#define BINARY_VERSION 1
+#define HEADER_SIZE 32
+#define ENTRY_SIZE 16
+#define MAX_DEPTH 128
+
+/* ------------------------------------------------------------------------- */
+/* Writer */
+
+struct interned_string {
+	UT_hash_handle hh;
+	uint32_t idx;
+	char str[];
+};
+
+struct binary_writer {
+	struct serializer s;
+	struct array_output_data output;
+
+	struct interned_string *strings;
+	DARRAY(uint32_t) string_offsets;
+	DARRAY(char) string_data;
+};
+
+static uint32_t intern_string(struct binary_writer *w, const char *str)
+{
+	struct interned_string *entry;
+	uint32_t offset;
+	size_t len;
+
+	if (!str)
+		str = "";
+
+	HASH_FIND_STR(w->strings, str, entry);
+	if (entry)
+		return entry->idx;
+
+	len = strlen(str);
+	entry = bmalloc(sizeof(struct interned_string) + len + 1);
+	memcpy(entry->str, str, len + 1);
+	entry->idx = (uint32_t)w->string_offsets.num;
+	HASH_ADD_STR(w->strings, str, entry);
+
+	offset = (uint32_t)w->string_data.num;
+	da_push_back(w->string_offsets, &offset);
+	da_push_back_array(w->string_data, str, len + 1);
+	return entry->idx;
+}
+
+static inline uint32_t writer_pos(struct binary_writer *w)
+{
+	return (uint32_t)w->output.bytes.num;
+}
+
+static inline void writer_align(struct binary_writer *w)
+{
+	while (writer_pos(w) & 3)
+		s_w8(&w->s, 0);
+}
+
+static uint32_t write_obj(struct binary_writer *w, obs_data_t *data);
+
+static uint32_t write_array(struct binary_writer *w, obs_data_array_t *array)
+{
+	size_t count = obs_data_array_count(array);
+	DARRAY(uint32_t) offsets;
+	uint32_t pos;
+
+	da_init(offsets);
+	da_reserve(offsets, count);
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *obj = obs_data_array_item(array, i);
+		uint32_t offset = write_obj(w, obj);
+		da_push_back(offsets, &offset);
+		obs_data_release(obj);
+	}
+
+	writer_align(w);
+	pos = writer_pos(w);
+
+	s_wl32(&w->s, (uint32_t)count);
+	for (size_t i = 0; i < count; i++)
+		s_wl32(&w->s, offsets.array[i]);
+
+	da_free(offsets);
+	return pos;
+}
+
+static uint64_t write_child(struct binary_writer *w, obs_data_item_t *item)
+{
+	enum obs_data_type type = obs_data_item_gettype(item);
+	uint64_t offset = 0;
+
+	if (type == OBS_DATA_OBJECT) {
+		obs_data_t *obj = obs_data_item_get_obj(item);
+		offset = write_obj(w, obj);
+		obs_data_release(obj);
+
+	} else if (type == OBS_DATA_ARRAY) {
+		obs_data_array_t *array = obs_data_item_get_array(item);
+		offset = write_array(w, array);
+		obs_data_array_release(array);
+	}
+
+	return offset;
+}
+
+static void write_entry(struct binary_writer *w, obs_data_item_t *item, uint64_t child_offset)
+{
+	enum obs_data_type type = obs_data_item_gettype(item);
+	enum obs_data_number_type num_type = OBS_DATA_NUM_INVALID;
+	uint64_t value = child_offset;
+
+	if (type == OBS_DATA_STRING) {
+		value = intern_string(w, obs_data_item_get_string(item));
+
+	} else if (type == OBS_DATA_NUMBER) {
+		num_type = obs_data_item_numtype(item);
+		if (num_type == OBS_DATA_NUM_INT) {
+			value = (uint64_t)obs_data_item_get_int(item);
+		} else {
+			double d = obs_data_item_get_double(item);
+			memcpy(&value, &d, sizeof(value));
+		}
+
+	} else if (type == OBS_DATA_BOOLEAN) {
+		value = obs_data_item_get_bool(item);
+	}
+
+	s_wl32(&w->s, intern_string(w, obs_data_item_get_name(item)));
+	s_w8(&w->s, (uint8_t)type);
+	s_w8(&w->s, (uint8_t)num_type);
+	s_wl16(&w->s, 0);
+	s_wl64(&w->s, value);
+}
+
+static uint32_t write_obj(struct binary_writer *w, obs_data_t *data)
+{
+	DARRAY(uint64_t) child_offsets;
+	obs_data_item_t *item;
+	uint32_t count = 0;
+	uint32_t pos;
+	size_t idx = 0;
+
+	da_init(child_offsets);
+
+	/* children first, so their offsets are known when writing entries */
+	for (item = obs_data_first(data); item; obs_data_item_next(&item)) {
+		if (!obs_data_item_has_user_value(item))
+			continue;
+
+		uint64_t offset = write_child(w, item);
+		da_push_back(child_offsets, &offset);
+		count++;
+	}
+
+	writer_align(w);
+	pos = writer_pos(w);
+	s_wl32(&w->s, count);
+
+	for (item = obs_data_first(data); item; obs_data_item_next(&item)) {
+		if (!obs_data_item_has_user_value(item))
+			continue;
+
+		write_entry(w, item, child_offsets.array[idx++]);
+	}
+
+	da_free(child_offsets);
+	return pos;
+}
+
+static void free_writer(struct binary_writer *w)
+{
+	struct interned_string *entry, *temp;
+
+	HASH_ITER (hh, w->strings, entry, temp) {
+		HASH_DELETE(hh, w->strings, entry);
+		bfree(entry);
+	}
+
+	da_free(w->string_offsets);
+	da_free(w->string_data);
+	array_output_serializer_free(&w->output);
+}
+
+void *obs_data_get_binary(obs_data_t *data, size_t *size)
+{
+	struct binary_writer w = {0};
+	uint32_t root, string_offsets, string_data;
+	void *buf;
+
+	*size = 0;
+	if (!data)
+		return NULL;
+
+	array_output_serializer_init(&w.s, &w.output);
+
+	for (size_t i = 0; i < HEADER_SIZE; i++)
+		s_w8(&w.s, 0);
+
+	root = write_obj(&w, data);
+
+	writer_align(&w);
+	string_offsets = writer_pos(&w);
+	for (size_t i = 0; i < w.string_offsets.num; i++)
+		s_wl32(&w.s, w.string_offsets.array[i]);
+
+	string_data = writer_pos(&w);
+	s_write(&w.s, w.string_data.array, w.string_data.num);
+
+	if (w.output.bytes.num > UINT32_MAX) {
+		blog(LOG_ERROR, "obs-data-binary.c: [obs_data_get_binary] "
+				"Data is too large to serialize");
+		free_writer(&w);
+		return NULL;
+	}
+
+	serializer_seek(&w.s, 0, SERIALIZE_SEEK_START);
+	s_write(&w.s, BINARY_MAGIC, 4);
+	s_wl16(&w.s, BINARY_VERSION);
+	s_wl16(&w.s, 0);
+	s_wl32(&w.s, (uint32_t)w.output.bytes.num);
+	s_wl32(&w.s, root);
+	s_wl32(&w.s, (uint32_t)w.string_offsets.num);
+	s_wl32(&w.s, string_offsets);
+	s_wl32(&w.s, string_data);
+	s_wl32(&w.s, (uint32_t)w.string_data.num);
+
+	/* hand the output buffer to the caller */
+	buf = w.output.bytes.array;
+	*size = w.output.bytes.num;
+	w.output.bytes.array = NULL;
+	w.output.bytes.num = 0;
+	w.output.bytes.capacity = 0;
+
+	free_writer(&w);
+	return buf;
+}
+
+bool obs_data_save_binary_safe(obs_data_t *data, const char *file, const char *temp_ext, const char *backup_ext)
+{
+	size_t size;
+	void *buf = obs_data_get_binary(data, &size);
+	bool success;
+
+	if (!buf)
+		return false;
+
+	success = os_quick_write_utf8_file_safe(file, buf, size, false, temp_ext, backup_ext);
+	bfree(buf);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Reader */
+
+struct binary_reader {
+	const uint8_t *data;
+	size_t size;
+
+	uint32_t string_count;
+	uint32_t string_offsets;
+	uint32_t string_data;
+	uint32_t string_data_size;
+
+	/* limits the work a malformed file with shared offsets can cause */
+	size_t nodes_left;
+};
+
+static inline uint16_t read_u16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t read_u64(const uint8_t *p)
+{
+	return (uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32);
+}
+
+static inline bool range_valid(const struct binary_reader *r, uint64_t offset, uint64_t size)
+{
+	return offset <= r->size && size <= r->size - offset;
+}
+
+static const char *read_string(const struct binary_reader *r, uint64_t idx)
+{
+	const char *str;
+	uint32_t offset;
+
+	if (idx >= r->string_count)
+		return NULL;
+
+	offset = read_u32(r->data + r->string_offsets + idx * 4);
+	if (offset >= r->string_data_size)
+		return NULL;
+
+	/* strings are only validated when used, so unused parts of a mapped
+	 * file are never touched */
+	str = (const char *)r->data + r->string_data + offset;
+	if (!memchr(str, 0, r->string_data_size - offset))
+		return NULL;
+
+	return str;
+}
+
+static bool read_obj(struct binary_reader *r, obs_data_t *data, uint32_t offset, uint32_t parent, int depth);
+
+static bool read_array(struct binary_reader *r, obs_data_array_t *array, uint32_t offset, uint32_t parent,
+		       int depth)
+{
+	uint32_t count;
+
+	if (offset >= parent || !range_valid(r, offset, 4))
+		return false;
+
+	count = read_u32(r->data + offset);
+	if (!range_valid(r, (uint64_t)offset + 4, (uint64_t)count * 4))
+		return false;
+	if (count > r->nodes_left)
+		return false;
+	r->nodes_left -= count;
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t obj_offset = read_u32(r->data + offset + 4 + i * 4);
+		obs_data_t *obj = obs_data_create();
+		bool success = read_obj(r, obj, obj_offset, offset, depth + 1);
+
+		if (success)
+			obs_data_array_push_back(array, obj);
+		obs_data_release(obj);
+
+		if (!success)
+			return false;
+	}
+
+	return true;
+}
+
+static bool read_entry(struct binary_reader *r, obs_data_t *data, const uint8_t *entry, uint32_t parent, int depth)
+{
+	const char *name = read_string(r, read_u32(entry));
+	enum obs_data_type type = entry[4];
+	enum obs_data_number_type num_type = entry[5];
+	uint64_t value = read_u64(entry + 8);
+
+	if (!name)
+		return false;
+
+	if (type == OBS_DATA_STRING) {
+		const char *str = read_string(r, value);
+		if (!str)
+			return false;
+		obs_data_set_string(data, name, str);
+
+	} else if (type == OBS_DATA_NUMBER) {
+		if (num_type == OBS_DATA_NUM_INT) {
+			obs_data_set_int(data, name, (long long)value);
+		} else {
+			double d;
+			memcpy(&d, &value, sizeof(d));
+			obs_data_set_double(data, name, d);
+		}
+
+	} else if (type == OBS_DATA_BOOLEAN) {
+		obs_data_set_bool(data, name, value != 0);
+
+	} else if (type == OBS_DATA_OBJECT) {
+		obs_data_t *obj = obs_data_create();
+		bool success = value <= UINT32_MAX && read_obj(r, obj, (uint32_t)value, parent, depth + 1);
+
+		if (success)
+			obs_data_set_obj(data, name, obj);
+		obs_data_release(obj);
+		return success;
+
+	} else if (type == OBS_DATA_ARRAY) {
+		obs_data_array_t *array = obs_data_array_create();
+		bool success = value <= UINT32_MAX && read_array(r, array, (uint32_t)value, parent, depth + 1);
+
+		if (success)
+			obs_data_set_array(data, name, array);
+		obs_data_array_release(array);
+		return success;
+	}
+
+	return true;
+}
+
+static bool read_obj(struct binary_reader *r, obs_data_t *data, uint32_t offset, uint32_t parent, int depth)
+{
+	uint32_t count;
+
+	if (depth > MAX_DEPTH || offset >= parent || !range_valid(r, offset, 4))
+		return false;
+
+	count = read_u32(r->data + offset);
+	if (!range_valid(r, (uint64_t)offset + 4, (uint64_t)count * ENTRY_SIZE))
+		return false;
+	if (count > r->nodes_left)
+		return false;
+	r->nodes_left -= count;
+
+	for (uint32_t i = 0; i < count; i++) {
+		const uint8_t *entry = r->data + offset + 4 + (size_t)i * ENTRY_SIZE;
+		if (!read_entry(r, data, entry, offset, depth))
+			return false;
+	}
+
+	return true;
+}
+
+obs_data_t *obs_data_create_from_binary(const void *buf, size_t size)
+{
+	struct binary_reader r = {0};
+	const uint8_t *header = buf;
+	obs_data_t *data;
+	uint32_t root;
+
+	if (!buf || size < HEADER_SIZE || memcmp(header, BINARY_MAGIC, 4) != 0) {
+		blog(LOG_ERROR, "obs-data-binary.c: [obs_data_create_from_binary] "
+				"Invalid header");
+		return NULL;
+	}
+
+	if (read_u16(header + 4) > BINARY_VERSION) {
+		blog(LOG_ERROR,
+		     "obs-data-binary.c: [obs_data_create_from_binary] "
+		     "Unsupported version %u",
+		     read_u16(header + 4));
+		return NULL;
+	}
+
+	r.data = buf;
+	r.size = read_u32(header + 8);
+	root = read_u32(header + 12);
+	r.string_count = read_u32(header + 16);
+	r.string_offsets = read_u32(header + 20);
+	r.string_data = read_u32(header + 24);
+	r.string_data_size = read_u32(header + 28);
+	r.nodes_left = size / 4;
+
+	if (r.size > size || !range_valid(&r, r.string_offsets, (uint64_t)r.string_count * 4) ||
+	    !range_valid(&r, r.string_data, r.string_data_size)) {
+		blog(LOG_ERROR, "obs-data-binary.c: [obs_data_create_from_binary] "
+				"Invalid string table");
+		return NULL;
+	}
+
+	data = obs_data_create();
+	if (!read_obj(&r, data, root, (uint32_t)r.size, 0)) {
+		blog(LOG_ERROR, "obs-data-binary.c: [obs_data_create_from_binary] "
+				"Data is corrupt");
+		obs_data_release(data);
+		data = NULL;
+	}
+
+	return data;
+}
+
+obs_data_t *obs_data_create_from_binary_file(const char *file)
+{
+	obs_data_t *data = NULL;
+	const void *buf;
+	size_t size;
+
+	buf = os_map_file(file, &size);
+	if (buf) {
+		data = obs_data_create_from_binary(buf, size);
+		os_unmap_file(buf, size);
+	}
+
+	return data;
+}
+
+obs_data_t *obs_data_create_from_binary_file_safe(const char *file, const char *backup_ext)
+{
+	obs_data_t *file_data = obs_data_create_from_binary_file(file);
+	if (!file_data && backup_ext && *backup_ext) {
+		struct dstr backup_file = {0};
+
+		dstr_copy(&backup_file, file);
+		if (*backup_ext != '.')
+			dstr_cat(&backup_file, ".");
+		dstr_cat(&backup_file, backup_ext);
+
+		if (os_file_exists(backup_file.array)) {
+			blog(LOG_WARNING, "obs-data-binary.c: "
+					  "[obs_data_create_from_binary_file_safe] "
+					  "attempting backup file");
+
+			/* delete current file if corrupt to prevent it from
+			 * being backed up again */
+			os_rename(backup_file.array, file);
+
+			file_data = obs_data_create_from_binary_file(file);
+		}
+
+		dstr_free(&backup_file);
+	}
+
+	return file_data;
+}
@@ -27,12 +27,14 @@
 #include "graphics/quat.h"
 #include "obs-data.h"
 
-#include <jansson.h>
+#include <errno.h>
+#include <locale.h>
+#include <math.h>
 
 struct obs_data_item {
 	volatile long ref;
 	const char *name;
-	struct obs_data *parent;
+	struct obs_data_store *parent;
 	UT_hash_handle hh;
 	enum obs_data_type type;
 	size_t name_len;
@@ -44,15 +46,29 @@ struct obs_data_item {
 	size_t capacity;
 };
 
+/* Items and array objects live in stores that copy-on-write clones share
+ * until one of them is modified, which gives that one its own copy first */
+struct obs_data_store {
+	volatile long ref;
+	struct obs_data_item *items;
+};
+
+struct obs_data_array_store {
+	volatile long ref;
+	DARRAY(obs_data_t *) objects;
+};
+
 struct obs_data {
 	volatile long ref;
 	char *json;
-	struct obs_data_item *items;
+	struct obs_data_store *store;
+	DARRAY(struct obs_data_store *) retired;
 };
 
 struct obs_data_array {
 	volatile long ref;
-	DARRAY(obs_data_t *) objects;
+	struct obs_data_array_store *store;
+	DARRAY(struct obs_data_array_store *) retired;
 };
 
 struct obs_data_number {
@@ -302,6 +318,33 @@ static struct obs_data_item *obs_data_item_create(const char *name, const void *
 	return item;
 }
 
+static inline struct obs_data_store *load_store(struct obs_data *data)
+{
+	return os_atomic_load_ptr((void *const volatile *)&data->store);
+}
+
+static inline struct obs_data_array_store *load_array_store(struct obs_data_array *array)
+{
+	return os_atomic_load_ptr((void *const volatile *)&array->store);
+}
+
+static inline struct obs_data_item *data_items(struct obs_data *data)
+{
+	struct obs_data_store *store = data ? load_store(data) : NULL;
+	return store ? store->items : NULL;
+}
+
+static inline size_t array_count(struct obs_data_array *array)
+{
+	struct obs_data_array_store *store = array ? load_array_store(array) : NULL;
+	return store ? store->objects.num : 0;
+}
+
+static inline obs_data_t *array_object(struct obs_data_array *array, size_t idx)
+{
+	return idx < array_count(array) ? load_array_store(array)->objects.array[idx] : NULL;
+}
+
 static inline void obs_data_item_detach(struct obs_data_item *item)
 {
 	if (item->parent) {
@@ -310,7 +353,7 @@ static inline void obs_data_item_detach(struct obs_data_item *item)
 	}
 }
 
-static inline void obs_data_item_reattach(struct obs_data *parent, struct obs_data_item *item)
+static inline void obs_data_item_reattach(struct obs_data_store *parent, struct obs_data_item *item)
 {
 	if (parent) {
 		HASH_ADD_STR(parent->items, name, item);
@@ -326,7 +369,7 @@ static struct obs_data_item *obs_data_item_ensure_capacity(struct obs_data_item
 	if (item->capacity >= new_size)
 		return item;
 
-	struct obs_data *parent = item->parent;
+	struct obs_data_store *parent = item->parent;
 	obs_data_item_detach(item);
 
 	new_item = brealloc(item, new_size);
@@ -439,148 +482,900 @@ static inline void obs_data_item_set_autoselect_data(struct obs_data_item **p_it
 }
 
 /* ------------------------------------------------------------------------- */
+/* Copy-on-write stores */
+
+static inline void clone_item_value(struct obs_data_item *item, void *ptr)
+{
+	if (item->type == OBS_DATA_OBJECT) {
+		obs_data_t **obj = ptr;
+		*obj = obs_data_clone(*obj);
+
+	} else if (item->type == OBS_DATA_ARRAY) {
+		obs_data_array_t **array = ptr;
+		*array = obs_data_array_clone(*array);
+	}
+}
+
+/* objects and arrays of the copy are clones sharing the originals' stores, so
+ * unsharing only ever copies the level that is being modified */
+static struct obs_data_item *obs_data_item_copy(struct obs_data_item *item)
+{
+	size_t size = obs_data_item_total_size(item);
+	struct obs_data_item *new_item = bmalloc(size);
+
+	memcpy(new_item, item, size);
+	memset(&new_item->hh, 0, sizeof(new_item->hh));
+	new_item->ref = 1;
+	new_item->parent = NULL;
+	new_item->capacity = size;
+	new_item->name = get_item_name(new_item);
+
+	if (item->data_size)
+		clone_item_value(new_item, get_data_ptr(new_item));
+	if (item->default_size)
+		clone_item_value(new_item, get_default_data_ptr(new_item));
+	if (item->autoselect_size)
+		clone_item_value(new_item, get_autoselect_data_ptr(new_item));
+
+	return new_item;
+}
+
+static void obs_data_store_release(struct obs_data_store *store)
+{
+	struct obs_data_item *item, *temp;
+
+	if (!store || os_atomic_dec_long(&store->ref) != 0)
+		return;
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key, json_t *json);
+	HASH_ITER (hh, store->items, item, temp) {
+		obs_data_item_detach(item);
+		obs_data_item_release(&item);
+	}
 
-static inline void obs_data_add_json_object_data(obs_data_t *data, json_t *jobj)
+	bfree(store);
+}
+
+/*
+ * Unsharing a store replaces the store of a handle.  Setters may only be
+ * called while no other thread uses the handle, but getters that hand out
+ * nested objects, arrays or items have to unshare as well, since callers may
+ * modify what they get, and other threads may be reading the same handle at
+ * the time.  Unsharing is therefore serialized by unshare_mutex, and a store
+ * replaced by a getter stays referenced by the handle (retired) until its
+ * next modification or destruction, when no other thread can still be
+ * reading it.
+ */
+static pthread_mutex_t unshare_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static struct obs_data_store *copy_store(struct obs_data_store *store)
 {
-	const char *item_key;
-	json_t *jitem;
+	struct obs_data_store *copy = bzalloc(sizeof(struct obs_data_store));
+	struct obs_data_item *item, *temp;
+
+	copy->ref = 1;
 
-	json_object_foreach (jobj, item_key, jitem) {
-		obs_data_add_json_item(data, item_key, jitem);
+	if (store) {
+		HASH_ITER (hh, store->items, item, temp) {
+			obs_data_item_reattach(copy, obs_data_item_copy(item));
+		}
 	}
+
+	return copy;
+}
+
+static void release_retired_stores(struct obs_data *data)
+{
+	for (size_t i = 0; i < data->retired.num; i++)
+		obs_data_store_release(data->retired.array[i]);
+	da_free(data->retired);
 }
 
-static inline void obs_data_add_json_object(obs_data_t *data, const char *key, json_t *jobj)
+/* returns the store of data for modification, copying it first if it is
+ * shared with a clone.  exclusive is true for setters, which may not run
+ * concurrently with anything else using data. */
+static struct obs_data_store *get_store(struct obs_data *data, bool exclusive)
 {
-	obs_data_t *sub_obj = obs_data_create();
+	struct obs_data_store *store = load_store(data);
+	struct obs_data_store *replaced = NULL;
+
+	if (exclusive)
+		release_retired_stores(data);
+	if (store && os_atomic_load_long(&store->ref) == 1)
+		return store;
+
+	pthread_mutex_lock(&unshare_mutex);
+
+	store = data->store;
+	if (!store || os_atomic_load_long(&store->ref) != 1) {
+		replaced = store;
+		store = copy_store(replaced);
+		os_atomic_store_ptr((void *volatile *)&data->store, store);
+
+		if (replaced && !exclusive) {
+			da_push_back(data->retired, &replaced);
+			replaced = NULL;
+		}
+	}
 
-	obs_data_add_json_object_data(sub_obj, jobj);
-	obs_data_set_obj(data, key, sub_obj);
-	obs_data_release(sub_obj);
+	pthread_mutex_unlock(&unshare_mutex);
+
+	obs_data_store_release(replaced);
+	return store;
+}
+
+static void obs_data_array_store_release(struct obs_data_array_store *store)
+{
+	if (!store || os_atomic_dec_long(&store->ref) != 0)
+		return;
+
+	for (size_t i = 0; i < store->objects.num; i++)
+		obs_data_release(store->objects.array[i]);
+	da_free(store->objects);
+	bfree(store);
 }
 
-static void obs_data_add_json_array(obs_data_t *data, const char *key, json_t *jarray)
+static struct obs_data_array_store *copy_array_store(struct obs_data_array_store *store)
 {
-	obs_data_array_t *array = obs_data_array_create();
-	size_t idx;
-	json_t *jitem;
+	struct obs_data_array_store *copy = bzalloc(sizeof(struct obs_data_array_store));
 
-	json_array_foreach (jarray, idx, jitem) {
-		obs_data_t *item;
+	copy->ref = 1;
 
-		if (!json_is_object(jitem))
-			continue;
+	if (store) {
+		da_reserve(copy->objects, store->objects.num);
 
-		item = obs_data_create();
-		obs_data_add_json_object_data(item, jitem);
-		obs_data_array_push_back(array, item);
-		obs_data_release(item);
+		for (size_t i = 0; i < store->objects.num; i++) {
+			obs_data_t *obj = obs_data_clone(store->objects.array[i]);
+			da_push_back(copy->objects, &obj);
+		}
 	}
 
-	obs_data_set_array(data, key, array);
-	obs_data_array_release(array);
+	return copy;
 }
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key, json_t *json)
+static void release_retired_array_stores(struct obs_data_array *array)
 {
-	if (json_is_object(json))
-		obs_data_add_json_object(data, key, json);
-	else if (json_is_array(json))
-		obs_data_add_json_array(data, key, json);
-	else if (json_is_string(json))
-		obs_data_set_string(data, key, json_string_value(json));
-	else if (json_is_integer(json))
-		obs_data_set_int(data, key, json_integer_value(json));
-	else if (json_is_real(json))
-		obs_data_set_double(data, key, json_real_value(json));
-	else if (json_is_true(json))
-		obs_data_set_bool(data, key, true);
-	else if (json_is_false(json))
-		obs_data_set_bool(data, key, false);
+	for (size_t i = 0; i < array->retired.num; i++)
+		obs_data_array_store_release(array->retired.array[i]);
+	da_free(array->retired);
+}
+
+static struct obs_data_array_store *get_array_store(struct obs_data_array *array, bool exclusive)
+{
+	struct obs_data_array_store *store = load_array_store(array);
+	struct obs_data_array_store *replaced = NULL;
+
+	if (exclusive)
+		release_retired_array_stores(array);
+	if (store && os_atomic_load_long(&store->ref) == 1)
+		return store;
+
+	pthread_mutex_lock(&unshare_mutex);
+
+	store = array->store;
+	if (!store || os_atomic_load_long(&store->ref) != 1) {
+		replaced = store;
+		store = copy_array_store(replaced);
+		os_atomic_store_ptr((void *volatile *)&array->store, store);
+
+		if (replaced && !exclusive) {
+			da_push_back(array->retired, &replaced);
+			replaced = NULL;
+		}
+	}
+
+	pthread_mutex_unlock(&unshare_mutex);
+
+	obs_data_array_store_release(replaced);
+	return store;
+}
+
+/* the item is looked up in the store of data that is about to be modified or
+ * that an object, array or item of it is about to be handed out of */
+static struct obs_data_item *get_item_for_write(struct obs_data *data, const char *name, bool exclusive)
+{
+	if (!data || !load_store(data))
+		return NULL;
+
+	struct obs_data_item *item;
+	HASH_FIND_STR(get_store(data, exclusive)->items, name, item);
+	return item;
 }
 
 /* ------------------------------------------------------------------------- */
+/* Streaming JSON reader, builds obs_data directly while parsing */
+
+#define JSON_MAX_DEPTH 2048
+
+struct json_reader {
+	const char *pos;
+	int line;
+	int depth;
+
+	/* decoded strings, and a stack of the keys currently being parsed */
+	struct dstr str;
+	struct dstr keys;
+
+	char error[160];
+};
+
+static struct obs_data_item *get_item(struct obs_data *data, const char *name);
+
+static bool json_error(struct json_reader *r, const char *msg)
+{
+	if (!*r->error)
+		snprintf(r->error, sizeof(r->error), "%s", msg);
+	return false;
+}
 
-static inline void set_json_string(json_t *json, const char *name, obs_data_item_t *item)
+static inline void json_truncate(struct dstr *str, size_t len)
 {
-	const char *val = obs_data_item_get_string(item);
-	json_object_set_new(json, name, json_string(val));
+	if (str->array) {
+		str->array[len] = 0;
+		str->len = len;
+	}
 }
 
-static inline void set_json_number(json_t *json, const char *name, obs_data_item_t *item)
+static inline void json_skip_ws(struct json_reader *r)
 {
-	enum obs_data_number_type type = obs_data_item_numtype(item);
+	for (;;) {
+		char ch = *r->pos;
+		if (ch == '\n')
+			r->line++;
+		else if (ch != ' ' && ch != '\t' && ch != '\r')
+			return;
+		r->pos++;
+	}
+}
+
+/* returns the length of the UTF-8 sequence at str, or 0 if invalid */
+static size_t utf8_seq_len(const uint8_t *str)
+{
+	uint32_t cp;
+	size_t len;
+
+	if (str[0] < 0x80)
+		return 1;
+	else if (str[0] >= 0xC2 && str[0] <= 0xDF)
+		len = 2;
+	else if ((str[0] & 0xF0) == 0xE0)
+		len = 3;
+	else if (str[0] >= 0xF0 && str[0] <= 0xF4)
+		len = 4;
+	else
+		return 0;
+
+	cp = str[0] & (0x3F >> (len - 1));
+	for (size_t i = 1; i < len; i++) {
+		if ((str[i] & 0xC0) != 0x80)
+			return 0;
+		cp = (cp << 6) | (str[i] & 0x3F);
+	}
+
+	/* overlong, surrogate or out of range */
+	if ((len == 3 && cp < 0x800) || (len == 4 && cp < 0x10000) || (cp >= 0xD800 && cp <= 0xDFFF) ||
+	    cp > 0x10FFFF)
+		return 0;
+	return len;
+}
+
+static bool utf8_valid(const char *str)
+{
+	const uint8_t *pos = (const uint8_t *)str;
+
+	while (*pos) {
+		size_t len = utf8_seq_len(pos);
+		if (!len)
+			return false;
+		pos += len;
+	}
+
+	return true;
+}
+
+static inline int hex_val(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+	return -1;
+}
+
+static bool json_read_hex4(struct json_reader *r, uint32_t *val)
+{
+	*val = 0;
+	for (int i = 0; i < 4; i++) {
+		int digit = hex_val(r->pos[i]);
+		if (digit < 0)
+			return json_error(r, "invalid escape");
+		*val = (*val << 4) | (uint32_t)digit;
+	}
+
+	r->pos += 4;
+	return true;
+}
 
-	if (type == OBS_DATA_NUM_INT) {
-		long long val = obs_data_item_get_int(item);
-		json_object_set_new(json, name, json_integer(val));
+static void json_cat_codepoint(struct dstr *str, uint32_t cp)
+{
+	char buf[4];
+	size_t len;
+
+	if (cp < 0x80) {
+		buf[0] = (char)cp;
+		len = 1;
+	} else if (cp < 0x800) {
+		buf[0] = (char)(0xC0 | (cp >> 6));
+		buf[1] = (char)(0x80 | (cp & 0x3F));
+		len = 2;
+	} else if (cp < 0x10000) {
+		buf[0] = (char)(0xE0 | (cp >> 12));
+		buf[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		buf[2] = (char)(0x80 | (cp & 0x3F));
+		len = 3;
 	} else {
-		double val = obs_data_item_get_double(item);
-		json_object_set_new(json, name, json_real(val));
+		buf[0] = (char)(0xF0 | (cp >> 18));
+		buf[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+		buf[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		buf[3] = (char)(0x80 | (cp & 0x3F));
+		len = 4;
 	}
+
+	dstr_ncat(str, buf, len);
 }
 
-static inline void set_json_bool(json_t *json, const char *name, obs_data_item_t *item)
+static bool json_read_escape(struct json_reader *r, struct dstr *out)
 {
-	bool val = obs_data_item_get_bool(item);
-	json_object_set_new(json, name, val ? json_true() : json_false());
+	char ch = *r->pos++;
+	uint32_t cp, low;
+
+	switch (ch) {
+	case '"':
+	case '\\':
+	case '/':
+		dstr_cat_ch(out, ch);
+		return true;
+	case 'b':
+		dstr_cat_ch(out, '\b');
+		return true;
+	case 'f':
+		dstr_cat_ch(out, '\f');
+		return true;
+	case 'n':
+		dstr_cat_ch(out, '\n');
+		return true;
+	case 'r':
+		dstr_cat_ch(out, '\r');
+		return true;
+	case 't':
+		dstr_cat_ch(out, '\t');
+		return true;
+	case 'u':
+		break;
+	default:
+		return json_error(r, "invalid escape");
+	}
+
+	if (!json_read_hex4(r, &cp))
+		return false;
+
+	if (cp >= 0xD800 && cp <= 0xDBFF) {
+		if (r->pos[0] != '\\' || r->pos[1] != 'u')
+			return json_error(r, "invalid Unicode escape");
+		r->pos += 2;
+		if (!json_read_hex4(r, &low))
+			return false;
+		if (low < 0xDC00 || low > 0xDFFF)
+			return json_error(r, "invalid Unicode escape");
+		cp = 0x10000 + (((cp - 0xD800) << 10) | (low - 0xDC00));
+
+	} else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+		return json_error(r, "invalid Unicode escape");
+
+	} else if (cp == 0) {
+		return json_error(r, "\\u0000 is not allowed");
+	}
+
+	json_cat_codepoint(out, cp);
+	return true;
 }
 
-static json_t *obs_data_to_json(obs_data_t *data, bool with_defaults);
+/* appends the decoded string to out, r->pos must be after the opening quote */
+static bool json_read_string(struct json_reader *r, struct dstr *out)
+{
+	for (;;) {
+		const char *start = r->pos;
+
+		/* copy runs of plain characters at once */
+		while ((uint8_t)*r->pos >= 0x20 && *r->pos != '"' && *r->pos != '\\') {
+			if ((uint8_t)*r->pos < 0x80) {
+				r->pos++;
+			} else {
+				size_t len = utf8_seq_len((const uint8_t *)r->pos);
+				if (!len)
+					return json_error(r, "invalid UTF-8");
+				r->pos += len;
+			}
+		}
+
+		if (r->pos != start)
+			dstr_ncat(out, start, (size_t)(r->pos - start));
+
+		if (*r->pos == '"') {
+			r->pos++;
+			if (!out->array)
+				dstr_copy(out, "");
+			return true;
+		} else if (*r->pos == '\\') {
+			r->pos++;
+			if (!json_read_escape(r, out))
+				return false;
+		} else {
+			return json_error(r, *r->pos ? "control character in string" : "premature end of input");
+		}
+	}
+}
 
-static inline void set_json_obj(json_t *json, const char *name, obs_data_item_t *item, bool with_defaults)
+static inline void json_to_locale(char *str)
 {
-	obs_data_t *obj = obs_data_item_get_obj(item);
-	json_object_set_new(json, name, obs_data_to_json(obj, with_defaults));
-	obs_data_release(obj);
+	const char *point = localeconv()->decimal_point;
+	char *pos;
+
+	if (*point != '.' && (pos = strchr(str, '.')) != NULL)
+		*pos = *point;
 }
 
-static inline void set_json_array(json_t *json, const char *name, obs_data_item_t *item, bool with_defaults)
+static bool json_read_number(struct json_reader *r, obs_data_t *data, const char *key)
 {
-	json_t *jarray = json_array();
-	obs_data_array_t *array = obs_data_item_get_array(item);
-	size_t count = obs_data_array_count(array);
+	const char *start = r->pos;
+	bool is_real = false;
+	char buf[64];
+	char *num;
+	size_t len;
+
+	if (*r->pos == '-')
+		r->pos++;
 
-	for (size_t idx = 0; idx < count; idx++) {
-		obs_data_t *sub_item = obs_data_array_item(array, idx);
-		json_t *jitem = obs_data_to_json(sub_item, with_defaults);
-		json_array_append_new(jarray, jitem);
-		obs_data_release(sub_item);
+	if (*r->pos == '0') {
+		r->pos++;
+		if (*r->pos >= '0' && *r->pos <= '9')
+			return json_error(r, "invalid number");
+	} else if (*r->pos >= '1' && *r->pos <= '9') {
+		while (*r->pos >= '0' && *r->pos <= '9')
+			r->pos++;
+	} else {
+		return json_error(r, "invalid token");
 	}
 
-	json_object_set_new(json, name, jarray);
-	obs_data_array_release(array);
+	if (*r->pos == '.') {
+		is_real = true;
+		r->pos++;
+		if (*r->pos < '0' || *r->pos > '9')
+			return json_error(r, "invalid number");
+		while (*r->pos >= '0' && *r->pos <= '9')
+			r->pos++;
+	}
+
+	if (*r->pos == 'e' || *r->pos == 'E') {
+		is_real = true;
+		r->pos++;
+		if (*r->pos == '+' || *r->pos == '-')
+			r->pos++;
+		if (*r->pos < '0' || *r->pos > '9')
+			return json_error(r, "invalid number");
+		while (*r->pos >= '0' && *r->pos <= '9')
+			r->pos++;
+	}
+
+	len = (size_t)(r->pos - start);
+	num = len < sizeof(buf) ? buf : bmalloc(len + 1);
+	memcpy(num, start, len);
+	num[len] = 0;
+
+	errno = 0;
+	if (!is_real) {
+		long long val = strtoll(num, NULL, 10);
+		if (errno == ERANGE)
+			json_error(r, "too big integer");
+		else if (data)
+			obs_data_set_int(data, key, val);
+	} else {
+		json_to_locale(num);
+		double val = strtod(num, NULL);
+		if (errno == ERANGE && (val == HUGE_VAL || val == -HUGE_VAL))
+			json_error(r, "real number overflow");
+		else if (data)
+			obs_data_set_double(data, key, val);
+	}
+
+	if (num != buf)
+		bfree(num);
+	return !*r->error;
 }
 
-static json_t *obs_data_to_json(obs_data_t *data, bool with_defaults)
+static inline bool json_read_literal(struct json_reader *r, const char *literal, size_t len)
 {
-	json_t *json = json_object();
+	if (strncmp(r->pos, literal, len) != 0)
+		return json_error(r, "invalid token");
 
-	obs_data_item_t *item = NULL;
-	obs_data_item_t *temp = NULL;
+	r->pos += len;
+	return true;
+}
 
-	HASH_ITER (hh, data->items, item, temp) {
-		enum obs_data_type type = obs_data_item_gettype(item);
-		const char *name = get_item_name(item);
+static bool json_read_object(struct json_reader *r, obs_data_t *data);
+static bool json_read_array(struct json_reader *r, obs_data_array_t *array);
+
+/* data is NULL for values that are parsed but not stored, such as values in
+ * arrays that aren't objects */
+static bool json_read_value(struct json_reader *r, obs_data_t *data, size_t key_offset)
+{
+	const char *key = data ? r->keys.array + key_offset : NULL;
+	bool success;
+
+	switch (*r->pos) {
+	case '{': {
+		obs_data_t *obj = data ? obs_data_create() : NULL;
+		success = json_read_object(r, obj);
+		if (success && obj)
+			obs_data_set_obj(data, r->keys.array + key_offset, obj);
+		obs_data_release(obj);
+		return success;
+	}
+	case '[': {
+		obs_data_array_t *array = data ? obs_data_array_create() : NULL;
+		success = json_read_array(r, array);
+		if (success && array)
+			obs_data_set_array(data, r->keys.array + key_offset, array);
+		obs_data_array_release(array);
+		return success;
+	}
+	case '"':
+		r->pos++;
+		json_truncate(&r->str, 0);
+		if (!json_read_string(r, &r->str))
+			return false;
+		if (data)
+			obs_data_set_string(data, key, r->str.array);
+		return true;
+	case 't':
+		if (!json_read_literal(r, "true", 4))
+			return false;
+		if (data)
+			obs_data_set_bool(data, key, true);
+		return true;
+	case 'f':
+		if (!json_read_literal(r, "false", 5))
+			return false;
+		if (data)
+			obs_data_set_bool(data, key, false);
+		return true;
+	case 'n':
+		return json_read_literal(r, "null", 4);
+	default:
+		return json_read_number(r, data, key);
+	}
+}
+
+static bool json_read_object(struct json_reader *r, obs_data_t *data)
+{
+	size_t base = r->keys.len;
+	size_t key_offset;
+	bool success = false;
+
+	if (++r->depth > JSON_MAX_DEPTH)
+		return json_error(r, "maximum parsing depth reached");
+
+	/* keep the key of the parent object terminated */
+	dstr_cat_ch(&r->keys, 0);
+	key_offset = r->keys.len;
+
+	r->pos++;
+	json_skip_ws(r);
+
+	if (*r->pos == '}') {
+		r->pos++;
+		success = true;
+		goto exit;
+	}
+
+	for (;;) {
+		if (*r->pos != '"') {
+			json_error(r, "string or '}' expected");
+			break;
+		}
+
+		r->pos++;
+		if (!json_read_string(r, &r->keys))
+			break;
+
+		if (data && get_item(data, r->keys.array + key_offset)) {
+			json_error(r, "duplicate object key");
+			break;
+		}
+
+		json_skip_ws(r);
+		if (*r->pos != ':') {
+			json_error(r, "':' expected");
+			break;
+		}
+		r->pos++;
+		json_skip_ws(r);
+
+		if (!json_read_value(r, data, key_offset))
+			break;
+
+		json_truncate(&r->keys, key_offset);
+
+		json_skip_ws(r);
+		if (*r->pos == '}') {
+			r->pos++;
+			success = true;
+			break;
+		} else if (*r->pos != ',') {
+			json_error(r, "',' or '}' expected");
+			break;
+		}
+
+		r->pos++;
+		json_skip_ws(r);
+	}
+
+exit:
+	json_truncate(&r->keys, base);
+	r->depth--;
+	return success;
+}
+
+static bool json_read_array(struct json_reader *r, obs_data_array_t *array)
+{
+	bool success = false;
+
+	if (++r->depth > JSON_MAX_DEPTH)
+		return json_error(r, "maximum parsing depth reached");
+
+	r->pos++;
+	json_skip_ws(r);
+
+	if (*r->pos == ']') {
+		r->pos++;
+		r->depth--;
+		return true;
+	}
 
-		if (!with_defaults && !obs_data_item_has_user_value(item))
-			continue;
+	for (;;) {
+		/* only objects are kept in arrays */
+		if (*r->pos == '{' && array) {
+			obs_data_t *obj = obs_data_create();
+			success = json_read_object(r, obj);
+			if (success)
+				obs_data_array_push_back(array, obj);
+			obs_data_release(obj);
+		} else {
+			success = json_read_value(r, NULL, r->keys.len);
+		}
+
+		if (!success)
+			break;
+		success = false;
+
+		json_skip_ws(r);
+		if (*r->pos == ']') {
+			r->pos++;
+			success = true;
+			break;
+		} else if (*r->pos != ',') {
+			json_error(r, "',' or ']' expected");
+			break;
+		}
 
-		if (type == OBS_DATA_STRING)
-			set_json_string(json, name, item);
-		else if (type == OBS_DATA_NUMBER)
-			set_json_number(json, name, item);
-		else if (type == OBS_DATA_BOOLEAN)
-			set_json_bool(json, name, item);
-		else if (type == OBS_DATA_OBJECT)
-			set_json_obj(json, name, item, with_defaults);
-		else if (type == OBS_DATA_ARRAY)
-			set_json_array(json, name, item, with_defaults);
+		r->pos++;
+		json_skip_ws(r);
 	}
 
-	return json;
+	r->depth--;
+	return success;
+}
+
+static bool json_read_root(struct json_reader *r, obs_data_t *data)
+{
+	bool success;
+
+	json_skip_ws(r);
+
+	/* like before, a root array is accepted but results in empty data */
+	if (*r->pos == '{')
+		success = json_read_object(r, data);
+	else if (*r->pos == '[')
+		success = json_read_array(r, NULL);
+	else
+		return json_error(r, "'[' or '{' expected");
+
+	if (!success)
+		return false;
+
+	json_skip_ws(r);
+	if (*r->pos)
+		return json_error(r, "end of file expected");
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Streaming JSON writer, output matches jansson's compact and indented
+ * formats */
+
+struct json_writer {
+	struct dstr out;
+	bool pretty;
+	bool with_defaults;
+	int depth;
+};
+
+static void json_write_newline(struct json_writer *w)
+{
+	if (!w->pretty)
+		return;
+
+	dstr_cat_ch(&w->out, '\n');
+	for (int i = 0; i < w->depth * 4; i++)
+		dstr_cat_ch(&w->out, ' ');
+}
+
+static void json_write_string(struct json_writer *w, const char *str)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	dstr_cat_ch(&w->out, '"');
+
+	for (;;) {
+		const char *start = str;
+
+		while ((uint8_t)*str >= 0x20 && *str != '"' && *str != '\\')
+			str++;
+
+		if (str != start)
+			dstr_ncat(&w->out, start, (size_t)(str - start));
+		if (!*str)
+			break;
+
+		char ch = *str++;
+		switch (ch) {
+		case '"':
+			dstr_cat(&w->out, "\\\"");
+			break;
+		case '\\':
+			dstr_cat(&w->out, "\\\\");
+			break;
+		case '\b':
+			dstr_cat(&w->out, "\\b");
+			break;
+		case '\f':
+			dstr_cat(&w->out, "\\f");
+			break;
+		case '\n':
+			dstr_cat(&w->out, "\\n");
+			break;
+		case '\r':
+			dstr_cat(&w->out, "\\r");
+			break;
+		case '\t':
+			dstr_cat(&w->out, "\\t");
+			break;
+		default: {
+			char seq[7] = {'\\', 'u', '0', '0', hex[(ch >> 4) & 0xF], hex[ch & 0xF], 0};
+			dstr_cat(&w->out, seq);
+		}
+		}
+	}
+
+	dstr_cat_ch(&w->out, '"');
+}
+
+static void json_write_obj(struct json_writer *w, obs_data_t *data);
+
+static void json_write_array(struct json_writer *w, obs_data_array_t *array)
+{
+	size_t count = array_count(array);
+
+	if (!count) {
+		dstr_cat(&w->out, "[]");
+		return;
+	}
+
+	dstr_cat_ch(&w->out, '[');
+	w->depth++;
+
+	for (size_t i = 0; i < count; i++) {
+		if (i)
+			dstr_cat_ch(&w->out, ',');
+		json_write_newline(w);
+		json_write_obj(w, array_object(array, i));
+	}
+
+	w->depth--;
+	json_write_newline(w);
+	dstr_cat_ch(&w->out, ']');
+}
+
+/* values that jansson can't represent are left out, like before */
+static bool json_item_valid(obs_data_item_t *item)
+{
+	enum obs_data_type type = obs_data_item_gettype(item);
+
+	if (!utf8_valid(obs_data_item_get_name(item)))
+		return false;
+
+	if (type == OBS_DATA_STRING)
+		return utf8_valid(obs_data_item_get_string(item));
+	if (type == OBS_DATA_NUMBER && obs_data_item_numtype(item) != OBS_DATA_NUM_INT)
+		return isfinite(obs_data_item_get_double(item));
+	return type != OBS_DATA_NULL;
+}
+
+static void json_write_item(struct json_writer *w, obs_data_item_t *item)
+{
+	enum obs_data_type type = obs_data_item_gettype(item);
+	char buf[32];
+
+	json_write_string(w, obs_data_item_get_name(item));
+	dstr_cat(&w->out, w->pretty ? ": " : ":");
+
+	if (type == OBS_DATA_STRING) {
+		json_write_string(w, obs_data_item_get_string(item));
+
+	} else if (type == OBS_DATA_NUMBER) {
+		if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT) {
+			snprintf(buf, sizeof(buf), "%lld", obs_data_item_get_int(item));
+			dstr_cat(&w->out, buf);
+		} else {
+			os_dtostr(obs_data_item_get_double(item), buf, sizeof(buf));
+			dstr_cat(&w->out, buf);
+		}
+
+	} else if (type == OBS_DATA_BOOLEAN) {
+		dstr_cat(&w->out, obs_data_item_get_bool(item) ? "true" : "false");
+
+	} else if (type == OBS_DATA_OBJECT) {
+		obs_data_t *obj = obs_data_item_get_obj(item);
+		json_write_obj(w, obj);
+		obs_data_release(obj);
+
+	} else if (type == OBS_DATA_ARRAY) {
+		obs_data_array_t *array = obs_data_item_get_array(item);
+		json_write_array(w, array);
+		obs_data_array_release(array);
+	}
+}
+
+static void json_write_obj(struct json_writer *w, obs_data_t *data)
+{
+	obs_data_item_t *item = NULL;
+	obs_data_item_t *temp = NULL;
+	bool first = true;
+
+	dstr_cat_ch(&w->out, '{');
+	w->depth++;
+
+	if (data) {
+		HASH_ITER (hh, data_items(data), item, temp) {
+			if (!w->with_defaults && !obs_data_item_has_user_value(item))
+				continue;
+			if (!json_item_valid(item))
+				continue;
+
+			if (!first)
+				dstr_cat_ch(&w->out, ',');
+			json_write_newline(w);
+			json_write_item(w, item);
+			first = false;
+		}
+	}
+
+	w->depth--;
+	if (!first)
+		json_write_newline(w);
+	dstr_cat_ch(&w->out, '}');
 }
 
 /* ------------------------------------------------------------------------- */
@@ -595,23 +1390,27 @@ obs_data_t *obs_data_create()
 
 obs_data_t *obs_data_create_from_json(const char *json_string)
 {
-	obs_data_t *data = obs_data_create();
+	struct json_reader r = {0};
+	obs_data_t *data;
 
-	json_error_t error;
-	json_t *root = json_loads(json_string, JSON_REJECT_DUPLICATES, &error);
+	if (!json_string)
+		return NULL;
 
-	if (root) {
-		obs_data_add_json_object_data(data, root);
-		json_decref(root);
-	} else {
+	data = obs_data_create();
+	r.pos = json_string;
+	r.line = 1;
+
+	if (!json_read_root(&r, data)) {
 		blog(LOG_ERROR,
 		     "obs-data.c: [obs_data_create_from_json] "
 		     "Failed reading json string (%d): %s",
-		     error.line, error.text);
+		     r.line, r.error);
 		obs_data_release(data);
 		data = NULL;
 	}
 
+	dstr_free(&r.str);
+	dstr_free(&r.keys);
 	return data;
 }
 
@@ -665,15 +1464,9 @@ void obs_data_addref(obs_data_t *data)
 
 static inline void obs_data_destroy(struct obs_data *data)
 {
-	struct obs_data_item *item, *temp;
-
-	HASH_ITER (hh, data->items, item, temp) {
-		obs_data_item_detach(item);
-		obs_data_item_release(&item);
-	}
-
-	/* NOTE: don't use bfree for json text, allocated by json */
-	free(data->json);
+	release_retired_stores(data);
+	obs_data_store_release(data->store);
+	bfree(data->json);
 	bfree(data);
 }
 
@@ -686,25 +1479,32 @@ void obs_data_release(obs_data_t *data)
 		obs_data_destroy(data);
 }
 
-static const char *obs_data_get_json_internal(obs_data_t *data, bool pretty, bool with_defaults)
+obs_data_t *obs_data_clone(obs_data_t *data)
 {
 	if (!data)
 		return NULL;
 
-	size_t flags = JSON_PRESERVE_ORDER;
+	struct obs_data *clone = obs_data_create();
+	clone->store = load_store(data);
+	if (clone->store)
+		os_atomic_inc_long(&clone->store->ref);
 
-	if (pretty)
-		flags |= JSON_INDENT(4);
-	else
-		flags |= JSON_COMPACT;
+	return clone;
+}
+
+static const char *obs_data_get_json_internal(obs_data_t *data, bool pretty, bool with_defaults)
+{
+	struct json_writer w = {0};
+
+	if (!data)
+		return NULL;
 
-	/* NOTE: don't use libobs bfree for json text */
-	free(data->json);
-	data->json = NULL;
+	w.pretty = pretty;
+	w.with_defaults = with_defaults;
+	json_write_obj(&w, data);
 
-	json_t *root = obs_data_to_json(data, with_defaults);
-	data->json = json_dumps(root, flags);
-	json_decref(root);
+	bfree(data->json);
+	data->json = w.out.array;
 
 	return data->json;
 }
@@ -786,7 +1586,7 @@ obs_data_t *obs_data_get_defaults(obs_data_t *data)
 
 	struct obs_data_item *item, *temp;
 
-	HASH_ITER (hh, data->items, item, temp) {
+	HASH_ITER (hh, data_items(data), item, temp) {
 		const char *name = get_item_name(item);
 		switch (item->type) {
 		case OBS_DATA_NULL:
@@ -858,7 +1658,7 @@ static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 		return NULL;
 
 	struct obs_data_item *item;
-	HASH_FIND_STR(data->items, name, item);
+	HASH_FIND_STR(data_items(data), name, item);
 	return item;
 }
 
@@ -869,8 +1669,7 @@ static void set_item_data(struct obs_data *data, struct obs_data_item **item, co
 
 	if ((!item || !*item) && data) {
 		new_item = obs_data_item_create(name, ptr, size, type, default_data, autoselect_data);
-		new_item->parent = data;
-		HASH_ADD_STR(data->items, name, new_item);
+		obs_data_item_reattach(get_store(data, true), new_item);
 
 	} else if (default_data) {
 		obs_data_item_set_default_data(item, ptr, size, type);
@@ -890,7 +1689,7 @@ static inline void set_item(struct obs_data *data, obs_data_item_t **item, const
 		return;
 
 	if (!item) {
-		actual_item = get_item(data, name);
+		actual_item = get_item_for_write(data, name, true);
 		item = &actual_item;
 	}
 
@@ -906,7 +1705,7 @@ static inline void set_item_def(struct obs_data *data, obs_data_item_t **item, c
 		return;
 
 	if (!item) {
-		actual_item = get_item(data, name);
+		actual_item = get_item_for_write(data, name, true);
 		item = &actual_item;
 	}
 
@@ -925,7 +1724,7 @@ static inline void set_item_auto(struct obs_data *data, obs_data_item_t **item,
 		return;
 
 	if (!item) {
-		actual_item = get_item(data, name);
+		actual_item = get_item_for_write(data, name, true);
 		item = &actual_item;
 	}
 
@@ -936,8 +1735,7 @@ static void copy_obj(struct obs_data *data, const char *name, struct obs_data *o
 		     void (*callback)(obs_data_t *, const char *, obs_data_t *))
 {
 	if (obj) {
-		obs_data_t *new_obj = obs_data_create();
-		obs_data_apply(new_obj, obj);
+		obs_data_t *new_obj = obs_data_clone(obj);
 		callback(data, name, new_obj);
 		obs_data_release(new_obj);
 	}
@@ -947,19 +1745,7 @@ static void copy_array(struct obs_data *data, const char *name, struct obs_data_
 		       void (*callback)(obs_data_t *, const char *, obs_data_array_t *))
 {
 	if (array) {
-		obs_data_array_t *new_array = obs_data_array_create();
-		da_reserve(new_array->objects, array->objects.num);
-
-		for (size_t i = 0; i < array->objects.num; i++) {
-			obs_data_t *new_obj = obs_data_create();
-			obs_data_t *obj = array->objects.array[i];
-
-			obs_data_apply(new_obj, obj);
-			obs_data_array_push_back(new_array, new_obj);
-
-			obs_data_release(new_obj);
-		}
-
+		obs_data_array_t *new_array = obs_data_array_clone(array);
 		callback(data, name, new_array);
 		obs_data_array_release(new_array);
 	}
@@ -995,14 +1781,14 @@ void obs_data_apply(obs_data_t *target, obs_data_t *apply_data)
 
 	struct obs_data_item *item, *temp;
 
-	HASH_ITER (hh, apply_data->items, item, temp) {
+	HASH_ITER (hh, data_items(apply_data), item, temp) {
 		copy_item(target, item);
 	}
 }
 
 void obs_data_erase(obs_data_t *data, const char *name)
 {
-	struct obs_data_item *item = get_item(data, name);
+	struct obs_data_item *item = get_item_for_write(data, name, true);
 
 	if (item) {
 		obs_data_item_detach(item);
@@ -1040,11 +1826,11 @@ static inline void clear_item(struct obs_data_item *item)
 
 void obs_data_clear(obs_data_t *target)
 {
-	if (!target)
+	if (!target || !load_store(target))
 		return;
 
 	struct obs_data_item *item, *temp;
-	HASH_ITER (hh, target->items, item, temp) {
+	HASH_ITER (hh, get_store(target, true)->items, item, temp) {
 		clear_item(item);
 	}
 }
@@ -1214,12 +2000,12 @@ bool obs_data_get_bool(obs_data_t *data, const char *name)
 
 obs_data_t *obs_data_get_obj(obs_data_t *data, const char *name)
 {
-	return obs_data_item_get_obj(get_item(data, name));
+	return obs_data_item_get_obj(get_item_for_write(data, name, false));
 }
 
 obs_data_array_t *obs_data_get_array(obs_data_t *data, const char *name)
 {
-	return obs_data_item_get_array(get_item(data, name));
+	return obs_data_item_get_array(get_item_for_write(data, name, false));
 }
 
 const char *obs_data_get_default_string(obs_data_t *data, const char *name)
@@ -1244,12 +2030,12 @@ bool obs_data_get_default_bool(obs_data_t *data, const char *name)
 
 obs_data_t *obs_data_get_default_obj(obs_data_t *data, const char *name)
 {
-	return obs_data_item_get_default_obj(get_item(data, name));
+	return obs_data_item_get_default_obj(get_item_for_write(data, name, false));
 }
 
 obs_data_array_t *obs_data_get_default_array(obs_data_t *data, const char *name)
 {
-	return obs_data_item_get_default_array(get_item(data, name));
+	return obs_data_item_get_default_array(get_item_for_write(data, name, false));
 }
 
 const char *obs_data_get_autoselect_string(obs_data_t *data, const char *name)
@@ -1274,12 +2060,12 @@ bool obs_data_get_autoselect_bool(obs_data_t *data, const char *name)
 
 obs_data_t *obs_data_get_autoselect_obj(obs_data_t *data, const char *name)
 {
-	return obs_data_item_get_autoselect_obj(get_item(data, name));
+	return obs_data_item_get_autoselect_obj(get_item_for_write(data, name, false));
 }
 
 obs_data_array_t *obs_data_get_autoselect_array(obs_data_t *data, const char *name)
 {
-	return obs_data_item_get_autoselect_array(get_item(data, name));
+	return obs_data_item_get_autoselect_array(get_item_for_write(data, name, false));
 }
 
 obs_data_array_t *obs_data_array_create()
@@ -1299,9 +2085,8 @@ void obs_data_array_addref(obs_data_array_t *array)
 static inline void obs_data_array_destroy(obs_data_array_t *array)
 {
 	if (array) {
-		for (size_t i = 0; i < array->objects.num; i++)
-			obs_data_release(array->objects.array[i]);
-		da_free(array->objects);
+		release_retired_array_stores(array);
+		obs_data_array_store_release(array->store);
 		bfree(array);
 	}
 }
@@ -1315,19 +2100,32 @@ void obs_data_array_release(obs_data_array_t *array)
 		obs_data_array_destroy(array);
 }
 
+obs_data_array_t *obs_data_array_clone(obs_data_array_t *array)
+{
+	if (!array)
+		return NULL;
+
+	struct obs_data_array *clone = obs_data_array_create();
+	clone->store = load_array_store(array);
+	if (clone->store)
+		os_atomic_inc_long(&clone->store->ref);
+
+	return clone;
+}
+
 size_t obs_data_array_count(obs_data_array_t *array)
 {
-	return array ? array->objects.num : 0;
+	return array_count(array);
 }
 
 obs_data_t *obs_data_array_item(obs_data_array_t *array, size_t idx)
 {
 	obs_data_t *data;
 
-	if (!array)
+	if (!array || idx >= array_count(array))
 		return NULL;
 
-	data = (idx < array->objects.num) ? array->objects.array[idx] : NULL;
+	data = get_array_store(array, false)->objects.array[idx];
 
 	if (data)
 		os_atomic_inc_long(&data->ref);
@@ -1340,7 +2138,7 @@ size_t obs_data_array_push_back(obs_data_array_t *array, obs_data_t *obj)
 		return 0;
 
 	os_atomic_inc_long(&obj->ref);
-	return da_push_back(array->objects, &obj);
+	return da_push_back(get_array_store(array, true)->objects, &obj);
 }
 
 void obs_data_array_insert(obs_data_array_t *array, size_t idx, obs_data_t *obj)
@@ -1349,34 +2147,40 @@ void obs_data_array_insert(obs_data_array_t *array, size_t idx, obs_data_t *obj)
 		return;
 
 	os_atomic_inc_long(&obj->ref);
-	da_insert(array->objects, idx, &obj);
+	da_insert(get_array_store(array, true)->objects, idx, &obj);
 }
 
 void obs_data_array_push_back_array(obs_data_array_t *array, obs_data_array_t *array2)
 {
-	if (!array || !array2)
+	if (!array || !array2 || !array_count(array2))
 		return;
 
-	for (size_t i = 0; i < array2->objects.num; i++) {
-		obs_data_t *obj = array2->objects.array[i];
+	struct obs_data_array_store *store = get_array_store(array, true);
+	struct obs_data_array_store *store2 = get_array_store(array2, false);
+
+	for (size_t i = 0; i < store2->objects.num; i++) {
+		obs_data_t *obj = store2->objects.array[i];
 		obs_data_addref(obj);
 	}
-	da_push_back_da(array->objects, array2->objects);
+	da_push_back_da(store->objects, store2->objects);
 }
 
 void obs_data_array_erase(obs_data_array_t *array, size_t idx)
 {
 	if (array) {
-		obs_data_release(array->objects.array[idx]);
-		da_erase(array->objects, idx);
+		struct obs_data_array_store *store = get_array_store(array, true);
+		obs_data_release(store->objects.array[idx]);
+		da_erase(store->objects, idx);
 	}
 }
 
 void obs_data_array_enum(obs_data_array_t *array, void (*cb)(obs_data_t *data, void *param), void *param)
 {
-	if (array && cb) {
-		for (size_t i = 0; i < array->objects.num; i++) {
-			cb(array->objects.array[i], param);
+	if (array && cb && array_count(array)) {
+		struct obs_data_array_store *store = get_array_store(array, false);
+
+		for (size_t i = 0; i < store->objects.num; i++) {
+			cb(store->objects.array[i], param);
 		}
 	}
 }
@@ -1419,17 +2223,17 @@ bool obs_data_item_has_autoselect_value(obs_data_item_t *item)
 
 void obs_data_unset_user_value(obs_data_t *data, const char *name)
 {
-	obs_data_item_unset_user_value(get_item(data, name));
+	obs_data_item_unset_user_value(get_item_for_write(data, name, true));
 }
 
 void obs_data_unset_default_value(obs_data_t *data, const char *name)
 {
-	obs_data_item_unset_default_value(get_item(data, name));
+	obs_data_item_unset_default_value(get_item_for_write(data, name, true));
 }
 
 void obs_data_unset_autoselect_value(obs_data_t *data, const char *name)
 {
-	obs_data_item_unset_autoselect_value(get_item(data, name));
+	obs_data_item_unset_autoselect_value(get_item_for_write(data, name, true));
 }
 
 void obs_data_item_unset_user_value(obs_data_item_t *item)
@@ -1477,12 +2281,13 @@ void obs_data_item_unset_autoselect_value(obs_data_item_t *item)
 
 obs_data_item_t *obs_data_first(obs_data_t *data)
 {
-	if (!data)
+	if (!data || !load_store(data))
 		return NULL;
 
-	if (data->items)
-		os_atomic_inc_long(&data->items->ref);
-	return data->items;
+	struct obs_data_item *item = get_store(data, false)->items;
+	if (item)
+		os_atomic_inc_long(&item->ref);
+	return item;
 }
 
 obs_data_item_t *obs_data_item_byname(obs_data_t *data, const char *name)
@@ -1490,7 +2295,7 @@ obs_data_item_t *obs_data_item_byname(obs_data_t *data, const char *name)
 	if (!data)
 		return NULL;
 
-	struct obs_data_item *item = get_item(data, name);
+	struct obs_data_item *item = get_item_for_write(data, name, false);
 	if (item)
 		os_atomic_inc_long(&item->ref);
 	return item;
@@ -64,6 +64,15 @@ EXPORT obs_data_t *obs_data_create_from_json_file_safe(const char *json_file, co
 EXPORT void obs_data_addref(obs_data_t *data);
 EXPORT void obs_data_release(obs_data_t *data);
 
+/*
+ * Copy-on-write clones.  A clone shares its items (and nested objects and
+ * arrays) with the original until either of them is modified, so cloning is
+ * O(1) and modifying only copies the levels that are written to.  Objects,
+ * arrays and items taken from the original before cloning it must not be
+ * used to modify it afterwards, as that would modify the clone as well.
+ */
+EXPORT obs_data_t *obs_data_clone(obs_data_t *data);
+
 EXPORT const char *obs_data_get_json(obs_data_t *data);
 EXPORT const char *obs_data_get_json_with_defaults(obs_data_t *data);
 EXPORT const char *obs_data_get_json_pretty(obs_data_t *data);
@@ -74,6 +83,19 @@ EXPORT bool obs_data_save_json_safe(obs_data_t *data, const char *file, const ch
 EXPORT bool obs_data_save_json_pretty_safe(obs_data_t *data, const char *file, const char *temp_ext,
 					   const char *backup_ext);
 
+/*
+ * Compact binary serialization.  Keys and strings are interned, and files are
+ * memory mapped and decoded directly, without an intermediate tree.  Like
+ * JSON, only user values are stored.  obs_data_get_binary returns a buffer
+ * that must be freed with bfree.
+ */
+EXPORT void *obs_data_get_binary(obs_data_t *data, size_t *size);
+EXPORT obs_data_t *obs_data_create_from_binary(const void *buf, size_t size);
+EXPORT obs_data_t *obs_data_create_from_binary_file(const char *file);
+EXPORT obs_data_t *obs_data_create_from_binary_file_safe(const char *file, const char *backup_ext);
+EXPORT bool obs_data_save_binary_safe(obs_data_t *data, const char *file, const char *temp_ext,
+				      const char *backup_ext);
+
 EXPORT void obs_data_apply(obs_data_t *target, obs_data_t *apply_data);
 
 EXPORT void obs_data_erase(obs_data_t *data, const char *name);
@@ -142,6 +164,7 @@ EXPORT obs_data_array_t *obs_data_get_autoselect_array(obs_data_t *data, const c
 EXPORT obs_data_array_t *obs_data_array_create();
 EXPORT void obs_data_array_addref(obs_data_array_t *array);
 EXPORT void obs_data_array_release(obs_data_array_t *array);
+EXPORT obs_data_array_t *obs_data_array_clone(obs_data_array_t *array);
 
 EXPORT size_t obs_data_array_count(obs_data_array_t *array);
 EXPORT obs_data_t *obs_data_array_item(obs_data_array_t *array, size_t idx);
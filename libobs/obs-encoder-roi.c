@@ -0,0 +1,300 @@
+#include "graphics/matrix4.h"
+#include "obs-internal.h"
+
+/* Regions smaller than this are rejected by obs_encoder_add_roi as well */
+#define ROI_MIN_SIZE 16
+
+/* A background only counts as such if it covers at least half the canvas,
+ * anything smaller is likely a logo or overlay rather than a backdrop */
+#define ROI_BACKGROUND_MIN_COVERAGE 0.5f
+
+/* Nested scenes deeper than this are treated as opaque */
+#define ROI_MAX_DEPTH 8
+
+/* With x264 these map to roughly -5, -3 and +3 QP respectively */
+#define ROI_PRIORITY_CAMERA 0.1f
+#define ROI_PRIORITY_TEXT 0.06f
+#define ROI_PRIORITY_BACKGROUND -0.06f
+
+static volatile long roi_scene_encoders = 0;
+
+/* ------------------------------------------------------------------------- */
+/* ROI map construction */
+
+static inline float clampf(float val, float min_val, float max_val)
+{
+	return val < min_val ? min_val : (val > max_val ? max_val : val);
+}
+
+static bool item_to_roi(struct obs_encoder_roi *roi, const struct obs_roi_item *item, float scale_x, float scale_y,
+			uint32_t width, uint32_t height)
+{
+	float left = clampf(item->left * scale_x, 0.0f, (float)width);
+	float right = clampf(item->right * scale_x, 0.0f, (float)width);
+	float top = clampf(item->top * scale_y, 0.0f, (float)height);
+	float bottom = clampf(item->bottom * scale_y, 0.0f, (float)height);
+
+	roi->left = (uint32_t)left;
+	roi->right = (uint32_t)right;
+	roi->top = (uint32_t)top;
+	roi->bottom = (uint32_t)bottom;
+
+	return roi->right >= roi->left + ROI_MIN_SIZE && roi->bottom >= roi->top + ROI_MIN_SIZE;
+}
+
+static inline float item_coverage(const struct obs_roi_item *item, uint32_t canvas_width, uint32_t canvas_height)
+{
+	float w = fminf(item->right, (float)canvas_width) - fmaxf(item->left, 0.0f);
+	float h = fminf(item->bottom, (float)canvas_height) - fmaxf(item->top, 0.0f);
+
+	if (w <= 0.0f || h <= 0.0f)
+		return 0.0f;
+	return (w * h) / ((float)canvas_width * (float)canvas_height);
+}
+
+size_t obs_roi_from_scene_items(struct obs_encoder_roi *roi, const struct obs_roi_item *items, size_t num_items,
+				uint32_t canvas_width, uint32_t canvas_height, uint32_t width, uint32_t height)
+{
+	if (!roi || !items || !num_items || !canvas_width || !canvas_height || !width || !height)
+		return 0;
+
+	const float scale_x = (float)width / (float)canvas_width;
+	const float scale_y = (float)height / (float)canvas_height;
+	size_t last_prioritized = SIZE_MAX;
+	size_t count = 0;
+
+	/* Find the bottommost item that gets a non-zero priority; plain items
+	 * above it need to be added as well so that they cut out the parts of
+	 * the prioritized regions they occlude. */
+	for (size_t i = num_items; i > 0; i--) {
+		const struct obs_roi_item *item = &items[i - 1];
+
+		if (item->type == OBS_ROI_ITEM_NONE)
+			continue;
+		if (item->type == OBS_ROI_ITEM_BACKGROUND &&
+		    item_coverage(item, canvas_width, canvas_height) < ROI_BACKGROUND_MIN_COVERAGE)
+			continue;
+
+		last_prioritized = i - 1;
+		break;
+	}
+
+	if (last_prioritized == SIZE_MAX)
+		return 0;
+
+	/* Items are ordered topmost first, and since regions added first take
+	 * precedence the map can be built in the same order. */
+	for (size_t i = 0; i <= last_prioritized; i++) {
+		const struct obs_roi_item *item = &items[i];
+		struct obs_encoder_roi *cur = &roi[count];
+
+		switch (item->type) {
+		case OBS_ROI_ITEM_CAMERA:
+			cur->priority = ROI_PRIORITY_CAMERA;
+			break;
+		case OBS_ROI_ITEM_TEXT:
+			cur->priority = ROI_PRIORITY_TEXT;
+			break;
+		case OBS_ROI_ITEM_BACKGROUND:
+			if (item_coverage(item, canvas_width, canvas_height) >= ROI_BACKGROUND_MIN_COVERAGE) {
+				cur->priority = ROI_PRIORITY_BACKGROUND;
+				break;
+			}
+			/* fall through */
+		case OBS_ROI_ITEM_NONE:
+		default:
+			cur->priority = 0.0f;
+		}
+
+		if (item_to_roi(cur, item, scale_x, scale_y, width, height))
+			count++;
+	}
+
+	return count;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Scene graph traversal */
+
+struct roi_walk {
+	DARRAY(struct obs_roi_item) items;
+	struct matrix4 parent;
+	int depth;
+};
+
+static enum obs_roi_item_type source_roi_type(const obs_source_t *source)
+{
+	switch (source->info.icon_type) {
+	case OBS_ICON_TYPE_CAMERA:
+		return OBS_ROI_ITEM_CAMERA;
+	case OBS_ICON_TYPE_TEXT:
+		return OBS_ROI_ITEM_TEXT;
+	case OBS_ICON_TYPE_IMAGE:
+	case OBS_ICON_TYPE_COLOR:
+	case OBS_ICON_TYPE_SLIDESHOW:
+		return OBS_ROI_ITEM_BACKGROUND;
+	default:
+		return OBS_ROI_ITEM_NONE;
+	}
+}
+
+static void get_item_bounds(struct obs_roi_item *roi_item, obs_sceneitem_t *item, const struct matrix4 *parent)
+{
+	struct matrix4 box;
+	struct vec3 corner;
+
+	obs_sceneitem_get_box_transform(item, &box);
+	matrix4_mul(&box, &box, parent);
+
+	roi_item->left = roi_item->top = INFINITY;
+	roi_item->right = roi_item->bottom = -INFINITY;
+
+	for (int i = 0; i < 4; i++) {
+		vec3_set(&corner, (float)(i & 1), (float)(i >> 1), 0.0f);
+		vec3_transform(&corner, &corner, &box);
+
+		roi_item->left = fminf(roi_item->left, corner.x);
+		roi_item->right = fmaxf(roi_item->right, corner.x);
+		roi_item->top = fminf(roi_item->top, corner.y);
+		roi_item->bottom = fmaxf(roi_item->bottom, corner.y);
+	}
+}
+
+static bool collect_roi_items(obs_scene_t *scene, obs_sceneitem_t *item, void *param)
+{
+	struct roi_walk *walk = param;
+	obs_source_t *source = obs_sceneitem_get_source(item);
+	obs_scene_t *nested = obs_group_or_scene_from_source(source);
+
+	UNUSED_PARAMETER(scene);
+
+	if (!obs_sceneitem_visible(item))
+		return true;
+
+	if (nested && walk->depth < ROI_MAX_DEPTH) {
+		struct matrix4 parent = walk->parent;
+		struct matrix4 draw;
+
+		obs_sceneitem_get_draw_transform(item, &draw);
+		matrix4_mul(&walk->parent, &draw, &parent);
+		walk->depth++;
+
+		obs_scene_enum_items(nested, collect_roi_items, walk);
+
+		walk->depth--;
+		walk->parent = parent;
+		return true;
+	}
+
+	struct obs_roi_item *roi_item = da_push_back_new(walk->items);
+	roi_item->type = nested ? OBS_ROI_ITEM_NONE : source_roi_type(source);
+	get_item_bounds(roi_item, item, &walk->parent);
+	return true;
+}
+
+static void update_encoder_roi_scene(struct obs_encoder *encoder)
+{
+	struct obs_core_video_mix *mix = get_mix_for_video(encoder->media);
+	DARRAY(struct obs_encoder_roi) roi;
+	struct roi_walk walk = {0};
+	obs_source_t *source;
+	obs_scene_t *scene;
+
+	if (!mix)
+		return;
+
+	pthread_mutex_lock(&encoder->roi_mutex);
+	source = obs_weak_source_get_source(encoder->roi_scene);
+	pthread_mutex_unlock(&encoder->roi_mutex);
+
+	scene = obs_scene_from_source(source);
+	if (!scene) {
+		obs_source_release(source);
+		return;
+	}
+
+	/* Scene items are enumerated bottom to top, the ROI map needs the
+	 * topmost items first */
+	matrix4_identity(&walk.parent);
+	obs_scene_enum_items(scene, collect_roi_items, &walk);
+
+	for (size_t i = 0, j = walk.items.num; i + 1 < j; i++, j--)
+		da_swap(walk.items, i, j - 1);
+
+	da_init(roi);
+	da_resize(roi, walk.items.num);
+	roi.num = obs_roi_from_scene_items(roi.array, walk.items.array, walk.items.num, mix->ovi.base_width,
+					   mix->ovi.base_height, obs_encoder_get_width(encoder),
+					   obs_encoder_get_height(encoder));
+
+	pthread_mutex_lock(&encoder->roi_mutex);
+	if (obs_weak_source_references_source(encoder->roi_scene, source) &&
+	    (roi.num != encoder->roi.num ||
+	     (roi.num && memcmp(roi.array, encoder->roi.array, roi.num * sizeof(*roi.array)) != 0))) {
+		da_copy(encoder->roi, roi);
+		encoder->roi_increment++;
+	}
+	pthread_mutex_unlock(&encoder->roi_mutex);
+
+	da_free(roi);
+	da_free(walk.items);
+	obs_source_release(source);
+}
+
+void update_encoder_roi_scenes(void)
+{
+	DARRAY(obs_encoder_t *) encoders;
+
+	if (!os_atomic_load_long(&roi_scene_encoders))
+		return;
+
+	da_init(encoders);
+
+	pthread_mutex_lock(&obs->data.encoders_mutex);
+	for (struct obs_encoder *encoder = obs->data.first_encoder; encoder;
+	     encoder = (struct obs_encoder *)encoder->context.next) {
+		if (!encoder->roi_scene || !os_atomic_load_bool(&encoder->active))
+			continue;
+
+		obs_encoder_t *ref = obs_encoder_get_ref(encoder);
+		if (ref)
+			da_push_back(encoders, &ref);
+	}
+	pthread_mutex_unlock(&obs->data.encoders_mutex);
+
+	for (size_t i = 0; i < encoders.num; i++) {
+		update_encoder_roi_scene(encoders.array[i]);
+		obs_encoder_release(encoders.array[i]);
+	}
+
+	da_free(encoders);
+}
+
+bool obs_encoder_set_roi_scene(obs_encoder_t *encoder, obs_scene_t *scene)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_roi_scene"))
+		return false;
+	if (encoder->info.type != OBS_ENCODER_VIDEO)
+		return false;
+	if (scene && !(encoder->info.caps & OBS_ENCODER_CAP_ROI))
+		return false;
+
+	obs_weak_source_t *weak = scene ? obs_source_get_weak_source(obs_scene_get_source(scene)) : NULL;
+
+	pthread_mutex_lock(&encoder->roi_mutex);
+	obs_weak_source_t *prev = encoder->roi_scene;
+	encoder->roi_scene = weak;
+	if (encoder->roi.num) {
+		da_clear(encoder->roi);
+		encoder->roi_increment++;
+	}
+	pthread_mutex_unlock(&encoder->roi_mutex);
+
+	if (prev && !weak)
+		os_atomic_dec_long(&roi_scene_encoders);
+	else if (!prev && weak)
+		os_atomic_inc_long(&roi_scene_encoders);
+
+	obs_weak_source_release(prev);
+	return true;
+}
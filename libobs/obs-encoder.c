@@ -18,6 +18,7 @@
 #include "obs.h"
 #include "obs-internal.h"
 #include "util/util_uint64.h"
+#include "media-io/video-frame.h"
 
 #define encoder_active(encoder) os_atomic_load_bool(&encoder->active)
 #define set_encoder_active(encoder, val) os_atomic_set_bool(&encoder->active, val)
@@ -51,6 +52,8 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name, obs_data
 	pthread_mutex_init_value(&encoder->outputs_mutex);
 	pthread_mutex_init_value(&encoder->pause.mutex);
 	pthread_mutex_init_value(&encoder->roi_mutex);
+	pthread_mutex_init_value(&encoder->stats_mutex);
+	pthread_mutex_init_value(&encoder->async_mutex);
 
 	if (!obs_context_data_init(&encoder->context, OBS_OBJ_TYPE_ENCODER, settings, name, NULL, hotkey_data, false))
 		return false;
@@ -64,6 +67,13 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name, obs_data
 		return false;
 	if (pthread_mutex_init(&encoder->roi_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->stats_mutex, NULL) != 0)
+		return false;
+	if (pthread_mutex_init(&encoder->async_mutex, NULL) != 0)
+		return false;
+
+	histogram_init(&encoder->latency_hist);
+	histogram_init(&encoder->encode_call_hist);
 
 	if (encoder->orig_info.get_defaults) {
 		encoder->orig_info.get_defaults(encoder->context.settings);
@@ -139,6 +149,10 @@ obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name, obs_da
 }
 
 static void receive_video(void *param, struct video_data *frame);
+static void start_async_encode(struct obs_encoder *encoder, const struct video_scale_info *info);
+static void stop_async_encode(struct obs_encoder *encoder);
+static void start_duplicate_detection(struct obs_encoder *encoder);
+static void stop_duplicate_detection(struct obs_encoder *encoder);
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data);
 
 static inline void get_audio_info(const struct obs_encoder *encoder, struct audio_convert_info *info)
@@ -342,6 +356,8 @@ static void add_connection(struct obs_encoder *encoder)
 		if (gpu_encode_available(encoder)) {
 			start_gpu_encode(encoder);
 		} else {
+			start_async_encode(encoder, &info);
+			start_duplicate_detection(encoder);
 			start_raw_video(encoder->media, &info, encoder->frame_rate_divisor, receive_video, encoder);
 		}
 	}
@@ -374,6 +390,8 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 			stop_gpu_encode(encoder);
 		} else {
 			stop_raw_video(encoder->media, receive_video, encoder);
+			stop_async_encode(encoder);
+			stop_duplicate_detection(encoder);
 		}
 	}
 
@@ -414,6 +432,259 @@ static inline void free_audio_buffers(struct obs_encoder *encoder)
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* CPU thread budget */
+
+static long default_thread_budget(void)
+{
+	long cores = os_get_logical_cores();
+
+	/* leave room for the graphics thread and the video/audio threads */
+	if (cores > 4)
+		cores -= 2;
+	else if (cores > 1)
+		cores -= 1;
+
+	return cores;
+}
+
+/* encoding cost is assumed to scale with the pixel rate */
+static uint64_t thread_budget_weight(const struct obs_encoder *encoder)
+{
+	const struct video_output_info *voi = video_output_get_info(encoder->media);
+	uint64_t pixels = (uint64_t)obs_encoder_get_width(encoder) * obs_encoder_get_height(encoder);
+
+	if (!voi || !voi->fps_den)
+		return pixels;
+
+	return pixels * voi->fps_num / ((uint64_t)voi->fps_den * encoder->frame_rate_divisor);
+}
+
+/* video encoders share the budget by their pixel rate.  Unless a budget was
+ * set, it only applies once several video encoders compete for the cores, a
+ * single one keeps the thread count of its library.  Audio encoders don't
+ * take part, they are cheap enough not to matter. */
+static void rebalance_thread_budget(void)
+{
+	struct obs_encoder *encoder;
+	uint64_t total_weight = 0;
+	size_t competing = 0;
+	long budget;
+
+	pthread_mutex_lock(&obs->data.encoders_mutex);
+
+	for (encoder = obs->data.first_encoder; encoder; encoder = (struct obs_encoder *)encoder->context.next) {
+		if (!encoder->thread_budget_active)
+			continue;
+
+		total_weight += thread_budget_weight(encoder);
+		competing++;
+	}
+
+	budget = (long)obs->data.encoder_thread_budget;
+	if (!budget && competing > 1)
+		budget = default_thread_budget();
+
+	for (encoder = obs->data.first_encoder; encoder; encoder = (struct obs_encoder *)encoder->context.next) {
+		long threads = 0;
+
+		if (!encoder->thread_budget_active)
+			continue;
+
+		if (budget && total_weight) {
+			uint64_t weight = thread_budget_weight(encoder);
+			threads = (long)(((uint64_t)budget * weight + total_weight / 2) / total_weight);
+			if (threads < 1)
+				threads = 1;
+		}
+
+		if (os_atomic_set_long(&encoder->thread_budget, threads) != threads)
+			blog(LOG_DEBUG, "encoder '%s': %ld CPU threads", encoder->context.name, threads);
+	}
+
+	pthread_mutex_unlock(&obs->data.encoders_mutex);
+}
+
+static void acquire_thread_budget(struct obs_encoder *encoder)
+{
+	if (encoder->orig_info.type != OBS_ENCODER_VIDEO || !(encoder->orig_info.caps & OBS_ENCODER_CAP_THREAD_BUDGET))
+		return;
+	if (encoder->thread_budget_active)
+		return;
+
+	encoder->thread_budget_active = true;
+	rebalance_thread_budget();
+}
+
+static void release_thread_budget(struct obs_encoder *encoder)
+{
+	if (!encoder->thread_budget_active)
+		return;
+
+	encoder->thread_budget_active = false;
+	os_atomic_set_long(&encoder->thread_budget, 0);
+	rebalance_thread_budget();
+}
+
+/* ------------------------------------------------------------------------- */
+/* statistics */
+
+/* removes the oldest frame, and the frames after it that have already
+ * produced a packet */
+static void pop_submit_time(struct obs_encoder *encoder)
+{
+	struct encoder_submit_time st;
+
+	deque_pop_front(&encoder->submit_times, &st, sizeof(st));
+	if (st.ts)
+		encoder->pending_frames--;
+
+	while (encoder->submit_times.size) {
+		deque_peek_front(&encoder->submit_times, &st, sizeof(st));
+		if (st.ts)
+			break;
+
+		deque_pop_front(&encoder->submit_times, NULL, sizeof(st));
+	}
+}
+
+/* called after each call to the encode callback, with the pts of the frame
+ * and the times just before and after it */
+void record_encode_call(struct obs_encoder *encoder, int64_t pts, uint64_t start_ts, uint64_t end_ts)
+{
+	struct encoder_submit_time st = {pts, start_ts};
+
+	pthread_mutex_lock(&encoder->stats_mutex);
+
+	/* encoders that neither pass the pts through nor return a packet for
+	 * every frame would grow the queue forever */
+	if (encoder->submit_times.size >= ENCODER_MAX_SUBMIT_TIMES * sizeof(st))
+		pop_submit_time(encoder);
+
+	deque_push_back(&encoder->submit_times, &st, sizeof(st));
+	encoder->pending_frames++;
+	histogram_record(&encoder->encode_call_hist, end_ts - start_ts);
+
+	if (encoder->pending_frames > encoder->max_queue_depth)
+		encoder->max_queue_depth = encoder->pending_frames;
+
+	pthread_mutex_unlock(&encoder->stats_mutex);
+}
+
+static void add_bitrate_bytes(struct obs_encoder *encoder, uint64_t ts, size_t size)
+{
+	uint64_t slot = ts / ENCODER_BITRATE_SLOT_NS;
+
+	if (slot != encoder->last_bitrate_slot) {
+		uint64_t stale = slot - encoder->last_bitrate_slot;
+		if (stale > ENCODER_BITRATE_SLOTS)
+			stale = ENCODER_BITRATE_SLOTS;
+
+		for (uint64_t i = 0; i < stale; i++)
+			encoder->bitrate_bytes[(slot - i) % ENCODER_BITRATE_SLOTS] = 0;
+		encoder->last_bitrate_slot = slot;
+	}
+
+	encoder->bitrate_bytes[slot % ENCODER_BITRATE_SLOTS] += size;
+}
+
+/* bits per second over the complete slots of the last window_slots slots,
+ * leaving out the slot still being filled */
+static uint64_t get_bitrate(const struct obs_encoder *encoder, uint64_t ts, uint64_t window_slots)
+{
+	uint64_t slot = ts / ENCODER_BITRATE_SLOT_NS;
+	uint64_t bytes = 0;
+
+	for (uint64_t i = 1; i <= window_slots; i++) {
+		uint64_t cur = slot - i;
+		if (cur > encoder->last_bitrate_slot || encoder->last_bitrate_slot - cur >= ENCODER_BITRATE_SLOTS)
+			continue;
+
+		bytes += encoder->bitrate_bytes[cur % ENCODER_BITRATE_SLOTS];
+	}
+
+	return bytes * 8 * 1000000000ULL / (window_slots * ENCODER_BITRATE_SLOT_NS);
+}
+
+static struct encoder_submit_time *find_submit_time(struct obs_encoder *encoder, const struct encoder_packet *pkt)
+{
+	size_t count = encoder->submit_times.size / sizeof(struct encoder_submit_time);
+
+	for (size_t i = 0; i < count; i++) {
+		struct encoder_submit_time *st =
+			deque_data(&encoder->submit_times, i * sizeof(struct encoder_submit_time));
+		if (st->ts && st->pts == pkt->pts)
+			return st;
+	}
+
+	return NULL;
+}
+
+/* the submit time of the packet's frame is found by its pts, as B-frames come
+ * out of order.  Frames with a pts before the packet's dts will never produce
+ * a packet, the encoder dropped or merged them, so they're removed as well.
+ * Packets of encoders that don't pass the pts through are assumed to come out
+ * in submission order. */
+static void receive_packet_stats(struct obs_encoder *encoder, const struct encoder_packet *pkt)
+{
+	uint64_t now = os_gettime_ns();
+
+	pthread_mutex_lock(&encoder->stats_mutex);
+
+	struct encoder_submit_time *st = find_submit_time(encoder, pkt);
+	bool matched = st != NULL;
+
+	if (!matched)
+		st = deque_data(&encoder->submit_times, 0);
+
+	if (st) {
+		uint64_t latency = now - st->ts;
+		st->ts = 0;
+		encoder->pending_frames--;
+
+		histogram_record(&encoder->latency_hist, latency);
+		if (encoder->encode_latency_ns)
+			encoder->encode_latency_ns = (encoder->encode_latency_ns * 15 + latency) / 16;
+		else
+			encoder->encode_latency_ns = latency;
+	}
+
+	while (encoder->submit_times.size) {
+		st = deque_data(&encoder->submit_times, 0);
+		if (st->ts && (!matched || st->pts >= pkt->dts))
+			break;
+
+		pop_submit_time(encoder);
+	}
+
+	add_bitrate_bytes(encoder, now, pkt->size);
+	encoder->total_packets++;
+
+	pthread_mutex_unlock(&encoder->stats_mutex);
+}
+
+static void clear_encoder_stats(struct obs_encoder *encoder)
+{
+	encoder->max_queue_depth = encoder->pending_frames;
+	histogram_reset(&encoder->latency_hist);
+	histogram_reset(&encoder->encode_call_hist);
+	encoder->total_packets = 0;
+	encoder->duplicate_frames = 0;
+}
+
+static void reset_encoder_stats(struct obs_encoder *encoder)
+{
+	pthread_mutex_lock(&encoder->stats_mutex);
+	deque_free(&encoder->submit_times);
+	encoder->pending_frames = 0;
+	encoder->encode_latency_ns = 0;
+	memset(encoder->bitrate_bytes, 0, sizeof(encoder->bitrate_bytes));
+	clear_encoder_stats(encoder);
+	pthread_mutex_unlock(&encoder->stats_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
 void obs_encoder_destroy(obs_encoder_t *encoder)
 {
 	if (encoder) {
@@ -430,19 +701,24 @@ void obs_encoder_destroy(obs_encoder_t *encoder)
 		blog(LOG_DEBUG, "encoder '%s' destroyed", encoder->context.name);
 
 		obs_encoder_set_group(encoder, NULL);
+		obs_encoder_set_roi_scene(encoder, NULL);
 
 		free_audio_buffers(encoder);
 
 		if (encoder->context.data)
 			encoder->info.destroy(encoder->context.data);
+		release_thread_budget(encoder);
 		da_free(encoder->callbacks);
 		da_free(encoder->roi);
 		da_free(encoder->encoder_packet_times);
+		deque_free(&encoder->submit_times);
 		pthread_mutex_destroy(&encoder->init_mutex);
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
 		pthread_mutex_destroy(&encoder->outputs_mutex);
 		pthread_mutex_destroy(&encoder->pause.mutex);
 		pthread_mutex_destroy(&encoder->roi_mutex);
+		pthread_mutex_destroy(&encoder->stats_mutex);
+		pthread_mutex_destroy(&encoder->async_mutex);
 		obs_context_data_free(&encoder->context);
 		if (encoder->owns_info_id)
 			bfree((void *)encoder->info.id);
@@ -643,6 +919,7 @@ static inline bool obs_encoder_initialize_internal(obs_encoder_t *encoder)
 	obs_encoder_shutdown(encoder);
 
 	maybe_set_up_gpu_rescale(encoder);
+	acquire_thread_budget(encoder);
 
 	if (encoder->orig_info.create) {
 		can_reroute = true;
@@ -650,8 +927,10 @@ static inline bool obs_encoder_initialize_internal(obs_encoder_t *encoder)
 		encoder->context.data = encoder->orig_info.create(encoder->context.settings, encoder);
 		can_reroute = false;
 	}
-	if (!encoder->context.data)
+	if (!encoder->context.data) {
+		release_thread_budget(encoder);
 		return false;
+	}
 
 	if (encoder->orig_info.type == OBS_ENCODER_AUDIO)
 		intitialize_audio_encoder(encoder);
@@ -726,6 +1005,8 @@ void obs_encoder_shutdown(obs_encoder_t *encoder)
 	if (encoder->context.data) {
 		encoder->info.destroy(encoder->context.data);
 		encoder->context.data = NULL;
+		release_thread_budget(encoder);
+		reset_encoder_stats(encoder);
 		encoder->first_received = false;
 		encoder->offset_usec = 0;
 		encoder->start_ts = 0;
@@ -1357,6 +1638,8 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success, bool received
 	}
 
 	if (received) {
+		receive_packet_stats(encoder, pkt);
+
 		if (!encoder->first_received) {
 			encoder->offset_usec = packet_dts_usec(pkt);
 			encoder->first_received = true;
@@ -1409,27 +1692,23 @@ void send_off_encoder_packet(obs_encoder_t *encoder, bool success, bool received
 	}
 }
 
-static const char *do_encode_name = "do_encode";
-bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame, const uint64_t *frame_cts)
+/* calls the encode callback, the packet still has to be sent off */
+static bool encode_frame(struct obs_encoder *encoder, struct encoder_frame *frame, const uint64_t *frame_cts,
+			 bool reconfigure, struct encoder_packet *pkt, bool *received)
 {
-	profile_start(do_encode_name);
 	if (!encoder->profile_encoder_encode_name)
 		encoder->profile_encoder_encode_name =
 			profile_store_name(obs_get_profiler_name_store(), "encode(%s)", encoder->context.name);
 
-	struct encoder_packet pkt = {0};
-	bool received = false;
 	bool success;
 	uint64_t fer_ts = 0;
 
-	if (encoder->reconfigure_requested) {
-		encoder->reconfigure_requested = false;
+	if (reconfigure)
 		encoder->info.update(encoder->context.data, encoder->context.settings);
-	}
 
-	pkt.timebase_num = encoder->timebase_num * encoder->frame_rate_divisor;
-	pkt.timebase_den = encoder->timebase_den;
-	pkt.encoder = encoder;
+	pkt->timebase_num = encoder->timebase_num * encoder->frame_rate_divisor;
+	pkt->timebase_den = encoder->timebase_den;
+	pkt->encoder = encoder;
 
 	/* Get the frame encode request timestamp. This
 	 * needs to be read just before the encode request.
@@ -1437,9 +1716,11 @@ bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame, const u
 	fer_ts = os_gettime_ns();
 
 	profile_start(encoder->profile_encoder_encode_name);
-	success = encoder->info.encode(encoder->context.data, frame, &pkt, &received);
+	success = encoder->info.encode(encoder->context.data, frame, pkt, received);
 	profile_end(encoder->profile_encoder_encode_name);
 
+	record_encode_call(encoder, frame->pts, fer_ts, os_gettime_ns());
+
 	/* Generate and enqueue the frame timing metrics, namely
 	 * the CTS (composition time), FER (frame encode request), FERC
 	 * (frame encode request complete) and current PTS. PTS is used to
@@ -1457,6 +1738,22 @@ bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame, const u
 		ept->cts = *frame_cts;
 		ept->fer = fer_ts;
 	}
+
+	return success;
+}
+
+static const char *do_encode_name = "do_encode";
+bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame, const uint64_t *frame_cts)
+{
+	profile_start(do_encode_name);
+
+	struct encoder_packet pkt = {0};
+	bool received = false;
+	bool success;
+
+	success = encode_frame(encoder, frame, frame_cts, encoder->reconfigure_requested, &pkt, &received);
+	encoder->reconfigure_requested = false;
+
 	send_off_encoder_packet(encoder, success, received, &pkt);
 
 	profile_end(do_encode_name);
@@ -1539,6 +1836,218 @@ void handle_encoder_group_reconfigure_request(obs_encoder_t *encoder)
 	pthread_mutex_unlock(&group->mutex);
 }
 
+/* ------------------------------------------------------------------------- */
+/* asynchronous encoding */
+
+/* frames queued per encoder before the video thread has to wait for it */
+#define ASYNC_MAX_FRAMES 3
+
+struct encoder_async_frame {
+	struct encoder_frame frame;
+	uint64_t timestamp;
+	bool reconfigure;
+
+	/* the video output's own frame while it is held, otherwise a copy */
+	struct video_data held;
+	bool is_held;
+	struct video_frame copy;
+};
+
+static void release_async_frame(struct obs_encoder *encoder, struct encoder_async_frame *af)
+{
+	if (af->is_held) {
+		video_output_release_frame(encoder->media, &af->held);
+	} else {
+		pthread_mutex_lock(&encoder->async_mutex);
+		da_push_back(encoder->async_pool, &af->copy);
+		pthread_mutex_unlock(&encoder->async_mutex);
+	}
+
+	os_sem_post(encoder->async_free_sem);
+}
+
+static const char *async_encode_name = "async_encode";
+static void *async_encode_thread(void *param)
+{
+	struct obs_encoder *encoder = param;
+
+	os_set_thread_name("libobs: encode thread");
+
+	while (os_sem_wait(encoder->async_frames_sem) == 0) {
+		struct encoder_async_frame af;
+		bool empty;
+
+		pthread_mutex_lock(&encoder->async_mutex);
+		empty = encoder->async_queue.size == 0;
+		if (!empty)
+			deque_pop_front(&encoder->async_queue, &af, sizeof(af));
+		pthread_mutex_unlock(&encoder->async_mutex);
+
+		/* only the stop request is left once the queue is empty */
+		if (empty)
+			break;
+
+		/* after an error, frames are dropped until the video thread
+		 * has stopped the encoder */
+		if (!os_atomic_load_bool(&encoder->async_failed)) {
+			struct encoder_packet pkt = {0};
+			bool received = false;
+
+			profile_start(async_encode_name);
+			if (encode_frame(encoder, &af.frame, &af.timestamp, af.reconfigure, &pkt, &received))
+				send_off_encoder_packet(encoder, true, received, &pkt);
+			else
+				os_atomic_set_bool(&encoder->async_failed, true);
+			profile_end(async_encode_name);
+		}
+
+		release_async_frame(encoder, &af);
+		profile_reenable_thread();
+	}
+
+	return NULL;
+}
+
+/* queues the frame for the encode thread, holding the video output's frame
+ * so it does not need to be copied.  encoders sharing a conversion hold the
+ * same scaled frame */
+static void queue_async_frame(struct obs_encoder *encoder, struct video_data *frame, struct encoder_frame *enc_frame)
+{
+	struct encoder_async_frame af = {
+		.frame = *enc_frame,
+		.timestamp = frame->timestamp,
+		.reconfigure = encoder->reconfigure_requested,
+	};
+
+	encoder->reconfigure_requested = false;
+
+	os_sem_wait(encoder->async_free_sem);
+
+	if (video_output_hold_frame(encoder->media, frame)) {
+		af.held = *frame;
+		af.is_held = true;
+
+	} else {
+		const struct video_scale_info *info = &encoder->async_info;
+
+		pthread_mutex_lock(&encoder->async_mutex);
+		if (encoder->async_pool.num) {
+			af.copy = encoder->async_pool.array[encoder->async_pool.num - 1];
+			da_pop_back(encoder->async_pool);
+		}
+		pthread_mutex_unlock(&encoder->async_mutex);
+
+		if (!af.copy.data[0])
+			video_frame_init(&af.copy, info->format, info->width, info->height);
+		video_frame_copy(&af.copy, (const struct video_frame *)frame, info->format, info->height);
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			af.frame.data[i] = af.copy.data[i];
+			af.frame.linesize[i] = af.copy.linesize[i];
+		}
+	}
+
+	pthread_mutex_lock(&encoder->async_mutex);
+	deque_push_back(&encoder->async_queue, &af, sizeof(af));
+	pthread_mutex_unlock(&encoder->async_mutex);
+
+	os_sem_post(encoder->async_frames_sem);
+}
+
+static void start_async_encode(struct obs_encoder *encoder, const struct video_scale_info *info)
+{
+	if (!(encoder->orig_info.caps & OBS_ENCODER_CAP_ASYNC_ENCODE))
+		return;
+
+	encoder->async_info = *info;
+	os_atomic_set_bool(&encoder->async_failed, false);
+
+	if (os_sem_init(&encoder->async_frames_sem, 0) != 0)
+		goto fail;
+	if (os_sem_init(&encoder->async_free_sem, ASYNC_MAX_FRAMES) != 0)
+		goto fail;
+	if (pthread_create(&encoder->async_thread, NULL, async_encode_thread, encoder) != 0)
+		goto fail;
+
+	encoder->async_active = true;
+	return;
+
+fail:
+	blog(LOG_WARNING, "Failed to start encode thread for encoder '%s', encoding on the video thread",
+	     encoder->context.name);
+	os_sem_destroy(encoder->async_frames_sem);
+	os_sem_destroy(encoder->async_free_sem);
+	encoder->async_frames_sem = NULL;
+	encoder->async_free_sem = NULL;
+}
+
+/* the encoder must already be disconnected from the video output, frames
+ * that are still queued are encoded before this returns */
+static void stop_async_encode(struct obs_encoder *encoder)
+{
+	if (!encoder->async_active)
+		return;
+
+	encoder->async_active = false;
+	os_sem_post(encoder->async_frames_sem);
+	pthread_join(encoder->async_thread, NULL);
+
+	os_sem_destroy(encoder->async_frames_sem);
+	os_sem_destroy(encoder->async_free_sem);
+	encoder->async_frames_sem = NULL;
+	encoder->async_free_sem = NULL;
+
+	deque_free(&encoder->async_queue);
+	for (size_t i = 0; i < encoder->async_pool.num; i++)
+		video_frame_free(&encoder->async_pool.array[i]);
+	da_free(encoder->async_pool);
+}
+
+/* ------------------------------------------------------------------------- */
+/* duplicate frames */
+
+/* frames are still passed to the encoder this often, so outputs that
+ * interleave audio and video keep getting video packets */
+#define MAX_DUPLICATE_NS 250000000ULL
+
+/* encoders in a group are left out, their reconfiguration needs every
+ * encoder to see the same frames */
+static void start_duplicate_detection(struct obs_encoder *encoder)
+{
+	encoder->skip_duplicates = (encoder->orig_info.caps & OBS_ENCODER_CAP_SKIP_DUPLICATES) != 0 &&
+				   !encoder->encoder_group;
+	encoder->last_frame_hash = 0;
+
+	if (encoder->skip_duplicates)
+		video_output_inc_duplicate_detection(encoder->media);
+}
+
+static void stop_duplicate_detection(struct obs_encoder *encoder)
+{
+	if (!encoder->skip_duplicates)
+		return;
+
+	encoder->skip_duplicates = false;
+	video_output_dec_duplicate_detection(encoder->media);
+}
+
+static bool skip_duplicate_frame(struct obs_encoder *encoder, const struct video_data *frame)
+{
+	if (!encoder->skip_duplicates || !frame->hash)
+		return false;
+
+	if (frame->hash == encoder->last_frame_hash && frame->timestamp - encoder->last_frame_ts < MAX_DUPLICATE_NS) {
+		pthread_mutex_lock(&encoder->stats_mutex);
+		encoder->duplicate_frames++;
+		pthread_mutex_unlock(&encoder->stats_mutex);
+		return true;
+	}
+
+	encoder->last_frame_hash = frame->hash;
+	encoder->last_frame_ts = frame->timestamp;
+	return false;
+}
+
 static const char *receive_video_name = "receive_video";
 static void receive_video(void *param, struct video_data *frame)
 {
@@ -1547,6 +2056,12 @@ static void receive_video(void *param, struct video_data *frame)
 	struct obs_encoder *encoder = param;
 	struct encoder_frame enc_frame;
 
+	if (os_atomic_load_bool(&encoder->async_failed)) {
+		blog(LOG_ERROR, "Error encoding with encoder '%s'", encoder->context.name);
+		full_stop(encoder);
+		goto wait_for_audio;
+	}
+
 	if (encoder->encoder_group && !encoder->start_ts) {
 		struct obs_encoder_group *group = encoder->encoder_group;
 		bool ready = false;
@@ -1590,8 +2105,18 @@ static void receive_video(void *param, struct video_data *frame)
 	enc_frame.frames = 1;
 	enc_frame.pts = encoder->cur_pts;
 
-	if (do_encode(encoder, &enc_frame, &frame->timestamp))
+	/* the frame's timestamp is still used up, so the next frame that is
+	 * encoded is shown at the right time */
+	if (skip_duplicate_frame(encoder, frame)) {
+		encoder->cur_pts += encoder->timebase_num * encoder->frame_rate_divisor;
+
+	} else if (encoder->async_active) {
+		queue_async_frame(encoder, frame, &enc_frame);
+		encoder->cur_pts += encoder->timebase_num * encoder->frame_rate_divisor;
+
+	} else if (do_encode(encoder, &enc_frame, &frame->timestamp)) {
 		encoder->cur_pts += encoder->timebase_num * encoder->frame_rate_divisor;
+	}
 
 wait_for_audio:
 	profile_end(receive_video_name);
@@ -2221,6 +2746,103 @@ void obs_encoder_group_destroy(obs_encoder_group_t *group)
 	obs_encoder_group_actually_destroy(group);
 }
 
+obs_encoder_group_t *obs_encoder_get_group(const obs_encoder_t *encoder)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_group"))
+		return NULL;
+
+	return encoder->encoder_group;
+}
+
+void obs_encoder_group_enum_encoders(obs_encoder_group_t *group, bool (*enum_proc)(void *param, obs_encoder_t *encoder),
+				     void *param)
+{
+	if (!group || !enum_proc)
+		return;
+
+	pthread_mutex_lock(&group->mutex);
+
+	for (size_t i = 0; i < group->encoders.num; i++) {
+		if (!enum_proc(param, group->encoders.array[i]))
+			break;
+	}
+
+	pthread_mutex_unlock(&group->mutex);
+}
+
+uint32_t obs_encoder_get_thread_budget(const obs_encoder_t *encoder)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_thread_budget"))
+		return 0;
+
+	return (uint32_t)os_atomic_load_long(&encoder->thread_budget);
+}
+
+bool obs_encoder_get_stats(const obs_encoder_t *encoder, struct obs_encoder_stats *stats)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_stats"))
+		return false;
+	if (!obs_ptr_valid(stats, "obs_encoder_get_stats"))
+		return false;
+
+	struct obs_encoder *enc = (struct obs_encoder *)encoder;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->threads = obs_encoder_get_thread_budget(encoder);
+
+	pthread_mutex_lock(&enc->stats_mutex);
+	stats->queue_depth = enc->pending_frames;
+	stats->max_queue_depth = enc->max_queue_depth;
+
+	stats->encode_latency_ns = enc->encode_latency_ns;
+	stats->latency_p50_ns = histogram_percentile(&enc->latency_hist, 50.0);
+	stats->latency_p99_ns = histogram_percentile(&enc->latency_hist, 99.0);
+	stats->latency_max_ns = enc->latency_hist.count ? enc->latency_hist.max : 0;
+
+	stats->encode_call_p50_ns = histogram_percentile(&enc->encode_call_hist, 50.0);
+	stats->encode_call_p99_ns = histogram_percentile(&enc->encode_call_hist, 99.0);
+	stats->encode_call_max_ns = enc->encode_call_hist.count ? enc->encode_call_hist.max : 0;
+
+	uint64_t now = os_gettime_ns();
+	stats->bitrate_1s = get_bitrate(enc, now, 1000000000ULL / ENCODER_BITRATE_SLOT_NS);
+	stats->bitrate_10s = get_bitrate(enc, now, ENCODER_BITRATE_SLOTS);
+	stats->total_packets = enc->total_packets;
+	stats->duplicate_frames = enc->duplicate_frames;
+	pthread_mutex_unlock(&enc->stats_mutex);
+
+	pthread_mutex_lock(&enc->async_mutex);
+	stats->async_queue_depth = (uint32_t)(enc->async_queue.size / sizeof(struct encoder_async_frame));
+	pthread_mutex_unlock(&enc->async_mutex);
+
+	return true;
+}
+
+void obs_encoder_reset_stats(obs_encoder_t *encoder)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_reset_stats"))
+		return;
+
+	pthread_mutex_lock(&encoder->stats_mutex);
+	clear_encoder_stats(encoder);
+	pthread_mutex_unlock(&encoder->stats_mutex);
+}
+
+void obs_set_encoder_thread_budget(uint32_t threads)
+{
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->data.encoders_mutex);
+	obs->data.encoder_thread_budget = threads;
+	rebalance_thread_budget();
+	pthread_mutex_unlock(&obs->data.encoders_mutex);
+}
+
+uint32_t obs_get_encoder_thread_budget(void)
+{
+	return obs ? obs->data.encoder_thread_budget : 0;
+}
+
 bool obs_encoder_video_tex_active(const obs_encoder_t *encoder, enum video_format format)
 {
 	struct obs_core_video_mix *mix = get_mix_for_video(encoder->media);
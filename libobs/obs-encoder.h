@@ -38,6 +38,9 @@ typedef struct obs_encoder obs_encoder_t;
 #define OBS_ENCODER_CAP_INTERNAL (1 << 3)
 #define OBS_ENCODER_CAP_ROI (1 << 4)
 #define OBS_ENCODER_CAP_SCALING (1 << 5)
+#define OBS_ENCODER_CAP_THREAD_BUDGET (1 << 6)
+#define OBS_ENCODER_CAP_ASYNC_ENCODE (1 << 7)
+#define OBS_ENCODER_CAP_SKIP_DUPLICATES (1 << 8)
 
 /** Specifies the encoder type */
 enum obs_encoder_type {
@@ -25,6 +25,7 @@
 #include "util/platform.h"
 #include "util/profiler.h"
 #include "util/task.h"
+#include "util/histogram.h"
 #include "util/uthash.h"
 #include "util/array-serializer.h"
 #include "callback/signal.h"
@@ -125,6 +126,9 @@ struct obs_module {
 	const char *(*name)(void);
 	const char *(*description)(void);
 	const char *(*author)(void);
+	bool (*concurrent_load)(void);
+
+	struct obs_module_load_times times;
 
 	struct obs_module *next;
 };
@@ -380,6 +384,16 @@ struct obs_core_video {
 
 	pthread_mutex_t mixes_mutex;
 	DARRAY(struct obs_core_video_mix *) mixes;
+
+	pthread_mutex_t frame_timing_mutex;
+	struct obs_frame_pacing_info pacing;
+	volatile bool pacing_changed;
+	bool realtime_applied;
+	int affinity_applied;
+	uint64_t spin_margin_ns;
+	struct histogram render_time_hist;
+	struct histogram sleep_overshoot_hist;
+	struct histogram wakeup_latency_window;
 };
 
 extern void add_ready_encoder_group(obs_encoder_t *encoder);
@@ -424,6 +438,9 @@ struct obs_core_data {
 	struct obs_encoder *first_encoder;
 	struct obs_service *first_service;
 
+	/* CPU threads shared by encoders, 0 for automatic */
+	uint32_t encoder_thread_budget;
+
 	pthread_mutex_t sources_mutex;
 	pthread_mutex_t displays_mutex;
 	pthread_mutex_t outputs_mutex;
@@ -447,6 +464,9 @@ struct obs_core_data {
 
 	DARRAY(char *) protocols;
 	DARRAY(obs_source_t *) sources_to_tick;
+
+	volatile bool lazy_sources;
+	volatile long lazy_unload_timeout_ms;
 };
 
 /* user hotkeys */
@@ -939,6 +959,14 @@ struct obs_source {
 
 	/* canvas this source belongs to (only used for scenes) */
 	obs_weak_canvas_t *canvas;
+
+	/* time spent creating and loading the source, set by the source
+	 * loader */
+	uint64_t load_time_ns;
+
+	/* lazy loading, resources_loaded is set on the graphics thread */
+	volatile bool resources_loaded;
+	uint64_t inactive_since;
 };
 
 extern struct obs_source_info *get_source_info(const char *id);
@@ -962,17 +990,28 @@ extern obs_source_t *obs_source_create_canvas(obs_canvas_t *canvas, const char *
 extern obs_source_t *obs_source_create_set_last_ver(obs_canvas_t *canvas, const char *id, const char *name,
 						    const char *uuid, obs_data_t *settings, obs_data_t *hotkey_data,
 						    uint32_t last_obs_ver, bool is_private);
+extern obs_source_t *obs_source_create_prepare(obs_canvas_t **canvas, const char *id, const char *name,
+					       const char *uuid, obs_data_t *settings, obs_data_t *hotkey_data,
+					       bool private, uint32_t last_obs_ver);
+extern void obs_source_create_hotkeys(obs_source_t *source);
+extern void obs_source_create_context_data(obs_source_t *source);
+extern void obs_source_create_finish(obs_source_t *source, obs_canvas_t *canvas);
 
 extern void obs_source_destroy(struct obs_source *source);
 extern void obs_source_addref(obs_source_t *source);
 
+/* calldata signatures of frequently emitted source signals */
+extern struct calldata_signature obs_source_signature;
+extern struct calldata_signature obs_source_canvas_signature;
+extern struct calldata_signature obs_source_volume_signature;
+
 static inline void obs_source_dosignal(struct obs_source *source, const char *signal_obs, const char *signal_source)
 {
 	struct calldata data;
-	uint8_t stack[128];
+	uint8_t stack[CALLDATA_SIGNATURE_STACK_SIZE];
 
-	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
+	calldata_init_signature(&data, &obs_source_signature, stack, sizeof(stack));
+	calldata_sig_set_ptr(&data, &obs_source_signature, 0, source);
 	if (signal_obs && !source->context.private)
 		signal_handler_signal(obs->signals, signal_obs, &data);
 	if (signal_source)
@@ -983,11 +1022,11 @@ static inline void obs_source_dosignal_canvas(struct obs_source *source, struct
 					      const char *signal_obs, const char *signal_source)
 {
 	struct calldata data;
-	uint8_t stack[128];
+	uint8_t stack[CALLDATA_SIGNATURE_STACK_SIZE];
 
-	calldata_init_fixed(&data, stack, sizeof(stack));
-	calldata_set_ptr(&data, "source", source);
-	calldata_set_ptr(&data, "canvas", canvas);
+	calldata_init_signature(&data, &obs_source_canvas_signature, stack, sizeof(stack));
+	calldata_sig_set_ptr(&data, &obs_source_canvas_signature, 0, source);
+	calldata_sig_set_ptr(&data, &obs_source_canvas_signature, 1, canvas);
 	if (signal_obs && !source->context.private)
 		signal_handler_signal(obs->signals, signal_obs, &data);
 	if (signal_source)
@@ -1298,6 +1337,15 @@ struct obs_encoder_group {
 	bool reconfigure_again;
 };
 
+#define ENCODER_BITRATE_SLOT_NS 100000000ULL
+#define ENCODER_BITRATE_SLOTS 100
+#define ENCODER_MAX_SUBMIT_TIMES 1024
+
+struct encoder_submit_time {
+	int64_t pts;
+	uint64_t ts; /* 0 once its packet has been received */
+};
+
 struct obs_encoder {
 	struct obs_context_data context;
 	struct obs_encoder_info info;
@@ -1352,6 +1400,7 @@ struct obs_encoder {
 	pthread_mutex_t roi_mutex;
 	DARRAY(struct obs_encoder_roi) roi;
 	uint32_t roi_increment;
+	obs_weak_source_t *roi_scene;
 
 	int64_t cur_pts;
 
@@ -1388,6 +1437,46 @@ struct obs_encoder {
 	const char *profile_encoder_encode_name;
 	char *last_error_message;
 
+	/* counts towards the encoder thread budget while initialized */
+	bool thread_budget_active;
+	volatile long thread_budget;
+
+	/* submit times of frames in submission order, up to the oldest frame
+	 * that has not produced a packet yet.  pending_frames leaves out the
+	 * frames whose packets came out of order. */
+	pthread_mutex_t stats_mutex;
+	struct deque submit_times;
+	uint32_t pending_frames;
+	uint64_t encode_latency_ns;
+	uint32_t max_queue_depth;
+	struct histogram latency_hist;
+	struct histogram encode_call_hist;
+	uint64_t total_packets;
+	uint64_t duplicate_frames;
+
+	/* output bytes per ENCODER_BITRATE_SLOT_NS, last_bitrate_slot is the
+	 * newest slot written */
+	uint64_t bitrate_bytes[ENCODER_BITRATE_SLOTS];
+	uint64_t last_bitrate_slot;
+
+	/* raw video frames waiting for the encode thread, for encoders with
+	 * OBS_ENCODER_CAP_ASYNC_ENCODE */
+	bool async_active;
+	pthread_t async_thread;
+	pthread_mutex_t async_mutex;
+	os_sem_t *async_frames_sem;
+	os_sem_t *async_free_sem;
+	struct deque async_queue;
+	DARRAY(struct video_frame) async_pool;
+	struct video_scale_info async_info;
+	volatile bool async_failed;
+
+	/* content hash and timestamp of the last raw frame passed to the
+	 * encoder, for encoders with OBS_ENCODER_CAP_SKIP_DUPLICATES */
+	bool skip_duplicates;
+	uint64_t last_frame_hash;
+	uint64_t last_frame_ts;
+
 	/* reconfigure encoder at next possible opportunity */
 	bool reconfigure_requested;
 };
@@ -1408,6 +1497,8 @@ extern void stop_gpu_encode(obs_encoder_t *encoder);
 
 extern bool do_encode(struct obs_encoder *encoder, struct encoder_frame *frame, const uint64_t *frame_cts);
 extern void send_off_encoder_packet(obs_encoder_t *encoder, bool success, bool received, struct encoder_packet *pkt);
+extern void record_encode_call(struct obs_encoder *encoder, int64_t pts, uint64_t start_ts, uint64_t end_ts);
+extern void update_encoder_roi_scenes(void);
 
 void obs_encoder_destroy(obs_encoder_t *encoder);
 
@@ -15,7 +15,10 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <sys/stat.h>
+
 #include "util/platform.h"
+#include "util/threading.h"
 #include "util/dstr.h"
 
 #include "obs-defs.h"
@@ -56,6 +59,7 @@ static int load_module_exports(struct obs_module *mod, const char *path)
 	mod->description = os_dlsym(mod->module, "obs_module_description");
 	mod->author = os_dlsym(mod->module, "obs_module_author");
 	mod->get_string = os_dlsym(mod->module, "obs_module_get_string");
+	mod->concurrent_load = os_dlsym(mod->module, "obs_module_concurrent_load");
 	return MODULE_SUCCESS;
 }
 
@@ -77,14 +81,9 @@ const char *obs_module_get_locale_text(const obs_module_t *mod, const char *text
 
 static inline char *get_module_name(const char *file)
 {
-	static size_t ext_len = 0;
+	size_t ext_len = strlen(get_module_extension());
 	struct dstr name = {0};
 
-	if (ext_len == 0) {
-		const char *ext = get_module_extension();
-		ext_len = strlen(ext);
-	}
-
 	dstr_copy(&name, file);
 	dstr_resize(&name, name.len - ext_len);
 	return name.array;
@@ -94,14 +93,16 @@ static inline char *get_module_name(const char *file)
 extern void reset_win32_symbol_paths(void);
 #endif
 
-int obs_open_module(obs_module_t **module, const char *path, const char *data_path)
+/* Opens the module binary and sets its locale, without adding it to the module
+ * list.  Can be called from loader threads for modules that allow it. */
+static int open_module(obs_module_t **module, const char *path, const char *data_path, const char *hash)
 {
 	struct obs_module mod = {0};
+	const char *file;
+	const char *profile_name;
+	uint64_t start;
 	int errorcode;
 
-	if (!module || !path || !obs)
-		return MODULE_ERROR;
-
 #ifdef __APPLE__
 	/* HACK: Do not load obsolete obs-browser build on macOS; the
 	 * obs-browser plugin used to live in the Application Support
@@ -112,40 +113,79 @@ int obs_open_module(obs_module_t **module, const char *path, const char *data_pa
 	}
 #endif
 
-	blog(LOG_DEBUG, "---------------------------------");
+	file = strrchr(path, '/');
+	file = file ? file + 1 : path;
+
+	profile_name = profile_store_name(obs_get_profiler_name_store(), "obs_open_module(%s)", file);
+	profile_start(profile_name);
+	start = os_gettime_ns();
 
 	mod.module = os_dlopen(path);
 	if (!mod.module) {
 		blog(LOG_WARNING, "Module '%s' not loaded", path);
+		profile_end(profile_name);
 		return MODULE_FILE_NOT_FOUND;
 	}
 
 	errorcode = load_module_exports(&mod, path);
-	if (errorcode != MODULE_SUCCESS)
+	if (errorcode != MODULE_SUCCESS) {
+		profile_end(profile_name);
 		return errorcode;
+	}
 
 	mod.bin_path = bstrdup(path);
-	mod.hash_sha256 = os_hash_file_sha256(path);
+	mod.hash_sha256 = hash ? bstrdup(hash) : os_hash_file_sha256(path);
 	mod.file = strrchr(mod.bin_path, '/');
 	mod.file = (!mod.file) ? mod.bin_path : (mod.file + 1);
 	mod.mod_name = get_module_name(mod.file);
 	mod.data_path = bstrdup(data_path);
-	mod.next = obs->first_module;
 
 	if (mod.file) {
 		blog(LOG_DEBUG, "Loading module: %s", mod.file);
 	}
 
+	mod.times.open_ns = os_gettime_ns() - start;
+	profile_end(profile_name);
+
 	*module = bmemdup(&mod, sizeof(mod));
-	obs->first_module = (*module);
 	mod.set_pointer(*module);
 
-	if (mod.set_locale)
+	if (mod.set_locale) {
+		profile_name = profile_store_name(obs_get_profiler_name_store(), "obs_module_set_locale(%s)", file);
+		profile_start(profile_name);
+		start = os_gettime_ns();
+
 		mod.set_locale(obs->locale);
 
+		(*module)->times.locale_ns = os_gettime_ns() - start;
+		profile_end(profile_name);
+	}
+
 	return MODULE_SUCCESS;
 }
 
+static inline void link_module(obs_module_t *module)
+{
+	module->next = obs->first_module;
+	obs->first_module = module;
+}
+
+int obs_open_module(obs_module_t **module, const char *path, const char *data_path)
+{
+	int errorcode;
+
+	if (!module || !path || !obs)
+		return MODULE_ERROR;
+
+	blog(LOG_DEBUG, "---------------------------------");
+
+	errorcode = open_module(module, path, data_path, NULL);
+	if (errorcode == MODULE_SUCCESS)
+		link_module(*module);
+
+	return errorcode;
+}
+
 bool obs_init_module(obs_module_t *module)
 {
 	if (!module || !obs)
@@ -156,11 +196,13 @@ bool obs_init_module(obs_module_t *module)
 	const char *profile_name =
 		profile_store_name(obs_get_profiler_name_store(), "obs_init_module(%s)", module->file);
 	profile_start(profile_name);
+	uint64_t start = os_gettime_ns();
 
 	module->loaded = module->load();
 	if (!module->loaded)
 		blog(LOG_WARNING, "Failed to initialize module '%s'", module->file);
 
+	module->times.load_ns = os_gettime_ns() - start;
 	profile_end(profile_name);
 	return module->loaded;
 }
@@ -210,6 +252,15 @@ const char *obs_get_module_hash_sha256(obs_module_t *module)
 	return module ? module->hash_sha256 : NULL;
 }
 
+bool obs_get_module_load_times(obs_module_t *module, struct obs_module_load_times *times)
+{
+	if (!module || !times)
+		return false;
+
+	*times = module->times;
+	return true;
+}
+
 obs_module_t *obs_get_module(const char *name)
 {
 	obs_module_t *module = obs->first_module;
@@ -304,66 +355,293 @@ static bool is_safe_module(const char *name)
 	return false;
 }
 
-static void load_all_callback(void *param, const struct obs_module_info2 *info)
-{
-	struct fail_info *fail_info = param;
+/* ------------------------------------------------------------------------- */
+/* Loading all modules
+ *
+ *   Modules are found first, then prepared by a few loader threads: plugin
+ * info and sha256 hashes are computed, and modules that declared
+ * OBS_MODULE_ALLOW_CONCURRENT_LOAD() are opened and load their locale.
+ * Everything else, including obs_module_load, then happens on the calling
+ * thread in the order the modules were found.
+ *
+ *   What is learned about each binary is kept in a module index in the module
+ * config directory, keyed by path, modification time and size, so unchanged
+ * modules are neither inspected nor hashed again, and the declaration is
+ * known before opening them. */
+
+#define MODULE_INDEX_FILE "module-index.json"
+#define MAX_LOADER_THREADS 8
+
+struct module_candidate {
+	char *name;
+	char *bin_path;
+	char *data_path;
+	char *hash;
+
+	int64_t mtime;
+	int64_t size;
+	bool cached;
+	bool is_obs_plugin;
+	bool can_load;
+	bool concurrent;
+
+	bool opened;
+	int code;
 	obs_module_t *module;
+};
 
-	bool is_obs_plugin;
-	bool can_load_obs_plugin;
+struct module_loader {
+	DARRAY(struct module_candidate) candidates;
+	volatile long next;
+};
+
+static void add_candidate(void *param, const struct obs_module_info2 *info)
+{
+	struct module_loader *loader = param;
+	struct module_candidate *mc = da_push_back_new(loader->candidates);
+
+	mc->name = bstrdup(info->name);
+	mc->bin_path = bstrdup(info->bin_path);
+	mc->data_path = bstrdup(info->data_path);
+	mc->mtime = -1;
+	mc->size = -1;
+}
+
+static void free_candidates(struct module_loader *loader)
+{
+	for (size_t i = 0; i < loader->candidates.num; i++) {
+		struct module_candidate *mc = loader->candidates.array + i;
+		bfree(mc->name);
+		bfree(mc->bin_path);
+		bfree(mc->data_path);
+		bfree(mc->hash);
+	}
+
+	da_free(loader->candidates);
+}
+
+static char *get_module_index_path(void)
+{
+	struct dstr path = {0};
 
-	get_plugin_info(info->bin_path, &is_obs_plugin, &can_load_obs_plugin);
+	if (!obs->module_config_path || !*obs->module_config_path)
+		return NULL;
+
+	dstr_copy(&path, obs->module_config_path);
+	if (dstr_end(&path) != '/')
+		dstr_cat_ch(&path, '/');
+	dstr_cat(&path, MODULE_INDEX_FILE);
+	return path.array;
+}
+
+static void lookup_module_index(obs_data_t *index, struct module_candidate *mc)
+{
+	struct stat st;
 
-	if (!is_obs_plugin) {
-		blog(LOG_WARNING, "Skipping module '%s', not an OBS plugin", info->bin_path);
+	if (os_stat(mc->bin_path, &st) != 0)
 		return;
+
+	mc->mtime = (int64_t)st.st_mtime;
+	mc->size = (int64_t)st.st_size;
+
+	obs_data_t *entry = index ? obs_data_get_obj(index, mc->bin_path) : NULL;
+	if (!entry)
+		return;
+
+	if (obs_data_get_int(entry, "mtime") == mc->mtime && obs_data_get_int(entry, "size") == mc->size) {
+		const char *hash = obs_data_get_string(entry, "sha256");
+
+		mc->cached = true;
+		mc->is_obs_plugin = obs_data_get_bool(entry, "is_obs_plugin");
+		mc->can_load = obs_data_get_bool(entry, "can_load");
+		mc->concurrent = obs_data_get_bool(entry, "concurrent");
+		mc->hash = *hash ? bstrdup(hash) : NULL;
 	}
 
-	if (!is_safe_module(info->name)) {
-		blog(LOG_WARNING, "Skipping module '%s', not on safe list", info->name);
+	obs_data_release(entry);
+}
+
+static void save_module_index(struct module_loader *loader, const char *path)
+{
+	obs_data_t *index = obs_data_create();
+
+	for (size_t i = 0; i < loader->candidates.num; i++) {
+		struct module_candidate *mc = loader->candidates.array + i;
+		if (mc->mtime < 0)
+			continue;
+
+		obs_data_t *entry = obs_data_create();
+		obs_data_set_int(entry, "mtime", mc->mtime);
+		obs_data_set_int(entry, "size", mc->size);
+		obs_data_set_bool(entry, "is_obs_plugin", mc->is_obs_plugin);
+		obs_data_set_bool(entry, "can_load", mc->can_load);
+		obs_data_set_bool(entry, "concurrent", mc->concurrent);
+		obs_data_set_string(entry, "sha256", mc->hash ? mc->hash : "");
+		obs_data_set_obj(index, mc->bin_path, entry);
+		obs_data_release(entry);
+	}
+
+	if (!obs_data_save_json_safe(index, path, "tmp", "bak"))
+		blog(LOG_WARNING, "Failed to save module index '%s'", path);
+
+	obs_data_release(index);
+}
+
+static inline bool allows_concurrent_load(obs_module_t *module)
+{
+	return module->concurrent_load && module->concurrent_load();
+}
+
+static void prepare_candidate(struct module_candidate *mc)
+{
+	if (!mc->cached)
+		get_plugin_info(mc->bin_path, &mc->is_obs_plugin, &mc->can_load);
+
+	if (!mc->is_obs_plugin || !mc->can_load || !is_safe_module(mc->name))
+		return;
+
+	if (!mc->hash)
+		mc->hash = os_hash_file_sha256(mc->bin_path);
+
+	if (mc->concurrent) {
+		mc->code = open_module(&mc->module, mc->bin_path, mc->data_path, mc->hash);
+		mc->opened = true;
+
+		if (mc->code == MODULE_SUCCESS)
+			mc->module->times.concurrent = true;
+	}
+}
+
+static void *module_loader_thread(void *param)
+{
+	struct module_loader *loader = param;
+	long count = (long)loader->candidates.num;
+	long idx;
+
+	os_set_thread_name("libobs: module loader");
+	profile_start("module_loader_thread");
+
+	while ((idx = os_atomic_inc_long(&loader->next) - 1) < count)
+		prepare_candidate(loader->candidates.array + idx);
+
+	profile_end("module_loader_thread");
+	return NULL;
+}
+
+static void prepare_candidates(struct module_loader *loader)
+{
+	pthread_t threads[MAX_LOADER_THREADS];
+	size_t num_threads = (size_t)os_get_logical_cores();
+	size_t started = 0;
+
+	if (num_threads > MAX_LOADER_THREADS)
+		num_threads = MAX_LOADER_THREADS;
+	if (num_threads > loader->candidates.num)
+		num_threads = loader->candidates.num;
+
+	for (size_t i = 1; i < num_threads; i++) {
+		if (pthread_create(&threads[started], NULL, module_loader_thread, loader) != 0)
+			break;
+		started++;
+	}
+
+	/* the calling thread helps out instead of waiting */
+	module_loader_thread(loader);
+
+	for (size_t i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+}
+
+static void load_candidate(struct module_candidate *mc, struct fail_info *fail_info)
+{
+	obs_module_t *module;
+
+	if (!mc->is_obs_plugin) {
+		blog(LOG_WARNING, "Skipping module '%s', not an OBS plugin", mc->bin_path);
 		return;
 	}
 
-	if (!can_load_obs_plugin) {
+	if (!is_safe_module(mc->name)) {
+		blog(LOG_WARNING, "Skipping module '%s', not on safe list", mc->name);
+		return;
+	}
+
+	if (!mc->can_load) {
 		blog(LOG_WARNING,
 		     "Skipping module '%s' due to possible "
 		     "import conflicts",
-		     info->bin_path);
+		     mc->bin_path);
 		goto load_failure;
 	}
 
-	int code = obs_open_module(&module, info->bin_path, info->data_path);
-	switch (code) {
+	blog(LOG_DEBUG, "---------------------------------");
+
+	if (!mc->opened)
+		mc->code = open_module(&mc->module, mc->bin_path, mc->data_path, mc->hash);
+
+	switch (mc->code) {
 	case MODULE_MISSING_EXPORTS:
-		blog(LOG_DEBUG, "Failed to load module file '%s', not an OBS plugin", info->bin_path);
+		blog(LOG_DEBUG, "Failed to load module file '%s', not an OBS plugin", mc->bin_path);
 		return;
 	case MODULE_FILE_NOT_FOUND:
-		blog(LOG_DEBUG, "Failed to load module file '%s', file not found", info->bin_path);
+		blog(LOG_DEBUG, "Failed to load module file '%s', file not found", mc->bin_path);
 		return;
 	case MODULE_ERROR:
-		blog(LOG_DEBUG, "Failed to load module file '%s'", info->bin_path);
+		blog(LOG_DEBUG, "Failed to load module file '%s'", mc->bin_path);
 		goto load_failure;
 	case MODULE_INCOMPATIBLE_VER:
-		blog(LOG_DEBUG, "Failed to load module file '%s', incompatible version", info->bin_path);
+		blog(LOG_DEBUG, "Failed to load module file '%s', incompatible version", mc->bin_path);
 		goto load_failure;
 	case MODULE_HARDCODED_SKIP:
 		return;
 	}
 
+	module = mc->module;
+	mc->concurrent = allows_concurrent_load(module);
+	if (!mc->hash)
+		mc->hash = bstrdup(module->hash_sha256);
+
+	link_module(module);
 	if (!obs_init_module(module))
 		free_module(module);
 
-	UNUSED_PARAMETER(param);
 	return;
 
 load_failure:
 	if (fail_info) {
-		dstr_cat(&fail_info->fail_modules, info->name);
+		dstr_cat(&fail_info->fail_modules, mc->name);
 		dstr_cat(&fail_info->fail_modules, ";");
 		fail_info->fail_count++;
 	}
 }
 
+static void load_all_modules(struct fail_info *fail_info)
+{
+	struct module_loader loader = {0};
+	char *index_path = get_module_index_path();
+	obs_data_t *index = NULL;
+
+	obs_find_modules2(add_candidate, &loader);
+
+	if (index_path && os_file_exists(index_path))
+		index = obs_data_create_from_json_file_safe(index_path, "bak");
+
+	for (size_t i = 0; i < loader.candidates.num; i++)
+		lookup_module_index(index, loader.candidates.array + i);
+	obs_data_release(index);
+
+	prepare_candidates(&loader);
+
+	for (size_t i = 0; i < loader.candidates.num; i++)
+		load_candidate(loader.candidates.array + i, fail_info);
+
+	if (index_path)
+		save_module_index(&loader, index_path);
+
+	bfree(index_path);
+	free_candidates(&loader);
+}
+
 static const char *obs_load_all_modules_name = "obs_load_all_modules";
 #ifdef _WIN32
 static const char *reset_win32_symbol_paths_name = "reset_win32_symbol_paths";
@@ -372,7 +650,7 @@ static const char *reset_win32_symbol_paths_name = "reset_win32_symbol_paths";
 void obs_load_all_modules(void)
 {
 	profile_start(obs_load_all_modules_name);
-	obs_find_modules2(load_all_callback, NULL);
+	load_all_modules(NULL);
 #ifdef _WIN32
 	profile_start(reset_win32_symbol_paths_name);
 	reset_win32_symbol_paths();
@@ -389,7 +667,7 @@ void obs_load_all_modules2(struct obs_module_failure_info *mfi)
 	memset(mfi, 0, sizeof(*mfi));
 
 	profile_start(obs_load_all_modules2_name);
-	obs_find_modules2(load_all_callback, &fail_info);
+	load_all_modules(&fail_info);
 #ifdef _WIN32
 	profile_start(reset_win32_symbol_paths_name);
 	reset_win32_symbol_paths();
@@ -410,11 +688,28 @@ void obs_module_failure_info_free(struct obs_module_failure_info *mfi)
 	}
 }
 
+static const char *obs_post_load_modules_name = "obs_post_load_modules";
+
 void obs_post_load_modules(void)
 {
-	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next)
-		if (mod->post_load)
-			mod->post_load();
+	profile_start(obs_post_load_modules_name);
+
+	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next) {
+		if (!mod->post_load)
+			continue;
+
+		const char *profile_name =
+			profile_store_name(obs_get_profiler_name_store(), "obs_module_post_load(%s)", mod->file);
+		profile_start(profile_name);
+		uint64_t start = os_gettime_ns();
+
+		mod->post_load();
+
+		mod->times.post_load_ns = os_gettime_ns() - start;
+		profile_end(profile_name);
+	}
+
+	profile_end(obs_post_load_modules_name);
 }
 
 static inline void make_data_dir(struct dstr *parsed_data_dir, const char *data_dir, const char *name)
@@ -619,10 +914,35 @@ void free_module(struct obs_module *mod)
 	bfree(mod);
 }
 
+/* compiled locale tables are cached next to the module configs */
+static char *get_locale_cache_path(obs_module_t *module, const char *default_locale, const char *locale)
+{
+	struct dstr path = {0};
+
+	if (!obs->module_config_path || !*obs->module_config_path)
+		return NULL;
+
+	dstr_copy(&path, obs->module_config_path);
+	if (dstr_end(&path) != '/')
+		dstr_cat_ch(&path, '/');
+	dstr_cat(&path, "locale-cache");
+
+	if (os_mkdirs(path.array) == MKDIR_ERROR) {
+		dstr_free(&path);
+		return NULL;
+	}
+
+	dstr_catf(&path, "/%s.%s.%s.bin", module->mod_name, default_locale, locale);
+	return path.array;
+}
+
 lookup_t *obs_module_load_locale(obs_module_t *module, const char *default_locale, const char *locale)
 {
 	struct dstr str = {0};
 	lookup_t *lookup = NULL;
+	char *files[2] = {NULL, NULL};
+	size_t num_files = 1;
+	char *cache_path;
 
 	if (!module || !default_locale || !locale) {
 		blog(LOG_WARNING, "obs_module_load_locale: Invalid parameters");
@@ -633,31 +953,32 @@ lookup_t *obs_module_load_locale(obs_module_t *module, const char *default_local
 	dstr_cat(&str, default_locale);
 	dstr_cat(&str, ".ini");
 
-	char *file = obs_find_module_file(module, str.array);
-	if (file)
-		lookup = text_lookup_create(file);
+	files[0] = obs_find_module_file(module, str.array);
+	if (!files[0])
+		goto failed;
 
-	bfree(file);
+	if (astrcmpi(locale, default_locale) != 0) {
+		dstr_copy(&str, "/locale/");
+		dstr_cat(&str, locale);
+		dstr_cat(&str, ".ini");
 
-	if (!lookup) {
-		blog(LOG_WARNING, "Failed to load '%s' text for module: '%s'", default_locale, module->file);
-		goto cleanup;
+		files[1] = obs_find_module_file(module, str.array);
+		if (files[1])
+			num_files++;
+		else
+			blog(LOG_WARNING, "Failed to load '%s' text for module: '%s'", locale, module->file);
 	}
 
-	if (astrcmpi(locale, default_locale) == 0)
-		goto cleanup;
+	cache_path = get_locale_cache_path(module, default_locale, locale);
+	lookup = text_lookup_create_compiled(cache_path, (const char *const *)files, num_files);
+	bfree(cache_path);
 
-	dstr_copy(&str, "/locale/");
-	dstr_cat(&str, locale);
-	dstr_cat(&str, ".ini");
-
-	file = obs_find_module_file(module, str.array);
-
-	if (!text_lookup_add(lookup, file))
-		blog(LOG_WARNING, "Failed to load '%s' text for module: '%s'", locale, module->file);
+failed:
+	if (!lookup)
+		blog(LOG_WARNING, "Failed to load '%s' text for module: '%s'", default_locale, module->file);
 
-	bfree(file);
-cleanup:
+	bfree(files[0]);
+	bfree(files[1]);
 	dstr_free(&str);
 	return lookup;
 }
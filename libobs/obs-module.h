@@ -174,6 +174,23 @@ MODULE_EXTERN obs_module_t *obs_current_module(void);
 		return name;                               \
 	}
 
+/**
+ * Optional: Declares that the module can be opened and can load its locale
+ * concurrently with other modules.  Only use this if opening the module has no
+ * side effects outside of it (such as static initializers registering things
+ * globally) and its obs_module_set_locale is thread safe.  obs_module_load is
+ * always called on the loading thread, in order.
+ *
+ * Takes effect from the next start, once libobs has recorded the declaration
+ * in its module index.
+ */
+#define OBS_MODULE_ALLOW_CONCURRENT_LOAD()                   \
+	MODULE_EXPORT bool obs_module_concurrent_load(void); \
+	bool obs_module_concurrent_load(void)                \
+	{                                                    \
+		return true;                                 \
+	}
+
 /** Optional: Returns the full name of the module */
 MODULE_EXPORT const char *obs_module_name(void);
 
@@ -912,7 +912,7 @@ static inline void render_item(struct obs_scene_item *item)
 	}
 
 	if (!item->item_render && use_texrender) {
-		item->item_render = gs_texrender_create(format, GS_ZS_NONE);
+		item->item_render = gs_texrender_create_pooled(format, GS_ZS_NONE);
 	}
 
 	if (item->item_render) {
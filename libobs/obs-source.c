@@ -115,6 +115,14 @@ static const char *source_signals[] = {
 	NULL,
 };
 
+struct calldata_signature obs_source_signature = CALLDATA_SIGNATURE({"source", CALL_PARAM_TYPE_PTR});
+
+struct calldata_signature obs_source_canvas_signature =
+	CALLDATA_SIGNATURE({"source", CALL_PARAM_TYPE_PTR}, {"canvas", CALL_PARAM_TYPE_PTR});
+
+struct calldata_signature obs_source_volume_signature =
+	CALLDATA_SIGNATURE({"source", CALL_PARAM_TYPE_PTR}, {"volume", CALL_PARAM_TYPE_FLOAT});
+
 bool obs_source_init_context(struct obs_source *source, obs_data_t *settings, const char *name, const char *uuid,
 			     obs_data_t *hotkey_data, bool private)
 {
@@ -328,9 +336,13 @@ static void obs_source_init_audio_hotkeys(struct obs_source *source)
 							      obs_source_hotkey_push_to_talk, source);
 }
 
-static obs_source_t *obs_source_create_internal(const char *id, const char *name, const char *uuid,
-						obs_data_t *settings, obs_data_t *hotkey_data, bool private,
-						uint32_t last_obs_ver, obs_canvas_t *canvas)
+/* Creation is split in steps so that the source loader can call the create
+ * callbacks of thread-safe source types on worker threads while everything
+ * that touches global state, including registering hotkeys, stays on the
+ * calling thread, in order. */
+obs_source_t *obs_source_create_prepare(obs_canvas_t **canvas, const char *id, const char *name, const char *uuid,
+					obs_data_t *settings, obs_data_t *hotkey_data, bool private,
+					uint32_t last_obs_ver)
 {
 	struct obs_source *source = bzalloc(sizeof(struct obs_source));
 
@@ -373,22 +385,93 @@ static obs_source_t *obs_source_create_internal(const char *id, const char *name
 		goto fail;
 
 	/* Scenes need canvases, fall back to using default canvas if none provided here. */
-	if (requires_canvas(source) && !canvas) {
+	if (requires_canvas(source) && !*canvas) {
 		blog(LOG_WARNING, "Attempted to add Scene without specifying a canvas! Using default canvas instead.");
-		canvas = obs->data.main_canvas;
+		*canvas = obs->data.main_canvas;
 	}
 
-	if (!private)
+	return source;
+
+fail:
+	blog(LOG_ERROR, "obs_source_create failed");
+	obs_source_destroy(source);
+	return NULL;
+}
+
+static inline bool lazy_loading_applies(const obs_source_t *source)
+{
+	return source->info.type == OBS_SOURCE_TYPE_INPUT && os_atomic_load_bool(&obs->data.lazy_sources);
+}
+
+static void load_source_resources(obs_source_t *source)
+{
+	if (!source->context.data || !source->info.load_resources || source->resources_loaded)
+		return;
+
+	source->info.load_resources(source->context.data);
+	os_atomic_set_bool(&source->resources_loaded, true);
+}
+
+static void unload_source_resources(obs_source_t *source)
+{
+	if (!source->info.unload_resources || !source->resources_loaded)
+		return;
+
+	blog(LOG_DEBUG, "Unloading resources of inactive source '%s'", source->context.name);
+
+	os_atomic_set_bool(&source->resources_loaded, false);
+	source->info.unload_resources(source->context.data);
+}
+
+/* loads the resources of a lazily loaded source before it's first shown or
+ * activated, and unloads them once it's been unused for the unload timeout */
+static void tick_source_resources(obs_source_t *source)
+{
+	if (source->show_refs || source->activate_refs || !lazy_loading_applies(source)) {
+		source->inactive_since = 0;
+		load_source_resources(source);
+		return;
+	}
+
+	long timeout_ms = os_atomic_load_long(&obs->data.lazy_unload_timeout_ms);
+	if (!source->resources_loaded || timeout_ms <= 0)
+		return;
+
+	uint64_t now = os_gettime_ns();
+	if (!source->inactive_since)
+		source->inactive_since = now;
+	else if (now - source->inactive_since >= (uint64_t)timeout_ms * 1000000ULL)
+		unload_source_resources(source);
+}
+
+void obs_source_create_hotkeys(obs_source_t *source)
+{
+	if (!source->context.private)
 		obs_source_init_audio_hotkeys(source);
+}
+
+void obs_source_create_context_data(obs_source_t *source)
+{
+	const struct obs_source_info *info = &source->info;
+	const char *name = source->context.name;
 
 	/* allow the source to be created even if creation fails so that the
 	 * user's data doesn't become lost */
-	if (info && info->create)
+	if (info->create)
 		source->context.data = info->create(source->context.settings, source);
-	if ((!info || info->create) && !source->context.data)
+	if ((source->owns_info_id || info->create) && !source->context.data)
 		blog(LOG_ERROR, "Failed to create source '%s'!", name);
 
-	blog(LOG_DEBUG, "%ssource '%s' (%s) created", private ? "private " : "", name, id);
+	if (!lazy_loading_applies(source))
+		load_source_resources(source);
+
+	blog(LOG_DEBUG, "%ssource '%s' (%s) created", source->context.private ? "private " : "", name,
+	     source->info.id);
+}
+
+void obs_source_create_finish(obs_source_t *source, obs_canvas_t *canvas)
+{
+	bool private = source->context.private;
 
 	source->flags = source->default_flags;
 	source->enabled = true;
@@ -400,13 +483,21 @@ static obs_source_t *obs_source_create_internal(const char *id, const char *name
 		if (!canvas || canvas == obs->data.main_canvas)
 			obs_source_dosignal(source, "source_create", NULL);
 	}
+}
 
-	return source;
+static obs_source_t *obs_source_create_internal(const char *id, const char *name, const char *uuid,
+						obs_data_t *settings, obs_data_t *hotkey_data, bool private,
+						uint32_t last_obs_ver, obs_canvas_t *canvas)
+{
+	obs_source_t *source =
+		obs_source_create_prepare(&canvas, id, name, uuid, settings, hotkey_data, private, last_obs_ver);
+	if (!source)
+		return NULL;
 
-fail:
-	blog(LOG_ERROR, "obs_source_create failed");
-	obs_source_destroy(source);
-	return NULL;
+	obs_source_create_hotkeys(source);
+	obs_source_create_context_data(source);
+	obs_source_create_finish(source, canvas);
+	return source;
 }
 
 obs_source_t *obs_source_create(const char *id, const char *name, obs_data_t *settings, obs_data_t *hotkey_data)
@@ -1269,6 +1360,9 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 	if (source->filter_texrender)
 		gs_texrender_reset(source->filter_texrender);
 
+	if (source->info.load_resources)
+		tick_source_resources(source);
+
 	/* call show/hide if the reference changed */
 	now_showing = !!source->show_refs;
 	if (now_showing != source->showing) {
@@ -4292,7 +4386,7 @@ bool obs_source_process_filter_begin_with_color_space(obs_source_t *filter, enum
 	}
 
 	if (!filter->filter_texrender) {
-		filter->filter_texrender = gs_texrender_create(format, GS_ZS_NONE);
+		filter->filter_texrender = gs_texrender_create_pooled(format, GS_ZS_NONE);
 	}
 
 	if (gs_texrender_begin_with_color_space(filter->filter_texrender, cx, cy, space)) {
@@ -4410,17 +4504,17 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		struct audio_action action = {.timestamp = os_gettime_ns(), .type = AUDIO_ACTION_VOL, .vol = volume};
 
 		struct calldata data;
-		uint8_t stack[128];
+		uint8_t stack[CALLDATA_SIGNATURE_STACK_SIZE];
 
-		calldata_init_fixed(&data, stack, sizeof(stack));
-		calldata_set_ptr(&data, "source", source);
-		calldata_set_float(&data, "volume", volume);
+		calldata_init_signature(&data, &obs_source_volume_signature, stack, sizeof(stack));
+		calldata_sig_set_ptr(&data, &obs_source_volume_signature, 0, source);
+		calldata_sig_set_float(&data, &obs_source_volume_signature, 1, volume);
 
 		signal_handler_signal(source->context.signals, "volume", &data);
 		if (!source->context.private)
 			signal_handler_signal(obs->signals, "source_volume", &data);
 
-		volume = (float)calldata_float(&data, "volume");
+		volume = (float)calldata_sig_float(&data, &obs_source_volume_signature, 1);
 
 		pthread_mutex_lock(&source->audio_actions_mutex);
 		da_push_back(source->audio_actions, &action);
@@ -5591,6 +5685,29 @@ uint32_t obs_source_get_last_obs_version(const obs_source_t *source)
 	return obs_source_valid(source, "obs_source_get_last_obs_version") ? source->last_obs_ver : 0;
 }
 
+uint64_t obs_source_get_load_time_ns(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_load_time_ns") ? source->load_time_ns : 0;
+}
+
+bool obs_source_resources_loaded(const obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_resources_loaded"))
+		return false;
+
+	return !source->info.load_resources || os_atomic_load_bool(&source->resources_loaded);
+}
+
+uint64_t obs_source_get_memory_usage(const obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_get_memory_usage"))
+		return 0;
+
+	return (source->context.data && source->info.get_memory_usage)
+		       ? source->info.get_memory_usage(source->context.data)
+		       : 0;
+}
+
 enum obs_icon_type obs_source_get_icon_type(const char *id)
 {
 	const struct obs_source_info *info = get_source_info(id);
@@ -208,6 +208,13 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_REQUIRES_CANVAS (1 << 17)
 
+/**
+ * Source type's create callback is thread-safe, it may be called from a
+ * worker thread and at the same time as the create callbacks of other
+ * sources when loading sources
+ */
+#define OBS_SOURCE_THREADSAFE_CREATE (1 << 18)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent, obs_source_t *child, void *param);
@@ -551,6 +558,34 @@ struct obs_source_info {
 	 * @param  source  Source that the filter is being added to
 	 */
 	void (*filter_add)(void *data, obs_source_t *source);
+
+	/**
+	 * Allocates the source's heavy resources (decoded images, textures,
+	 * decoders).  When lazy source loading is enabled this is called the
+	 * first time the source is shown or activated, otherwise right after
+	 * create.  Only used for input sources.
+	 *
+	 * @param  data  Source data
+	 */
+	void (*load_resources)(void *data);
+
+	/**
+	 * Frees the resources allocated by load_resources.  Called when lazy
+	 * source loading is enabled and the source has been neither showing
+	 * nor active for longer than the unload timeout.  The destroy
+	 * callback must still free the resources if they are loaded.
+	 *
+	 * @param  data  Source data
+	 */
+	void (*unload_resources)(void *data);
+
+	/**
+	 * Gets the amount of memory currently held by the source, in bytes
+	 *
+	 * @param  data  Source data
+	 * @return       The memory usage in bytes
+	 */
+	uint64_t (*get_memory_usage)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info, size_t size);
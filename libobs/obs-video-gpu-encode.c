@@ -168,6 +168,8 @@ static void *gpu_encode_thread(void *data)
 			}
 			profile_end(gpu_encode_frame_name);
 
+			record_encode_call(encoder, encoder->cur_pts, fer_ts, os_gettime_ns());
+
 			/* Generate and enqueue the frame timing metrics, namely
 			 * the CTS (composition time), FER (frame encode request), FERC
 			 * (frame encode request complete) and current PTS. PTS is used to
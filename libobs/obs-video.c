@@ -802,16 +802,87 @@ void add_ready_encoder_group(obs_encoder_t *encoder)
 	pthread_mutex_unlock(&obs->video.encoder_group_mutex);
 }
 
+static void apply_frame_pacing(struct obs_core_video *video)
+{
+	struct obs_frame_pacing_info pacing;
+
+	pthread_mutex_lock(&video->frame_timing_mutex);
+	pacing = video->pacing;
+	pthread_mutex_unlock(&video->frame_timing_mutex);
+
+	/* only touch scheduling when it differs from what was last applied, so
+	 * the defaults leave the thread as the system created it */
+	if (pacing.realtime != video->realtime_applied) {
+		if (os_set_thread_realtime(pacing.realtime))
+			video->realtime_applied = pacing.realtime;
+		else
+			blog(LOG_WARNING, "Failed to %s real-time scheduling for the graphics thread",
+			     pacing.realtime ? "enable" : "disable");
+	}
+
+	if (pacing.cpu_affinity != video->affinity_applied) {
+		if (os_set_thread_affinity(pacing.cpu_affinity))
+			video->affinity_applied = pacing.cpu_affinity;
+		else if (pacing.cpu_affinity >= 0)
+			blog(LOG_WARNING, "Failed to pin the graphics thread to CPU %d", pacing.cpu_affinity);
+	}
+}
+
+/* Sleeps to the frame deadline.  With adaptive spinning, the thread sleeps to
+ * (deadline - spin margin) and busy-waits the rest.  The margin tracks the
+ * 99th percentile of the measured scheduler wakeup latency over the last
+ * second of frames. */
+static inline bool frame_sleepto(struct obs_core_video *video, uint64_t target, uint64_t interval_ns,
+				 uint64_t *overshoot)
+{
+	uint64_t now = os_gettime_ns();
+	uint64_t margin = video->spin_margin_ns;
+	uint64_t coarse_target;
+
+	if (now >= target)
+		return false;
+
+	coarse_target = (margin < target - now) ? target - margin : now;
+	if (coarse_target > now) {
+		os_sleepto_ns(coarse_target);
+		now = os_gettime_ns();
+
+		pthread_mutex_lock(&video->frame_timing_mutex);
+		histogram_record(&video->wakeup_latency_window, now - coarse_target);
+
+		if (video->wakeup_latency_window.count * interval_ns >= 1000000000ULL) {
+			if (video->pacing.adaptive_spin) {
+				uint64_t p99 = histogram_percentile(&video->wakeup_latency_window, 99.0);
+				uint64_t max_spin = video->pacing.max_spin_ns;
+				video->spin_margin_ns = p99 < max_spin ? p99 : max_spin;
+			}
+			histogram_reset(&video->wakeup_latency_window);
+		}
+		pthread_mutex_unlock(&video->frame_timing_mutex);
+	}
+
+	while (now < target)
+		now = os_gettime_ns();
+
+	*overshoot = now - target;
+	return true;
+}
+
 static inline void video_sleep(struct obs_core_video *video, uint64_t *p_time, uint64_t interval_ns)
 {
 	struct obs_vframe_info vframe_info;
 	uint64_t cur_time = *p_time;
 	uint64_t t = cur_time + interval_ns;
+	uint64_t overshoot = 0;
 	int count;
 
-	if (os_sleepto_ns(t)) {
+	if (frame_sleepto(video, t, interval_ns, &overshoot)) {
 		*p_time = t;
 		count = 1;
+
+		pthread_mutex_lock(&video->frame_timing_mutex);
+		histogram_record(&video->sleep_overshoot_hist, overshoot);
+		pthread_mutex_unlock(&video->frame_timing_mutex);
 	} else {
 		const uint64_t udiff = os_gettime_ns() - cur_time;
 		int64_t diff;
@@ -1101,6 +1172,9 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 
 	update_active_states();
 
+	if (os_atomic_exchange_bool(&obs->video.pacing_changed, false))
+		apply_frame_pacing(&obs->video);
+
 	profile_start(context->video_thread_name);
 	source_profiler_frame_begin();
 
@@ -1112,6 +1186,8 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 	context->last_time = tick_sources(obs->video.video_time, context->last_time);
 	profile_end(tick_sources_name);
 
+	update_encoder_roi_scenes();
+
 #ifdef _WIN32
 	MSG msg;
 	while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
@@ -1134,6 +1210,10 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 
 	frame_time_ns = os_gettime_ns() - frame_start;
 
+	pthread_mutex_lock(&obs->video.frame_timing_mutex);
+	histogram_record(&obs->video.render_time_hist, frame_time_ns);
+	pthread_mutex_unlock(&obs->video.frame_timing_mutex);
+
 	source_profiler_frame_collect();
 	profile_end(context->video_thread_name);
 
@@ -1194,6 +1274,15 @@ void *obs_graphics_thread(void *param)
 #endif
 		;
 
+	struct obs_frame_timing_stats stats;
+	obs_get_frame_timing_stats(&stats);
+	blog(LOG_INFO,
+	     "Graphics thread frame timing: render p50/p99/max %.3f/%.3f/%.3f ms, "
+	     "sleep overshoot p50/p99/max %.3f/%.3f/%.3f ms",
+	     stats.render_p50_ns / 1000000.0, stats.render_p99_ns / 1000000.0, stats.render_max_ns / 1000000.0,
+	     stats.sleep_overshoot_p50_ns / 1000000.0, stats.sleep_overshoot_p99_ns / 1000000.0,
+	     stats.sleep_overshoot_max_ns / 1000000.0);
+
 #ifdef _WIN32
 	uninit_winrt_state(&winrt);
 #endif
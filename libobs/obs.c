@@ -698,6 +698,14 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	if (pthread_mutex_init(&video->mixes_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
+	if (pthread_mutex_init(&video->frame_timing_mutex, NULL) < 0)
+		return OBS_VIDEO_FAIL;
+
+	histogram_init(&video->render_time_hist);
+	histogram_init(&video->sleep_overshoot_hist);
+	histogram_init(&video->wakeup_latency_window);
+	video->spin_margin_ns = 0;
+	os_atomic_set_bool(&video->pacing_changed, true);
 
 	/* Reset main canvas mix first so it remains first in the rendering order. */
 	if (!obs_canvas_reset_video_internal(obs->data.main_canvas, ovi))
@@ -848,6 +856,9 @@ static void obs_free_video(void)
 	pthread_mutex_destroy(&obs->video.task_mutex);
 	pthread_mutex_init_value(&obs->video.task_mutex);
 	deque_free(&obs->video.tasks);
+
+	pthread_mutex_destroy(&obs->video.frame_timing_mutex);
+	pthread_mutex_init_value(&obs->video.frame_timing_mutex);
 }
 
 static void obs_free_graphics(void)
@@ -1207,6 +1218,11 @@ static bool obs_init(const char *locale, const char *module_config_path, profile
 	pthread_mutex_init_value(&obs->video.task_mutex);
 	pthread_mutex_init_value(&obs->video.encoder_group_mutex);
 	pthread_mutex_init_value(&obs->video.mixes_mutex);
+	pthread_mutex_init_value(&obs->video.frame_timing_mutex);
+
+	obs->video.pacing.max_spin_ns = 1000000;
+	obs->video.pacing.cpu_affinity = -1;
+	obs->video.affinity_applied = -1;
 
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
@@ -2211,52 +2227,131 @@ gs_texture_t *obs_get_main_texture(void)
 	return video->render_texture;
 }
 
-static obs_source_t *obs_load_source_type(obs_data_t *source_data, bool is_private)
+/* ------------------------------------------------------------------------- */
+/* source loading                                                            */
+
+#define MAX_SOURCE_CREATE_THREADS 8
+#define SLOWEST_SOURCES_LOGGED 5
+
+struct source_load_job {
+	obs_data_t *source_data;
+	obs_source_t *source;
+	obs_canvas_t *canvas;
+	obs_canvas_t *create_canvas;
+	size_t parent;
+	bool is_private;
+	bool threadsafe;
+	volatile bool created;
+	uint64_t create_time;
+};
+
+typedef DARRAY(struct source_load_job) source_load_jobs_t;
+
+#define NO_PARENT SIZE_MAX
+
+/* adds jobs for a source and its filters, in the same order that loading
+ * them serially would create them in */
+static size_t add_source_load_jobs(source_load_jobs_t *jobs, obs_data_t *source_data, size_t parent, bool is_private)
 {
 	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
-	obs_source_t *source;
+	struct source_load_job *job = da_push_back_new(*jobs);
+	size_t idx = jobs->num - 1;
+
+	job->source_data = obs_data_newref(source_data);
+	job->parent = parent;
+	job->is_private = is_private;
+
+	if (filters) {
+		size_t count = obs_data_array_count(filters);
+
+		for (size_t i = 0; i < count; i++) {
+			obs_data_t *filter_data = obs_data_array_item(filters, i);
+			add_source_load_jobs(jobs, filter_data, idx, true);
+			obs_data_release(filter_data);
+		}
+
+		obs_data_array_release(filters);
+	}
+
+	return idx;
+}
+
+static const char *source_load_job_id(const struct source_load_job *job)
+{
+	const char *v_id = obs_data_get_string(job->source_data, "versioned_id");
+	return *v_id ? v_id : obs_data_get_string(job->source_data, "id");
+}
+
+static bool source_load_job_threadsafe(const struct source_load_job *job)
+{
+	const struct obs_source_info *info = get_source_info(source_load_job_id(job));
+	return info && (info->output_flags & OBS_SOURCE_THREADSAFE_CREATE) != 0;
+}
+
+static void prepare_source_load_job(struct source_load_job *job)
+{
+	obs_data_t *source_data = job->source_data;
 	const char *name = obs_data_get_string(source_data, "name");
 	const char *uuid = obs_data_get_string(source_data, "uuid");
 	const char *id = obs_data_get_string(source_data, "id");
-	const char *v_id = obs_data_get_string(source_data, "versioned_id");
+	const char *v_id = source_load_job_id(job);
 	obs_data_t *settings = obs_data_get_obj(source_data, "settings");
 	obs_data_t *hotkeys = obs_data_get_obj(source_data, "hotkeys");
-	obs_canvas_t *canvas = NULL;
-	double volume;
-	double balance;
-	int64_t sync;
 	uint32_t prev_ver;
-	uint32_t caps;
-	uint32_t flags;
-	uint32_t mixers;
-	int di_order;
-	int di_mode;
-	int monitoring_type;
 
 	prev_ver = (uint32_t)obs_data_get_int(source_data, "prev_ver");
 
-	if (!*v_id)
-		v_id = id;
-
 	if (strcmp(id, scene_info.id) == 0 || strcmp(id, group_info.id) == 0) {
 		const char *canvas_uuid = obs_data_get_string(source_data, "canvas_uuid");
-		canvas = obs_get_canvas_by_uuid(canvas_uuid);
+		job->canvas = obs_get_canvas_by_uuid(canvas_uuid);
 		/* Fall back to main canvas if canvas cannot be found. */
-		if (!canvas) {
-			canvas = obs_canvas_get_ref(obs->data.main_canvas);
+		if (!job->canvas) {
+			job->canvas = obs_canvas_get_ref(obs->data.main_canvas);
 		}
 	}
 
-	source = obs_source_create_set_last_ver(canvas, v_id, name, uuid, settings, hotkeys, prev_ver, is_private);
+	job->create_canvas = job->canvas;
+	job->source = obs_source_create_prepare(&job->create_canvas, v_id, name, uuid, settings, hotkeys,
+						job->is_private, prev_ver);
 
-	if (source->owns_info_id) {
-		bfree((void *)source->info.unversioned_id);
-		source->info.unversioned_id = bstrdup(id);
+	if (job->source && job->source->owns_info_id) {
+		bfree((void *)job->source->info.unversioned_id);
+		job->source->info.unversioned_id = bstrdup(id);
 	}
 
-	obs_canvas_release(canvas);
 	obs_data_release(hotkeys);
+	obs_data_release(settings);
+}
+
+static void run_source_load_job(struct source_load_job *job)
+{
+	uint64_t start = os_gettime_ns();
+	obs_source_create_context_data(job->source);
+	job->create_time = os_gettime_ns() - start;
+	os_atomic_set_bool(&job->created, true);
+}
 
+static void finish_source_load_job(source_load_jobs_t *jobs, struct source_load_job *job)
+{
+	obs_data_t *source_data = job->source_data;
+	obs_source_t *source = job->source;
+	double volume;
+	double balance;
+	int64_t sync;
+	uint32_t prev_ver;
+	uint32_t caps;
+	uint32_t flags;
+	uint32_t mixers;
+	int di_order;
+	int di_mode;
+	int monitoring_type;
+
+	obs_source_create_finish(source, job->create_canvas);
+	obs_canvas_release(job->canvas);
+	job->canvas = NULL;
+
+	source->load_time_ns = job->create_time;
+	prev_ver = (uint32_t)obs_data_get_int(source_data, "prev_ver");
 	caps = obs_source_get_output_flags(source);
 
 	obs_data_set_default_double(source_data, "volume", 1.0);
@@ -2319,26 +2414,124 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data, bool is_priva
 	if (!source->private_settings)
 		source->private_settings = obs_data_create();
 
-	if (filters) {
-		size_t count = obs_data_array_count(filters);
+	/* filters are finished after their parent, so it always exists */
+	if (job->parent != NO_PARENT) {
+		obs_source_t *parent = jobs->array[job->parent].source;
+		if (parent) {
+			obs_source_filter_add(parent, source);
+			parent->load_time_ns += job->create_time;
+		}
+		obs_source_release(source);
+		job->source = NULL;
+	}
+}
 
-		for (size_t i = 0; i < count; i++) {
-			obs_data_t *filter_data = obs_data_array_item(filters, i);
+struct source_create_pool {
+	source_load_jobs_t *jobs;
+	volatile long next;
+	os_event_t *created_event;
+};
+
+static void *source_create_thread(void *param)
+{
+	struct source_create_pool *pool = param;
+
+	os_set_thread_name("libobs: source create thread");
+
+	for (;;) {
+		size_t idx = (size_t)os_atomic_inc_long(&pool->next) - 1;
+		if (idx >= pool->jobs->num)
+			break;
+
+		struct source_load_job *job = &pool->jobs->array[idx];
+		if (job->threadsafe && job->source) {
+			run_source_load_job(job);
+			os_event_signal(pool->created_event);
+		}
+	}
+
+	return NULL;
+}
 
-			obs_source_t *filter = obs_load_source_type(filter_data, true);
-			if (filter) {
-				obs_source_filter_add(source, filter);
-				obs_source_release(filter);
+/* Creates the sources of every job.  Create callbacks of source types that
+ * are flagged as OBS_SOURCE_THREADSAFE_CREATE run on a pool of worker
+ * threads, so those sources are prepared up front.  Their hotkeys are still
+ * registered in job order, so hotkey IDs don't depend on which types are
+ * thread-safe.  Every other source is prepared, created and finished on the
+ * calling thread in job order, after all sources before it have been
+ * finished, so its create callback sees the same sources as when loading
+ * serially. */
+static void run_source_load_jobs(source_load_jobs_t *jobs, bool parallel)
+{
+	struct source_create_pool pool = {jobs, 0, NULL};
+	pthread_t threads[MAX_SOURCE_CREATE_THREADS];
+	size_t num_threads = 0;
+	size_t num_threadsafe = 0;
+
+	if (parallel) {
+		for (size_t i = 0; i < jobs->num; i++) {
+			struct source_load_job *job = &jobs->array[i];
+
+			job->threadsafe = source_load_job_threadsafe(job);
+			if (job->threadsafe) {
+				prepare_source_load_job(job);
+				num_threadsafe++;
 			}
+		}
+	}
 
-			obs_data_release(filter_data);
+	if (num_threadsafe > 1 && os_event_init(&pool.created_event, OS_EVENT_TYPE_AUTO) == 0) {
+		size_t max_threads = (size_t)os_get_logical_cores();
+		if (max_threads > MAX_SOURCE_CREATE_THREADS)
+			max_threads = MAX_SOURCE_CREATE_THREADS;
+		if (max_threads > num_threadsafe)
+			max_threads = num_threadsafe;
+
+		for (; num_threads < max_threads; num_threads++) {
+			if (pthread_create(&threads[num_threads], NULL, source_create_thread, &pool) != 0)
+				break;
+		}
+	}
+
+	for (size_t i = 0; i < jobs->num; i++) {
+		struct source_load_job *job = &jobs->array[i];
+
+		if (!job->threadsafe)
+			prepare_source_load_job(job);
+		if (job->source)
+			obs_source_create_hotkeys(job->source);
+
+		if (job->source && job->threadsafe && num_threads) {
+			while (!os_atomic_load_bool(&job->created))
+				os_event_wait(pool.created_event);
+		} else if (job->source) {
+			run_source_load_job(job);
 		}
 
-		obs_data_array_release(filters);
+		if (job->source)
+			finish_source_load_job(jobs, job);
+		else
+			obs_canvas_release(job->canvas);
+		obs_data_release(job->source_data);
 	}
 
-	obs_data_release(settings);
+	for (size_t i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	os_event_destroy(pool.created_event);
+}
+
+static obs_source_t *obs_load_source_type(obs_data_t *source_data, bool is_private)
+{
+	source_load_jobs_t jobs;
+	obs_source_t *source;
 
+	da_init(jobs);
+	add_source_load_jobs(&jobs, source_data, NO_PARENT, is_private);
+	run_source_load_jobs(&jobs, false);
+
+	source = jobs.array[0].source;
+	da_free(jobs);
 	return source;
 }
 
@@ -2352,46 +2545,140 @@ obs_source_t *obs_load_private_source(obs_data_t *source_data)
 	return obs_load_source_type(source_data, true);
 }
 
+static void log_slowest_sources(obs_source_t **sources, size_t num)
+{
+	obs_source_t *slowest[SLOWEST_SOURCES_LOGGED] = {0};
+
+	for (size_t i = 0; i < num; i++) {
+		obs_source_t *source = sources[i];
+		if (!source)
+			continue;
+
+		for (size_t j = 0; j < SLOWEST_SOURCES_LOGGED; j++) {
+			if (!slowest[j] || source->load_time_ns > slowest[j]->load_time_ns) {
+				memmove(&slowest[j + 1], &slowest[j],
+					(SLOWEST_SOURCES_LOGGED - j - 1) * sizeof(obs_source_t *));
+				slowest[j] = source;
+				break;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < SLOWEST_SOURCES_LOGGED && slowest[i]; i++) {
+		blog(LOG_INFO, "\t'%s' (%s): %.2f ms", obs_source_get_name(slowest[i]), obs_source_get_id(slowest[i]),
+		     (double)slowest[i]->load_time_ns / 1000000.0);
+	}
+}
+
 void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb, void *private_data)
 {
+	source_load_jobs_t jobs;
+	DARRAY(size_t) roots;
 	DARRAY(obs_source_t *) sources;
+	uint64_t start_time = os_gettime_ns();
+	uint64_t create_time = 0;
 	size_t count;
 	size_t i;
 
+	da_init(jobs);
+	da_init(roots);
 	da_init(sources);
 
 	count = obs_data_array_count(array);
+	da_reserve(roots, count);
 	da_reserve(sources, count);
 
 	for (i = 0; i < count; i++) {
 		obs_data_t *source_data = obs_data_array_item(array, i);
-		obs_source_t *source = obs_load_source(source_data);
+		size_t idx = add_source_load_jobs(&jobs, source_data, NO_PARENT, false);
 
-		da_push_back(sources, &source);
+		da_push_back(roots, &idx);
 
 		obs_data_release(source_data);
 	}
 
+	run_source_load_jobs(&jobs, true);
+
+	for (i = 0; i < jobs.num; i++)
+		create_time += jobs.array[i].create_time;
+	for (i = 0; i < roots.num; i++)
+		da_push_back(sources, &jobs.array[roots.array[i]].source);
+
+	da_free(roots);
+	da_free(jobs);
+
 	/* tell sources that we want to load */
 	for (i = 0; i < sources.num; i++) {
 		obs_source_t *source = sources.array[i];
 		obs_data_t *source_data = obs_data_array_item(array, i);
 		if (source) {
+			uint64_t load_start = os_gettime_ns();
+
 			if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 				obs_transition_load(source, source_data);
 			obs_source_load2(source);
+
+			source->load_time_ns += os_gettime_ns() - load_start;
 			if (cb)
 				cb(private_data, source);
 		}
 		obs_data_release(source_data);
 	}
 
+	if (sources.num) {
+		blog(LOG_INFO, "Loaded %zu sources in %.2f ms (%.2f ms spent in create callbacks), slowest:",
+		     sources.num, (double)(os_gettime_ns() - start_time) / 1000000.0,
+		     (double)create_time / 1000000.0);
+		log_slowest_sources(sources.array, sources.num);
+	}
+
 	for (i = 0; i < sources.num; i++)
 		obs_source_release(sources.array[i]);
 
 	da_free(sources);
 }
 
+void obs_set_lazy_source_loading(bool enable, uint32_t unload_timeout_ms)
+{
+	if (!obs)
+		return;
+
+	os_atomic_set_long(&obs->data.lazy_unload_timeout_ms, (long)unload_timeout_ms);
+	os_atomic_set_bool(&obs->data.lazy_sources, enable);
+}
+
+bool obs_lazy_source_loading_enabled(void)
+{
+	return obs ? os_atomic_load_bool(&obs->data.lazy_sources) : false;
+}
+
+uint64_t obs_get_inactive_source_memory(void (*callback)(void *param, obs_source_t *source, uint64_t bytes),
+					void *param)
+{
+	uint64_t total = 0;
+	obs_source_t *source;
+
+	if (!obs)
+		return 0;
+
+	pthread_mutex_lock(&obs->data.sources_mutex);
+	source = obs->data.sources;
+
+	while (source) {
+		if (!source->showing && !source->active && obs_source_resources_loaded(source)) {
+			uint64_t bytes = obs_source_get_memory_usage(source);
+			total += bytes;
+			if (callback && bytes)
+				callback(param, source, bytes);
+		}
+
+		source = (obs_source_t *)source->context.hh_uuid.next;
+	}
+
+	pthread_mutex_unlock(&obs->data.sources_mutex);
+	return total;
+}
+
 obs_data_t *obs_save_source(obs_source_t *source)
 {
 	obs_data_array_t *filters = obs_data_array_create();
@@ -3025,6 +3312,76 @@ uint32_t obs_get_lagged_frames(void)
 	return obs->video.lagged_frames;
 }
 
+void obs_set_frame_pacing(const struct obs_frame_pacing_info *info)
+{
+	if (!obs || !info)
+		return;
+
+	pthread_mutex_lock(&obs->video.frame_timing_mutex);
+	obs->video.pacing = *info;
+	if (!obs->video.pacing.adaptive_spin)
+		obs->video.spin_margin_ns = 0;
+	pthread_mutex_unlock(&obs->video.frame_timing_mutex);
+
+	/* scheduling changes must be applied from the graphics thread itself */
+	os_atomic_set_bool(&obs->video.pacing_changed, true);
+}
+
+void obs_get_frame_pacing(struct obs_frame_pacing_info *info)
+{
+	if (!obs || !info)
+		return;
+
+	pthread_mutex_lock(&obs->video.frame_timing_mutex);
+	*info = obs->video.pacing;
+	pthread_mutex_unlock(&obs->video.frame_timing_mutex);
+}
+
+void obs_get_frame_timing_stats(struct obs_frame_timing_stats *stats)
+{
+	if (!obs || !stats)
+		return;
+
+	struct obs_core_video *video = &obs->video;
+
+	pthread_mutex_lock(&video->frame_timing_mutex);
+	stats->total_frames = video->total_frames;
+	stats->lagged_frames = video->lagged_frames;
+	stats->render_p50_ns = histogram_percentile(&video->render_time_hist, 50.0);
+	stats->render_p99_ns = histogram_percentile(&video->render_time_hist, 99.0);
+	stats->render_max_ns = video->render_time_hist.count ? video->render_time_hist.max : 0;
+	stats->sleep_overshoot_p50_ns = histogram_percentile(&video->sleep_overshoot_hist, 50.0);
+	stats->sleep_overshoot_p99_ns = histogram_percentile(&video->sleep_overshoot_hist, 99.0);
+	stats->sleep_overshoot_max_ns = video->sleep_overshoot_hist.count ? video->sleep_overshoot_hist.max : 0;
+	stats->spin_margin_ns = video->spin_margin_ns;
+	pthread_mutex_unlock(&video->frame_timing_mutex);
+}
+
+void obs_reset_frame_timing_stats(void)
+{
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->video.frame_timing_mutex);
+	histogram_reset(&obs->video.render_time_hist);
+	histogram_reset(&obs->video.sleep_overshoot_hist);
+	pthread_mutex_unlock(&obs->video.frame_timing_mutex);
+}
+
+void obs_get_texture_pool_stats(struct gs_texture_pool_stats *stats)
+{
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!obs || !obs->video.graphics)
+		return;
+
+	obs_enter_graphics();
+	gs_get_texture_pool_stats(stats);
+	obs_leave_graphics();
+}
+
 struct obs_core_video_mix *get_mix_for_video(video_t *v)
 {
 	struct obs_core_video_mix *result = NULL;
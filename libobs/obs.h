@@ -203,6 +203,102 @@ struct obs_video_info {
 	enum obs_scale_type scale_type; /**< How to scale if scaling */
 };
 
+/**
+ * Graphics thread frame pacing options
+ */
+struct obs_frame_pacing_info {
+	/**
+	 * Wake up early by an adaptively measured margin and spin for the
+	 * remainder of the frame interval to reduce wakeup jitter
+	 */
+	bool adaptive_spin;
+	uint64_t max_spin_ns; /**< Upper bound of the spin margin */
+
+	/** Request real-time scheduling (SCHED_FIFO) for the graphics thread */
+	bool realtime;
+
+	/** Pin the graphics thread to this CPU index, or -1 to not pin */
+	int cpu_affinity;
+};
+
+/**
+ * Graphics thread frame timing statistics
+ */
+struct obs_frame_timing_stats {
+	uint32_t total_frames;
+	uint32_t lagged_frames;
+
+	uint64_t render_p50_ns;
+	uint64_t render_p99_ns;
+	uint64_t render_max_ns;
+
+	/** How late the graphics thread woke up relative to the frame deadline */
+	uint64_t sleep_overshoot_p50_ns;
+	uint64_t sleep_overshoot_p99_ns;
+	uint64_t sleep_overshoot_max_ns;
+
+	uint64_t spin_margin_ns; /**< Current adaptive spin margin */
+};
+
+/**
+ * Encoder load statistics
+ */
+struct obs_encoder_stats {
+	/** CPU threads assigned to the encoder, 0 if it does not use the
+	 * thread budget */
+	uint32_t threads;
+
+	/** Frames submitted to the encoder that have not produced a packet
+	 * yet, and the most there have been since the stats were reset */
+	uint32_t queue_depth;
+	uint32_t max_queue_depth;
+
+	/** Frames waiting for the encoder's own encode thread, for encoders
+	 * with OBS_ENCODER_CAP_ASYNC_ENCODE */
+	uint32_t async_queue_depth;
+
+	/** Time from submitting a frame to receiving its packet */
+	uint64_t encode_latency_ns; /**< Moving average */
+	uint64_t latency_p50_ns;
+	uint64_t latency_p99_ns;
+	uint64_t latency_max_ns;
+
+	/** Time spent inside the encoder's encode callback */
+	uint64_t encode_call_p50_ns;
+	uint64_t encode_call_p99_ns;
+	uint64_t encode_call_max_ns;
+
+	/** Output bitrate in bits per second over the last 1 and 10 seconds */
+	uint64_t bitrate_1s;
+	uint64_t bitrate_10s;
+
+	uint64_t total_packets;
+
+	/** Frames that were not encoded because they were identical to the
+	 * previous one */
+	uint64_t duplicate_frames;
+};
+
+/**
+ * Scene item classification used to derive encoder regions of interest
+ */
+enum obs_roi_item_type {
+	OBS_ROI_ITEM_NONE,
+	OBS_ROI_ITEM_BACKGROUND,
+	OBS_ROI_ITEM_TEXT,
+	OBS_ROI_ITEM_CAMERA,
+};
+
+struct obs_roi_item {
+	enum obs_roi_item_type type;
+
+	/** Bounding box of the item in canvas coordinates */
+	float left;
+	float top;
+	float right;
+	float bottom;
+};
+
 /**
  * Audio initialization structure
  */
@@ -517,6 +613,17 @@ EXPORT const char *obs_get_module_data_path(obs_module_t *module);
 /** Returns the module's sha256 hash */
 EXPORT const char *obs_get_module_hash_sha256(obs_module_t *module);
 
+struct obs_module_load_times {
+	uint64_t open_ns;      /**< opening the binary and looking up exports */
+	uint64_t locale_ns;    /**< obs_module_set_locale */
+	uint64_t load_ns;      /**< obs_module_load */
+	uint64_t post_load_ns; /**< obs_module_post_load */
+	bool concurrent;       /**< opened concurrently with other modules */
+};
+
+/** Gets how long each step of loading the module took */
+EXPORT bool obs_get_module_load_times(obs_module_t *module, struct obs_module_load_times *times);
+
 #ifndef SWIG
 /**
  * Adds a module search path to be used with obs_find_modules.  If the search
@@ -860,6 +967,32 @@ EXPORT uint64_t obs_get_frame_interval_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+EXPORT void obs_set_frame_pacing(const struct obs_frame_pacing_info *info);
+EXPORT void obs_get_frame_pacing(struct obs_frame_pacing_info *info);
+EXPORT void obs_get_frame_timing_stats(struct obs_frame_timing_stats *stats);
+EXPORT void obs_reset_frame_timing_stats(void);
+
+/** Gets statistics of the shared render target pool used by pooled texrenders */
+EXPORT void obs_get_texture_pool_stats(struct gs_texture_pool_stats *stats);
+
+/**
+ * Enables or disables lazy source loading.  When enabled, input sources that
+ * implement load_resources only allocate their resources once they are
+ * shown or activated, and free them again after they have been neither
+ * showing nor active for unload_timeout_ms (0 to never unload).
+ */
+EXPORT void obs_set_lazy_source_loading(bool enable, uint32_t unload_timeout_ms);
+EXPORT bool obs_lazy_source_loading_enabled(void);
+
+/**
+ * Calls the callback for every source that holds resources while neither
+ * showing nor active, with the memory the source reports as used.  Returns
+ * the total of those sources.  The callback is called with the sources mutex
+ * locked and must not create or release sources.
+ */
+EXPORT uint64_t obs_get_inactive_source_memory(void (*callback)(void *param, obs_source_t *source, uint64_t bytes),
+					       void *param);
+
 OBS_DEPRECATED EXPORT bool obs_nv12_tex_active(void);
 OBS_DEPRECATED EXPORT bool obs_p010_tex_active(void);
 
@@ -1492,6 +1625,17 @@ EXPORT bool obs_source_audio_active(const obs_source_t *source);
 
 EXPORT uint32_t obs_source_get_last_obs_version(const obs_source_t *source);
 
+/** Returns the time spent creating and loading the source (including its
+ * filters) when it was loaded from saved data */
+EXPORT uint64_t obs_source_get_load_time_ns(const obs_source_t *source);
+
+/** Returns whether the resources of the source are currently loaded, always
+ * true if the source doesn't implement load_resources */
+EXPORT bool obs_source_resources_loaded(const obs_source_t *source);
+
+/** Returns the memory held by the source in bytes, if the source reports it */
+EXPORT uint64_t obs_source_get_memory_usage(const obs_source_t *source);
+
 /** Media controls */
 EXPORT void obs_source_media_play_pause(obs_source_t *source, bool pause);
 EXPORT void obs_source_media_restart(obs_source_t *source);
@@ -2246,6 +2390,25 @@ EXPORT void obs_encoder_enum_roi(obs_encoder_t *encoder, void (*enum_proc)(void
 				 void *param);
 /** Get ROI increment, encoders must rebuild their ROI map if it has changed */
 EXPORT uint32_t obs_encoder_get_roi_increment(const obs_encoder_t *encoder);
+/**
+ * Derives the encoder's regions of interest from a scene every frame: camera
+ * and text items are prioritized, static backgrounds covering most of the
+ * canvas are deprioritized.  Replaces any manually added regions.
+ *
+ * Pass NULL to stop.  Returns false if the encoder does not support ROI.
+ */
+EXPORT bool obs_encoder_set_roi_scene(obs_encoder_t *encoder, obs_scene_t *scene);
+/**
+ * Builds a region of interest map from scene item bounding boxes given in
+ * canvas coordinates, ordered topmost item first.  The regions are scaled to
+ * the video output size and written in order of precedence.
+ *
+ * roi must have room for num_items entries.  Returns the number of regions
+ * written.
+ */
+EXPORT size_t obs_roi_from_scene_items(struct obs_encoder_roi *roi, const struct obs_roi_item *items,
+				       size_t num_items, uint32_t canvas_width, uint32_t canvas_height,
+				       uint32_t width, uint32_t height);
 
 /** For video encoders, returns true if pre-encode scaling is enabled */
 EXPORT bool obs_encoder_scaling_enabled(const obs_encoder_t *encoder);
@@ -2268,6 +2431,29 @@ EXPORT uint32_t obs_encoder_get_frame_rate_divisor(const obs_encoder_t *encoder)
 /** For video encoders, returns the number of frames encoded */
 EXPORT uint32_t obs_encoder_get_encoded_frames(const obs_encoder_t *encoder);
 
+/**
+ * Returns the number of CPU threads a video encoder with
+ * OBS_ENCODER_CAP_THREAD_BUDGET should use, or 0 to use its own default.  The
+ * budget is rebalanced whenever such an encoder starts or stops; encoders
+ * read it when they are created.
+ */
+EXPORT uint32_t obs_encoder_get_thread_budget(const obs_encoder_t *encoder);
+
+/** Gets encoder load statistics, returns false if the encoder is invalid */
+EXPORT bool obs_encoder_get_stats(const obs_encoder_t *encoder, struct obs_encoder_stats *stats);
+
+/** Resets the encoder's latency histograms, peak queue depth and packet count */
+EXPORT void obs_encoder_reset_stats(obs_encoder_t *encoder);
+
+/**
+ * Sets the total number of CPU threads shared by video encoders with
+ * OBS_ENCODER_CAP_THREAD_BUDGET.  0 (the default) only splits the cores
+ * not needed by the graphics, video and audio threads once several such
+ * encoders are active, and leaves a single one at its own default.
+ */
+EXPORT void obs_set_encoder_thread_budget(uint32_t threads);
+EXPORT uint32_t obs_get_encoder_thread_budget(void);
+
 /** For audio encoders, returns the sample rate of the audio */
 EXPORT uint32_t obs_encoder_get_sample_rate(const obs_encoder_t *encoder);
 
@@ -2393,6 +2579,13 @@ EXPORT bool obs_encoder_set_group(obs_encoder_t *encoder, obs_encoder_group_t *g
 EXPORT obs_encoder_group_t *obs_encoder_group_create();
 EXPORT void obs_encoder_group_destroy(obs_encoder_group_t *group);
 
+/** Gets the encoder group the encoder belongs to, or NULL if none */
+EXPORT obs_encoder_group_t *obs_encoder_get_group(const obs_encoder_t *encoder);
+
+/** Enumerates the encoders in an encoder group */
+EXPORT void obs_encoder_group_enum_encoders(obs_encoder_group_t *group,
+					    bool (*enum_proc)(void *param, obs_encoder_t *encoder), void *param);
+
 /* ------------------------------------------------------------------------- */
 /* Stream Services */
 
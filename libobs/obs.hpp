@@ -21,6 +21,8 @@
 
 #include "obs.h"
 
+#include <type_traits>
+
 /* RAII wrappers */
 
 template<typename T, void release(T)> class OBSRefAutoRelease;
@@ -340,3 +342,50 @@ public:
 		return *this;
 	}
 };
+
+/* reads a parameter of calldata received by a signal handler */
+template<typename T> inline T OBSSignatureGet(calldata_t *cd, calldata_signature &sig, size_t idx)
+{
+	if constexpr (std::is_same_v<T, bool>)
+		return calldata_sig_bool(cd, &sig, idx);
+	else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+		return (T)calldata_sig_int(cd, &sig, idx);
+	else if constexpr (std::is_floating_point_v<T>)
+		return (T)calldata_sig_float(cd, &sig, idx);
+	else
+		return (T)calldata_sig_ptr(cd, &sig, idx);
+}
+
+/* calldata initialized from a signature, see calldata_init_signature */
+class OBSSignatureData {
+	calldata_t cd;
+	calldata_signature *sig;
+	uint8_t stack[CALLDATA_SIGNATURE_STACK_SIZE];
+
+public:
+	template<typename... Args> inline OBSSignatureData(calldata_signature &sig_, Args... args) : sig(&sig_)
+	{
+		size_t idx = 0;
+		calldata_init_signature(&cd, sig, stack, sizeof(stack));
+		(Set(idx++, args), ...);
+	}
+
+	template<typename T> inline void Set(size_t idx, T val)
+	{
+		if constexpr (std::is_same_v<T, bool>)
+			calldata_sig_set_bool(&cd, sig, idx, val);
+		else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+			calldata_sig_set_int(&cd, sig, idx, (long long)val);
+		else if constexpr (std::is_floating_point_v<T>)
+			calldata_sig_set_float(&cd, sig, idx, (double)val);
+		else
+			calldata_sig_set_ptr(&cd, sig, idx, (void *)val);
+	}
+
+	template<typename T> inline T Get(size_t idx) { return OBSSignatureGet<T>(&cd, *sig, idx); }
+
+	inline operator calldata_t *() { return &cd; }
+
+	OBSSignatureData(const OBSSignatureData &) = delete;
+	OBSSignatureData &operator=(const OBSSignatureData &) = delete;
+};
@@ -0,0 +1,473 @@
+#include "file-watch.h"
+#include "platform.h"
+#include "threading.h"
+#include "darray.h"
+#include "bmem.h"
+#include "base.h"
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define INOTIFY_MASK (IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM)
+#endif
+
+#define WATCH_INTERVAL_MS 250
+#define POLL_INTERVAL_NS 1000000000ULL
+
+/* Changes are reported once a file has been left alone for DEBOUNCE_MS, so
+ * that files are not read back while they are still being written.  Files
+ * that keep changing are still reported every DEBOUNCE_MAX_NS. */
+#define DEBOUNCE_MS 100
+#define DEBOUNCE_NS (DEBOUNCE_MS * 1000000ULL)
+#define DEBOUNCE_MAX_NS 1000000000ULL
+
+struct os_file_watch {
+	char *path;
+	char *dir;
+	const char *name;
+
+	os_file_watch_cb_t callback;
+	void *param;
+
+	int wd;
+
+	/* time of the first and last change not reported yet, 0 if none */
+	uint64_t first_change;
+	uint64_t last_change;
+
+	/* polling fallback */
+	int64_t mtime;
+	int64_t size;
+};
+
+/* lifecycle_mutex serializes starting and stopping the thread and is never
+ * taken by the thread itself, watch_mutex protects the watch list */
+static pthread_mutex_t lifecycle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t watch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct os_file_watch *) watches;
+static pthread_t watch_thread;
+static bool watch_thread_active = false;
+static os_event_t *watch_stop_event = NULL;
+#ifdef __linux__
+static int inotify_fd = -1;
+#endif
+
+static void get_file_state(const char *path, int64_t *mtime, int64_t *size)
+{
+	struct stat st;
+
+	if (os_stat(path, &st) != 0) {
+		*mtime = -1;
+		*size = -1;
+		return;
+	}
+
+	*mtime = (int64_t)st.st_mtime;
+	*size = (int64_t)st.st_size;
+}
+
+static void mark_changed(struct os_file_watch *watch, uint64_t now)
+{
+	if (!watch->first_change)
+		watch->first_change = now;
+	watch->last_change = now;
+}
+
+/* returns true if changes are left to report */
+static bool report_changes(uint64_t now)
+{
+	bool pending = false;
+
+	for (size_t i = 0; i < watches.num; i++) {
+		struct os_file_watch *watch = watches.array[i];
+
+		if (!watch->first_change)
+			continue;
+
+		if (now - watch->last_change < DEBOUNCE_NS && now - watch->first_change < DEBOUNCE_MAX_NS) {
+			pending = true;
+			continue;
+		}
+
+		watch->first_change = 0;
+		watch->last_change = 0;
+		watch->callback(watch->param, watch->path);
+	}
+
+	return pending;
+}
+
+static void poll_watches(uint64_t now)
+{
+	for (size_t i = 0; i < watches.num; i++) {
+		struct os_file_watch *watch = watches.array[i];
+		int64_t mtime, size;
+
+		if (watch->wd >= 0)
+			continue;
+
+		get_file_state(watch->path, &mtime, &size);
+		if (mtime == watch->mtime && size == watch->size)
+			continue;
+
+		watch->mtime = mtime;
+		watch->size = size;
+		mark_changed(watch, now);
+	}
+}
+
+#ifdef __linux__
+static void mark_all_inotify_watches(uint64_t now)
+{
+	for (size_t i = 0; i < watches.num; i++) {
+		struct os_file_watch *watch = watches.array[i];
+		if (watch->wd >= 0)
+			mark_changed(watch, now);
+	}
+}
+
+static void dispatch_inotify_event(const struct inotify_event *event, uint64_t now)
+{
+	if (event->mask & IN_Q_OVERFLOW) {
+		mark_all_inotify_watches(now);
+		return;
+	}
+	if (!event->len)
+		return;
+
+	for (size_t i = 0; i < watches.num; i++) {
+		struct os_file_watch *watch = watches.array[i];
+		if (watch->wd == event->wd && strcmp(watch->name, event->name) == 0)
+			mark_changed(watch, now);
+	}
+}
+
+/* the descriptor stays open while the thread runs, it is only closed
+ * after the thread was joined */
+static void read_inotify_events(int fd, int timeout_ms)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct pollfd pfd = {fd, POLLIN, 0};
+
+	if (poll(&pfd, 1, timeout_ms) <= 0)
+		return;
+
+	uint64_t now = os_gettime_ns();
+	pthread_mutex_lock(&watch_mutex);
+
+	for (;;) {
+		ssize_t len = read(fd, buf, sizeof(buf));
+		if (len <= 0)
+			break;
+
+		for (char *ptr = buf; ptr < buf + len;) {
+			const struct inotify_event *event = (const struct inotify_event *)ptr;
+			dispatch_inotify_event(event, now);
+			ptr += sizeof(struct inotify_event) + event->len;
+		}
+	}
+
+	pthread_mutex_unlock(&watch_mutex);
+}
+
+static void add_inotify_watch(struct os_file_watch *watch)
+{
+	watch->wd = -1;
+
+	if (inotify_fd == -1)
+		inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd == -1 || !*watch->dir)
+		return;
+
+	watch->wd = inotify_add_watch(inotify_fd, watch->dir, INOTIFY_MASK);
+	if (watch->wd == -1)
+		blog(LOG_DEBUG, "os_file_watch: inotify_add_watch failed for '%s' (%d), polling instead", watch->dir,
+		     errno);
+}
+
+static void remove_inotify_watch(struct os_file_watch *watch)
+{
+	if (watch->wd == -1)
+		return;
+
+	/* directory watches are shared by every file in that directory */
+	for (size_t i = 0; i < watches.num; i++) {
+		if (watches.array[i]->wd == watch->wd)
+			return;
+	}
+
+	inotify_rm_watch(inotify_fd, watch->wd);
+}
+
+static void close_inotify(void)
+{
+	if (inotify_fd != -1) {
+		close(inotify_fd);
+		inotify_fd = -1;
+	}
+}
+#endif
+
+static void *file_watch_thread(void *unused)
+{
+	uint64_t last_poll = 0;
+	bool pending = false;
+
+	os_set_thread_name("libobs: file watch thread");
+
+	for (;;) {
+		int timeout_ms = pending ? DEBOUNCE_MS : WATCH_INTERVAL_MS;
+
+#ifdef __linux__
+		pthread_mutex_lock(&watch_mutex);
+		int fd = inotify_fd;
+		pthread_mutex_unlock(&watch_mutex);
+
+		if (fd != -1) {
+			read_inotify_events(fd, timeout_ms);
+			if (os_event_try(watch_stop_event) != EAGAIN)
+				break;
+		} else if (os_event_timedwait(watch_stop_event, timeout_ms) != ETIMEDOUT) {
+			break;
+		}
+#else
+		if (os_event_timedwait(watch_stop_event, timeout_ms) != ETIMEDOUT)
+			break;
+#endif
+
+		uint64_t now = os_gettime_ns();
+
+		pthread_mutex_lock(&watch_mutex);
+		if (now - last_poll >= POLL_INTERVAL_NS) {
+			poll_watches(now);
+			last_poll = now;
+		}
+		pending = report_changes(now);
+		pthread_mutex_unlock(&watch_mutex);
+	}
+
+	UNUSED_PARAMETER(unused);
+	return NULL;
+}
+
+static bool start_watch_thread(void)
+{
+	if (watch_thread_active)
+		return true;
+
+	if (os_event_init(&watch_stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		return false;
+
+	if (pthread_create(&watch_thread, NULL, file_watch_thread, NULL) != 0) {
+		os_event_destroy(watch_stop_event);
+		watch_stop_event = NULL;
+		return false;
+	}
+
+	watch_thread_active = true;
+	return true;
+}
+
+static void split_path(struct os_file_watch *watch)
+{
+	const char *slash = strrchr(watch->path, '/');
+#ifdef _WIN32
+	const char *backslash = strrchr(watch->path, '\\');
+	if (backslash > slash)
+		slash = backslash;
+#endif
+
+	if (!slash) {
+		watch->dir = bstrdup(".");
+		watch->name = watch->path;
+		return;
+	}
+
+	watch->dir = bstrdup_n(watch->path, slash == watch->path ? 1 : (size_t)(slash - watch->path));
+	watch->name = slash + 1;
+}
+
+os_file_watch_t *os_file_watch_add(const char *path, os_file_watch_cb_t callback, void *param)
+{
+	struct os_file_watch *watch;
+
+	if (!path || !*path || !callback)
+		return NULL;
+
+	watch = bzalloc(sizeof(struct os_file_watch));
+	watch->path = bstrdup(path);
+	watch->callback = callback;
+	watch->param = param;
+	watch->wd = -1;
+	split_path(watch);
+	get_file_state(watch->path, &watch->mtime, &watch->size);
+
+	pthread_mutex_lock(&lifecycle_mutex);
+	pthread_mutex_lock(&watch_mutex);
+
+#ifdef __linux__
+	add_inotify_watch(watch);
+#endif
+	da_push_back(watches, &watch);
+
+	pthread_mutex_unlock(&watch_mutex);
+
+	if (!start_watch_thread()) {
+		blog(LOG_WARNING, "os_file_watch_add: Failed to start file watch thread");
+		pthread_mutex_unlock(&lifecycle_mutex);
+		os_file_watch_remove(watch);
+		return NULL;
+	}
+
+	pthread_mutex_unlock(&lifecycle_mutex);
+	return watch;
+}
+
+void os_file_watch_remove(os_file_watch_t *watch)
+{
+	bool stop_thread;
+
+	if (!watch)
+		return;
+
+	pthread_mutex_lock(&lifecycle_mutex);
+
+	pthread_mutex_lock(&watch_mutex);
+	da_erase_item(watches, &watch);
+#ifdef __linux__
+	remove_inotify_watch(watch);
+#endif
+	stop_thread = watches.num == 0;
+	pthread_mutex_unlock(&watch_mutex);
+
+	if (stop_thread) {
+		if (watch_thread_active) {
+			os_event_signal(watch_stop_event);
+			pthread_join(watch_thread, NULL);
+			os_event_destroy(watch_stop_event);
+			watch_stop_event = NULL;
+			watch_thread_active = false;
+		}
+
+		da_free(watches);
+#ifdef __linux__
+		close_inotify();
+#endif
+	}
+
+	pthread_mutex_unlock(&lifecycle_mutex);
+
+	bfree(watch->dir);
+	bfree(watch->path);
+	bfree(watch);
+}
+
+static uint64_t get_file_id(const char *path)
+{
+	struct stat st;
+	return os_stat(path, &st) == 0 ? (uint64_t)st.st_ino : 0;
+}
+
+/* keeps the last bytes before the offset, to tell appended files from
+ * files that were rewritten */
+static void update_check_bytes(struct os_appended_file *state, const uint8_t *data, size_t size)
+{
+	const size_t max_size = sizeof(state->check);
+
+	if (size >= max_size) {
+		memcpy(state->check, data + size - max_size, max_size);
+		state->check_size = max_size;
+		return;
+	}
+
+	size_t keep = state->check_size + size > max_size ? max_size - size : state->check_size;
+	memmove(state->check, state->check + state->check_size - keep, keep);
+	memcpy(state->check + keep, data, size);
+	state->check_size = keep + size;
+}
+
+static bool check_bytes_match(FILE *file, const struct os_appended_file *state)
+{
+	uint8_t check[sizeof(state->check)];
+
+	if (!state->check_size)
+		return true;
+	if (os_fseeki64(file, state->offset - (int64_t)state->check_size, SEEK_SET) != 0)
+		return false;
+
+	return fread(check, 1, state->check_size, file) == state->check_size &&
+	       memcmp(check, state->check, state->check_size) == 0;
+}
+
+bool os_file_appended_init(struct os_appended_file *state, const char *path, int64_t offset)
+{
+	FILE *file;
+	bool success = false;
+
+	memset(state, 0, sizeof(*state));
+	state->id = get_file_id(path);
+
+	file = os_fopen(path, "rb");
+	if (!file)
+		return false;
+
+	size_t check_size = offset < (int64_t)sizeof(state->check) ? (size_t)offset : sizeof(state->check);
+	if (os_fseeki64(file, offset - (int64_t)check_size, SEEK_SET) == 0 &&
+	    fread(state->check, 1, check_size, file) == check_size) {
+		state->offset = offset;
+		state->check_size = check_size;
+		success = true;
+	}
+
+	fclose(file);
+	return success;
+}
+
+char *os_file_read_appended(const char *path, struct os_appended_file *state, size_t *size, bool *reset)
+{
+	FILE *file;
+	int64_t file_size;
+	uint64_t id;
+	char *data = NULL;
+
+	*reset = false;
+	*size = 0;
+
+	id = get_file_id(path);
+	file = os_fopen(path, "rb");
+	if (!file)
+		return NULL;
+
+	file_size = os_fgetsize(file);
+	if (file_size < 0)
+		goto exit;
+
+	if (state->offset && (file_size < state->offset || id != state->id || !check_bytes_match(file, state))) {
+		state->offset = 0;
+		state->check_size = 0;
+		*reset = true;
+	}
+	state->id = id;
+	if (file_size == state->offset)
+		goto exit;
+
+	if (os_fseeki64(file, state->offset, SEEK_SET) != 0)
+		goto exit;
+
+	size_t len = (size_t)(file_size - state->offset);
+	data = bmalloc(len + 1);
+	len = fread(data, 1, len, file);
+	data[len] = 0;
+
+	update_check_bytes(state, (const uint8_t *)data, len);
+	state->offset += (int64_t)len;
+	*size = len;
+
+exit:
+	fclose(file);
+	return data;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Shared file watch service.  All watches are serviced by a single thread,
+ * which uses inotify on Linux (watching the parent directory, so files that
+ * are replaced by rename are still picked up) and falls back to polling the
+ * modification time and size of the file elsewhere, or when inotify is not
+ * available.
+ *
+ * Changes are reported once a file was left alone for a short while, and at
+ * least once a second for files that keep changing, so that files are not
+ * read back while they are still being written.
+ *
+ * The callback is called from the watch thread.  It must not add or remove
+ * watches; once os_file_watch_remove returns the callback will not be
+ * called again.
+ */
+
+struct os_file_watch;
+typedef struct os_file_watch os_file_watch_t;
+
+typedef void (*os_file_watch_cb_t)(void *param, const char *path);
+
+EXPORT os_file_watch_t *os_file_watch_add(const char *path, os_file_watch_cb_t callback, void *param);
+EXPORT void os_file_watch_remove(os_file_watch_t *watch);
+
+/* Position of an incremental reader in a file that is appended to */
+struct os_appended_file {
+	int64_t offset;
+
+	/* identity of the file and the bytes just before offset, to detect
+	 * files that were rewritten or replaced rather than appended to */
+	uint64_t id;
+	uint8_t check[128];
+	size_t check_size;
+};
+
+/*
+ * Sets up state for reading what is appended to a file after offset, for
+ * example after the file was read up to offset by other means.
+ */
+EXPORT bool os_file_appended_init(struct os_appended_file *state, const char *path, int64_t offset);
+
+/*
+ * Reads the data that was appended to a file since the last read into a
+ * newly allocated, null-terminated buffer and advances state past it.  If
+ * the file was truncated, replaced or rewritten since, it is read from the
+ * start and *reset is set to true.  Returns NULL if there was nothing new to
+ * read or on error.
+ */
+EXPORT char *os_file_read_appended(const char *path, struct os_appended_file *state, size_t *size, bool *reset);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed-size log-linear histogram for latency style values (nanoseconds,
+ * bytes, etc).  Each power of two is split into HISTOGRAM_SUB_BUCKETS linear
+ * sub-buckets, so percentile queries are accurate to within ~6% while
+ * recording stays O(1) and allocation-free.
+ */
+
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+struct histogram {
+	uint32_t buckets[HISTOGRAM_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+};
+
+static inline void histogram_init(struct histogram *h)
+{
+	memset(h, 0, sizeof(struct histogram));
+	h->min = UINT64_MAX;
+}
+
+static inline void histogram_reset(struct histogram *h)
+{
+	histogram_init(h);
+}
+
+static inline int histogram_log2(uint64_t val)
+{
+	int bit = 0;
+	while (val >>= 1)
+		bit++;
+	return bit;
+}
+
+static inline size_t histogram_bucket_idx(uint64_t val)
+{
+	if (val < HISTOGRAM_SUB_BUCKETS)
+		return (size_t)val;
+
+	int shift = histogram_log2(val) - HISTOGRAM_SUB_BITS;
+	size_t sub = (size_t)(val >> shift) & (HISTOGRAM_SUB_BUCKETS - 1);
+	return (size_t)(shift + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+/* returns the largest value that maps to the given bucket */
+static inline uint64_t histogram_bucket_value(size_t idx)
+{
+	if (idx < HISTOGRAM_SUB_BUCKETS)
+		return (uint64_t)idx;
+
+	int shift = (int)(idx / HISTOGRAM_SUB_BUCKETS) - 1;
+	uint64_t sub = (uint64_t)(idx % HISTOGRAM_SUB_BUCKETS) | HISTOGRAM_SUB_BUCKETS;
+	return ((sub + 1) << shift) - 1;
+}
+
+static inline void histogram_record(struct histogram *h, uint64_t val)
+{
+	size_t idx = histogram_bucket_idx(val);
+	if (h->buckets[idx] != UINT32_MAX)
+		h->buckets[idx]++;
+
+	h->count++;
+	h->sum += val;
+	if (val < h->min)
+		h->min = val;
+	if (val > h->max)
+		h->max = val;
+}
+
+static inline void histogram_merge(struct histogram *dst, const struct histogram *src)
+{
+	for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		uint64_t total = (uint64_t)dst->buckets[i] + src->buckets[i];
+		dst->buckets[i] = total > UINT32_MAX ? UINT32_MAX : (uint32_t)total;
+	}
+
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/* pct is in the range [0.0, 100.0] */
+static inline uint64_t histogram_percentile(const struct histogram *h, double pct)
+{
+	if (!h->count)
+		return 0;
+	if (pct <= 0.0)
+		return h->min;
+	if (pct >= 100.0)
+		return h->max;
+
+	uint64_t target = (uint64_t)((double)h->count * pct / 100.0 + 0.5);
+	uint64_t seen = 0;
+	if (!target)
+		target = 1;
+
+	for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= target) {
+			uint64_t val = histogram_bucket_value(i);
+			return val > h->max ? h->max : val;
+		}
+	}
+
+	return h->max;
+}
+
+static inline uint64_t histogram_mean(const struct histogram *h)
+{
+	return h->count ? h->sum / h->count : 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -27,6 +27,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -225,6 +227,18 @@ bool os_sleepto_ns(uint64_t time_target)
 	if (time_target < current)
 		return false;
 
+#if defined(__linux__) || defined(__FreeBSD__)
+	/* os_gettime_ns uses CLOCK_MONOTONIC, so sleep on an absolute deadline
+	 * of the same clock instead of accumulating relative sleep drift */
+	struct timespec deadline;
+	deadline.tv_sec = (time_t)(time_target / 1000000000);
+	deadline.tv_nsec = (long)(time_target % 1000000000);
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+		;
+
+	return true;
+#else
 	time_target -= current;
 
 	struct timespec req, remain;
@@ -239,6 +253,7 @@ bool os_sleepto_ns(uint64_t time_target)
 	}
 
 	return true;
+#endif
 }
 
 bool os_sleepto_ns_fast(uint64_t time_target)
@@ -263,6 +278,39 @@ void os_sleep_ms(uint32_t duration)
 	usleep(duration * 1000);
 }
 
+bool os_set_thread_realtime(bool realtime)
+{
+	int policy = realtime ? SCHED_FIFO : SCHED_OTHER;
+	struct sched_param param;
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = sched_get_priority_min(policy);
+
+	return pthread_setschedparam(pthread_self(), policy, &param) == 0;
+}
+
+bool os_set_thread_affinity(int cpu)
+{
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	if (cpu < 0) {
+		long count = sysconf(_SC_NPROCESSORS_CONF);
+		for (long i = 0; i < count && i < CPU_SETSIZE; i++)
+			CPU_SET(i, &set);
+	} else {
+		if (cpu >= CPU_SETSIZE)
+			return false;
+		CPU_SET(cpu, &set);
+	}
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	UNUSED_PARAMETER(cpu);
+	return false;
+#endif
+}
+
 #if !defined(__APPLE__)
 
 uint64_t os_gettime_ns(void)
@@ -553,6 +601,39 @@ int64_t os_get_free_space(const char *path)
 }
 #endif
 
+const void *os_map_file(const char *path, size_t *size)
+{
+	struct stat st;
+	void *data;
+	int fd;
+
+	*size = 0;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	*size = (size_t)st.st_size;
+	return data;
+}
+
+void os_unmap_file(const void *data, size_t size)
+{
+	if (data)
+		munmap((void *)data, size);
+}
+
 struct posix_glob_info {
 	struct os_glob_info base;
 	glob_t gl;
@@ -63,6 +63,8 @@ static inline uint32_t get_winver(void)
 	return winver;
 }
 
+static SRWLOCK dlopen_lock = SRWLOCK_INIT;
+
 void *os_dlopen(const char *path)
 {
 	struct dstr dll_name;
@@ -83,7 +85,11 @@ void *os_dlopen(const char *path)
 
 	/* to make module dependency issues easier to deal with, allow
 	 * dynamically loaded libraries on windows to search for dependent
-	 * libraries that are within the library's own directory */
+	 * libraries that are within the library's own directory.  The DLL
+	 * directory is process-wide, so modules loaded from several threads
+	 * take turns. */
+	AcquireSRWLockExclusive(&dlopen_lock);
+
 	wpath_slash = wcsrchr(wpath, L'/');
 	if (wpath_slash) {
 		*wpath_slash = 0;
@@ -98,6 +104,8 @@ void *os_dlopen(const char *path)
 	if (wpath_slash)
 		SetDllDirectoryW(NULL);
 
+	ReleaseSRWLockExclusive(&dlopen_lock);
+
 	if (!h_library) {
 		DWORD error = GetLastError();
 
@@ -443,6 +451,33 @@ bool os_sleepto_ns_fast(uint64_t time_target)
 	return true;
 }
 
+bool os_set_thread_realtime(bool realtime)
+{
+	int priority = realtime ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL;
+	return !!SetThreadPriority(GetCurrentThread(), priority);
+}
+
+bool os_set_thread_affinity(int cpu)
+{
+	DWORD_PTR process_mask, system_mask;
+	DWORD_PTR mask;
+
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+		return false;
+
+	if (cpu < 0) {
+		mask = process_mask;
+	} else {
+		if (cpu >= (int)(sizeof(DWORD_PTR) * 8))
+			return false;
+		mask = (DWORD_PTR)1 << cpu;
+		if (!(mask & process_mask))
+			return false;
+	}
+
+	return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
 void os_sleep_ms(uint32_t duration)
 {
 	/* windows 8+ appears to have decreased sleep precision */
@@ -673,6 +708,51 @@ int64_t os_get_free_space(const char *path)
 	return -1;
 }
 
+const void *os_map_file(const char *path, size_t *size)
+{
+	wchar_t *wpath = NULL;
+	HANDLE file, mapping;
+	LARGE_INTEGER file_size;
+	void *data = NULL;
+
+	*size = 0;
+
+	if (!os_utf8_to_wcs_ptr(path, 0, &wpath))
+		return NULL;
+
+	file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	bfree(wpath);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0) {
+		CloseHandle(file);
+		return NULL;
+	}
+
+	mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+
+	if (!mapping)
+		return NULL;
+
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+
+	if (data)
+		*size = (size_t)file_size.QuadPart;
+	return data;
+}
+
+void os_unmap_file(const void *data, size_t size)
+{
+	if (data)
+		UnmapViewOfFile(data);
+
+	UNUSED_PARAMETER(size);
+}
+
 static void make_globent(struct os_globent *ent, WIN32_FIND_DATA *wfd, const char *pattern)
 {
 	struct dstr name = {0};
@@ -603,7 +603,8 @@ int os_dtostr(double value, char *dst, size_t size)
 			end++;
 
 		if (end != start) {
-			memmove(start, end, length - (size_t)(end - dst));
+			/* include the null terminator */
+			memmove(start, end, length + 1 - (size_t)(end - dst));
 			length -= (size_t)(end - start);
 		}
 	}
@@ -57,6 +57,11 @@ EXPORT bool os_quick_write_mbs_file(const char *path, const char *str, size_t le
 EXPORT int64_t os_get_file_size(const char *path);
 EXPORT int64_t os_get_free_space(const char *path);
 
+/* Maps a file into memory for reading.  Returns NULL if the file could not be
+ * opened or is empty.  Release with os_unmap_file. */
+EXPORT const void *os_map_file(const char *path, size_t *size);
+EXPORT void os_unmap_file(const void *data, size_t size);
+
 EXPORT size_t os_mbs_to_wcs(const char *str, size_t str_len, wchar_t *dst, size_t dst_size);
 EXPORT size_t os_utf8_to_wcs(const char *str, size_t len, wchar_t *dst, size_t dst_size);
 EXPORT size_t os_wcs_to_mbs(const wchar_t *str, size_t len, char *dst, size_t dst_size);
@@ -98,6 +103,20 @@ EXPORT bool os_sleepto_ns(uint64_t time_target);
 EXPORT bool os_sleepto_ns_fast(uint64_t time_target);
 EXPORT void os_sleep_ms(uint32_t duration);
 
+/**
+ * Requests real-time (SCHED_FIFO or platform equivalent) scheduling for the
+ * calling thread, or returns it to normal scheduling if realtime is false.
+ * Returns false if the request was denied, for example due to missing
+ * privileges.
+ */
+EXPORT bool os_set_thread_realtime(bool realtime);
+
+/**
+ * Pins the calling thread to the given CPU index, or allows it to run on all
+ * CPUs again if cpu is negative.  Returns false if unsupported or denied.
+ */
+EXPORT bool os_set_thread_affinity(int cpu);
+
 EXPORT uint64_t os_gettime_ns(void);
 
 EXPORT int os_get_config_path(char *dst, size_t size, const char *name);
@@ -10,8 +10,6 @@
 
 #include <zlib.h>
 
-//#define TRACK_OVERHEAD
-
 struct profiler_snapshot {
 	DARRAY(profiler_snapshot_entry_t) roots;
 };
@@ -35,14 +33,8 @@ typedef struct profiler_time_entry profiler_time_entry;
 typedef struct profile_call profile_call;
 struct profile_call {
 	const char *name;
-#ifdef TRACK_OVERHEAD
-	uint64_t overhead_start;
-#endif
 	uint64_t start_time;
 	uint64_t end_time;
-#ifdef TRACK_OVERHEAD
-	uint64_t overhead_end;
-#endif
 	uint64_t expected_time_between_calls;
 	DARRAY(profile_call) children;
 	profile_call *parent;
@@ -70,9 +62,6 @@ typedef struct profile_entry profile_entry;
 struct profile_entry {
 	const char *name;
 	profile_times_table times;
-#ifdef TRACK_OVERHEAD
-	profile_times_table overhead;
-#endif
 	uint64_t expected_time_between_calls;
 	profile_times_table times_between_calls;
 	DARRAY(profile_entry) children;
@@ -202,9 +191,6 @@ static profile_entry *init_entry(profile_entry *entry, const char *name)
 {
 	entry->name = name;
 	init_hashmap(&entry->times, 1);
-#ifdef TRACK_OVERHEAD
-	init_hashmap(&entry->overhead, 1);
-#endif
 	entry->expected_time_between_calls = 0;
 	init_hashmap(&entry->times_between_calls, 1);
 	return entry;
@@ -239,33 +225,123 @@ static void merge_call(profile_entry *entry, profile_call *call, profile_call *p
 	migrate_old_entries(&entry->times, true);
 	uint64_t usec = diff_ns_to_usec(call->start_time, call->end_time);
 	add_hashmap_entry(&entry->times, usec, 1);
-
-#ifdef TRACK_OVERHEAD
-	migrate_old_entries(&entry->overhead, true);
-	usec = diff_ns_to_usec(call->overhead_start, call->start_time);
-	usec += diff_ns_to_usec(call->end_time, call->overhead_end);
-	add_hashmap_entry(&entry->overhead, usec, 1);
-#endif
 }
 
-static bool enabled = false;
+/* ------------------------------------------------------------------------- */
+/* Event recording
+ *
+ * profile_start/profile_end only append timestamped events to a ring buffer
+ * owned by the calling thread, which is read without locks by the aggregate
+ * thread.  That thread rebuilds the call trees, merges them into the root
+ * entries and, while trace capture is enabled, keeps the most recent calls of
+ * every running thread for trace export. */
+
+#define PROFILE_EVENT_RING_SIZE 8192
+#define PROFILE_AGGREGATE_INTERVAL_MS 10
+#define PROFILE_THREAD_NAME_SIZE 64
+
+#define PROFILE_EVENT_END ((uint64_t)1 << 63)
+
+typedef struct profile_event profile_event;
+struct profile_event {
+	const char *name;
+	uint64_t time; /* PROFILE_EVENT_END set for end events */
+};
+
+typedef struct profile_span profile_span;
+struct profile_span {
+	const char *name;
+	uint64_t start_time;
+	uint64_t end_time;
+};
+
+typedef struct profile_thread profile_thread;
+struct profile_thread {
+	profile_thread *next;
+	long id;
+
+	/* written by the owning thread, read by the aggregate thread */
+	profile_event *events;
+	volatile long write_pos;
+	volatile long read_pos;
+	volatile long dropped;
+	volatile bool exited;
+
+	/* owning thread only */
+	DARRAY(const char *) stack;
+	size_t skip_depth;
+
+	/* aggregate_mutex */
+	profile_call *context;
+	profile_span *history;
+	uint64_t history_count;
+
+	/* threads_mutex */
+	char name[PROFILE_THREAD_NAME_SIZE];
+};
+
+static volatile bool enabled = false;
+static volatile long generation = 0;
 static pthread_mutex_t root_mutex = PTHREAD_MUTEX_INITIALIZER;
 static DARRAY(profile_root_entry) root_entries;
 
-static THREAD_LOCAL profile_call *thread_context = NULL;
+static pthread_mutex_t threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static profile_thread *threads = NULL;
+static long next_thread_id = 1;
+static pthread_key_t thread_key;
+static bool thread_key_created = false;
+
+static pthread_mutex_t aggregate_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t aggregate_thread;
+static os_event_t *aggregate_wake_event = NULL;
+static volatile bool aggregate_stopping = false;
+static bool aggregate_thread_active = false;
+static size_t trace_history_size = 0; /* aggregate_mutex */
+
+static THREAD_LOCAL profile_thread *thread_buffer = NULL;
+static THREAD_LOCAL long thread_generation = 0;
 static THREAD_LOCAL bool thread_enabled = true;
+static THREAD_LOCAL char thread_name[PROFILE_THREAD_NAME_SIZE];
+
+static void *aggregate_thread_func(void *data);
+
+static void thread_exit(void *data)
+{
+	long id = (long)(uintptr_t)data;
+
+	pthread_mutex_lock(&threads_mutex);
+	for (profile_thread *thread = threads; thread; thread = thread->next) {
+		if (thread->id == id) {
+			os_atomic_set_bool(&thread->exited, true);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&threads_mutex);
+}
 
 void profiler_start(void)
 {
 	pthread_mutex_lock(&root_mutex);
-	enabled = true;
+	if (!thread_key_created)
+		thread_key_created = pthread_key_create(&thread_key, thread_exit) == 0;
+
+	if (!aggregate_thread_active && os_event_init(&aggregate_wake_event, OS_EVENT_TYPE_AUTO) == 0) {
+		os_atomic_set_bool(&aggregate_stopping, false);
+		aggregate_thread_active = pthread_create(&aggregate_thread, NULL, aggregate_thread_func, NULL) == 0;
+		if (!aggregate_thread_active) {
+			os_event_destroy(aggregate_wake_event);
+			aggregate_wake_event = NULL;
+		}
+	}
+
+	os_atomic_set_bool(&enabled, true);
 	pthread_mutex_unlock(&root_mutex);
 }
 
 void profiler_stop(void)
 {
 	pthread_mutex_lock(&root_mutex);
-	enabled = false;
+	os_atomic_set_bool(&enabled, false);
 	pthread_mutex_unlock(&root_mutex);
 }
 
@@ -274,9 +350,7 @@ void profile_reenable_thread(void)
 	if (thread_enabled)
 		return;
 
-	pthread_mutex_lock(&root_mutex);
-	thread_enabled = enabled;
-	pthread_mutex_unlock(&root_mutex);
+	thread_enabled = os_atomic_load_bool(&enabled);
 }
 
 static bool lock_root(void)
@@ -326,16 +400,15 @@ void profile_register_root(const char *name, uint64_t expected_time_between_call
 
 static void free_call_context(profile_call *context);
 
+/* calls recorded before profiler_stop are merged even if they are drained
+ * after it, so a snapshot taken right after stopping is complete */
 static void merge_context(profile_call *context)
 {
 	pthread_mutex_t *mutex = NULL;
 	profile_entry *entry = NULL;
 	profile_call *prev_call = NULL;
 
-	if (!lock_root()) {
-		free_call_context(context);
-		return;
-	}
+	pthread_mutex_lock(&root_mutex);
 
 	profile_root_entry *r_entry = get_root_entry(context->name);
 
@@ -355,31 +428,105 @@ static void merge_context(profile_call *context)
 	free_call_context(prev_call);
 }
 
+static profile_thread *register_thread(void)
+{
+	profile_thread *thread = bzalloc(sizeof(profile_thread));
+	thread->events = bmalloc(sizeof(profile_event) * PROFILE_EVENT_RING_SIZE);
+
+	pthread_mutex_lock(&threads_mutex);
+	thread->id = next_thread_id++;
+	strcpy(thread->name, thread_name);
+	thread->next = threads;
+	threads = thread;
+	pthread_mutex_unlock(&threads_mutex);
+
+	if (thread_key_created)
+		pthread_setspecific(thread_key, (void *)(uintptr_t)thread->id);
+
+	thread_buffer = thread;
+	thread_generation = os_atomic_load_long(&generation);
+	return thread;
+}
+
+void profile_set_thread_name(const char *name)
+{
+	if (!name)
+		return;
+
+	snprintf(thread_name, sizeof(thread_name), "%s", name);
+
+	if (!thread_buffer || thread_generation != os_atomic_load_long(&generation))
+		return;
+
+	pthread_mutex_lock(&threads_mutex);
+	strcpy(thread_buffer->name, thread_name);
+	pthread_mutex_unlock(&threads_mutex);
+}
+
+/* fails unless more than 'reserve' slots are free, begin events reserve
+ * room for the end events of all open calls so those are never dropped.
+ * Wakes the aggregate thread early once the ring is half full. */
+static inline bool push_event(profile_thread *thread, const char *name, uint64_t time, size_t reserve)
+{
+	unsigned long write = (unsigned long)thread->write_pos;
+	unsigned long read = (unsigned long)os_atomic_load_long(&thread->read_pos);
+
+	if (PROFILE_EVENT_RING_SIZE - (write - read) <= reserve)
+		return false;
+
+	profile_event *event = &thread->events[write & (PROFILE_EVENT_RING_SIZE - 1)];
+	event->name = name;
+	event->time = time;
+
+	os_atomic_store_long(&thread->write_pos, (long)(write + 1));
+
+	if (write + 1 - read == PROFILE_EVENT_RING_SIZE / 2 && aggregate_wake_event)
+		os_event_signal(aggregate_wake_event);
+	return true;
+}
+
 void profile_start(const char *name)
 {
 	if (!thread_enabled)
 		return;
 
-	profile_call new_call = {
-		.name = name,
-#ifdef TRACK_OVERHEAD
-		.overhead_start = os_gettime_ns(),
-#endif
-		.parent = thread_context,
-	};
+	profile_thread *thread = thread_buffer;
+
+	if (!thread || thread_generation != os_atomic_load_long(&generation)) {
+		if (!os_atomic_load_bool(&enabled)) {
+			thread_enabled = false;
+			return;
+		}
 
-	profile_call *call = NULL;
+		thread = register_thread();
 
-	if (new_call.parent) {
-		size_t idx = da_push_back(new_call.parent->children, &new_call);
-		call = &new_call.parent->children.array[idx];
-	} else {
-		call = bmalloc(sizeof(profile_call));
-		memcpy(call, &new_call, sizeof(profile_call));
+	} else if (!thread->stack.num && !os_atomic_load_bool(&enabled)) {
+		thread_enabled = false;
+		return;
 	}
 
-	thread_context = call;
-	call->start_time = os_gettime_ns();
+	da_push_back(thread->stack, &name);
+
+	/* the ring was full, skip everything nested in the dropped call */
+	if (thread->skip_depth)
+		return;
+
+	if (!push_event(thread, name, os_gettime_ns(), thread->stack.num)) {
+		thread->skip_depth = thread->stack.num;
+		os_atomic_inc_long(&thread->dropped);
+	}
+}
+
+static void end_call(profile_thread *thread, uint64_t time)
+{
+	const char *name = thread->stack.array[thread->stack.num - 1];
+
+	if (!thread->skip_depth)
+		push_event(thread, name, time | PROFILE_EVENT_END, 0);
+	else if (thread->skip_depth == thread->stack.num)
+		thread->skip_depth = 0;
+
+	da_pop_back(thread->stack);
 }
 
 void profile_end(const char *name)
@@ -388,45 +535,177 @@ void profile_end(const char *name)
 	if (!thread_enabled)
 		return;
 
-	profile_call *call = thread_context;
-	if (!call) {
+	profile_thread *thread = thread_buffer;
+
+	/* calls started before profiler_free are discarded */
+	if (thread && thread_generation != os_atomic_load_long(&generation))
+		return;
+
+	if (!thread || !thread->stack.num) {
 		blog(LOG_ERROR, "Called profile end with no active profile");
 		return;
 	}
 
-	if (!call->name)
-		call->name = name;
+	const char **stack = thread->stack.array;
+	size_t top = thread->stack.num - 1;
+
+	if (!stack[top])
+		stack[top] = name;
 
-	if (call->name != name) {
+	if (stack[top] != name) {
 		blog(LOG_ERROR,
 		     "Called profile end with mismatching name: "
 		     "start(\"%s\"[%p]) <-> end(\"%s\"[%p])",
-		     call->name, call->name, name, name);
+		     stack[top], stack[top], name, name);
 
-		profile_call *parent = call->parent;
-		while (parent && parent->parent && parent->name != name)
-			parent = parent->parent;
+		size_t idx = top;
+		while (idx > 0 && stack[idx] != name)
+			idx--;
 
-		if (!parent || parent->name != name)
+		if (stack[idx] != name)
 			return;
 
-		while (call->name != name) {
-			profile_end(call->name);
-			call = call->parent;
+		while (thread->stack.num > idx + 1)
+			end_call(thread, end);
+	}
+
+	end_call(thread, end);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Aggregation */
+
+static void record_span(profile_thread *thread, const profile_call *call)
+{
+	if (!trace_history_size)
+		return;
+
+	if (!thread->history)
+		thread->history = bmalloc(sizeof(profile_span) * trace_history_size);
+
+	profile_span *span = &thread->history[thread->history_count++ % trace_history_size];
+	span->name = call->name;
+	span->start_time = call->start_time;
+	span->end_time = call->end_time;
+}
+
+static void aggregate_event(profile_thread *thread, const profile_event *event)
+{
+	if (!(event->time & PROFILE_EVENT_END)) {
+		profile_call new_call = {
+			.name = event->name,
+			.start_time = event->time,
+			.parent = thread->context,
+		};
+
+		profile_call *call = NULL;
+
+		if (new_call.parent) {
+			size_t idx = da_push_back(new_call.parent->children, &new_call);
+			call = &new_call.parent->children.array[idx];
+		} else {
+			call = bmalloc(sizeof(profile_call));
+			memcpy(call, &new_call, sizeof(profile_call));
 		}
+
+		thread->context = call;
+		return;
 	}
 
-	thread_context = call->parent;
+	profile_call *call = thread->context;
+	if (!call)
+		return;
 
-	call->end_time = end;
-#ifdef TRACK_OVERHEAD
-	call->overhead_end = os_gettime_ns();
-#endif
+	/* a call started with a NULL name is named by profile_end */
+	call->name = event->name;
+	call->end_time = event->time & ~PROFILE_EVENT_END;
+	thread->context = call->parent;
 
-	if (call->parent)
+	record_span(thread, call);
+
+	if (!call->parent)
+		merge_context(call);
+}
+
+static void free_thread_context(profile_thread *thread)
+{
+	profile_call *root = thread->context;
+	if (!root)
 		return;
 
-	merge_context(call);
+	while (root->parent)
+		root = root->parent;
+
+	free_call_context(root);
+	thread->context = NULL;
+}
+
+static void free_thread(profile_thread *thread);
+
+/* returns true once the thread has exited and all of its events are drained */
+static bool drain_thread(profile_thread *thread)
+{
+	unsigned long write = (unsigned long)os_atomic_load_long(&thread->write_pos);
+	unsigned long read = (unsigned long)thread->read_pos;
+
+	for (; read != write; read++)
+		aggregate_event(thread, &thread->events[read & (PROFILE_EVENT_RING_SIZE - 1)]);
+
+	os_atomic_store_long(&thread->read_pos, (long)read);
+
+	return os_atomic_load_bool(&thread->exited) && read == (unsigned long)os_atomic_load_long(&thread->write_pos);
+}
+
+/* must be called with aggregate_mutex held.  Threads that have exited are
+ * unlinked and freed along with their history once drained, new threads are
+ * only ever added to the front of the list. */
+static void drain_threads(void)
+{
+	pthread_mutex_lock(&threads_mutex);
+	profile_thread *thread = threads;
+	pthread_mutex_unlock(&threads_mutex);
+
+	while (thread) {
+		profile_thread *next = thread->next;
+
+		if (drain_thread(thread)) {
+			pthread_mutex_lock(&threads_mutex);
+			profile_thread **prev = &threads;
+			while (*prev != thread)
+				prev = &(*prev)->next;
+			*prev = next;
+			pthread_mutex_unlock(&threads_mutex);
+
+			free_thread(thread);
+		}
+
+		thread = next;
+	}
+}
+
+static void *aggregate_thread_func(void *data)
+{
+	os_set_thread_name("libobs: profiler aggregate thread");
+
+	while (!os_atomic_load_bool(&aggregate_stopping)) {
+		os_event_timedwait(aggregate_wake_event, PROFILE_AGGREGATE_INTERVAL_MS);
+
+		pthread_mutex_lock(&aggregate_mutex);
+		drain_threads();
+		pthread_mutex_unlock(&aggregate_mutex);
+	}
+
+	UNUSED_PARAMETER(data);
+	return NULL;
+}
+
+static void free_thread(profile_thread *thread)
+{
+	free_thread_context(thread);
+	da_free(thread->stack);
+	bfree(thread->history);
+	bfree(thread->events);
+	bfree(thread);
 }
 
 static int profiler_time_entry_compare(const void *first, const void *second)
@@ -757,9 +1036,6 @@ static void free_profile_entry(profile_entry *entry)
 		free_profile_entry(&entry->children.array[i]);
 
 	free_hashmap(&entry->times);
-#ifdef TRACK_OVERHEAD
-	free_hashmap(&entry->overhead);
-#endif
 	free_hashmap(&entry->times_between_calls);
 	da_free(entry->children);
 }
@@ -767,9 +1043,38 @@ static void free_profile_entry(profile_entry *entry)
 void profiler_free(void)
 {
 	DARRAY(profile_root_entry) old_root_entries = {0};
+	profile_thread *old_threads = NULL;
+	bool stop_thread;
+
+	pthread_mutex_lock(&root_mutex);
+	os_atomic_set_bool(&enabled, false);
+	stop_thread = aggregate_thread_active;
+	aggregate_thread_active = false;
+	pthread_mutex_unlock(&root_mutex);
+
+	pthread_mutex_lock(&aggregate_mutex);
+	pthread_mutex_lock(&threads_mutex);
+	os_atomic_inc_long(&generation);
+	old_threads = threads;
+	threads = NULL;
+	pthread_mutex_unlock(&threads_mutex);
+	pthread_mutex_unlock(&aggregate_mutex);
+
+	if (stop_thread) {
+		os_atomic_set_bool(&aggregate_stopping, true);
+		os_event_signal(aggregate_wake_event);
+		pthread_join(aggregate_thread, NULL);
+		os_event_destroy(aggregate_wake_event);
+		aggregate_wake_event = NULL;
+	}
+
+	while (old_threads) {
+		profile_thread *next = old_threads->next;
+		free_thread(old_threads);
+		old_threads = next;
+	}
 
 	pthread_mutex_lock(&root_mutex);
-	enabled = false;
 	da_move(old_root_entries, root_entries);
 	pthread_mutex_unlock(&root_mutex);
 
@@ -887,6 +1192,10 @@ profiler_snapshot_t *profile_snapshot_create(void)
 {
 	profiler_snapshot_t *snap = bzalloc(sizeof(profiler_snapshot_t));
 
+	pthread_mutex_lock(&aggregate_mutex);
+	drain_threads();
+	pthread_mutex_unlock(&aggregate_mutex);
+
 	pthread_mutex_lock(&root_mutex);
 	da_reserve(snap->roots, root_entries.num);
 	for (size_t i = 0; i < root_entries.num; i++) {
@@ -1115,3 +1424,147 @@ uint64_t profiler_snapshot_entry_overall_between_calls_count(profiler_snapshot_e
 {
 	return entry ? entry->overall_between_calls_count : 0;
 }
+
+/* ------------------------------------------------------------------------- */
+/* Trace export */
+
+struct trace_thread {
+	long id;
+	char name[PROFILE_THREAD_NAME_SIZE];
+	long dropped;
+	size_t first_span;
+	size_t num_spans;
+};
+
+static void trace_cat_string(struct dstr *buffer, const char *str)
+{
+	dstr_cat_ch(buffer, '"');
+
+	for (; str && *str; str++) {
+		unsigned char ch = (unsigned char)*str;
+
+		if (ch == '"' || ch == '\\') {
+			dstr_cat_ch(buffer, '\\');
+			dstr_cat_ch(buffer, (char)ch);
+		} else if (ch < 0x20) {
+			dstr_catf(buffer, "\\u%04x", ch);
+		} else {
+			dstr_cat_ch(buffer, (char)ch);
+		}
+	}
+
+	dstr_cat_ch(buffer, '"');
+}
+
+void profiler_set_trace_history(size_t spans)
+{
+	pthread_mutex_lock(&aggregate_mutex);
+	drain_threads();
+
+	pthread_mutex_lock(&threads_mutex);
+	profile_thread *thread = threads;
+	pthread_mutex_unlock(&threads_mutex);
+
+	/* histories are reallocated at the new size by the next recorded call */
+	for (; thread; thread = thread->next) {
+		bfree(thread->history);
+		thread->history = NULL;
+		thread->history_count = 0;
+	}
+
+	trace_history_size = spans;
+	pthread_mutex_unlock(&aggregate_mutex);
+}
+
+bool profiler_trace_dump_json(const char *filename, uint64_t start_time, uint64_t end_time)
+{
+	DARRAY(struct trace_thread) trace_threads = {0};
+	DARRAY(profile_span) spans = {0};
+	struct dstr buffer = {0};
+	bool success;
+
+	/* copy the spans so file I/O doesn't hold up the aggregate thread */
+	pthread_mutex_lock(&aggregate_mutex);
+	drain_threads();
+
+	pthread_mutex_lock(&threads_mutex);
+	profile_thread *thread = threads;
+	pthread_mutex_unlock(&threads_mutex);
+
+	for (; thread; thread = thread->next) {
+		struct trace_thread *info = da_push_back_new(trace_threads);
+		uint64_t count = thread->history_count;
+		uint64_t first = count > trace_history_size ? count - trace_history_size : 0;
+
+		pthread_mutex_lock(&threads_mutex);
+		strcpy(info->name, thread->name);
+		pthread_mutex_unlock(&threads_mutex);
+
+		info->id = thread->id;
+		info->dropped = os_atomic_load_long(&thread->dropped);
+		info->first_span = spans.num;
+
+		for (uint64_t i = first; i < count; i++) {
+			profile_span *span = &thread->history[i % trace_history_size];
+			if (span->end_time >= start_time && span->start_time <= end_time)
+				da_push_back(spans, span);
+		}
+
+		info->num_spans = spans.num - info->first_span;
+	}
+
+	pthread_mutex_unlock(&aggregate_mutex);
+
+	FILE *f = os_fopen(filename, "wb");
+	if (!f) {
+		da_free(trace_threads);
+		da_free(spans);
+		return false;
+	}
+
+	dstr_copy(&buffer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	for (size_t i = 0; i < trace_threads.num; i++) {
+		struct trace_thread *info = &trace_threads.array[i];
+
+		dstr_catf(&buffer,
+			  "%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%ld,"
+			  "\"name\":\"thread_name\",\"args\":{\"name\":",
+			  i ? "," : "", info->id);
+		if (*info->name)
+			trace_cat_string(&buffer, info->name);
+		else
+			dstr_catf(&buffer, "\"thread %ld\"", info->id);
+		dstr_cat(&buffer, "}}");
+
+		if (info->dropped)
+			blog(LOG_WARNING, "profiler_trace_dump_json: %ld calls were dropped on thread '%s'",
+			     info->dropped, info->name);
+
+		for (size_t j = 0; j < info->num_spans; j++) {
+			profile_span *span = &spans.array[info->first_span + j];
+
+			dstr_catf(&buffer, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+				  info->id, span->start_time / 1000., (span->end_time - span->start_time) / 1000.);
+			trace_cat_string(&buffer, span->name);
+			dstr_cat_ch(&buffer, '}');
+
+			if (buffer.len >= 65536) {
+				fwrite(buffer.array, 1, buffer.len, f);
+				buffer.array[0] = 0;
+				buffer.len = 0;
+			}
+		}
+	}
+
+	dstr_cat(&buffer, "\n]}\n");
+	fwrite(buffer.array, 1, buffer.len, f);
+
+	success = ferror(f) == 0;
+	fclose(f);
+
+	dstr_free(&buffer);
+	da_free(trace_threads);
+	da_free(spans);
+	return success;
+}
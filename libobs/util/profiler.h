@@ -21,6 +21,9 @@ EXPORT void profile_end(const char *name);
 
 EXPORT void profile_reenable_thread(void);
 
+/* called by os_set_thread_name, labels the thread in trace exports */
+EXPORT void profile_set_thread_name(const char *name);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler control */
 
@@ -30,6 +33,9 @@ EXPORT void profiler_stop(void);
 EXPORT void profiler_print(profiler_snapshot_t *snap);
 EXPORT void profiler_print_time_between_calls(profiler_snapshot_t *snap);
 
+EXPORT void profiler_set_trace_history(size_t spans);
+EXPORT bool profiler_trace_dump_json(const char *filename, uint64_t start_time, uint64_t end_time);
+
 EXPORT void profiler_free(void);
 
 /* ------------------------------------------------------------------------- */
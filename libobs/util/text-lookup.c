@@ -15,11 +15,14 @@
  */
 
 #include <ctype.h>
+#include <sys/stat.h>
 
 #include "dstr.h"
+#include "darray.h"
 #include "text-lookup.h"
 #include "lexer.h"
 #include "platform.h"
+#include "array-serializer.h"
 #include "uthash.h"
 
 /* ------------------------------------------------------------------------- */
@@ -40,8 +43,19 @@ static inline void text_item_destroy(struct text_item *item)
 
 struct text_lookup {
 	struct text_item *items;
+
+	/* compiled table mapped from disk, items override it */
+	const uint8_t *map;
+	size_t map_size;
+	uint32_t bucket_count;
+	uint32_t slot_count;
+	const uint8_t *displacements;
+	const uint8_t *slots;
+	const char *strings;
 };
 
+static bool compiled_getstring(const struct text_lookup *lookup, const char *lookup_val, const char **out);
+
 static void lookup_getstringtoken(struct lexer *lex, struct strref *token)
 {
 	const char *temp = lex->offset;
@@ -202,12 +216,12 @@ static inline bool lookup_getstring(const char *lookup_val, const char **out, st
 	struct text_item *item;
 
 	if (!lookup->items)
-		return false;
+		return lookup->map && compiled_getstring(lookup, lookup_val, out);
 
 	HASH_FIND_STR(lookup->items, lookup_val, item);
 
 	if (!item)
-		return false;
+		return lookup->map && compiled_getstring(lookup, lookup_val, out);
 
 	*out = item->value;
 	return true;
@@ -259,6 +273,8 @@ void text_lookup_destroy(lookup_t *lookup)
 			HASH_DELETE(hh, lookup->items, item);
 			text_item_destroy(item);
 		}
+		if (lookup->map)
+			os_unmap_file(lookup->map, lookup->map_size);
 		bfree(lookup);
 	}
 }
@@ -269,3 +285,400 @@ bool text_lookup_getstr(lookup_t *lookup, const char *lookup_val, const char **o
 		return lookup_getstring(lookup_val, out, lookup);
 	return false;
 }
+
+/* ------------------------------------------------------------------------- */
+/* Compiled tables
+ *
+ *   All values are little endian, offsets are relative to the start of the
+ * file.
+ *
+ *   header:
+ *     char     magic[4]         "OBSL"
+ *     uint16   version
+ *     uint16   source_count
+ *     uint32   file_size
+ *     uint32   bucket_count     power of two
+ *     uint32   slot_count       power of two
+ *     uint32   displacements    offset of uint32[bucket_count]
+ *     uint32   slots            offset of slot[slot_count]
+ *     uint32   strings          offset of the null-terminated strings
+ *
+ *   source (directly after the header):
+ *     int64    mtime            of each source file, -1 if it was missing
+ *     int64    size
+ *
+ *   slot:
+ *     uint32   key              offset relative to strings, UINT32_MAX if
+ *     uint32   value            the slot is empty
+ *
+ *   Keys are placed with hash and displace: the hash of a key picks a
+ * bucket, and the displacement stored for that bucket picks a slot that no
+ * other key uses.  A lookup is therefore one hash and one string comparison.
+ */
+
+#define COMPILED_MAGIC "OBSL"
+#define COMPILED_VERSION 1
+#define COMPILED_HEADER_SIZE 32
+#define COMPILED_SOURCE_SIZE 16
+#define COMPILED_SLOT_SIZE 8
+#define EMPTY_SLOT UINT32_MAX
+#define MAX_DISPLACEMENT (1 << 20)
+
+struct source_stamp {
+	int64_t mtime;
+	int64_t size;
+};
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int64_t read_i64(const uint8_t *p)
+{
+	return (int64_t)((uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32));
+}
+
+static inline uint64_t hash_key(const char *key)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	while (*key) {
+		hash ^= (uint8_t)*key++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static inline uint32_t key_bucket(uint64_t hash, uint32_t bucket_count)
+{
+	return (uint32_t)(hash >> 32) & (bucket_count - 1);
+}
+
+static inline uint32_t key_slot(uint64_t hash, uint32_t displacement, uint32_t slot_count)
+{
+	uint64_t x = hash ^ ((uint64_t)displacement * 0x9e3779b97f4a7c15ULL);
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	return (uint32_t)x & (slot_count - 1);
+}
+
+static inline uint32_t next_pow2(size_t val)
+{
+	uint32_t pow2 = 1;
+	while (pow2 < val)
+		pow2 <<= 1;
+	return pow2;
+}
+
+static bool compiled_getstring(const struct text_lookup *lookup, const char *lookup_val, const char **out)
+{
+	uint64_t hash = hash_key(lookup_val);
+	uint32_t bucket = key_bucket(hash, lookup->bucket_count);
+	uint32_t displacement = read_u32(lookup->displacements + bucket * 4);
+	const uint8_t *slot = lookup->slots + key_slot(hash, displacement, lookup->slot_count) * COMPILED_SLOT_SIZE;
+	uint32_t key = read_u32(slot);
+
+	if (key == EMPTY_SLOT || strcmp(lookup->strings + key, lookup_val) != 0)
+		return false;
+
+	*out = lookup->strings + read_u32(slot + 4);
+	return true;
+}
+
+static void get_source_stamps(struct source_stamp *stamps, const char *const *paths, size_t num_paths)
+{
+	for (size_t i = 0; i < num_paths; i++) {
+		struct stat st;
+
+		if (os_stat(paths[i], &st) == 0) {
+			stamps[i].mtime = (int64_t)st.st_mtime;
+			stamps[i].size = (int64_t)st.st_size;
+		} else {
+			stamps[i].mtime = -1;
+			stamps[i].size = -1;
+		}
+	}
+}
+
+/* checks everything a lookup could touch, so a truncated or corrupted table
+ * is rejected here instead of crashing later */
+static bool compiled_load(struct text_lookup *lookup, const uint8_t *data, size_t size,
+			  const struct source_stamp *stamps, size_t num_paths)
+{
+	uint32_t displacements, slots, strings, strings_size;
+
+	if (size < COMPILED_HEADER_SIZE || memcmp(data, COMPILED_MAGIC, 4) != 0)
+		return false;
+	if ((data[4] | (data[5] << 8)) != COMPILED_VERSION || (size_t)(data[6] | (data[7] << 8)) != num_paths)
+		return false;
+	if (read_u32(data + 8) != size)
+		return false;
+
+	lookup->bucket_count = read_u32(data + 12);
+	lookup->slot_count = read_u32(data + 16);
+	displacements = read_u32(data + 20);
+	slots = read_u32(data + 24);
+	strings = read_u32(data + 28);
+
+	if (!lookup->bucket_count || (lookup->bucket_count & (lookup->bucket_count - 1)) != 0 ||
+	    !lookup->slot_count || (lookup->slot_count & (lookup->slot_count - 1)) != 0)
+		return false;
+	if (COMPILED_HEADER_SIZE + num_paths * COMPILED_SOURCE_SIZE > displacements ||
+	    (uint64_t)displacements + (uint64_t)lookup->bucket_count * 4 > slots ||
+	    (uint64_t)slots + (uint64_t)lookup->slot_count * COMPILED_SLOT_SIZE > strings || strings >= size)
+		return false;
+
+	for (size_t i = 0; i < num_paths; i++) {
+		const uint8_t *source = data + COMPILED_HEADER_SIZE + i * COMPILED_SOURCE_SIZE;
+		if (read_i64(source) != stamps[i].mtime || read_i64(source + 8) != stamps[i].size)
+			return false;
+	}
+
+	strings_size = (uint32_t)(size - strings);
+	if (data[size - 1] != 0)
+		return false;
+
+	for (uint32_t i = 0; i < lookup->slot_count; i++) {
+		const uint8_t *slot = data + slots + i * COMPILED_SLOT_SIZE;
+		uint32_t key = read_u32(slot);
+		if (key != EMPTY_SLOT && (key >= strings_size || read_u32(slot + 4) >= strings_size))
+			return false;
+	}
+
+	lookup->map = data;
+	lookup->map_size = size;
+	lookup->displacements = data + displacements;
+	lookup->slots = data + slots;
+	lookup->strings = (const char *)(data + strings);
+	return true;
+}
+
+struct compile_key {
+	const struct text_item *item;
+	uint64_t hash;
+	uint32_t bucket;
+};
+
+static int compare_key_bucket(const void *a, const void *b)
+{
+	const struct compile_key *ka = a;
+	const struct compile_key *kb = b;
+	return (ka->bucket > kb->bucket) - (ka->bucket < kb->bucket);
+}
+
+struct compile_bucket {
+	size_t first;
+	size_t count;
+};
+
+static int compare_bucket_size(const void *a, const void *b)
+{
+	const struct compile_bucket *ba = a;
+	const struct compile_bucket *bb = b;
+	return (ba->count < bb->count) - (ba->count > bb->count);
+}
+
+/* finds a displacement for every bucket, largest buckets first */
+static bool place_keys(struct compile_key *keys, size_t num_keys, uint32_t slot_count, uint32_t *displacements,
+		       uint32_t *slot_keys)
+{
+	DARRAY(struct compile_bucket) buckets;
+	uint32_t bucket_slots[64];
+	bool success = true;
+
+	da_init(buckets);
+
+	qsort(keys, num_keys, sizeof(*keys), compare_key_bucket);
+	for (size_t i = 0; i < num_keys;) {
+		struct compile_bucket *bucket = da_push_back_new(buckets);
+		bucket->first = i;
+		while (i < num_keys && keys[i].bucket == keys[bucket->first].bucket)
+			i++;
+		bucket->count = i - bucket->first;
+	}
+	qsort(buckets.array, buckets.num, sizeof(*buckets.array), compare_bucket_size);
+
+	for (size_t i = 0; i < slot_count; i++)
+		slot_keys[i] = EMPTY_SLOT;
+
+	for (size_t b = 0; b < buckets.num && success; b++) {
+		struct compile_bucket *bucket = buckets.array + b;
+		struct compile_key *first = keys + bucket->first;
+		uint32_t d;
+
+		if (bucket->count > 64) {
+			success = false;
+			break;
+		}
+
+		for (d = 0; d < MAX_DISPLACEMENT; d++) {
+			size_t placed = 0;
+
+			for (; placed < bucket->count; placed++) {
+				uint32_t slot = key_slot(first[placed].hash, d, slot_count);
+				bool taken = slot_keys[slot] != EMPTY_SLOT;
+
+				for (size_t j = 0; j < placed && !taken; j++)
+					taken = bucket_slots[j] == slot;
+				if (taken)
+					break;
+
+				bucket_slots[placed] = slot;
+			}
+
+			if (placed == bucket->count)
+				break;
+		}
+
+		if (d == MAX_DISPLACEMENT) {
+			success = false;
+			break;
+		}
+
+		displacements[first->bucket] = d;
+		for (size_t j = 0; j < bucket->count; j++)
+			slot_keys[bucket_slots[j]] = (uint32_t)(bucket->first + j);
+	}
+
+	da_free(buckets);
+	return success;
+}
+
+static bool compiled_save(const struct text_lookup *lookup, const char *cache_path, const struct source_stamp *stamps,
+			  size_t num_paths)
+{
+	struct array_output_data output;
+	struct serializer s;
+	DARRAY(struct compile_key) keys;
+	DARRAY(char) strings;
+	uint32_t *displacements = NULL;
+	uint32_t *slot_keys = NULL;
+	uint32_t *key_offsets = NULL;
+	uint32_t *value_offsets = NULL;
+	uint32_t bucket_count, slot_count, displacements_pos, slots_pos, strings_pos;
+	struct text_item *item, *tmp;
+	bool success = false;
+
+	da_init(keys);
+	da_init(strings);
+
+	HASH_ITER (hh, lookup->items, item, tmp) {
+		struct compile_key *key = da_push_back_new(keys);
+		key->item = item;
+		key->hash = hash_key(item->lookup);
+	}
+
+	bucket_count = next_pow2(keys.num / 2 + 1);
+	slot_count = next_pow2(keys.num + keys.num / 4 + 1);
+	for (size_t i = 0; i < keys.num; i++)
+		keys.array[i].bucket = key_bucket(keys.array[i].hash, bucket_count);
+
+	displacements = bzalloc(bucket_count * sizeof(uint32_t));
+	slot_keys = bmalloc(slot_count * sizeof(uint32_t));
+	if (!place_keys(keys.array, keys.num, slot_count, displacements, slot_keys))
+		goto cleanup;
+
+	key_offsets = bmalloc((keys.num + 1) * sizeof(uint32_t));
+	value_offsets = bmalloc((keys.num + 1) * sizeof(uint32_t));
+	for (size_t i = 0; i < keys.num; i++) {
+		const struct text_item *key_item = keys.array[i].item;
+
+		key_offsets[i] = (uint32_t)strings.num;
+		da_push_back_array(strings, key_item->lookup, strlen(key_item->lookup) + 1);
+		value_offsets[i] = (uint32_t)strings.num;
+		da_push_back_array(strings, key_item->value, strlen(key_item->value) + 1);
+	}
+	da_push_back(strings, "");
+
+	displacements_pos = (uint32_t)(COMPILED_HEADER_SIZE + num_paths * COMPILED_SOURCE_SIZE);
+	slots_pos = displacements_pos + bucket_count * 4;
+	strings_pos = slots_pos + slot_count * COMPILED_SLOT_SIZE;
+	if ((uint64_t)strings_pos + strings.num > UINT32_MAX)
+		goto cleanup;
+
+	array_output_serializer_init(&s, &output);
+
+	s_write(&s, COMPILED_MAGIC, 4);
+	s_wl16(&s, COMPILED_VERSION);
+	s_wl16(&s, (uint16_t)num_paths);
+	s_wl32(&s, (uint32_t)(strings_pos + strings.num));
+	s_wl32(&s, bucket_count);
+	s_wl32(&s, slot_count);
+	s_wl32(&s, displacements_pos);
+	s_wl32(&s, slots_pos);
+	s_wl32(&s, strings_pos);
+
+	for (size_t i = 0; i < num_paths; i++) {
+		s_wl64(&s, (uint64_t)stamps[i].mtime);
+		s_wl64(&s, (uint64_t)stamps[i].size);
+	}
+	for (uint32_t i = 0; i < bucket_count; i++)
+		s_wl32(&s, displacements[i]);
+	for (uint32_t i = 0; i < slot_count; i++) {
+		uint32_t idx = slot_keys[i];
+		s_wl32(&s, idx == EMPTY_SLOT ? EMPTY_SLOT : key_offsets[idx]);
+		s_wl32(&s, idx == EMPTY_SLOT ? EMPTY_SLOT : value_offsets[idx]);
+	}
+	s_write(&s, strings.array, strings.num);
+
+	success = os_quick_write_utf8_file_safe(cache_path, (const char *)output.bytes.array, output.bytes.num, false,
+						"tmp", NULL);
+	array_output_serializer_free(&output);
+
+cleanup:
+	if (!success)
+		blog(LOG_DEBUG, "text_lookup_create_compiled: Failed to write '%s'", cache_path);
+
+	bfree(value_offsets);
+	bfree(key_offsets);
+	bfree(slot_keys);
+	bfree(displacements);
+	da_free(strings);
+	da_free(keys);
+	return success;
+}
+
+lookup_t *text_lookup_create_compiled(const char *cache_path, const char *const *paths, size_t num_paths)
+{
+	struct source_stamp *stamps;
+	struct text_lookup *lookup;
+	const void *data;
+	size_t size;
+
+	if (!paths || !num_paths || num_paths > UINT16_MAX)
+		return NULL;
+	if (!cache_path)
+		goto parse;
+
+	stamps = bmalloc(num_paths * sizeof(struct source_stamp));
+	get_source_stamps(stamps, paths, num_paths);
+
+	data = os_map_file(cache_path, &size);
+	if (data) {
+		lookup = bzalloc(sizeof(struct text_lookup));
+		if (compiled_load(lookup, data, size, stamps, num_paths)) {
+			bfree(stamps);
+			return lookup;
+		}
+
+		os_unmap_file(data, size);
+		bfree(lookup);
+	}
+
+	lookup = text_lookup_create(paths[0]);
+	if (lookup) {
+		for (size_t i = 1; i < num_paths; i++)
+			text_lookup_add(lookup, paths[i]);
+		compiled_save(lookup, cache_path, stamps, num_paths);
+	}
+
+	bfree(stamps);
+	return lookup;
+
+parse:
+	lookup = text_lookup_create(paths[0]);
+	for (size_t i = 1; lookup && i < num_paths; i++)
+		text_lookup_add(lookup, paths[i]);
+	return lookup;
+}
@@ -40,6 +40,14 @@ EXPORT bool text_lookup_add(lookup_t *lookup, const char *path);
 EXPORT void text_lookup_destroy(lookup_t *lookup);
 EXPORT bool text_lookup_getstr(lookup_t *lookup, const char *lookup_val, const char **out);
 
+/*
+ * Loads the files in order, like text_lookup_create followed by
+ * text_lookup_add, through a compiled cache at cache_path.  The cache is a
+ * perfect-hashed string table that is mapped from disk and used as long as
+ * none of the files changed, otherwise it is rebuilt from the files.
+ */
+EXPORT lookup_t *text_lookup_create_compiled(const char *cache_path, const char *const *paths, size_t num_paths);
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,10 @@ struct image_source {
 	volatile bool file_decoded;
 	volatile bool texture_loaded;
 
+	/* serializes loading and unloading the image between settings
+	 * updates and lazy resource loading */
+	pthread_mutex_t mutex;
+
 	gs_image_file4_t if4;
 };
 
@@ -103,6 +107,8 @@ static void image_source_update(void *data, obs_data_t *settings)
 	const bool linear_alpha = obs_data_get_bool(settings, "linear_alpha");
 	const bool is_slide = obs_data_get_bool(settings, "is_slide");
 
+	pthread_mutex_lock(&context->mutex);
+
 	if (context->file)
 		bfree(context->file);
 	context->file = bstrdup(file);
@@ -110,14 +116,15 @@ static void image_source_update(void *data, obs_data_t *settings)
 	context->linear_alpha = linear_alpha;
 	context->is_slide = is_slide;
 
-	if (is_slide)
-		return;
+	if (!is_slide && obs_source_resources_loaded(context->source)) {
+		/* Load the image if the source is persistent or showing */
+		if (context->persistent || obs_source_showing(context->source))
+			image_source_load(data);
+		else
+			image_source_unload(data);
+	}
 
-	/* Load the image if the source is persistent or showing */
-	if (context->persistent || obs_source_showing(context->source))
-		image_source_load(data);
-	else
-		image_source_unload(data);
+	pthread_mutex_unlock(&context->mutex);
 }
 
 static void image_source_defaults(obs_data_t *settings)
@@ -142,6 +149,26 @@ static void image_source_hide(void *data)
 		image_source_unload(context);
 }
 
+static void image_source_load_resources(void *data)
+{
+	struct image_source *context = data;
+
+	pthread_mutex_lock(&context->mutex);
+	if (context->persistent && !context->is_slide)
+		image_source_load(context);
+	pthread_mutex_unlock(&context->mutex);
+}
+
+static void image_source_unload_resources(void *data)
+{
+	struct image_source *context = data;
+
+	pthread_mutex_lock(&context->mutex);
+	if (!context->is_slide)
+		image_source_unload(context);
+	pthread_mutex_unlock(&context->mutex);
+}
+
 static void restart_gif(void *data)
 {
 	struct image_source *context = data;
@@ -169,6 +196,7 @@ static void *image_source_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct image_source *context = bzalloc(sizeof(struct image_source));
 	context->source = source;
+	pthread_mutex_init(&context->mutex, NULL);
 
 	image_source_update(context, settings);
 	return context;
@@ -182,6 +210,7 @@ static void image_source_destroy(void *data)
 
 	if (context->file)
 		bfree(context->file);
+	pthread_mutex_destroy(&context->mutex);
 	bfree(context);
 }
 
@@ -316,7 +345,12 @@ static obs_properties_t *image_source_properties(void *data)
 uint64_t image_source_get_memory_usage(void *data)
 {
 	struct image_source *s = data;
-	return s->if4.image3.image2.mem_usage;
+	uint64_t mem_usage;
+
+	pthread_mutex_lock(&s->mutex);
+	mem_usage = s->if4.image3.image2.mem_usage;
+	pthread_mutex_unlock(&s->mutex);
+	return mem_usage;
 }
 
 static void missing_file_callback(void *src, const char *new_path, void *data)
@@ -363,7 +397,7 @@ static enum gs_color_space image_source_get_color_space(void *data, size_t count
 static struct obs_source_info image_source_info = {
 	.id = "image_source",
 	.type = OBS_SOURCE_TYPE_INPUT,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB | OBS_SOURCE_THREADSAFE_CREATE,
 	.get_name = image_source_get_name,
 	.create = image_source_create,
 	.destroy = image_source_destroy,
@@ -380,10 +414,14 @@ static struct obs_source_info image_source_info = {
 	.icon_type = OBS_ICON_TYPE_IMAGE,
 	.activate = image_source_activate,
 	.video_get_color_space = image_source_get_color_space,
+	.load_resources = image_source_load_resources,
+	.unload_resources = image_source_unload_resources,
+	.get_memory_usage = image_source_get_memory_usage,
 };
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("image-source", "en-US")
+OBS_MODULE_ALLOW_CONCURRENT_LOAD()
 MODULE_EXPORT const char *obs_module_description(void)
 {
 	return "Image/color/slideshow sources";
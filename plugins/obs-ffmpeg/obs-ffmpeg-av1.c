@@ -80,7 +80,7 @@ static bool av1_update(struct av1_encoder *enc, obs_data_t *settings)
 	info.colorspace = voi->colorspace;
 	info.range = voi->range;
 
-	enc->ffve.context->thread_count = 0;
+	enc->ffve.context->thread_count = (int)obs_encoder_get_thread_budget(enc->ffve.encoder);
 
 	av1_video_info(enc, &info);
 
@@ -329,6 +329,7 @@ struct obs_encoder_info svt_av1_encoder_info = {
 	.get_properties = svt_av1_properties,
 	.get_extra_data = av1_extra_data,
 	.get_video_info = av1_video_info,
+	.caps = OBS_ENCODER_CAP_THREAD_BUDGET | OBS_ENCODER_CAP_ASYNC_ENCODE,
 };
 
 struct obs_encoder_info aom_av1_encoder_info = {
@@ -343,4 +344,5 @@ struct obs_encoder_info aom_av1_encoder_info = {
 	.get_properties = aom_av1_properties,
 	.get_extra_data = av1_extra_data,
 	.get_video_info = av1_video_info,
+	.caps = OBS_ENCODER_CAP_THREAD_BUDGET | OBS_ENCODER_CAP_ASYNC_ENCODE,
 };
@@ -67,7 +67,7 @@ static bool openh264_update(struct openh264_encoder *enc, obs_data_t *settings)
 	info.colorspace = voi->colorspace;
 	info.range = voi->range;
 
-	enc->ffve.context->thread_count = 0;
+	enc->ffve.context->thread_count = (int)obs_encoder_get_thread_budget(enc->ffve.encoder);
 
 	openh264_video_info(enc, &info);
 
@@ -247,4 +247,5 @@ struct obs_encoder_info openh264_encoder_info = {
 	.get_properties = openh264_properties,
 	.get_extra_data = openh264_extra_data,
 	.get_video_info = openh264_video_info,
+	.caps = OBS_ENCODER_CAP_THREAD_BUDGET | OBS_ENCODER_CAP_ASYNC_ENCODE,
 };
@@ -0,0 +1,21 @@
+#include <obs-module.h>
+
+#include "sim-encoder.h"
+
+OBS_DECLARE_MODULE()
+OBS_MODULE_USE_DEFAULT_LOCALE("obs-sim-encoder", "en-US")
+OBS_MODULE_ALLOW_CONCURRENT_LOAD()
+MODULE_EXPORT const char *obs_module_description(void)
+{
+	return "Simulated encoders for load testing";
+}
+
+bool obs_module_load(void)
+{
+	obs_register_encoder(&sim_h264_encoder_info);
+	obs_register_encoder(&sim_hevc_encoder_info);
+	obs_register_encoder(&sim_av1_encoder_info);
+	obs_register_encoder(&sim_aac_encoder_info);
+	obs_register_encoder(&sim_opus_encoder_info);
+	return true;
+}
@@ -0,0 +1,393 @@
+#include "sim-encoder.h"
+#include "sim-bitstream.h"
+
+#define AAC_FRAME_SIZE 1024
+#define OPUS_FRAME_SIZE 960
+#define OPUS_SAMPLE_RATE 48000
+#define OPUS_PRE_SKIP 312
+
+#define TEXT_BITRATE obs_module_text("Bitrate")
+
+/* Packets decode to silence.  AAC frames carry one element per channel
+ * (no spectral data) plus fill elements, Opus packets carry a single CELT
+ * silence frame plus Opus padding, both sized to match the bitrate */
+
+enum sim_audio_codec {
+	SIM_CODEC_AAC,
+	SIM_CODEC_OPUS,
+};
+
+struct sim_audio {
+	obs_encoder_t *encoder;
+	enum sim_audio_codec codec;
+
+	uint32_t sample_rate;
+	size_t channels;
+	size_t frame_size;
+	size_t packet_size;
+	int64_t total_samples;
+
+	uint8_t extra_data[19];
+	size_t extra_data_size;
+
+	DARRAY(uint8_t) packet;
+};
+
+static const char *sim_aac_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("SimEncoder.AAC");
+}
+
+static const char *sim_opus_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("SimEncoder.Opus");
+}
+
+static void sim_audio_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "bitrate", 160);
+}
+
+static obs_properties_t *sim_audio_props(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p = obs_properties_add_int(props, "bitrate", TEXT_BITRATE, 32, 1024, 32);
+	obs_property_int_set_suffix(p, " Kbps");
+	return props;
+}
+
+static void update_packet_size(struct sim_audio *enc, obs_data_t *settings)
+{
+	uint64_t bitrate = (uint64_t)obs_data_get_int(settings, "bitrate") * 1000;
+	enc->packet_size = (size_t)(bitrate * enc->frame_size / 8 / enc->sample_rate);
+}
+
+static bool sim_audio_update(void *data, obs_data_t *settings)
+{
+	update_packet_size(data, settings);
+	return true;
+}
+
+static void sim_audio_destroy(void *data)
+{
+	struct sim_audio *enc = data;
+
+	if (enc) {
+		da_free(enc->packet);
+		bfree(enc);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* AAC */
+
+#define AAC_ID_SCE 0
+#define AAC_ID_CPE 1
+#define AAC_ID_LFE 3
+#define AAC_ID_FIL 6
+#define AAC_ID_END 7
+
+#define AAC_FIL_MAX_COUNT (15 + 255 - 1)
+
+static const uint32_t aac_sample_rates[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+					    22050, 16000, 12000, 11025, 8000,  7350};
+
+/* elements of each channelConfiguration, terminated by AAC_ID_END */
+static const int aac_channel_elements[8][6] = {
+	{AAC_ID_END},
+	{AAC_ID_SCE, AAC_ID_END},
+	{AAC_ID_CPE, AAC_ID_END},
+	{AAC_ID_SCE, AAC_ID_CPE, AAC_ID_END},
+	{AAC_ID_SCE, AAC_ID_CPE, AAC_ID_SCE, AAC_ID_END},
+	{AAC_ID_SCE, AAC_ID_CPE, AAC_ID_CPE, AAC_ID_END},
+	{AAC_ID_SCE, AAC_ID_CPE, AAC_ID_CPE, AAC_ID_LFE, AAC_ID_END},
+	{AAC_ID_SCE, AAC_ID_CPE, AAC_ID_CPE, AAC_ID_CPE, AAC_ID_LFE, AAC_ID_END},
+};
+
+static inline int aac_channel_config(size_t channels)
+{
+	return channels == 8 ? 7 : (int)channels;
+}
+
+static void put_aac_ics(struct sim_bits *bits)
+{
+	sim_put_bits(bits, 8, 100); // global_gain
+	sim_put_bits(bits, 1, 0);   // ics_reserved_bit
+	sim_put_bits(bits, 2, 0);   // window_sequence (ONLY_LONG_SEQUENCE)
+	sim_put_bits(bits, 1, 0);   // window_shape
+	sim_put_bits(bits, 6, 0);   // max_sfb
+	sim_put_bits(bits, 1, 0);   // predictor_data_present
+	sim_put_bits(bits, 1, 0);   // pulse_data_present
+	sim_put_bits(bits, 1, 0);   // tns_data_present
+	sim_put_bits(bits, 1, 0);   // gain_control_data_present
+}
+
+static void put_aac_fill(struct sim_bits *bits, size_t count)
+{
+	sim_put_bits(bits, 3, AAC_ID_FIL);
+	if (count >= 15) {
+		sim_put_bits(bits, 4, 15);
+		sim_put_bits(bits, 8, (uint32_t)(count - 15 + 1)); // esc_count
+	} else {
+		sim_put_bits(bits, 4, (uint32_t)count);
+	}
+
+	sim_put_bits(bits, 4, 0); // extension_type (EXT_FILL)
+	sim_put_bits(bits, 4, 0); // fill_nibble
+	for (size_t i = 1; i < count; i++)
+		sim_put_bits(bits, 8, 0xa5); // fill_byte
+}
+
+static void write_aac_frame(struct sim_audio *enc)
+{
+	const int *element = aac_channel_elements[aac_channel_config(enc->channels)];
+	struct sim_bits bits;
+	int tag[8] = {0};
+
+	sim_bits_init(&bits);
+
+	for (; *element != AAC_ID_END; element++) {
+		sim_put_bits(&bits, 3, *element);
+		sim_put_bits(&bits, 4, tag[*element]++); // element_instance_tag
+		if (*element == AAC_ID_CPE) {
+			sim_put_bits(&bits, 1, 0); // common_window
+			put_aac_ics(&bits);
+		}
+		put_aac_ics(&bits);
+	}
+
+	/* fill elements take 7 or 15 bits plus their payload */
+	for (;;) {
+		size_t used = bits.data.num * 8 + bits.num_bits + 3;
+		size_t left = enc->packet_size * 8 > used ? enc->packet_size * 8 - used : 0;
+		size_t count;
+
+		if (left >= 15 + 15 * 8)
+			count = (left - 15) / 8;
+		else if (left >= 7 + 8)
+			count = (left - 7) / 8;
+		else
+			break;
+
+		if (count > AAC_FIL_MAX_COUNT)
+			count = AAC_FIL_MAX_COUNT;
+		else if (left < 15 + 15 * 8 && count > 14)
+			count = 14;
+		put_aac_fill(&bits, count);
+	}
+
+	sim_put_bits(&bits, 3, AAC_ID_END);
+	sim_bits_flush(&bits);
+
+	da_move(enc->packet, bits.data);
+}
+
+static bool init_aac(struct sim_audio *enc)
+{
+	const size_t count = sizeof(aac_sample_rates) / sizeof(aac_sample_rates[0]);
+	size_t rate_idx = 0;
+
+	while (rate_idx < count && aac_sample_rates[rate_idx] != enc->sample_rate)
+		rate_idx++;
+
+	if (rate_idx == count || enc->channels > 8 || enc->channels == 7 || !enc->channels) {
+		warn(enc->encoder, "Unsupported audio format: %u Hz, %zu channels", enc->sample_rate,
+		     enc->channels);
+		return false;
+	}
+
+	/* AudioSpecificConfig: AAC LC, no extensions */
+	enc->extra_data[0] = (uint8_t)(2 << 3 | rate_idx >> 1);
+	enc->extra_data[1] = (uint8_t)((rate_idx & 1) << 7 | aac_channel_config(enc->channels) << 3);
+	enc->extra_data_size = 2;
+	enc->frame_size = AAC_FRAME_SIZE;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Opus */
+
+static void write_opus_frame(struct sim_audio *enc)
+{
+	/* config 31 (CELT fullband, 20 ms), code 3 */
+	const uint8_t toc = (uint8_t)(31 << 3 | (enc->channels == 2 ? 1 : 0) << 2 | 3);
+	const uint8_t silence[] = {0xff, 0xfe};
+	const uint8_t frame_count = 0x41; // CBR, padding, one frame
+	size_t padding = enc->packet_size > 5 ? enc->packet_size - 5 : 0;
+	uint8_t val;
+
+	while (padding && 5 + padding / 254 + padding > enc->packet_size)
+		padding--;
+
+	da_resize(enc->packet, 0);
+	da_push_back(enc->packet, &toc);
+	da_push_back(enc->packet, &frame_count);
+
+	val = 255;
+	for (size_t i = 0; i < padding / 254; i++)
+		da_push_back(enc->packet, &val);
+	val = (uint8_t)(padding % 254);
+	da_push_back(enc->packet, &val);
+
+	da_push_back_array(enc->packet, silence, sizeof(silence));
+
+	size_t offset = enc->packet.num;
+	da_resize(enc->packet, offset + padding);
+	memset(enc->packet.array + offset, 0, padding);
+}
+
+static bool init_opus(struct sim_audio *enc)
+{
+	uint8_t *head = enc->extra_data;
+
+	if (enc->channels > 2)
+		enc->channels = 2;
+	enc->sample_rate = OPUS_SAMPLE_RATE;
+
+	/* OpusHead, channel mapping family 0 */
+	memcpy(head, "OpusHead", 8);
+	head[8] = 1;
+	head[9] = (uint8_t)enc->channels;
+	head[10] = OPUS_PRE_SKIP & 0xff;
+	head[11] = OPUS_PRE_SKIP >> 8;
+	head[12] = OPUS_SAMPLE_RATE & 0xff;
+	head[13] = (OPUS_SAMPLE_RATE >> 8) & 0xff;
+	head[14] = (OPUS_SAMPLE_RATE >> 16) & 0xff;
+	head[15] = OPUS_SAMPLE_RATE >> 24;
+	head[16] = 0;
+	head[17] = 0;
+	head[18] = 0;
+	enc->extra_data_size = 19;
+	enc->frame_size = OPUS_FRAME_SIZE;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void *sim_audio_create(obs_data_t *settings, obs_encoder_t *encoder, enum sim_audio_codec codec)
+{
+	audio_t *audio = obs_encoder_audio(encoder);
+	struct sim_audio *enc = bzalloc(sizeof(struct sim_audio));
+	bool success;
+
+	enc->encoder = encoder;
+	enc->codec = codec;
+	enc->sample_rate = audio_output_get_sample_rate(audio);
+	enc->channels = audio_output_get_channels(audio);
+
+	success = codec == SIM_CODEC_AAC ? init_aac(enc) : init_opus(enc);
+	if (!success) {
+		sim_audio_destroy(enc);
+		return NULL;
+	}
+
+	update_packet_size(enc, settings);
+
+	info(encoder,
+	     "settings:\n"
+	     "\tbitrate:     %d\n"
+	     "\tchannels:    %zu\n"
+	     "\tsample rate: %u",
+	     (int)obs_data_get_int(settings, "bitrate"), enc->channels, enc->sample_rate);
+
+	return enc;
+}
+
+static void *sim_aac_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	return sim_audio_create(settings, encoder, SIM_CODEC_AAC);
+}
+
+static void *sim_opus_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	return sim_audio_create(settings, encoder, SIM_CODEC_OPUS);
+}
+
+static bool sim_audio_encode(void *data, struct encoder_frame *frame, struct encoder_packet *packet,
+			     bool *received_packet)
+{
+	struct sim_audio *enc = data;
+
+	UNUSED_PARAMETER(frame);
+
+	if (enc->codec == SIM_CODEC_AAC)
+		write_aac_frame(enc);
+	else
+		write_opus_frame(enc);
+
+	packet->pts = enc->total_samples;
+	packet->dts = enc->total_samples;
+	packet->data = enc->packet.array;
+	packet->size = enc->packet.num;
+	packet->type = OBS_ENCODER_AUDIO;
+	packet->keyframe = true;
+	packet->timebase_num = 1;
+	packet->timebase_den = enc->sample_rate;
+	*received_packet = true;
+
+	enc->total_samples += enc->frame_size;
+	return true;
+}
+
+static bool sim_audio_extra_data(void *data, uint8_t **extra_data, size_t *size)
+{
+	struct sim_audio *enc = data;
+
+	*extra_data = enc->extra_data;
+	*size = enc->extra_data_size;
+	return true;
+}
+
+static void sim_audio_info(void *data, struct audio_convert_info *info)
+{
+	struct sim_audio *enc = data;
+
+	info->format = AUDIO_FORMAT_FLOAT_PLANAR;
+	info->samples_per_sec = enc->sample_rate;
+	info->speakers = (enum speaker_layout)enc->channels;
+}
+
+static size_t sim_audio_frame_size(void *data)
+{
+	struct sim_audio *enc = data;
+
+	return enc->frame_size;
+}
+
+struct obs_encoder_info sim_aac_encoder_info = {
+	.id = "sim_aac",
+	.type = OBS_ENCODER_AUDIO,
+	.codec = "aac",
+	.get_name = sim_aac_getname,
+	.create = sim_aac_create,
+	.destroy = sim_audio_destroy,
+	.encode = sim_audio_encode,
+	.update = sim_audio_update,
+	.get_frame_size = sim_audio_frame_size,
+	.get_defaults = sim_audio_defaults,
+	.get_properties = sim_audio_props,
+	.get_extra_data = sim_audio_extra_data,
+	.get_audio_info = sim_audio_info,
+	.caps = OBS_ENCODER_CAP_DYN_BITRATE,
+};
+
+struct obs_encoder_info sim_opus_encoder_info = {
+	.id = "sim_opus",
+	.type = OBS_ENCODER_AUDIO,
+	.codec = "opus",
+	.get_name = sim_opus_getname,
+	.create = sim_opus_create,
+	.destroy = sim_audio_destroy,
+	.encode = sim_audio_encode,
+	.update = sim_audio_update,
+	.get_frame_size = sim_audio_frame_size,
+	.get_defaults = sim_audio_defaults,
+	.get_properties = sim_audio_props,
+	.get_extra_data = sim_audio_extra_data,
+	.get_audio_info = sim_audio_info,
+	.caps = OBS_ENCODER_CAP_DYN_BITRATE,
+};
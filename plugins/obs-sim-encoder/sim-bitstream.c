@@ -0,0 +1,499 @@
+#include "sim-bitstream.h"
+
+#include <util/c99defs.h>
+
+void sim_put_bits(struct sim_bits *bits, int count, uint32_t val)
+{
+	while (count--) {
+		bits->cur = (uint8_t)((bits->cur << 1) | ((val >> count) & 1));
+
+		if (++bits->num_bits == 8) {
+			da_push_back(bits->data, &bits->cur);
+			bits->cur = 0;
+			bits->num_bits = 0;
+		}
+	}
+}
+
+void sim_put_ue(struct sim_bits *bits, uint32_t val)
+{
+	uint64_t code = (uint64_t)val + 1;
+	int len = 0;
+
+	while ((code >> len) > 1)
+		len++;
+
+	sim_put_bits(bits, len, 0);
+	if (len >= 32) {
+		sim_put_bits(bits, len + 1 - 32, (uint32_t)(code >> 32));
+		sim_put_bits(bits, 32, (uint32_t)code);
+	} else {
+		sim_put_bits(bits, len + 1, (uint32_t)code);
+	}
+}
+
+void sim_put_se(struct sim_bits *bits, int32_t val)
+{
+	sim_put_ue(bits, val > 0 ? (uint32_t)val * 2 - 1 : (uint32_t)(-(int64_t)val) * 2);
+}
+
+void sim_put_trailing_bits(struct sim_bits *bits)
+{
+	sim_put_bits(bits, 1, 1);
+	sim_bits_flush(bits);
+}
+
+void sim_bits_flush(struct sim_bits *bits)
+{
+	if (bits->num_bits)
+		sim_put_bits(bits, 8 - bits->num_bits, 0);
+}
+
+void sim_write_nal(struct darray *dst, struct sim_bits *bits)
+{
+	static const uint8_t start_code[4] = {0, 0, 0, 1};
+	static const uint8_t emulation_prevention = 3;
+	int zeros = 0;
+
+	sim_bits_flush(bits);
+	darray_push_back_array(sizeof(uint8_t), dst, start_code, sizeof(start_code));
+
+	for (size_t i = 0; i < bits->data.num; i++) {
+		uint8_t val = bits->data.array[i];
+
+		if (zeros == 2 && val <= 3) {
+			darray_push_back(sizeof(uint8_t), dst, &emulation_prevention);
+			zeros = 0;
+		}
+
+		darray_push_back(sizeof(uint8_t), dst, &val);
+		zeros = val ? 0 : zeros + 1;
+	}
+}
+
+void sim_write_obu_header(struct darray *dst, int type, size_t payload_size)
+{
+	/* obu_type, obu_has_size_field */
+	uint8_t val = (uint8_t)((type << 3) | 0x02);
+	darray_push_back(sizeof(uint8_t), dst, &val);
+
+	do {
+		val = payload_size & 0x7f;
+		payload_size >>= 7;
+		if (payload_size)
+			val |= 0x80;
+		darray_push_back(sizeof(uint8_t), dst, &val);
+	} while (payload_size);
+}
+
+void sim_write_obu(struct darray *dst, int type, const uint8_t *payload, size_t size)
+{
+	sim_write_obu_header(dst, type, size);
+	darray_push_back_array(sizeof(uint8_t), dst, payload, size);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Levels */
+
+static inline double frame_rate(const struct sim_video_params *params)
+{
+	return (double)params->fps_num / (double)params->fps_den;
+}
+
+struct h264_level {
+	int level_idc;
+	uint32_t max_mbps;
+	uint32_t max_fs;
+};
+
+static const struct h264_level h264_levels[] = {
+	{31, 108000, 3600},   {32, 216000, 5120},    {40, 245760, 8192},    {42, 522240, 8704},
+	{50, 589824, 22080},  {51, 983040, 36864},   {52, 2073600, 36864},  {60, 4177920, 139264},
+	{61, 8355840, 139264}, {62, 16711680, 139264},
+};
+
+static int h264_level_idc(const struct sim_video_params *params)
+{
+	uint32_t fs = ((params->width + 15) / 16) * ((params->height + 15) / 16);
+	double mbps = fs * frame_rate(params);
+
+	for (size_t i = 0; i < sizeof(h264_levels) / sizeof(h264_levels[0]); i++) {
+		if (fs <= h264_levels[i].max_fs && mbps <= h264_levels[i].max_mbps)
+			return h264_levels[i].level_idc;
+	}
+
+	return 62;
+}
+
+/* HEVC and AV1 share picture size and sample rate limits */
+struct sample_level {
+	int hevc_level_idc;
+	int av1_seq_level_idx;
+	uint64_t max_pic_size;
+	uint64_t max_sample_rate;
+};
+
+static const struct sample_level sample_levels[] = {
+	{93, 5, 983040, 33177600},         {120, 8, 2228224, 66846720},      {123, 9, 2228224, 133693440},
+	{150, 12, 8912896, 267386880},     {153, 13, 8912896, 534773760},    {156, 14, 8912896, 1069547520},
+	{183, 17, 35651584, 1069547520},   {186, 18, 35651584, 2139095040},
+};
+
+static const struct sample_level *get_sample_level(const struct sim_video_params *params)
+{
+	const size_t count = sizeof(sample_levels) / sizeof(sample_levels[0]);
+	uint64_t pic_size = (uint64_t)params->width * params->height;
+	double sample_rate = pic_size * frame_rate(params);
+
+	for (size_t i = 0; i < count; i++) {
+		if (pic_size <= sample_levels[i].max_pic_size && sample_rate <= sample_levels[i].max_sample_rate)
+			return &sample_levels[i];
+	}
+
+	return &sample_levels[count - 1];
+}
+
+/* ------------------------------------------------------------------------- */
+/* H.264 */
+
+static void put_h264_vui(struct sim_bits *bits, const struct sim_video_params *params, uint32_t max_refs)
+{
+	sim_put_bits(bits, 1, 0); // aspect_ratio_info_present_flag
+	sim_put_bits(bits, 1, 0); // overscan_info_present_flag
+
+	sim_put_bits(bits, 1, 1); // video_signal_type_present_flag
+	sim_put_bits(bits, 3, 5); // video_format (unspecified)
+	sim_put_bits(bits, 1, params->full_range);
+	sim_put_bits(bits, 1, 1); // colour_description_present_flag
+	sim_put_bits(bits, 8, 1); // colour_primaries (BT.709)
+	sim_put_bits(bits, 8, 1); // transfer_characteristics
+	sim_put_bits(bits, 8, 1); // matrix_coefficients
+
+	sim_put_bits(bits, 1, 0); // chroma_loc_info_present_flag
+
+	sim_put_bits(bits, 1, 1); // timing_info_present_flag
+	sim_put_bits(bits, 32, params->fps_den);
+	sim_put_bits(bits, 32, params->fps_num * 2);
+	sim_put_bits(bits, 1, 1); // fixed_frame_rate_flag
+
+	sim_put_bits(bits, 1, 0); // nal_hrd_parameters_present_flag
+	sim_put_bits(bits, 1, 0); // vcl_hrd_parameters_present_flag
+	sim_put_bits(bits, 1, 0); // pic_struct_present_flag
+
+	sim_put_bits(bits, 1, 1);                  // bitstream_restriction_flag
+	sim_put_bits(bits, 1, 1);                  // motion_vectors_over_pic_boundaries_flag
+	sim_put_ue(bits, 0);                       // max_bytes_per_pic_denom
+	sim_put_ue(bits, 0);                       // max_bits_per_mb_denom
+	sim_put_ue(bits, 16);                      // log2_max_mv_length_horizontal
+	sim_put_ue(bits, 16);                      // log2_max_mv_length_vertical
+	sim_put_ue(bits, params->bframes ? 1 : 0); // max_num_reorder_frames
+	sim_put_ue(bits, max_refs);                // max_dec_frame_buffering
+}
+
+void sim_write_h264_headers(struct darray *dst, const struct sim_video_params *params)
+{
+	uint32_t mb_width = (params->width + 15) / 16;
+	uint32_t mb_height = (params->height + 15) / 16;
+	uint32_t crop_right = (mb_width * 16 - params->width) / 2;
+	uint32_t crop_bottom = (mb_height * 16 - params->height) / 2;
+	uint32_t max_refs = params->bframes ? 2 : 1;
+	struct sim_bits bits;
+
+	sim_bits_init(&bits);
+
+	/* SPS */
+	sim_put_bits(&bits, 8, 0x67);                   // nal_ref_idc 3, nal_unit_type 7
+	sim_put_bits(&bits, 8, 100);                    // profile_idc (High)
+	sim_put_bits(&bits, 8, 0);                      // constraint_set flags
+	sim_put_bits(&bits, 8, h264_level_idc(params)); // level_idc
+	sim_put_ue(&bits, 0);                           // seq_parameter_set_id
+	sim_put_ue(&bits, 1);                           // chroma_format_idc (4:2:0)
+	sim_put_ue(&bits, 0);                           // bit_depth_luma_minus8
+	sim_put_ue(&bits, 0);                           // bit_depth_chroma_minus8
+	sim_put_bits(&bits, 1, 0);                      // qpprime_y_zero_transform_bypass_flag
+	sim_put_bits(&bits, 1, 0);                      // seq_scaling_matrix_present_flag
+	sim_put_ue(&bits, 0);                           // log2_max_frame_num_minus4
+	sim_put_ue(&bits, 0);                           // pic_order_cnt_type
+	sim_put_ue(&bits, 4);                           // log2_max_pic_order_cnt_lsb_minus4
+	sim_put_ue(&bits, max_refs);                    // max_num_ref_frames
+	sim_put_bits(&bits, 1, 0);                      // gaps_in_frame_num_value_allowed_flag
+	sim_put_ue(&bits, mb_width - 1);                // pic_width_in_mbs_minus1
+	sim_put_ue(&bits, mb_height - 1);               // pic_height_in_map_units_minus1
+	sim_put_bits(&bits, 1, 1);                      // frame_mbs_only_flag
+	sim_put_bits(&bits, 1, 1);                      // direct_8x8_inference_flag
+
+	sim_put_bits(&bits, 1, crop_right || crop_bottom); // frame_cropping_flag
+	if (crop_right || crop_bottom) {
+		sim_put_ue(&bits, 0);
+		sim_put_ue(&bits, crop_right);
+		sim_put_ue(&bits, 0);
+		sim_put_ue(&bits, crop_bottom);
+	}
+
+	sim_put_bits(&bits, 1, 1); // vui_parameters_present_flag
+	put_h264_vui(&bits, params, max_refs);
+	sim_put_trailing_bits(&bits);
+	sim_write_nal(dst, &bits);
+
+	/* PPS */
+	sim_bits_reset(&bits);
+	sim_put_bits(&bits, 8, 0x68); // nal_ref_idc 3, nal_unit_type 8
+	sim_put_ue(&bits, 0);         // pic_parameter_set_id
+	sim_put_ue(&bits, 0);         // seq_parameter_set_id
+	sim_put_bits(&bits, 1, 1);    // entropy_coding_mode_flag
+	sim_put_bits(&bits, 1, 0);    // bottom_field_pic_order_in_frame_present_flag
+	sim_put_ue(&bits, 0);         // num_slice_groups_minus1
+	sim_put_ue(&bits, 0);         // num_ref_idx_l0_default_active_minus1
+	sim_put_ue(&bits, 0);         // num_ref_idx_l1_default_active_minus1
+	sim_put_bits(&bits, 1, 0);    // weighted_pred_flag
+	sim_put_bits(&bits, 2, 0);    // weighted_bipred_idc
+	sim_put_se(&bits, 0);         // pic_init_qp_minus26
+	sim_put_se(&bits, 0);         // pic_init_qs_minus26
+	sim_put_se(&bits, 0);         // chroma_qp_index_offset
+	sim_put_bits(&bits, 1, 1);    // deblocking_filter_control_present_flag
+	sim_put_bits(&bits, 1, 0);    // constrained_intra_pred_flag
+	sim_put_bits(&bits, 1, 0);    // redundant_pic_cnt_present_flag
+	sim_put_bits(&bits, 1, 1);    // transform_8x8_mode_flag
+	sim_put_bits(&bits, 1, 0);    // pic_scaling_matrix_present_flag
+	sim_put_se(&bits, 0);         // second_chroma_qp_index_offset
+	sim_put_trailing_bits(&bits);
+	sim_write_nal(dst, &bits);
+
+	sim_bits_free(&bits);
+}
+
+/* ------------------------------------------------------------------------- */
+/* HEVC */
+
+static void put_hevc_profile_tier_level(struct sim_bits *bits, int level_idc)
+{
+	sim_put_bits(bits, 2, 0);           // general_profile_space
+	sim_put_bits(bits, 1, 0);           // general_tier_flag
+	sim_put_bits(bits, 5, 1);           // general_profile_idc (Main)
+	sim_put_bits(bits, 32, 0x60000000); // general_profile_compatibility_flags (Main, Main 10)
+	sim_put_bits(bits, 1, 1);           // general_progressive_source_flag
+	sim_put_bits(bits, 1, 0);           // general_interlaced_source_flag
+	sim_put_bits(bits, 1, 0);           // general_non_packed_constraint_flag
+	sim_put_bits(bits, 1, 1);           // general_frame_only_constraint_flag
+	sim_put_bits(bits, 32, 0);          // general_reserved_zero_43bits
+	sim_put_bits(bits, 11, 0);
+	sim_put_bits(bits, 1, 0);         // general_inbld_flag
+	sim_put_bits(bits, 8, level_idc); // general_level_idc
+}
+
+static inline void put_hevc_nal_header(struct sim_bits *bits, int type)
+{
+	sim_put_bits(bits, 1, 0);    // forbidden_zero_bit
+	sim_put_bits(bits, 6, type); // nal_unit_type
+	sim_put_bits(bits, 6, 0);    // nuh_layer_id
+	sim_put_bits(bits, 3, 1);    // nuh_temporal_id_plus1
+}
+
+static void put_hevc_vui(struct sim_bits *bits, const struct sim_video_params *params)
+{
+	sim_put_bits(bits, 1, 0); // aspect_ratio_info_present_flag
+	sim_put_bits(bits, 1, 0); // overscan_info_present_flag
+
+	sim_put_bits(bits, 1, 1); // video_signal_type_present_flag
+	sim_put_bits(bits, 3, 5); // video_format (unspecified)
+	sim_put_bits(bits, 1, params->full_range);
+	sim_put_bits(bits, 1, 1); // colour_description_present_flag
+	sim_put_bits(bits, 8, 1); // colour_primaries (BT.709)
+	sim_put_bits(bits, 8, 1); // transfer_characteristics
+	sim_put_bits(bits, 8, 1); // matrix_coeffs
+
+	sim_put_bits(bits, 1, 0); // chroma_loc_info_present_flag
+	sim_put_bits(bits, 1, 0); // neutral_chroma_indication_flag
+	sim_put_bits(bits, 1, 0); // field_seq_flag
+	sim_put_bits(bits, 1, 0); // frame_field_info_present_flag
+	sim_put_bits(bits, 1, 0); // default_display_window_flag
+
+	sim_put_bits(bits, 1, 1); // vui_timing_info_present_flag
+	sim_put_bits(bits, 32, params->fps_den);
+	sim_put_bits(bits, 32, params->fps_num);
+	sim_put_bits(bits, 1, 0); // vui_poc_proportional_to_timing_flag
+	sim_put_bits(bits, 1, 0); // vui_hrd_parameters_present_flag
+
+	sim_put_bits(bits, 1, 0); // bitstream_restriction_flag
+}
+
+void sim_write_hevc_headers(struct darray *dst, const struct sim_video_params *params)
+{
+	const int level_idc = get_sample_level(params)->hevc_level_idc;
+	const uint32_t max_dec_pic_buffering = params->bframes ? 2 : 1;
+	const uint32_t num_reorder = params->bframes ? 1 : 0;
+	uint32_t width = (params->width + 7) & ~7;
+	uint32_t height = (params->height + 7) & ~7;
+	struct sim_bits bits;
+
+	sim_bits_init(&bits);
+
+	/* VPS */
+	put_hevc_nal_header(&bits, 32);
+	sim_put_bits(&bits, 4, 0);       // vps_video_parameter_set_id
+	sim_put_bits(&bits, 1, 1);       // vps_base_layer_internal_flag
+	sim_put_bits(&bits, 1, 1);       // vps_base_layer_available_flag
+	sim_put_bits(&bits, 6, 0);       // vps_max_layers_minus1
+	sim_put_bits(&bits, 3, 0);       // vps_max_sub_layers_minus1
+	sim_put_bits(&bits, 1, 1);       // vps_temporal_id_nesting_flag
+	sim_put_bits(&bits, 16, 0xffff); // vps_reserved_0xffff_16bits
+	put_hevc_profile_tier_level(&bits, level_idc);
+	sim_put_bits(&bits, 1, 1); // vps_sub_layer_ordering_info_present_flag
+	sim_put_ue(&bits, max_dec_pic_buffering);
+	sim_put_ue(&bits, num_reorder);
+	sim_put_ue(&bits, 0);      // vps_max_latency_increase_plus1
+	sim_put_bits(&bits, 6, 0); // vps_max_layer_id
+	sim_put_ue(&bits, 0);      // vps_num_layer_sets_minus1
+	sim_put_bits(&bits, 1, 0); // vps_timing_info_present_flag
+	sim_put_bits(&bits, 1, 0); // vps_extension_flag
+	sim_put_trailing_bits(&bits);
+	sim_write_nal(dst, &bits);
+
+	/* SPS */
+	sim_bits_reset(&bits);
+	put_hevc_nal_header(&bits, 33);
+	sim_put_bits(&bits, 4, 0); // sps_video_parameter_set_id
+	sim_put_bits(&bits, 3, 0); // sps_max_sub_layers_minus1
+	sim_put_bits(&bits, 1, 1); // sps_temporal_id_nesting_flag
+	put_hevc_profile_tier_level(&bits, level_idc);
+	sim_put_ue(&bits, 0);      // sps_seq_parameter_set_id
+	sim_put_ue(&bits, 1);      // chroma_format_idc (4:2:0)
+	sim_put_ue(&bits, width);  // pic_width_in_luma_samples
+	sim_put_ue(&bits, height); // pic_height_in_luma_samples
+
+	sim_put_bits(&bits, 1, width != params->width || height != params->height); // conformance_window_flag
+	if (width != params->width || height != params->height) {
+		sim_put_ue(&bits, 0);
+		sim_put_ue(&bits, (width - params->width) / 2);
+		sim_put_ue(&bits, 0);
+		sim_put_ue(&bits, (height - params->height) / 2);
+	}
+
+	sim_put_ue(&bits, 0);      // bit_depth_luma_minus8
+	sim_put_ue(&bits, 0);      // bit_depth_chroma_minus8
+	sim_put_ue(&bits, 4);      // log2_max_pic_order_cnt_lsb_minus4
+	sim_put_bits(&bits, 1, 1); // sps_sub_layer_ordering_info_present_flag
+	sim_put_ue(&bits, max_dec_pic_buffering);
+	sim_put_ue(&bits, num_reorder);
+	sim_put_ue(&bits, 0);      // sps_max_latency_increase_plus1
+	sim_put_ue(&bits, 0);      // log2_min_luma_coding_block_size_minus3
+	sim_put_ue(&bits, 3);      // log2_diff_max_min_luma_coding_block_size
+	sim_put_ue(&bits, 0);      // log2_min_luma_transform_block_size_minus2
+	sim_put_ue(&bits, 3);      // log2_diff_max_min_luma_transform_block_size
+	sim_put_ue(&bits, 1);      // max_transform_hierarchy_depth_inter
+	sim_put_ue(&bits, 1);      // max_transform_hierarchy_depth_intra
+	sim_put_bits(&bits, 1, 0); // scaling_list_enabled_flag
+	sim_put_bits(&bits, 1, 0); // amp_enabled_flag
+	sim_put_bits(&bits, 1, 1); // sample_adaptive_offset_enabled_flag
+	sim_put_bits(&bits, 1, 0); // pcm_enabled_flag
+	sim_put_ue(&bits, 0);      // num_short_term_ref_pic_sets
+	sim_put_bits(&bits, 1, 0); // long_term_ref_pics_present_flag
+	sim_put_bits(&bits, 1, 1); // sps_temporal_mvp_enabled_flag
+	sim_put_bits(&bits, 1, 1); // strong_intra_smoothing_enabled_flag
+	sim_put_bits(&bits, 1, 1); // vui_parameters_present_flag
+	put_hevc_vui(&bits, params);
+	sim_put_bits(&bits, 1, 0); // sps_extension_present_flag
+	sim_put_trailing_bits(&bits);
+	sim_write_nal(dst, &bits);
+
+	/* PPS */
+	sim_bits_reset(&bits);
+	put_hevc_nal_header(&bits, 34);
+	sim_put_ue(&bits, 0);      // pps_pic_parameter_set_id
+	sim_put_ue(&bits, 0);      // pps_seq_parameter_set_id
+	sim_put_bits(&bits, 1, 0); // dependent_slice_segments_enabled_flag
+	sim_put_bits(&bits, 1, 0); // output_flag_present_flag
+	sim_put_bits(&bits, 3, 0); // num_extra_slice_header_bits
+	sim_put_bits(&bits, 1, 0); // sign_data_hiding_enabled_flag
+	sim_put_bits(&bits, 1, 0); // cabac_init_present_flag
+	sim_put_ue(&bits, 0);      // num_ref_idx_l0_default_active_minus1
+	sim_put_ue(&bits, 0);      // num_ref_idx_l1_default_active_minus1
+	sim_put_se(&bits, 0);      // init_qp_minus26
+	sim_put_bits(&bits, 1, 0); // constrained_intra_pred_flag
+	sim_put_bits(&bits, 1, 0); // transform_skip_enabled_flag
+	sim_put_bits(&bits, 1, 0); // cu_qp_delta_enabled_flag
+	sim_put_se(&bits, 0);      // pps_cb_qp_offset
+	sim_put_se(&bits, 0);      // pps_cr_qp_offset
+	sim_put_bits(&bits, 1, 0); // pps_slice_chroma_qp_offsets_present_flag
+	sim_put_bits(&bits, 1, 0); // weighted_pred_flag
+	sim_put_bits(&bits, 1, 0); // weighted_bipred_flag
+	sim_put_bits(&bits, 1, 0); // transquant_bypass_enabled_flag
+	sim_put_bits(&bits, 1, 0); // tiles_enabled_flag
+	sim_put_bits(&bits, 1, 0); // entropy_coding_sync_enabled_flag
+	sim_put_bits(&bits, 1, 0); // pps_loop_filter_across_slices_enabled_flag
+	sim_put_bits(&bits, 1, 0); // deblocking_filter_control_present_flag
+	sim_put_bits(&bits, 1, 0); // pps_scaling_list_data_present_flag
+	sim_put_bits(&bits, 1, 0); // lists_modification_present_flag
+	sim_put_ue(&bits, 0);      // log2_parallel_merge_level_minus2
+	sim_put_bits(&bits, 1, 0); // slice_segment_header_extension_present_flag
+	sim_put_bits(&bits, 1, 0); // pps_extension_present_flag
+	sim_put_trailing_bits(&bits);
+	sim_write_nal(dst, &bits);
+
+	sim_bits_free(&bits);
+}
+
+/* ------------------------------------------------------------------------- */
+/* AV1 */
+
+#define AV1_OBU_SEQUENCE_HEADER 1
+
+void sim_write_av1_sequence_header(struct darray *dst, const struct sim_video_params *params)
+{
+	struct sim_bits bits;
+
+	sim_bits_init(&bits);
+
+	int seq_level_idx = get_sample_level(params)->av1_seq_level_idx;
+
+	sim_put_bits(&bits, 3, 0);             // seq_profile (Main)
+	sim_put_bits(&bits, 1, 0);             // still_picture
+	sim_put_bits(&bits, 1, 0);             // reduced_still_picture_header
+	sim_put_bits(&bits, 1, 0);             // timing_info_present_flag
+	sim_put_bits(&bits, 1, 0);             // initial_display_delay_present_flag
+	sim_put_bits(&bits, 5, 0);             // operating_points_cnt_minus_1
+	sim_put_bits(&bits, 12, 0);            // operating_point_idc[0]
+	sim_put_bits(&bits, 5, seq_level_idx); // seq_level_idx[0]
+	if (seq_level_idx > 7)
+		sim_put_bits(&bits, 1, 0); // seq_tier[0]
+
+	sim_put_bits(&bits, 4, 15);                  // frame_width_bits_minus_1
+	sim_put_bits(&bits, 4, 15);                  // frame_height_bits_minus_1
+	sim_put_bits(&bits, 16, params->width - 1);  // max_frame_width_minus_1
+	sim_put_bits(&bits, 16, params->height - 1); // max_frame_height_minus_1
+
+	sim_put_bits(&bits, 1, 0); // frame_id_numbers_present_flag
+	sim_put_bits(&bits, 1, 0); // use_128x128_superblock
+	sim_put_bits(&bits, 1, 0); // enable_filter_intra
+	sim_put_bits(&bits, 1, 0); // enable_intra_edge_filter
+	sim_put_bits(&bits, 1, 0); // enable_interintra_compound
+	sim_put_bits(&bits, 1, 0); // enable_masked_compound
+	sim_put_bits(&bits, 1, 0); // enable_warped_motion
+	sim_put_bits(&bits, 1, 0); // enable_dual_filter
+	sim_put_bits(&bits, 1, 1); // enable_order_hint
+	sim_put_bits(&bits, 1, 0); // enable_jnt_comp
+	sim_put_bits(&bits, 1, 0); // enable_ref_frame_mvs
+	sim_put_bits(&bits, 1, 0); // seq_choose_screen_content_tools
+	sim_put_bits(&bits, 1, 0); // seq_force_screen_content_tools
+	sim_put_bits(&bits, 3, 6); // order_hint_bits_minus_1
+	sim_put_bits(&bits, 1, 0); // enable_superres
+	sim_put_bits(&bits, 1, 0); // enable_cdef
+	sim_put_bits(&bits, 1, 0); // enable_restoration
+
+	/* color_config */
+	sim_put_bits(&bits, 1, 0); // high_bitdepth
+	sim_put_bits(&bits, 1, 0); // mono_chrome
+	sim_put_bits(&bits, 1, 1); // color_description_present_flag
+	sim_put_bits(&bits, 8, 1); // color_primaries (BT.709)
+	sim_put_bits(&bits, 8, 1); // transfer_characteristics
+	sim_put_bits(&bits, 8, 1); // matrix_coefficients
+	sim_put_bits(&bits, 1, params->full_range);
+	sim_put_bits(&bits, 2, 0); // chroma_sample_position
+	sim_put_bits(&bits, 1, 0); // separate_uv_delta_q
+
+	sim_put_bits(&bits, 1, 0); // film_grain_params_present
+	sim_put_trailing_bits(&bits);
+
+	sim_write_obu(dst, AV1_OBU_SEQUENCE_HEADER, bits.data.array, bits.data.num);
+	sim_bits_free(&bits);
+}
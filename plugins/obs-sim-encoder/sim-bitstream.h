@@ -0,0 +1,60 @@
+#pragma once
+
+#include <util/darray.h>
+
+/* MSB first bit writer for parameter sets and frame headers */
+struct sim_bits {
+	DARRAY(uint8_t) data;
+	uint8_t cur;
+	int num_bits;
+};
+
+static inline void sim_bits_init(struct sim_bits *bits)
+{
+	da_init(bits->data);
+	bits->cur = 0;
+	bits->num_bits = 0;
+}
+
+static inline void sim_bits_reset(struct sim_bits *bits)
+{
+	da_resize(bits->data, 0);
+	bits->cur = 0;
+	bits->num_bits = 0;
+}
+
+static inline void sim_bits_free(struct sim_bits *bits)
+{
+	da_free(bits->data);
+}
+
+extern void sim_put_bits(struct sim_bits *bits, int count, uint32_t val);
+extern void sim_put_ue(struct sim_bits *bits, uint32_t val);
+extern void sim_put_se(struct sim_bits *bits, int32_t val);
+
+/* rbsp_trailing_bits() for H.264/HEVC, trailing_bits() for AV1 */
+extern void sim_put_trailing_bits(struct sim_bits *bits);
+
+/* pads the last byte with zeros */
+extern void sim_bits_flush(struct sim_bits *bits);
+
+/* Appends the NAL unit in bits (header included) to dst with a four byte
+ * start code, inserting emulation prevention bytes as needed */
+extern void sim_write_nal(struct darray *dst, struct sim_bits *bits);
+
+/* Appends an OBU with an obu_size field */
+extern void sim_write_obu(struct darray *dst, int type, const uint8_t *payload, size_t size);
+extern void sim_write_obu_header(struct darray *dst, int type, size_t payload_size);
+
+struct sim_video_params {
+	uint32_t width;
+	uint32_t height;
+	uint32_t fps_num;
+	uint32_t fps_den;
+	int bframes;
+	bool full_range;
+};
+
+extern void sim_write_h264_headers(struct darray *dst, const struct sim_video_params *params);
+extern void sim_write_hevc_headers(struct darray *dst, const struct sim_video_params *params);
+extern void sim_write_av1_sequence_header(struct darray *dst, const struct sim_video_params *params);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <obs-module.h>
+#include <util/darray.h>
+
+#define do_log(level, enc, format, ...) \
+	blog(level, "[sim encoder: '%s'] " format, obs_encoder_get_name(enc), ##__VA_ARGS__)
+
+#define warn(enc, format, ...) do_log(LOG_WARNING, enc, format, ##__VA_ARGS__)
+#define info(enc, format, ...) do_log(LOG_INFO, enc, format, ##__VA_ARGS__)
+
+/* ------------------------------------------------------------------------- */
+/* Deterministic pseudo random numbers, seeded from the encoder name so runs
+ * with the same encoders produce the same packet sizes */
+
+static inline uint64_t sim_rand_seed(const char *str)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (str && *str)
+		hash = (hash ^ (uint8_t)*(str++)) * 0x100000001b3ULL;
+
+	return hash ? hash : 1;
+}
+
+static inline uint64_t sim_rand(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* uniformly distributed in [-1, 1) */
+static inline double sim_rand_signed(uint64_t *state)
+{
+	return (double)(sim_rand(state) >> 11) / (double)(1ULL << 52) - 1.0;
+}
+
+extern struct obs_encoder_info sim_h264_encoder_info;
+extern struct obs_encoder_info sim_hevc_encoder_info;
+extern struct obs_encoder_info sim_av1_encoder_info;
+extern struct obs_encoder_info sim_aac_encoder_info;
+extern struct obs_encoder_info sim_opus_encoder_info;
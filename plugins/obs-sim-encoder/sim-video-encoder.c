@@ -0,0 +1,548 @@
+#include <util/deque.h>
+#include <util/dstr.h>
+#include <obs-nal.h>
+
+#include "sim-encoder.h"
+#include "sim-bitstream.h"
+
+#define MAX_BFRAMES 4
+
+/* Relative frame sizes, roughly what x264 produces at the medium preset for
+ * typical game and desktop content */
+#define KEYFRAME_WEIGHT 6.0
+#define PFRAME_WEIGHT 1.0
+#define BFRAME_WEIGHT 0.5
+
+#define MIN_FRAME_SIZE 32
+
+/* Filler for frame payloads.  Never contains zero bytes, so it can't emulate
+ * an Annex-B start code */
+#define FILLER_SIZE 65536
+
+struct sim_filler {
+	uint8_t data[FILLER_SIZE];
+	uint64_t rand;
+};
+
+#define TEXT_BITRATE obs_module_text("Bitrate")
+#define TEXT_KEYINT_SEC obs_module_text("KeyframeIntervalSec")
+#define TEXT_BFRAMES obs_module_text("BFrames")
+#define TEXT_JITTER obs_module_text("SizeJitter")
+
+enum sim_codec {
+	SIM_CODEC_H264,
+	SIM_CODEC_HEVC,
+	SIM_CODEC_AV1,
+};
+
+enum sim_frame_type {
+	SIM_FRAME_I,
+	SIM_FRAME_P,
+	SIM_FRAME_B,
+};
+
+struct sim_frame {
+	int64_t pts;
+	enum sim_frame_type type;
+	uint32_t gop_idx;
+};
+
+struct sim_video {
+	obs_encoder_t *encoder;
+	enum sim_codec codec;
+	struct sim_video_params params;
+
+	int64_t pts_step;
+	uint32_t keyint;
+	double frame_bytes[3];
+	double jitter;
+
+	/* frames of the current mini GOP in presentation order, and frames
+	 * ready for output in decode order */
+	DARRAY(struct sim_frame) pending;
+	struct deque output;
+	struct deque dts;
+	int64_t last_dts;
+	bool first_dts;
+
+	uint32_t frame_idx;
+	uint32_t frame_num;
+
+	uint64_t rand;
+	struct sim_filler filler;
+
+	DARRAY(uint8_t) header;
+	DARRAY(uint8_t) packet;
+};
+
+static void sim_filler_init(struct sim_filler *filler, uint64_t seed)
+{
+	filler->rand = seed;
+
+	for (size_t i = 0; i < FILLER_SIZE; i++)
+		filler->data[i] = (uint8_t)(sim_rand(&filler->rand) % 255 + 1);
+}
+
+static void sim_filler_append(struct sim_filler *filler, struct darray *dst, size_t size)
+{
+	while (size) {
+		size_t offset = (size_t)(sim_rand(&filler->rand) % FILLER_SIZE);
+		size_t count = FILLER_SIZE - offset;
+		if (count > size)
+			count = size;
+
+		darray_push_back_array(sizeof(uint8_t), dst, filler->data + offset, count);
+		size -= count;
+	}
+}
+
+static const char *sim_h264_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("SimEncoder.H264");
+}
+
+static const char *sim_hevc_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("SimEncoder.HEVC");
+}
+
+static const char *sim_av1_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("SimEncoder.AV1");
+}
+
+static void sim_video_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "bitrate", 6000);
+	obs_data_set_default_int(settings, "keyint_sec", 2);
+	obs_data_set_default_int(settings, "bframes", 2);
+	obs_data_set_default_int(settings, "jitter", 15);
+}
+
+static obs_properties_t *sim_video_props(bool bframes)
+{
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+
+	p = obs_properties_add_int(props, "bitrate", TEXT_BITRATE, 50, 10000000, 50);
+	obs_property_int_set_suffix(p, " Kbps");
+
+	p = obs_properties_add_int(props, "keyint_sec", TEXT_KEYINT_SEC, 1, 20, 1);
+	obs_property_int_set_suffix(p, " s");
+
+	if (bframes)
+		obs_properties_add_int(props, "bframes", TEXT_BFRAMES, 0, MAX_BFRAMES, 1);
+
+	p = obs_properties_add_int_slider(props, "jitter", TEXT_JITTER, 0, 100, 1);
+	obs_property_int_set_suffix(p, "%");
+
+	return props;
+}
+
+static obs_properties_t *sim_h264_props(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return sim_video_props(true);
+}
+
+static obs_properties_t *sim_av1_props(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return sim_video_props(false);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void update_frame_sizes(struct sim_video *enc, obs_data_t *settings)
+{
+	const double fps = (double)enc->params.fps_num / (double)enc->params.fps_den;
+	const double bytes_per_frame = (double)obs_data_get_int(settings, "bitrate") * 1000.0 / 8.0 / fps;
+	const uint32_t frames = enc->keyint - 1;
+	const uint32_t bframes = frames * enc->params.bframes / (enc->params.bframes + 1);
+	const uint32_t pframes = frames - bframes;
+
+	/* scale the weights so the average over a GOP hits the bitrate */
+	double scale = bytes_per_frame * enc->keyint /
+		       (KEYFRAME_WEIGHT + pframes * PFRAME_WEIGHT + bframes * BFRAME_WEIGHT);
+
+	enc->frame_bytes[SIM_FRAME_I] = KEYFRAME_WEIGHT * scale;
+	enc->frame_bytes[SIM_FRAME_P] = PFRAME_WEIGHT * scale;
+	enc->frame_bytes[SIM_FRAME_B] = BFRAME_WEIGHT * scale;
+	enc->jitter = (double)obs_data_get_int(settings, "jitter") / 100.0;
+}
+
+static bool sim_video_update(void *data, obs_data_t *settings)
+{
+	struct sim_video *enc = data;
+
+	update_frame_sizes(enc, settings);
+	return true;
+}
+
+static void sim_video_destroy(void *data)
+{
+	struct sim_video *enc = data;
+
+	if (!enc)
+		return;
+
+	da_free(enc->pending);
+	deque_free(&enc->output);
+	deque_free(&enc->dts);
+	da_free(enc->header);
+	da_free(enc->packet);
+	bfree(enc);
+}
+
+static void *sim_video_create(obs_data_t *settings, obs_encoder_t *encoder, enum sim_codec codec)
+{
+	video_t *video = obs_encoder_video(encoder);
+	const struct video_output_info *voi = video_output_get_info(video);
+	const struct video_output_info *parent_voi = video_output_get_info(obs_encoder_parent_video(encoder));
+	uint32_t divisor = obs_encoder_get_frame_rate_divisor(encoder);
+	struct dstr seed = {0};
+
+	struct sim_video *enc = bzalloc(sizeof(struct sim_video));
+	enc->encoder = encoder;
+	enc->codec = codec;
+
+	enc->params.width = obs_encoder_get_width(encoder);
+	enc->params.height = obs_encoder_get_height(encoder);
+	enc->params.fps_num = parent_voi->fps_num;
+	enc->params.fps_den = parent_voi->fps_den * (divisor ? divisor : 1);
+	enc->params.full_range = voi->range == VIDEO_RANGE_FULL;
+
+	/* AV1 encoders use hidden frames rather than reordering, packets are
+	 * always in presentation order */
+	if (codec != SIM_CODEC_AV1)
+		enc->params.bframes = (int)obs_data_get_int(settings, "bframes");
+	if (enc->params.bframes < 0)
+		enc->params.bframes = 0;
+	else if (enc->params.bframes > MAX_BFRAMES)
+		enc->params.bframes = MAX_BFRAMES;
+
+	enc->pts_step = (int64_t)enc->params.fps_den;
+	enc->keyint = (uint32_t)(obs_data_get_int(settings, "keyint_sec") * enc->params.fps_num / enc->params.fps_den);
+	if (enc->keyint < 1)
+		enc->keyint = 1;
+
+	update_frame_sizes(enc, settings);
+
+	dstr_printf(&seed, "%s:%d", obs_encoder_get_name(encoder), (int)codec);
+	enc->rand = sim_rand_seed(seed.array);
+	sim_filler_init(&enc->filler, enc->rand);
+	dstr_free(&seed);
+
+	if (codec == SIM_CODEC_H264)
+		sim_write_h264_headers(&enc->header.da, &enc->params);
+	else if (codec == SIM_CODEC_HEVC)
+		sim_write_hevc_headers(&enc->header.da, &enc->params);
+	else
+		sim_write_av1_sequence_header(&enc->header.da, &enc->params);
+
+	info(encoder,
+	     "settings:\n"
+	     "\tbitrate:     %d\n"
+	     "\tkeyint:      %u\n"
+	     "\tbframes:     %d\n"
+	     "\tjitter:      %d%%\n"
+	     "\twidth:       %u\n"
+	     "\theight:      %u",
+	     (int)obs_data_get_int(settings, "bitrate"), enc->keyint, enc->params.bframes,
+	     (int)obs_data_get_int(settings, "jitter"), enc->params.width, enc->params.height);
+
+	return enc;
+}
+
+static void *sim_h264_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	return sim_video_create(settings, encoder, SIM_CODEC_H264);
+}
+
+static void *sim_hevc_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	return sim_video_create(settings, encoder, SIM_CODEC_HEVC);
+}
+
+static void *sim_av1_create(obs_data_t *settings, obs_encoder_t *encoder)
+{
+	return sim_video_create(settings, encoder, SIM_CODEC_AV1);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Frame headers, followed by filler instead of actual slice/tile data */
+
+static void write_h264_frame(struct sim_video *enc, const struct sim_frame *frame, size_t size)
+{
+	static const uint32_t slice_types[] = {7, 5, 6};
+	const bool idr = frame->type == SIM_FRAME_I;
+	const bool ref = frame->type != SIM_FRAME_B;
+	struct sim_bits bits;
+
+	if (idr)
+		enc->frame_num = 0;
+
+	sim_bits_init(&bits);
+	sim_put_bits(&bits, 1, 0);                       // forbidden_zero_bit
+	sim_put_bits(&bits, 2, idr ? 3 : (ref ? 2 : 0)); // nal_ref_idc
+	sim_put_bits(&bits, 5, idr ? 5 : 1);             // nal_unit_type
+	sim_put_ue(&bits, 0);                            // first_mb_in_slice
+	sim_put_ue(&bits, slice_types[frame->type]);     // slice_type
+	sim_put_ue(&bits, 0);                            // pic_parameter_set_id
+	sim_put_bits(&bits, 4, enc->frame_num);          // frame_num
+	if (idr)
+		sim_put_ue(&bits, 0); // idr_pic_id
+	sim_put_bits(&bits, 8, (frame->gop_idx * 2) & 0xff); // pic_order_cnt_lsb
+	sim_put_bits(&bits, 1, 1);
+	sim_write_nal(&enc->packet.da, &bits);
+	sim_bits_free(&bits);
+
+	if (ref)
+		enc->frame_num = (enc->frame_num + 1) & 15;
+
+	if (enc->packet.num < size)
+		sim_filler_append(&enc->filler, &enc->packet.da, size - enc->packet.num);
+}
+
+static void write_hevc_frame(struct sim_video *enc, const struct sim_frame *frame, size_t size)
+{
+	/* IDR_W_RADL, TRAIL_R, TRAIL_N */
+	static const uint32_t nal_types[] = {19, 1, 0};
+	static const uint32_t slice_types[] = {2, 1, 0};
+	struct sim_bits bits;
+
+	sim_bits_init(&bits);
+	sim_put_bits(&bits, 1, 0);                      // forbidden_zero_bit
+	sim_put_bits(&bits, 6, nal_types[frame->type]); // nal_unit_type
+	sim_put_bits(&bits, 6, 0);                      // nuh_layer_id
+	sim_put_bits(&bits, 3, 1);                      // nuh_temporal_id_plus1
+	sim_put_bits(&bits, 1, 1);                      // first_slice_segment_in_pic_flag
+	if (frame->type == SIM_FRAME_I)
+		sim_put_bits(&bits, 1, 0); // no_output_of_prior_pics_flag
+	sim_put_ue(&bits, 0);                        // slice_pic_parameter_set_id
+	sim_put_ue(&bits, slice_types[frame->type]); // slice_type
+	if (frame->type != SIM_FRAME_I)
+		sim_put_bits(&bits, 8, frame->gop_idx & 0xff); // slice_pic_order_cnt_lsb
+	sim_put_bits(&bits, 1, 1);
+	sim_write_nal(&enc->packet.da, &bits);
+	sim_bits_free(&bits);
+
+	if (enc->packet.num < size)
+		sim_filler_append(&enc->filler, &enc->packet.da, size - enc->packet.num);
+}
+
+#define AV1_OBU_TEMPORAL_DELIMITER 2
+#define AV1_OBU_FRAME 6
+
+static void write_av1_frame(struct sim_video *enc, const struct sim_frame *frame, size_t size)
+{
+	const bool key = frame->type == SIM_FRAME_I;
+	struct sim_bits bits;
+
+	sim_write_obu_header(&enc->packet.da, AV1_OBU_TEMPORAL_DELIMITER, 0);
+	if (key)
+		da_push_back_array(enc->packet, enc->header.array, enc->header.num);
+
+	sim_bits_init(&bits);
+	sim_put_bits(&bits, 1, 0);           // show_existing_frame
+	sim_put_bits(&bits, 2, key ? 0 : 1); // frame_type
+	sim_put_bits(&bits, 1, 1);           // show_frame
+	if (!key)
+		sim_put_bits(&bits, 1, 0); // error_resilient_mode
+	sim_put_bits(&bits, 1, 0);                     // disable_cdf_update
+	sim_put_bits(&bits, 1, 0);                     // frame_size_override_flag
+	sim_put_bits(&bits, 7, frame->gop_idx & 0x7f); // order_hint
+	if (!key)
+		sim_put_bits(&bits, 3, 0); // primary_ref_frame
+	sim_bits_flush(&bits);
+
+	size_t header_size = enc->packet.num + bits.data.num + 4;
+	size_t payload = size > header_size ? size - header_size : 0;
+
+	sim_write_obu_header(&enc->packet.da, AV1_OBU_FRAME, bits.data.num + payload);
+	da_push_back_array(enc->packet, bits.data.array, bits.data.num);
+	sim_filler_append(&enc->filler, &enc->packet.da, payload);
+	sim_bits_free(&bits);
+}
+
+static void write_frame(struct sim_video *enc, const struct sim_frame *frame)
+{
+	double size = enc->frame_bytes[frame->type] * (1.0 + enc->jitter * sim_rand_signed(&enc->rand));
+	size_t bytes = size > MIN_FRAME_SIZE ? (size_t)size : MIN_FRAME_SIZE;
+
+	da_resize(enc->packet, 0);
+
+	if (enc->codec == SIM_CODEC_H264)
+		write_h264_frame(enc, frame, bytes);
+	else if (enc->codec == SIM_CODEC_HEVC)
+		write_hevc_frame(enc, frame, bytes);
+	else
+		write_av1_frame(enc, frame, bytes);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* moves the pending mini GOP to the output queue in decode order: the
+ * reference frame that ends it first, then the B frames before it */
+static void flush_pending(struct sim_video *enc)
+{
+	if (!enc->pending.num)
+		return;
+
+	struct sim_frame *last = &enc->pending.array[enc->pending.num - 1];
+	if (last->type == SIM_FRAME_B)
+		last->type = SIM_FRAME_P;
+
+	deque_push_back(&enc->output, last, sizeof(*last));
+	for (size_t i = 0; i + 1 < enc->pending.num; i++)
+		deque_push_back(&enc->output, &enc->pending.array[i], sizeof(struct sim_frame));
+
+	da_resize(enc->pending, 0);
+}
+
+static void queue_frame(struct sim_video *enc, int64_t pts)
+{
+	uint32_t gop_idx = enc->frame_idx % enc->keyint;
+	struct sim_frame frame = {.pts = pts, .gop_idx = gop_idx};
+
+	if (gop_idx == 0) {
+		frame.type = SIM_FRAME_I;
+		flush_pending(enc);
+		deque_push_back(&enc->output, &frame, sizeof(frame));
+
+	} else {
+		frame.type = (gop_idx % (enc->params.bframes + 1)) == 0 ? SIM_FRAME_P : SIM_FRAME_B;
+		da_push_back(enc->pending, &frame);
+
+		/* GOPs are closed, so the last frame always is a reference */
+		if (frame.type == SIM_FRAME_P || gop_idx == enc->keyint - 1)
+			flush_pending(enc);
+	}
+
+	enc->frame_idx++;
+}
+
+/* same as the nal_ref_idc of the slices, like x264 reports it */
+static inline int get_priority(enum sim_frame_type type)
+{
+	switch (type) {
+	case SIM_FRAME_I:
+		return OBS_NAL_PRIORITY_HIGHEST;
+	case SIM_FRAME_P:
+		return OBS_NAL_PRIORITY_HIGH;
+	case SIM_FRAME_B:
+		break;
+	}
+
+	return OBS_NAL_PRIORITY_DISPOSABLE;
+}
+
+static bool sim_video_encode(void *data, struct encoder_frame *frame, struct encoder_packet *packet,
+			     bool *received_packet)
+{
+	struct sim_video *enc = data;
+	struct sim_frame out;
+
+	if (!enc->first_dts) {
+		enc->last_dts = enc->params.bframes ? frame->pts - enc->pts_step : frame->pts;
+		enc->first_dts = true;
+	}
+
+	deque_push_back(&enc->dts, &frame->pts, sizeof(frame->pts));
+	queue_frame(enc, frame->pts);
+
+	if (!enc->output.size) {
+		*received_packet = false;
+		return true;
+	}
+
+	deque_pop_front(&enc->output, &out, sizeof(out));
+	write_frame(enc, &out);
+
+	/* with B frames, each packet is decoded at the presentation time of
+	 * the frame input before it, which keeps dts <= pts */
+	packet->dts = enc->last_dts;
+	deque_pop_front(&enc->dts, &enc->last_dts, sizeof(enc->last_dts));
+	if (!enc->params.bframes)
+		packet->dts = out.pts;
+
+	packet->data = enc->packet.array;
+	packet->size = enc->packet.num;
+	packet->type = OBS_ENCODER_VIDEO;
+	packet->pts = out.pts;
+	packet->keyframe = out.type == SIM_FRAME_I;
+	packet->priority = get_priority(out.type);
+	*received_packet = true;
+	return true;
+}
+
+static bool sim_video_extra_data(void *data, uint8_t **extra_data, size_t *size)
+{
+	struct sim_video *enc = data;
+
+	*extra_data = enc->header.array;
+	*size = enc->header.num;
+	return true;
+}
+
+static void sim_video_info(void *data, struct video_scale_info *info)
+{
+	UNUSED_PARAMETER(data);
+
+	/* the frame contents are never looked at, avoid a conversion */
+	if (info->format != VIDEO_FORMAT_I420 && info->format != VIDEO_FORMAT_NV12)
+		info->format = VIDEO_FORMAT_NV12;
+}
+
+#define SIM_VIDEO_CAPS (OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_ASYNC_ENCODE)
+
+struct obs_encoder_info sim_h264_encoder_info = {
+	.id = "sim_h264",
+	.type = OBS_ENCODER_VIDEO,
+	.codec = "h264",
+	.get_name = sim_h264_getname,
+	.create = sim_h264_create,
+	.destroy = sim_video_destroy,
+	.encode = sim_video_encode,
+	.update = sim_video_update,
+	.get_properties = sim_h264_props,
+	.get_defaults = sim_video_defaults,
+	.get_extra_data = sim_video_extra_data,
+	.get_video_info = sim_video_info,
+	.caps = SIM_VIDEO_CAPS,
+};
+
+struct obs_encoder_info sim_hevc_encoder_info = {
+	.id = "sim_hevc",
+	.type = OBS_ENCODER_VIDEO,
+	.codec = "hevc",
+	.get_name = sim_hevc_getname,
+	.create = sim_hevc_create,
+	.destroy = sim_video_destroy,
+	.encode = sim_video_encode,
+	.update = sim_video_update,
+	.get_properties = sim_h264_props,
+	.get_defaults = sim_video_defaults,
+	.get_extra_data = sim_video_extra_data,
+	.get_video_info = sim_video_info,
+	.caps = SIM_VIDEO_CAPS,
+};
+
+struct obs_encoder_info sim_av1_encoder_info = {
+	.id = "sim_av1",
+	.type = OBS_ENCODER_VIDEO,
+	.codec = "av1",
+	.get_name = sim_av1_getname,
+	.create = sim_av1_create,
+	.destroy = sim_video_destroy,
+	.encode = sim_video_encode,
+	.update = sim_video_update,
+	.get_properties = sim_av1_props,
+	.get_defaults = sim_video_defaults,
+	.get_extra_data = sim_video_extra_data,
+	.get_video_info = sim_video_info,
+	.caps = SIM_VIDEO_CAPS,
+};
@@ -1,8 +1,9 @@
 #include <graphics/math-defs.h>
 #include <util/platform.h>
+#include <util/threading.h>
+#include <util/file-watch.h>
 #include <util/util.hpp>
 #include <obs-module.h>
-#include <sys/stat.h>
 #include <combaseapi.h>
 #include <gdiplus.h>
 #include <algorithm>
@@ -220,9 +221,8 @@ struct TextSource {
 
 	bool read_from_file = false;
 	string file;
-	time_t file_timestamp = 0;
-	bool update_file = false;
-	float update_time_elapsed = 0.0f;
+	os_file_watch_t *file_watch = nullptr;
+	volatile bool file_changed = false;
 
 	wstring text;
 	wstring face;
@@ -273,6 +273,8 @@ struct TextSource {
 
 	inline ~TextSource()
 	{
+		os_file_watch_remove(file_watch);
+
 		if (tex) {
 			obs_enter_graphics();
 			gs_texture_destroy(tex);
@@ -287,6 +289,7 @@ struct TextSource {
 	void RenderOutlineText(Graphics &graphics, const GraphicsPath &path, const Brush &brush);
 	void RenderText();
 	void LoadFileText();
+	void WatchFile(const char *path);
 	void TransformText();
 	void SetAntiAliasing(Graphics &graphics_bitmap);
 
@@ -297,12 +300,10 @@ struct TextSource {
 	inline void Render();
 };
 
-static time_t get_modified_timestamp(const char *filename)
+static void file_changed_callback(void *param, const char *)
 {
-	struct stat stats;
-	if (os_stat(filename, &stats) != 0)
-		return -1;
-	return stats.st_mtime;
+	TextSource *s = reinterpret_cast<TextSource *>(param);
+	os_atomic_set_bool(&s->file_changed, true);
 }
 
 void TextSource::UpdateFont()
@@ -659,6 +660,13 @@ void TextSource::LoadFileText()
 		text.push_back('\n');
 }
 
+void TextSource::WatchFile(const char *path)
+{
+	os_file_watch_remove(file_watch);
+	file_watch = path ? os_file_watch_add(path, file_changed_callback, this) : nullptr;
+	os_atomic_set_bool(&file_changed, false);
+}
+
 void TextSource::TransformText()
 {
 	const locale loc = locale(obs_get_locale());
@@ -789,10 +797,12 @@ inline void TextSource::Update(obs_data_t *s)
 
 	if (read_from_file) {
 		file = new_file;
-		file_timestamp = get_modified_timestamp(new_file);
+		WatchFile(new_file);
 		LoadFileText();
 
 	} else {
+		WatchFile(nullptr);
+
 		text = to_wide(GetMainString(new_text));
 
 		/* all text should end with newlines due to the fact that GDI+
@@ -823,7 +833,6 @@ inline void TextSource::Update(obs_data_t *s)
 		valign = VAlign::Top;
 
 	RenderText();
-	update_time_elapsed = 0.0f;
 
 	/* ----------------------------- */
 
@@ -835,24 +844,13 @@ inline void TextSource::Tick(float seconds)
 	if (!read_from_file)
 		return;
 
-	update_time_elapsed += seconds;
-
-	if (update_time_elapsed >= 1.0f) {
-		time_t t = get_modified_timestamp(file.c_str());
-		update_time_elapsed = 0.0f;
-
-		if (update_file) {
-			LoadFileText();
-			TransformText();
-			RenderText();
-			update_file = false;
-		}
-
-		if (file_timestamp != t) {
-			file_timestamp = t;
-			update_file = true;
-		}
+	if (os_atomic_exchange_bool(&file_changed, false)) {
+		LoadFileText();
+		TransformText();
+		RenderText();
 	}
+
+	UNUSED_PARAMETER(seconds);
 }
 
 inline void TextSource::Render()
@@ -2,6 +2,7 @@
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("obs-transitions", "en-US")
+OBS_MODULE_ALLOW_CONCURRENT_LOAD()
 MODULE_EXPORT const char *obs_module_description(void)
 {
 	return "OBS core transitions";
@@ -21,7 +21,10 @@
 #include <util/dstr.h>
 #include <util/darray.h>
 #include <util/platform.h>
+#include <util/threading.h>
+#include <util/deque.h>
 #include <obs-module.h>
+#include <media-io/video-frame.h>
 #include <opts-parser.h>
 
 #ifndef _STDINT_H_INCLUDED
@@ -43,6 +46,36 @@
 
 /* ------------------------------------------------------------------------- */
 
+#define GROUP_DECISIONS 512
+#define GROUP_DELAY_SLACK_MS 100
+#define GROUP_MAX_DELAY_MS 2000
+
+struct frame_decision {
+	int64_t pts;
+	int type;
+};
+
+/* x264 instances in the same encoder group (e.g. a multitrack ladder) can
+ * share the lookahead of the largest one.  It picks frame types and
+ * keyframes as usual, and the others are forced to the same types, which
+ * keeps their keyframes aligned without running scenecut and B-frame
+ * decisions of their own. */
+struct x264_group {
+	obs_encoder_group_t *group;
+	long refs;
+
+	pthread_mutex_t mutex;
+	obs_encoder_t *leader;
+	bool leader_active;
+	int leader_delay;
+	struct frame_decision decisions[GROUP_DECISIONS];
+};
+
+struct queued_frame {
+	int64_t pts;
+	struct video_frame frame;
+};
+
 struct obs_x264 {
 	obs_encoder_t *encoder;
 
@@ -61,8 +94,29 @@ struct obs_x264 {
 
 	uint32_t roi_increment;
 	float *quant_offsets;
+
+	struct x264_group *group;
+	bool group_leader;
+	int64_t pts_step;
+	int keyint;
+	int frames_since_keyframe;
+	int consecutive_b;
+	bool queue_overflow;
+	int64_t delay_slack;
+	int64_t max_delay;
+	int64_t last_queued_pts;
+	enum video_format format;
+	struct deque queued_frames;
+	DARRAY(struct video_frame) frame_pool;
+
+	int64_t keyframe_pts;
+	int64_t keyframe_frame;
+	int64_t submitted_frames;
 };
 
+static pthread_mutex_t groups_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct x264_group *) groups;
+
 /* ------------------------------------------------------------------------- */
 
 static const char *obs_x264_getname(void *unused)
@@ -85,6 +139,8 @@ static void clear_data(struct obs_x264 *obsx264)
 	}
 }
 
+static void leave_group(struct obs_x264 *obsx264);
+
 static void obs_x264_destroy(void *data)
 {
 	struct obs_x264 *obsx264 = data;
@@ -92,6 +148,7 @@ static void obs_x264_destroy(void *data)
 	if (obsx264) {
 		os_end_high_performance(obsx264->performance_token);
 		clear_data(obsx264);
+		leave_group(obsx264);
 		da_free(obsx264->packet_data);
 		bfree(obsx264);
 	}
@@ -629,6 +686,326 @@ static void load_headers(struct obs_x264 *obsx264)
 	obsx264->sei_size = sei.num;
 }
 
+/* ------------------------------------------------------------------------- */
+/* encoder groups */
+
+static struct x264_group *x264_group_get(obs_encoder_group_t *group, obs_encoder_t *leader)
+{
+	struct x264_group *xg = NULL;
+
+	pthread_mutex_lock(&groups_mutex);
+
+	for (size_t i = 0; i < groups.num; i++) {
+		if (groups.array[i]->group == group) {
+			xg = groups.array[i];
+			break;
+		}
+	}
+
+	if (!xg) {
+		xg = bzalloc(sizeof(struct x264_group));
+		xg->group = group;
+		xg->leader = leader;
+		pthread_mutex_init(&xg->mutex, NULL);
+
+		for (size_t i = 0; i < GROUP_DECISIONS; i++)
+			xg->decisions[i].pts = -1;
+
+		da_push_back(groups, &xg);
+	}
+
+	xg->refs++;
+
+	pthread_mutex_unlock(&groups_mutex);
+	return xg;
+}
+
+static void x264_group_release(struct x264_group *xg)
+{
+	pthread_mutex_lock(&groups_mutex);
+
+	if (--xg->refs == 0) {
+		da_erase_item(groups, &xg);
+		if (!groups.num)
+			da_free(groups);
+
+		pthread_mutex_destroy(&xg->mutex);
+		bfree(xg);
+	}
+
+	pthread_mutex_unlock(&groups_mutex);
+}
+
+static inline size_t decision_slot(struct obs_x264 *obsx264, int64_t pts)
+{
+	return (size_t)((pts / obsx264->pts_step) % GROUP_DECISIONS);
+}
+
+static void add_decision(struct obs_x264 *obsx264, const x264_picture_t *pic_out)
+{
+	struct x264_group *xg = obsx264->group;
+	struct frame_decision *decision = &xg->decisions[decision_slot(obsx264, pic_out->i_pts)];
+
+	pthread_mutex_lock(&xg->mutex);
+	decision->pts = pic_out->i_pts;
+	decision->type = pic_out->b_keyframe ? X264_TYPE_KEYFRAME : pic_out->i_type;
+	pthread_mutex_unlock(&xg->mutex);
+}
+
+static bool get_decision(struct obs_x264 *obsx264, int64_t pts, int *type)
+{
+	struct x264_group *xg = obsx264->group;
+	const struct frame_decision *decision = &xg->decisions[decision_slot(obsx264, pts)];
+	bool found;
+
+	pthread_mutex_lock(&xg->mutex);
+	found = !xg->leader_active || decision->pts == pts;
+	*type = xg->leader_active ? decision->type : X264_TYPE_AUTO;
+	pthread_mutex_unlock(&xg->mutex);
+
+	return found;
+}
+
+/* frames are held for as long as the leader itself delays them, plus some
+ * slack for the leader running on another thread, but never for longer than
+ * GROUP_MAX_DELAY_MS */
+static int64_t max_queue_delay(struct obs_x264 *obsx264)
+{
+	struct x264_group *xg = obsx264->group;
+	int64_t delay;
+
+	pthread_mutex_lock(&xg->mutex);
+	delay = (int64_t)xg->leader_delay * obsx264->pts_step;
+	pthread_mutex_unlock(&xg->mutex);
+
+	delay += obsx264->delay_slack;
+	return delay < obsx264->max_delay ? delay : obsx264->max_delay;
+}
+
+/* the leader may use more consecutive B-frames or a B-pyramid this instance
+ * does not allow, so adjust its types instead of having x264 warn about
+ * every frame */
+static int follow_frame_type(struct obs_x264 *obsx264, int type)
+{
+	if (IS_X264_TYPE_B(type)) {
+		if (obsx264->consecutive_b >= obsx264->params.i_bframe) {
+			type = X264_TYPE_P;
+		} else if (type == X264_TYPE_BREF && obsx264->params.i_bframe_pyramid == X264_B_PYRAMID_NONE) {
+			type = X264_TYPE_B;
+		}
+	}
+
+	/* without a leader keyframes fall back to the configured interval */
+	if (type == X264_TYPE_AUTO && obsx264->frames_since_keyframe >= obsx264->keyint)
+		type = X264_TYPE_KEYFRAME;
+
+	obsx264->consecutive_b = IS_X264_TYPE_B(type) ? obsx264->consecutive_b + 1 : 0;
+	obsx264->frames_since_keyframe =
+		(type == X264_TYPE_KEYFRAME || type == X264_TYPE_IDR) ? 1 : obsx264->frames_since_keyframe + 1;
+	return type;
+}
+
+static void queue_frame(struct obs_x264 *obsx264, const struct encoder_frame *frame)
+{
+	const uint32_t height = obs_encoder_get_height(obsx264->encoder);
+	struct queued_frame queued = {.pts = frame->pts};
+	struct video_frame src;
+
+	if (obsx264->frame_pool.num) {
+		queued.frame = obsx264->frame_pool.array[obsx264->frame_pool.num - 1];
+		da_pop_back(obsx264->frame_pool);
+	} else {
+		video_frame_init(&queued.frame, obsx264->format, obs_encoder_get_width(obsx264->encoder), height);
+	}
+
+	memcpy(src.data, frame->data, sizeof(src.data));
+	memcpy(src.linesize, frame->linesize, sizeof(src.linesize));
+	video_frame_copy(&queued.frame, &src, obsx264->format, height);
+
+	deque_push_back(&obsx264->queued_frames, &queued, sizeof(queued));
+	obsx264->last_queued_pts = frame->pts;
+}
+
+/* frames are held back until the leader has decided their type, or until
+ * the leader has fallen behind, in which case the types are chosen here */
+static bool next_queued_frame(struct obs_x264 *obsx264, struct queued_frame *queued, int *type)
+{
+	if (!obsx264->queued_frames.size)
+		return false;
+
+	deque_peek_front(&obsx264->queued_frames, queued, sizeof(*queued));
+
+	if (!get_decision(obsx264, queued->pts, type)) {
+		if (obsx264->last_queued_pts - queued->pts < max_queue_delay(obsx264))
+			return false;
+
+		if (!obsx264->queue_overflow) {
+			warn("Encoder group leader is too far behind, "
+			     "choosing frame types independently");
+			obsx264->queue_overflow = true;
+		}
+
+		*type = X264_TYPE_AUTO;
+	}
+
+	deque_pop_front(&obsx264->queued_frames, NULL, sizeof(*queued));
+	*type = follow_frame_type(obsx264, *type);
+	return true;
+}
+
+static void free_queued_frames(struct obs_x264 *obsx264)
+{
+	if (obsx264->queued_frames.size)
+		info("dropped %zu frames waiting for the encoder group leader",
+		     obsx264->queued_frames.size / sizeof(struct queued_frame));
+
+	while (obsx264->queued_frames.size) {
+		struct queued_frame queued;
+		deque_pop_front(&obsx264->queued_frames, &queued, sizeof(queued));
+		video_frame_free(&queued.frame);
+	}
+
+	for (size_t i = 0; i < obsx264->frame_pool.num; i++)
+		video_frame_free(&obsx264->frame_pool.array[i]);
+
+	deque_free(&obsx264->queued_frames);
+	da_free(obsx264->frame_pool);
+}
+
+struct group_search {
+	obs_encoder_t *leader;
+	uint64_t leader_area;
+};
+
+static bool search_group(void *param, obs_encoder_t *encoder)
+{
+	struct group_search *search = param;
+
+	if (strcmp(obs_encoder_get_id(encoder), "obs_x264") != 0)
+		return true;
+
+	obs_data_t *settings = obs_encoder_get_settings(encoder);
+	bool share = obs_data_get_bool(settings, "share_analysis");
+	obs_data_release(settings);
+
+	if (!share)
+		return true;
+
+	uint64_t area = (uint64_t)obs_encoder_get_width(encoder) * obs_encoder_get_height(encoder);
+	if (area > search->leader_area) {
+		search->leader = encoder;
+		search->leader_area = area;
+	}
+
+	return true;
+}
+
+static int64_t get_pts_step(obs_encoder_t *encoder)
+{
+	const struct video_output_info *voi = video_output_get_info(obs_encoder_parent_video(encoder));
+	return (int64_t)voi->fps_den * obs_encoder_get_frame_rate_divisor(encoder);
+}
+
+static bool same_frame_rate(obs_encoder_t *a, obs_encoder_t *b)
+{
+	const struct video_output_info *voi_a = video_output_get_info(obs_encoder_parent_video(a));
+	const struct video_output_info *voi_b = video_output_get_info(obs_encoder_parent_video(b));
+
+	return voi_a->fps_num == voi_b->fps_num && get_pts_step(a) == get_pts_step(b);
+}
+
+static void join_group(struct obs_x264 *obsx264, obs_data_t *settings)
+{
+	obs_encoder_group_t *group = obs_encoder_get_group(obsx264->encoder);
+	struct group_search search = {0};
+
+	if (!group)
+		return;
+
+	obs_encoder_group_enum_encoders(group, search_group, &search);
+
+	if (!obs_data_get_bool(settings, "share_analysis") || !search.leader)
+		return;
+
+	if (!same_frame_rate(search.leader, obsx264->encoder)) {
+		info("not sharing analysis: frame rate differs from '%s'", obs_encoder_get_name(search.leader));
+		return;
+	}
+
+	obsx264->group = x264_group_get(group, search.leader);
+	obsx264->group_leader = search.leader == obsx264->encoder;
+	obsx264->pts_step = get_pts_step(obsx264->encoder);
+
+	if (obsx264->group_leader) {
+		info("sharing analysis as encoder group leader");
+		return;
+	}
+
+	info("sharing analysis of '%s'", obs_encoder_get_name(search.leader));
+
+	/* pts are in units of 1 / fps_num, see update_params */
+	const int64_t pts_per_sec = obsx264->params.i_timebase_den;
+	const int64_t max_frames_delay = (int64_t)(GROUP_DECISIONS / 2) * obsx264->pts_step;
+
+	obsx264->delay_slack = GROUP_DELAY_SLACK_MS * pts_per_sec / 1000;
+	obsx264->max_delay = GROUP_MAX_DELAY_MS * pts_per_sec / 1000;
+	if (obsx264->max_delay > max_frames_delay)
+		obsx264->max_delay = max_frames_delay;
+
+	/* frame types come from the leader */
+	obsx264->keyint = obsx264->params.i_keyint_max;
+	obsx264->frames_since_keyframe = obsx264->keyint;
+	obsx264->params.i_keyint_max = X264_KEYINT_MAX_INFINITE;
+	obsx264->params.i_scenecut_threshold = 0;
+	obsx264->params.i_bframe_adaptive = X264_B_ADAPT_NONE;
+
+	if (obsx264->params.i_csp == X264_CSP_I420)
+		obsx264->format = VIDEO_FORMAT_I420;
+	else if (obsx264->params.i_csp == X264_CSP_I444)
+		obsx264->format = VIDEO_FORMAT_I444;
+	else
+		obsx264->format = VIDEO_FORMAT_NV12;
+}
+
+static void set_group_leader_active(struct obs_x264 *obsx264, bool active)
+{
+	if (!obsx264->group || !obsx264->group_leader)
+		return;
+
+	pthread_mutex_lock(&obsx264->group->mutex);
+	obsx264->group->leader_active = active;
+	if (active)
+		obsx264->group->leader_delay = x264_encoder_maximum_delayed_frames(obsx264->context);
+	pthread_mutex_unlock(&obsx264->group->mutex);
+}
+
+/* x264 defaults to 1.5 threads per core for every instance, which
+ * oversubscribes the CPU when several encoders run at once */
+static void set_thread_budget(struct obs_x264 *obsx264)
+{
+	uint32_t threads = obs_encoder_get_thread_budget(obsx264->encoder);
+
+	if (!threads || obsx264->params.i_threads != X264_THREADS_AUTO)
+		return;
+
+	obsx264->params.i_threads = (int)threads;
+	info("threads: %d", obsx264->params.i_threads);
+}
+
+static void leave_group(struct obs_x264 *obsx264)
+{
+	if (!obsx264->group)
+		return;
+
+	set_group_leader_active(obsx264, false);
+	x264_group_release(obsx264->group);
+	obsx264->group = NULL;
+
+	free_queued_frames(obsx264);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 {
 	video_t *video = obs_encoder_video(encoder);
@@ -652,8 +1029,11 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 
 	struct obs_x264 *obsx264 = bzalloc(sizeof(struct obs_x264));
 	obsx264->encoder = encoder;
+	obsx264->pts_step = get_pts_step(encoder);
 
 	if (update_settings(obsx264, settings, false)) {
+		set_thread_budget(obsx264);
+		join_group(obsx264, settings);
 		obsx264->context = x264_encoder_open(&obsx264->params);
 
 		if (obsx264->context == NULL)
@@ -665,10 +1045,13 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 	}
 
 	if (!obsx264->context) {
+		leave_group(obsx264);
 		bfree(obsx264);
 		return NULL;
 	}
 
+	set_group_leader_active(obsx264, true);
+
 	obsx264->performance_token = os_request_high_performance("x264 encoding");
 
 	return obsx264;
@@ -695,6 +1078,24 @@ static void parse_packet(struct obs_x264 *obsx264, struct encoder_packet *packet
 	packet->keyframe = pic_out->b_keyframe != 0;
 }
 
+/* libobs does not pass on frames identical to the previous one, so fewer
+ * frames than keyint can take longer than the keyframe interval.  Only then
+ * is a keyframe forced, x264 places it on its own otherwise. */
+static void force_keyframe_by_time(struct obs_x264 *obsx264, x264_picture_t *pic)
+{
+	int keyint = obsx264->params.i_keyint_max;
+	int64_t frames = obsx264->submitted_frames - obsx264->keyframe_frame;
+
+	if (keyint <= 0 || keyint == X264_KEYINT_MAX_INFINITE)
+		return;
+
+	if (pic->i_pts - obsx264->keyframe_pts >= (int64_t)keyint * obsx264->pts_step && frames < keyint) {
+		pic->i_type = X264_TYPE_KEYFRAME;
+		obsx264->keyframe_pts = pic->i_pts;
+		obsx264->keyframe_frame = obsx264->submitted_frames;
+	}
+}
+
 static inline void init_pic_data(struct obs_x264 *obsx264, x264_picture_t *pic, struct encoder_frame *frame)
 {
 	x264_picture_init(pic);
@@ -778,26 +1179,67 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame, struct enco
 			    bool *received_packet)
 {
 	struct obs_x264 *obsx264 = data;
+	struct encoder_frame held_frame;
+	struct queued_frame queued;
+	bool following = false;
 	x264_nal_t *nals;
 	int nal_count;
 	int ret;
+	int type;
 	x264_picture_t pic, pic_out;
 
 	if (!frame || !packet || !received_packet)
 		return false;
 
+	if (obsx264->group && !obsx264->group_leader) {
+		queue_frame(obsx264, frame);
+
+		if (!next_queued_frame(obsx264, &queued, &type)) {
+			*received_packet = false;
+			return true;
+		}
+
+		memcpy(held_frame.data, queued.frame.data, sizeof(held_frame.data));
+		memcpy(held_frame.linesize, queued.frame.linesize, sizeof(held_frame.linesize));
+		held_frame.pts = queued.pts;
+		frame = &held_frame;
+		following = true;
+	}
+
 	if (frame)
 		init_pic_data(obsx264, &pic, frame);
 
+	if (following)
+		pic.i_type = type;
+	else if (frame)
+		force_keyframe_by_time(obsx264, &pic);
+
+	/* the submission index comes back with the output picture, telling how
+	 * many frames have been submitted since a keyframe x264 placed */
+	if (frame)
+		pic.opaque = (void *)(intptr_t)obsx264->submitted_frames++;
+
 	if (obs_encoder_has_roi(obsx264->encoder))
 		add_roi(obsx264, &pic);
 
 	ret = x264_encoder_encode(obsx264->context, &nals, &nal_count, (frame ? &pic : NULL), &pic_out);
+
+	/* x264 has copied the picture */
+	if (following)
+		da_push_back(obsx264->frame_pool, &queued.frame);
+
 	if (ret < 0) {
 		warn("encode failed");
 		return false;
 	}
 
+	if (nal_count && obsx264->group_leader)
+		add_decision(obsx264, &pic_out);
+	if (nal_count && pic_out.b_keyframe && pic_out.i_pts > obsx264->keyframe_pts) {
+		obsx264->keyframe_pts = pic_out.i_pts;
+		obsx264->keyframe_frame = (int64_t)(intptr_t)pic_out.opaque;
+	}
+
 	*received_packet = (nal_count != 0);
 	parse_packet(obsx264, packet, nals, nal_count, &pic_out);
 
@@ -861,5 +1303,6 @@ struct obs_encoder_info obs_x264_encoder = {
 	.get_extra_data = obs_x264_extra_data,
 	.get_sei_data = obs_x264_sei,
 	.get_video_info = obs_x264_video_info,
-	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_ROI,
+	.caps = OBS_ENCODER_CAP_DYN_BITRATE | OBS_ENCODER_CAP_ROI | OBS_ENCODER_CAP_THREAD_BUDGET |
+		OBS_ENCODER_CAP_ASYNC_ENCODE | OBS_ENCODER_CAP_SKIP_DUPLICATES,
 };
@@ -0,0 +1,370 @@
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include "glyph-atlas.h"
+
+/* number of unreferenced atlases kept around before the least recently
+ * used one is freed */
+#define GLYPH_ATLAS_MAX_IDLE 4
+
+extern FT_Library ft2_lib;
+extern uint32_t texbuf_w, texbuf_h;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static DARRAY(struct glyph_atlas *) atlases;
+
+static inline bool atlas_matches(const struct glyph_atlas *atlas, const char *path, FT_Long face_index, uint16_t size,
+				 bool antialiasing)
+{
+	return atlas->face_index == face_index && atlas->size == size && atlas->antialiasing == antialiasing &&
+	       strcmp(atlas->path, path) == 0;
+}
+
+static struct glyph_atlas *find_atlas(const char *path, FT_Long face_index, uint16_t size, bool antialiasing)
+{
+	for (size_t i = 0; i < atlases.num; i++) {
+		struct glyph_atlas *atlas = atlases.array[i];
+		if (atlas_matches(atlas, path, face_index, size, antialiasing))
+			return atlas;
+	}
+
+	return NULL;
+}
+
+static inline void clear_dirty(struct glyph_atlas *atlas)
+{
+	atlas->dirty_y = texbuf_h;
+	atlas->dirty_y2 = 0;
+}
+
+static void free_glyphs(struct glyph_atlas *atlas)
+{
+	for (uint32_t i = 0; i < num_cache_slots; i++) {
+		if (atlas->glyphs[i] != NULL) {
+			bfree(atlas->glyphs[i]);
+			atlas->glyphs[i] = NULL;
+		}
+	}
+}
+
+static void destroy_atlas(struct glyph_atlas *atlas)
+{
+	if (!atlas)
+		return;
+
+	if (atlas->tex) {
+		obs_enter_graphics();
+		gs_texture_destroy(atlas->tex);
+		obs_leave_graphics();
+	}
+
+	free_glyphs(atlas);
+	if (atlas->face)
+		FT_Done_Face(atlas->face);
+
+	pthread_mutex_destroy(&atlas->mutex);
+	bfree(atlas->texbuf);
+	bfree(atlas->path);
+	bfree(atlas);
+}
+
+static struct glyph_atlas *create_atlas(const char *path, FT_Long face_index, uint16_t size, bool antialiasing)
+{
+	struct glyph_atlas *atlas = bzalloc(sizeof(struct glyph_atlas));
+
+	if (pthread_mutex_init(&atlas->mutex, NULL) != 0) {
+		bfree(atlas);
+		return NULL;
+	}
+
+	atlas->path = bstrdup(path);
+	atlas->face_index = face_index;
+	atlas->size = size;
+	atlas->antialiasing = antialiasing;
+	atlas->refs = 1;
+
+	if (FT_New_Face(ft2_lib, path, face_index, &atlas->face) != 0) {
+		atlas->face = NULL;
+		destroy_atlas(atlas);
+		return NULL;
+	}
+
+	FT_Set_Pixel_Sizes(atlas->face, 0, size);
+	FT_Select_Charmap(atlas->face, FT_ENCODING_UNICODE);
+
+	atlas->texbuf = bzalloc((size_t)texbuf_w * (size_t)texbuf_h);
+	clear_dirty(atlas);
+	return atlas;
+}
+
+struct glyph_atlas *glyph_atlas_acquire(const char *path, FT_Long face_index, uint16_t size, bool antialiasing)
+{
+	struct glyph_atlas *atlas;
+	struct glyph_atlas *existing;
+
+	if (!path || !ft2_lib)
+		return NULL;
+
+	pthread_mutex_lock(&cache_mutex);
+	atlas = find_atlas(path, face_index, size, antialiasing);
+	if (atlas)
+		atlas->refs++;
+	pthread_mutex_unlock(&cache_mutex);
+
+	if (atlas)
+		return atlas;
+
+	/* load the face outside of the cache lock, it can take a while */
+	atlas = create_atlas(path, face_index, size, antialiasing);
+	if (!atlas)
+		return NULL;
+
+	pthread_mutex_lock(&cache_mutex);
+	existing = find_atlas(path, face_index, size, antialiasing);
+	if (existing)
+		existing->refs++;
+	else
+		da_push_back(atlases, &atlas);
+	pthread_mutex_unlock(&cache_mutex);
+
+	if (existing) {
+		destroy_atlas(atlas);
+		atlas = existing;
+	}
+
+	return atlas;
+}
+
+static struct glyph_atlas *remove_lru_idle_atlas(void)
+{
+	struct glyph_atlas *lru = NULL;
+	size_t lru_idx = 0;
+	size_t idle = 0;
+
+	for (size_t i = 0; i < atlases.num; i++) {
+		struct glyph_atlas *atlas = atlases.array[i];
+		if (atlas->refs)
+			continue;
+
+		idle++;
+		if (!lru || atlas->last_used < lru->last_used) {
+			lru = atlas;
+			lru_idx = i;
+		}
+	}
+
+	if (idle <= GLYPH_ATLAS_MAX_IDLE)
+		return NULL;
+
+	da_erase(atlases, lru_idx);
+	return lru;
+}
+
+void glyph_atlas_release(struct glyph_atlas *atlas)
+{
+	struct glyph_atlas *evicted = NULL;
+
+	if (!atlas)
+		return;
+
+	pthread_mutex_lock(&cache_mutex);
+	if (--atlas->refs == 0) {
+		atlas->last_used = os_gettime_ns();
+		evicted = remove_lru_idle_atlas();
+	}
+	pthread_mutex_unlock(&cache_mutex);
+
+	destroy_atlas(evicted);
+}
+
+void glyph_atlas_free_all(void)
+{
+	pthread_mutex_lock(&cache_mutex);
+	for (size_t i = 0; i < atlases.num; i++)
+		destroy_atlas(atlases.array[i]);
+	da_free(atlases);
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void reset_atlas(struct glyph_atlas *atlas)
+{
+	free_glyphs(atlas);
+	memset(atlas->texbuf, 0, (size_t)texbuf_w * (size_t)texbuf_h);
+
+	atlas->texbuf_x = 0;
+	atlas->texbuf_y = 0;
+	atlas->dirty_y = 0;
+	atlas->dirty_y2 = texbuf_h;
+	atlas->generation++;
+}
+
+static inline uint8_t get_pixel_value(const unsigned char *buf_row, FT_Render_Mode render_mode, const uint32_t x)
+{
+	if (render_mode == FT_RENDER_MODE_NORMAL) {
+		return buf_row[x];
+	}
+
+	const uint32_t byte_index = x / 8;
+	const uint8_t bit_index = x % 8;
+	const bool pixel_set = (buf_row[byte_index] >> (7 - bit_index)) & 1;
+	return pixel_set ? 255 : 0;
+}
+
+static void rasterize(struct glyph_atlas *atlas, FT_GlyphSlot slot, const FT_Render_Mode render_mode, const uint32_t dx,
+		      const uint32_t dy)
+{
+	/**
+	 * The pitch's absolute value is the number of bytes taken by one bitmap
+	 * row, including padding.
+	 *
+	 * Source: https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html
+	 */
+	const int pitch = abs(slot->bitmap.pitch);
+
+	for (uint32_t y = 0; y < slot->bitmap.rows; y++) {
+		const uint32_t row_start = y * pitch;
+		const uint32_t row = (dy + y) * texbuf_w;
+
+		for (uint32_t x = 0; x < slot->bitmap.width; x++) {
+			const uint32_t row_pixel_position = dx + x;
+			const uint8_t pixel_value = get_pixel_value(&slot->bitmap.buffer[row_start], render_mode, x);
+			atlas->texbuf[row_pixel_position + row] = pixel_value;
+		}
+	}
+}
+
+static struct glyph_info *init_glyph(FT_GlyphSlot slot, const uint32_t dx, const uint32_t dy, const uint32_t g_w,
+				     const uint32_t g_h)
+{
+	struct glyph_info *glyph = bzalloc(sizeof(struct glyph_info));
+	glyph->u = (float)dx / (float)texbuf_w;
+	glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
+	glyph->v = (float)dy / (float)texbuf_h;
+	glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
+	glyph->w = g_w;
+	glyph->h = g_h;
+	glyph->yoff = slot->bitmap_top;
+	glyph->xoff = slot->bitmap_left;
+	glyph->xadv = slot->advance.x >> 6;
+
+	return glyph;
+}
+
+/* returns false if the atlas ran out of space */
+static bool cache_missing_glyphs(struct glyph_atlas *atlas, const wchar_t *text)
+{
+	FT_GlyphSlot slot = atlas->face->glyph;
+
+	uint32_t dx = atlas->texbuf_x;
+	uint32_t dy = atlas->texbuf_y;
+	bool success = true;
+
+	const size_t len = wcslen(text);
+
+	const FT_Render_Mode render_mode = atlas->antialiasing ? FT_RENDER_MODE_NORMAL : FT_RENDER_MODE_MONO;
+	const FT_Int32 load_mode = render_mode == FT_RENDER_MODE_MONO ? FT_LOAD_TARGET_MONO : FT_LOAD_DEFAULT;
+
+	for (size_t i = 0; i < len; i++) {
+		const FT_UInt glyph_index = FT_Get_Char_Index(atlas->face, text[i]);
+
+		if (atlas->glyphs[glyph_index] != NULL) {
+			continue;
+		}
+
+		FT_Load_Glyph(atlas->face, glyph_index, load_mode);
+		FT_Render_Glyph(slot, render_mode);
+
+		const uint32_t g_w = slot->bitmap.width;
+		const uint32_t g_h = slot->bitmap.rows;
+
+		if (atlas->max_h < g_h) {
+			atlas->max_h = g_h;
+		}
+
+		if (dx + g_w >= texbuf_w) {
+			dx = 0;
+			dy += atlas->max_h + 1;
+		}
+
+		if (dy + g_h >= texbuf_h) {
+			success = false;
+			break;
+		}
+
+		atlas->glyphs[glyph_index] = init_glyph(slot, dx, dy, g_w, g_h);
+		rasterize(atlas, slot, render_mode, dx, dy);
+
+		if (atlas->dirty_y > dy)
+			atlas->dirty_y = dy;
+		if (atlas->dirty_y2 < dy + g_h)
+			atlas->dirty_y2 = dy + g_h;
+
+		dx += (g_w + 1);
+		if (dx >= texbuf_w) {
+			dx = 0;
+			dy += atlas->max_h;
+		}
+	}
+
+	atlas->texbuf_x = dx;
+	atlas->texbuf_y = dy;
+	return success;
+}
+
+/* uploads only the rows that changed since the last upload */
+static void upload_dirty_rows(struct glyph_atlas *atlas)
+{
+	if (atlas->dirty_y2 <= atlas->dirty_y)
+		return;
+
+	if (!atlas->tex) {
+		atlas->tex = gs_texture_create(texbuf_w, texbuf_h, GS_A8, 1, (const uint8_t **)&atlas->texbuf, 0);
+		if (atlas->tex)
+			clear_dirty(atlas);
+		return;
+	}
+
+	const uint32_t rows = atlas->dirty_y2 - atlas->dirty_y;
+	const uint8_t *data = atlas->texbuf + (size_t)atlas->dirty_y * texbuf_w;
+
+	gs_texture_t *strip = gs_texture_create(texbuf_w, rows, GS_A8, 1, &data, 0);
+	if (!strip)
+		return;
+
+	gs_copy_texture_region(atlas->tex, 0, atlas->dirty_y, strip, 0, 0, texbuf_w, rows);
+	gs_texture_destroy(strip);
+	clear_dirty(atlas);
+}
+
+void glyph_atlas_cache(struct glyph_atlas *atlas, const wchar_t *text)
+{
+	bool dirty;
+
+	if (!atlas || !text)
+		return;
+
+	glyph_atlas_lock(atlas);
+	if (!cache_missing_glyphs(atlas, text)) {
+		/* the atlas is full, start over with only what's needed now.
+		 * other sources will see the new generation and re-cache their
+		 * own text on their next tick. */
+		reset_atlas(atlas);
+		if (!cache_missing_glyphs(atlas, text))
+			blog(LOG_WARNING, "Out of space trying to render glyphs");
+	}
+	dirty = atlas->dirty_y2 > atlas->dirty_y;
+	glyph_atlas_unlock(atlas);
+
+	if (!dirty)
+		return;
+
+	/* the graphics context must always be entered before the atlas is
+	 * locked, otherwise this could deadlock against the render thread */
+	obs_enter_graphics();
+	glyph_atlas_lock(atlas);
+	upload_dirty_rows(atlas);
+	glyph_atlas_unlock(atlas);
+	obs_leave_graphics();
+}
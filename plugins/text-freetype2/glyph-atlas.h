@@ -0,0 +1,67 @@
+#pragma once
+
+#include <obs-module.h>
+#include <util/threading.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#define num_cache_slots 65535
+
+struct glyph_info {
+	float u, v, u2, v2;
+	int32_t w, h, xoff, yoff;
+	FT_Pos xadv;
+};
+
+/*
+ * Glyph atlases are shared between every text source that uses the same
+ * font file, face index, pixel size and render mode.  Font flags (bold,
+ * italic) are already resolved into the font path by get_font_path().
+ *
+ * An atlas owns its FT_Face, the CPU copy of the glyph bitmap and the
+ * texture.  Newly rasterized glyphs only upload the rows they touched.
+ * When an atlas runs out of space it is cleared and its generation is
+ * bumped, so sources holding UVs from the old contents know to re-cache
+ * their text.  Atlases that are no longer referenced are kept around in
+ * least recently used order so that re-adding a source or toggling a
+ * setting does not have to rasterize everything again.
+ */
+struct glyph_atlas {
+	char *path;
+	FT_Long face_index;
+	uint16_t size;
+	bool antialiasing;
+
+	long refs;
+	uint64_t last_used;
+
+	pthread_mutex_t mutex;
+	FT_Face face;
+
+	uint8_t *texbuf;
+	uint32_t texbuf_x, texbuf_y;
+	uint32_t max_h;
+	uint32_t dirty_y, dirty_y2;
+	gs_texture_t *tex;
+
+	uint64_t generation;
+	struct glyph_info *glyphs[num_cache_slots];
+};
+
+struct glyph_atlas *glyph_atlas_acquire(const char *path, FT_Long face_index, uint16_t size, bool antialiasing);
+void glyph_atlas_release(struct glyph_atlas *atlas);
+void glyph_atlas_free_all(void);
+
+/* Rasterizes any glyphs of text that aren't in the atlas yet and uploads
+ * the modified rows.  Must not be called with the atlas locked. */
+void glyph_atlas_cache(struct glyph_atlas *atlas, const wchar_t *text);
+
+static inline void glyph_atlas_lock(struct glyph_atlas *atlas)
+{
+	pthread_mutex_lock(&atlas->mutex);
+}
+
+static inline void glyph_atlas_unlock(struct glyph_atlas *atlas)
+{
+	pthread_mutex_unlock(&atlas->mutex);
+}
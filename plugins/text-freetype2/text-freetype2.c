@@ -17,9 +17,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <obs-module.h>
 #include <util/platform.h>
+#include <util/threading.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include <sys/stat.h>
 #include "text-freetype2.h"
 #include "obs-convenience.h"
 #include "find-font.h"
@@ -127,6 +127,7 @@ bool obs_module_load()
 void obs_module_unload(void)
 {
 	if (plugin_initialized) {
+		glyph_atlas_free_all();
 		free_os_font_list();
 		FT_Done_FreeType(ft2_lib);
 	}
@@ -219,17 +220,12 @@ static void ft2_source_destroy(void *data)
 {
 	struct ft2_source *srcdata = data;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
+	os_file_watch_remove(srcdata->file_watch);
+	srcdata->file_watch = NULL;
 
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
+	glyph_atlas_release(srcdata->atlas);
+	srcdata->atlas = NULL;
+	srcdata->font_face = NULL;
 
 	if (srcdata->font_name != NULL)
 		bfree(srcdata->font_name);
@@ -237,17 +233,11 @@ static void ft2_source_destroy(void *data)
 		bfree(srcdata->font_style);
 	if (srcdata->text != NULL)
 		bfree(srcdata->text);
-	if (srcdata->texbuf != NULL)
-		bfree(srcdata->texbuf);
 	if (srcdata->text_file != NULL)
 		bfree(srcdata->text_file);
 
 	obs_enter_graphics();
 
-	if (srcdata->tex != NULL) {
-		gs_texture_destroy(srcdata->tex);
-		srcdata->tex = NULL;
-	}
 	if (srcdata->vbuf != NULL) {
 		gs_vertexbuffer_destroy(srcdata->vbuf);
 		srcdata->vbuf = NULL;
@@ -268,7 +258,7 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	if (srcdata == NULL)
 		return;
 
-	if (srcdata->tex == NULL || srcdata->vbuf == NULL)
+	if (srcdata->atlas == NULL || srcdata->atlas->tex == NULL || srcdata->vbuf == NULL)
 		return;
 	if (srcdata->text == NULL || *srcdata->text == 0)
 		return;
@@ -279,7 +269,8 @@ static void ft2_source_render(void *data, gs_effect_t *effect)
 	if (srcdata->drop_shadow)
 		draw_drop_shadow(srcdata);
 
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6, true);
+	draw_uv_vbuffer(srcdata->vbuf, srcdata->atlas->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6,
+			true);
 
 	UNUSED_PARAMETER(effect);
 }
@@ -289,32 +280,44 @@ static void ft2_video_tick(void *data, float seconds)
 	struct ft2_source *srcdata = data;
 	if (srcdata == NULL)
 		return;
-	if (!srcdata->from_file || !srcdata->text_file)
-		return;
 
-	if (os_gettime_ns() - srcdata->last_checked >= 1000000000) {
-		time_t t = get_modified_timestamp(srcdata->text_file);
-		srcdata->last_checked = os_gettime_ns();
+	/* another source filled up the shared atlas and it was cleared, so
+	 * the glyphs this source references have to be cached again */
+	if (srcdata->atlas && srcdata->atlas_generation != srcdata->atlas->generation) {
+		cache_glyphs(srcdata, srcdata->text);
+		set_up_vertex_buffer(srcdata);
+	}
 
-		if (srcdata->update_file) {
-			if (srcdata->log_mode)
-				read_from_end(srcdata, srcdata->text_file);
-			else
-				load_text_from_file(srcdata, srcdata->text_file);
-			cache_glyphs(srcdata, srcdata->text);
-			set_up_vertex_buffer(srcdata);
-			srcdata->update_file = false;
-		}
+	if (!srcdata->from_file || !srcdata->text_file)
+		return;
 
-		if (srcdata->m_timestamp != t) {
-			srcdata->m_timestamp = t;
-			srcdata->update_file = true;
-		}
+	if (os_atomic_exchange_bool(&srcdata->file_changed, false)) {
+		if (srcdata->log_mode)
+			read_appended_lines(srcdata, srcdata->text_file);
+		else
+			load_text_from_file(srcdata, srcdata->text_file);
+		cache_glyphs(srcdata, srcdata->text);
+		set_up_vertex_buffer(srcdata);
 	}
 
 	UNUSED_PARAMETER(seconds);
 }
 
+static void text_file_changed(void *param, const char *path)
+{
+	struct ft2_source *srcdata = param;
+	os_atomic_set_bool(&srcdata->file_changed, true);
+
+	UNUSED_PARAMETER(path);
+}
+
+static void watch_text_file(struct ft2_source *srcdata, const char *path)
+{
+	os_file_watch_remove(srcdata->file_watch);
+	srcdata->file_watch = path ? os_file_watch_add(path, text_file_changed, srcdata) : NULL;
+	os_atomic_set_bool(&srcdata->file_changed, false);
+}
+
 static bool init_font(struct ft2_source *srcdata)
 {
 	FT_Long index;
@@ -323,12 +326,11 @@ static bool init_font(struct ft2_source *srcdata)
 	if (!path)
 		return false;
 
-	if (srcdata->font_face != NULL) {
-		FT_Done_Face(srcdata->font_face);
-		srcdata->font_face = NULL;
-	}
+	glyph_atlas_release(srcdata->atlas);
+	srcdata->atlas = glyph_atlas_acquire(path, index, srcdata->font_size, srcdata->antialiasing);
+	srcdata->font_face = srcdata->atlas ? srcdata->atlas->face : NULL;
 
-	return FT_New_Face(ft2_lib, path, index, &srcdata->font_face) == 0;
+	return srcdata->atlas != NULL;
 }
 
 static void ft2_source_update(void *data, obs_data_t *settings)
@@ -402,8 +404,6 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (ft2_lib == NULL)
 		goto error;
 
-	const size_t texbuf_size = (size_t)texbuf_w * (size_t)texbuf_h;
-
 	if (srcdata->draw_effect == NULL) {
 		char *effect_file = NULL;
 		char *error_string = NULL;
@@ -428,10 +428,7 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	const bool aa_changed = srcdata->antialiasing != new_aa_setting;
 	if (aa_changed) {
 		srcdata->antialiasing = new_aa_setting;
-		if (srcdata->texbuf != NULL) {
-			memset(srcdata->texbuf, 0, texbuf_size);
-		}
-		cache_standard_glyphs(srcdata);
+		vbuf_needs_update = true;
 	}
 
 	srcdata->file_load_failed = false;
@@ -439,7 +436,7 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 
 	if (srcdata->font_name != NULL) {
 		if (strcmp(font_name, srcdata->font_name) == 0 && strcmp(font_style, srcdata->font_style) == 0 &&
-		    font_flags == srcdata->font_flags && font_size == srcdata->font_size)
+		    font_flags == srcdata->font_flags && font_size == srcdata->font_size && !aa_changed)
 			goto skip_font_load;
 
 		bfree(srcdata->font_name);
@@ -458,19 +455,9 @@ static void ft2_source_update(void *data, obs_data_t *settings)
 	if (!init_font(srcdata) || srcdata->font_face == NULL) {
 		blog(LOG_WARNING, "FT2-text: Failed to load font %s", srcdata->font_name);
 		goto error;
-	} else {
-		FT_Set_Pixel_Sizes(srcdata->font_face, 0, srcdata->font_size);
-		FT_Select_Charmap(srcdata->font_face, FT_ENCODING_UNICODE);
 	}
 
-	if (srcdata->texbuf != NULL) {
-		bfree(srcdata->texbuf);
-		srcdata->texbuf = NULL;
-	}
-	srcdata->texbuf = bzalloc(texbuf_size);
-
-	if (srcdata->font_face)
-		cache_standard_glyphs(srcdata);
+	cache_standard_glyphs(srcdata);
 
 skip_font_load:
 	if (from_file) {
@@ -483,6 +470,7 @@ skip_font_load:
 			srcdata->text = NULL;
 
 			os_utf8_to_wcs_ptr(emptystr, strlen(emptystr), &srcdata->text);
+			watch_text_file(srcdata, NULL);
 			blog(LOG_WARNING,
 			     "FT2-text: Failed to open %s for "
 			     "reading",
@@ -494,14 +482,16 @@ skip_font_load:
 			bfree(srcdata->text_file);
 
 			srcdata->text_file = bstrdup(tmp);
+			watch_text_file(srcdata, tmp);
 			if (chat_log_mode)
 				read_from_end(srcdata, tmp);
 			else
 				load_text_from_file(srcdata, tmp);
-			srcdata->last_checked = os_gettime_ns();
 		}
 	} else {
 		const char *tmp = obs_data_get_string(settings, "text");
+
+		watch_text_file(srcdata, NULL);
 		if (!tmp)
 			goto error;
 
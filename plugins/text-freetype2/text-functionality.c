@@ -19,15 +19,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <util/platform.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include <sys/stat.h>
 #include "text-freetype2.h"
 #include "obs-convenience.h"
 
 float offsets[16] = {-2.0f, 0.0f, 0.0f, -2.0f, 2.0f,  0.0f, 2.0f,  0.0f,
 		     0.0f,  2.0f, 0.0f, 2.0f,  -2.0f, 0.0f, -2.0f, 0.0f};
 
-extern uint32_t texbuf_w, texbuf_h;
-
 void draw_outlines(struct ft2_source *srcdata)
 {
 	if (!srcdata->text)
@@ -36,8 +33,8 @@ void draw_outlines(struct ft2_source *srcdata)
 	gs_matrix_push();
 	for (int32_t i = 0; i < 8; i++) {
 		gs_matrix_translate3f(offsets[i * 2], offsets[(i * 2) + 1], 0.0f);
-		draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6,
-				false);
+		draw_uv_vbuffer(srcdata->vbuf, srcdata->atlas->tex, srcdata->draw_effect,
+				(uint32_t)wcslen(srcdata->text) * 6, false);
 	}
 	gs_matrix_identity();
 	gs_matrix_pop();
@@ -50,7 +47,8 @@ void draw_drop_shadow(struct ft2_source *srcdata)
 
 	gs_matrix_push();
 	gs_matrix_translate3f(4.0f, 4.0f, 0.0f);
-	draw_uv_vbuffer(srcdata->vbuf, srcdata->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6, false);
+	draw_uv_vbuffer(srcdata->vbuf, srcdata->atlas->tex, srcdata->draw_effect, (uint32_t)wcslen(srcdata->text) * 6,
+			false);
 	gs_matrix_identity();
 	gs_matrix_pop();
 }
@@ -61,28 +59,38 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 	uint32_t x = 0, space_pos = 0, word_width = 0;
 	size_t len;
 
-	if (!srcdata->text)
+	if (!srcdata->text || !srcdata->atlas)
 		return;
 
+	glyph_atlas_lock(srcdata->atlas);
 	if (srcdata->custom_width >= 100)
 		srcdata->cx = srcdata->custom_width;
 	else
 		srcdata->cx = get_ft2_text_width(srcdata->text, srcdata);
 	srcdata->cy = srcdata->max_h;
+	glyph_atlas_unlock(srcdata->atlas);
+
+	if (*srcdata->text == 0)
+		return;
+
+	const uint32_t num_verts = (uint32_t)wcslen(srcdata->text) * 6;
 
 	obs_enter_graphics();
-	if (srcdata->vbuf != NULL) {
-		gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
-		srcdata->vbuf = NULL;
-		gs_vertexbuffer_destroy(tmpvbuf);
-	}
 
-	if (*srcdata->text == 0) {
-		obs_leave_graphics();
-		return;
+	/* only recreate the vertex buffer when the text grew past it, log
+	 * style files that update constantly mostly stay the same length */
+	if (srcdata->vbuf == NULL || srcdata->vbuf_verts < num_verts) {
+		if (srcdata->vbuf != NULL) {
+			gs_vertbuffer_t *tmpvbuf = srcdata->vbuf;
+			srcdata->vbuf = NULL;
+			gs_vertexbuffer_destroy(tmpvbuf);
+		}
+
+		srcdata->vbuf = create_uv_vbuffer(num_verts, true);
+		srcdata->vbuf_verts = srcdata->vbuf ? num_verts : 0;
 	}
 
-	srcdata->vbuf = create_uv_vbuffer((uint32_t)wcslen(srcdata->text) * 6, true);
+	glyph_atlas_lock(srcdata->atlas);
 
 	if (srcdata->custom_width <= 100)
 		goto skip_word_wrap;
@@ -122,6 +130,7 @@ void set_up_vertex_buffer(struct ft2_source *srcdata)
 
 skip_word_wrap:;
 	fill_vertex_buffer(srcdata);
+	glyph_atlas_unlock(srcdata->atlas);
 	gs_vertexbuffer_flush(srcdata->vbuf);
 	obs_leave_graphics();
 }
@@ -188,21 +197,15 @@ void fill_vertex_buffer(struct ft2_source *srcdata)
 	skip_glyph:;
 	}
 
+	/* clear anything left over from previous, longer text */
+	if (vdata->num > cur_glyph * 6)
+		memset(vdata->points + (cur_glyph * 6), 0, sizeof(struct vec3) * (vdata->num - cur_glyph * 6));
+
 	srcdata->cy = max_y;
 }
 
 void cache_standard_glyphs(struct ft2_source *srcdata)
 {
-	for (uint32_t i = 0; i < num_cache_slots; i++) {
-		if (srcdata->cacheglyphs[i] != NULL) {
-			bfree(srcdata->cacheglyphs[i]);
-			srcdata->cacheglyphs[i] = NULL;
-		}
-	}
-
-	srcdata->texbuf_x = 0;
-	srcdata->texbuf_y = 0;
-
 	cache_glyphs(srcdata, L"abcdefghijklmnopqrstuvwxyz"
 			      L"ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890"
 			      L"!@#$%^&*()-_=+,<.>/?\\|[]{}`~ \'\"\0");
@@ -219,141 +222,17 @@ void load_glyph(struct ft2_source *srcdata, const FT_UInt glyph_index, const FT_
 	FT_Load_Glyph(srcdata->font_face, glyph_index, load_mode);
 }
 
-struct glyph_info *init_glyph(FT_GlyphSlot slot, const uint32_t dx, const uint32_t dy, const uint32_t g_w,
-			      const uint32_t g_h)
-{
-	struct glyph_info *glyph = bzalloc(sizeof(struct glyph_info));
-	glyph->u = (float)dx / (float)texbuf_w;
-	glyph->u2 = (float)(dx + g_w) / (float)texbuf_w;
-	glyph->v = (float)dy / (float)texbuf_h;
-	glyph->v2 = (float)(dy + g_h) / (float)texbuf_h;
-	glyph->w = g_w;
-	glyph->h = g_h;
-	glyph->yoff = slot->bitmap_top;
-	glyph->xoff = slot->bitmap_left;
-	glyph->xadv = slot->advance.x >> 6;
-
-	return glyph;
-}
-
-uint8_t get_pixel_value(const unsigned char *buf_row, FT_Render_Mode render_mode, const uint32_t x)
-{
-	if (render_mode == FT_RENDER_MODE_NORMAL) {
-		return buf_row[x];
-	}
-
-	const uint32_t byte_index = x / 8;
-	const uint8_t bit_index = x % 8;
-	const bool pixel_set = (buf_row[byte_index] >> (7 - bit_index)) & 1;
-	return pixel_set ? 255 : 0;
-}
-
-void rasterize(struct ft2_source *srcdata, FT_GlyphSlot slot, const FT_Render_Mode render_mode, const uint32_t dx,
-	       const uint32_t dy)
-{
-	/**
-	 * The pitch's absolute value is the number of bytes taken by one bitmap
-	 * row, including padding.
-	 *
-	 * Source: https://www.freetype.org/freetype2/docs/reference/ft2-basic_types.html
-	 */
-	const int pitch = abs(slot->bitmap.pitch);
-
-	for (uint32_t y = 0; y < slot->bitmap.rows; y++) {
-		const uint32_t row_start = y * pitch;
-		const uint32_t row = (dy + y) * texbuf_w;
-
-		for (uint32_t x = 0; x < slot->bitmap.width; x++) {
-			const uint32_t row_pixel_position = dx + x;
-			const uint8_t pixel_value = get_pixel_value(&slot->bitmap.buffer[row_start], render_mode, x);
-			srcdata->texbuf[row_pixel_position + row] = pixel_value;
-		}
-	}
-}
-
 void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
 {
-	if (!srcdata->font_face || !cache_glyphs)
+	if (!srcdata->atlas || !cache_glyphs)
 		return;
 
-	FT_GlyphSlot slot = srcdata->font_face->glyph;
-
-	uint32_t dx = srcdata->texbuf_x;
-	uint32_t dy = srcdata->texbuf_y;
-
-	int32_t cached_glyphs = 0;
-	const size_t len = wcslen(cache_glyphs);
-
-	const FT_Render_Mode render_mode = get_render_mode(srcdata);
-
-	for (size_t i = 0; i < len; i++) {
-		const FT_UInt glyph_index = FT_Get_Char_Index(srcdata->font_face, cache_glyphs[i]);
-
-		if (src_glyph != NULL) {
-			continue;
-		}
-
-		load_glyph(srcdata, glyph_index, render_mode);
-		FT_Render_Glyph(slot, render_mode);
-
-		const uint32_t g_w = slot->bitmap.width;
-		const uint32_t g_h = slot->bitmap.rows;
-
-		if (srcdata->max_h < g_h) {
-			srcdata->max_h = g_h;
-		}
-
-		if (dx + g_w >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h + 1;
-		}
+	glyph_atlas_cache(srcdata->atlas, cache_glyphs);
 
-		if (dy + g_h >= texbuf_h) {
-			blog(LOG_WARNING, "Out of space trying to render glyphs");
-			break;
-		}
-
-		src_glyph = init_glyph(slot, dx, dy, g_w, g_h);
-		rasterize(srcdata, slot, render_mode, dx, dy);
-
-		dx += (g_w + 1);
-		if (dx >= texbuf_w) {
-			dx = 0;
-			dy += srcdata->max_h;
-		}
-
-		cached_glyphs++;
-	}
-
-	srcdata->texbuf_x = dx;
-	srcdata->texbuf_y = dy;
-
-	if (cached_glyphs > 0) {
-
-		obs_enter_graphics();
-
-		if (srcdata->tex != NULL) {
-			gs_texture_t *tmp_texture = srcdata->tex;
-			srcdata->tex = NULL;
-			gs_texture_destroy(tmp_texture);
-		}
-
-		srcdata->tex = gs_texture_create(texbuf_w, texbuf_h, GS_A8, 1, (const uint8_t **)&srcdata->texbuf, 0);
-
-		obs_leave_graphics();
-	}
-}
-
-time_t get_modified_timestamp(char *filename)
-{
-	struct stat stats;
-
-	// stat is apparently terrifying and horrible, but we only call it once
-	// every second at most.
-	if (os_stat(filename, &stats) != 0)
-		return -1;
-
-	return stats.st_mtime;
+	glyph_atlas_lock(srcdata->atlas);
+	srcdata->max_h = srcdata->atlas->max_h;
+	srcdata->atlas_generation = srcdata->atlas->generation;
+	glyph_atlas_unlock(srcdata->atlas);
 }
 
 static void remove_cr(wchar_t *source)
@@ -470,6 +349,9 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 	if (cur_pos != 0)
 		cur_pos += (utf16) ? 2 : 1;
 
+	os_file_appended_init(&srcdata->log_state, filename, filesize);
+	srcdata->log_utf16 = utf16;
+
 	fseek(tmp_file, cur_pos, SEEK_SET);
 
 	if (utf16) {
@@ -502,6 +384,67 @@ void read_from_end(struct ft2_source *srcdata, const char *filename)
 	bfree(tmp_read);
 }
 
+/* same line counting as read_from_end: the trailing line break counts */
+static wchar_t *find_last_lines(wchar_t *text, uint32_t lines)
+{
+	uint32_t line_breaks = 0;
+
+	for (size_t i = wcslen(text); i > 0; i--) {
+		if (text[i - 1] == L'\n' && ++line_breaks > lines)
+			return text + i;
+	}
+
+	return text;
+}
+
+void read_appended_lines(struct ft2_source *srcdata, const char *filename)
+{
+	wchar_t *appended = NULL;
+	size_t size;
+	bool reset;
+
+	if (srcdata->log_utf16 || !srcdata->text) {
+		read_from_end(srcdata, filename);
+		return;
+	}
+
+	struct os_appended_file prev_state = srcdata->log_state;
+	char *data = os_file_read_appended(filename, &srcdata->log_state, &size, &reset);
+	if (!data)
+		return;
+
+	if (reset) {
+		bfree(data);
+		read_from_end(srcdata, filename);
+		return;
+	}
+
+	if (!os_utf8_to_wcs_ptr(data, size, &appended)) {
+		/* probably stopped in the middle of a multi-byte character,
+		 * try again once the rest has been written */
+		srcdata->log_state = prev_state;
+		bfree(data);
+		bfree(appended);
+		return;
+	}
+	bfree(data);
+	remove_cr(appended);
+
+	const size_t old_len = wcslen(srcdata->text);
+	const size_t new_len = wcslen(appended);
+	wchar_t *text = bmalloc((old_len + new_len + 1) * sizeof(wchar_t));
+	memcpy(text, srcdata->text, old_len * sizeof(wchar_t));
+	memcpy(text + old_len, appended, (new_len + 1) * sizeof(wchar_t));
+	bfree(appended);
+
+	const wchar_t *last_lines = find_last_lines(text, srcdata->log_lines);
+	if (last_lines != text)
+		memmove(text, last_lines, (wcslen(last_lines) + 1) * sizeof(wchar_t));
+
+	bfree(srcdata->text);
+	srcdata->text = text;
+}
+
 uint32_t get_ft2_text_width(wchar_t *text, struct ft2_source *srcdata)
 {
 	if (!text) {
@@ -0,0 +1,106 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <cmocka.h>
+
+#include <callback/calldata.h>
+
+static struct calldata_signature test_signature = CALLDATA_SIGNATURE(
+	{"source", CALL_PARAM_TYPE_PTR}, {"volume", CALL_PARAM_TYPE_FLOAT}, {"flags", CALL_PARAM_TYPE_INT},
+	{"enabled", CALL_PARAM_TYPE_BOOL});
+
+/* declared separately, e.g. by a plugin, but with the same parameters */
+static struct calldata_signature same_signature = CALLDATA_SIGNATURE(
+	{"source", CALL_PARAM_TYPE_PTR}, {"volume", CALL_PARAM_TYPE_FLOAT}, {"flags", CALL_PARAM_TYPE_INT},
+	{"enabled", CALL_PARAM_TYPE_BOOL});
+
+static struct calldata_signature other_signature =
+	CALLDATA_SIGNATURE({"flags", CALL_PARAM_TYPE_INT}, {"source", CALL_PARAM_TYPE_PTR});
+
+static void calldata_signature_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	uint8_t stack[CALLDATA_SIGNATURE_STACK_SIZE];
+	calldata_t cd;
+	int source;
+
+	calldata_init_signature(&cd, &test_signature, stack, sizeof(stack));
+	assert_true(calldata_has_signature(&cd, &test_signature));
+	assert_true(calldata_has_signature(&cd, &same_signature));
+	assert_false(calldata_has_signature(&cd, &other_signature));
+
+	/* parameters exist, zeroed, before being set */
+	assert_null(calldata_ptr(&cd, "source"));
+	assert_int_equal(calldata_sig_int(&cd, &test_signature, 2), 0);
+
+	calldata_sig_set_ptr(&cd, &test_signature, 0, &source);
+	calldata_sig_set_float(&cd, &test_signature, 1, 0.5);
+	calldata_sig_set_int(&cd, &test_signature, 2, 42);
+	calldata_sig_set_bool(&cd, &test_signature, 3, true);
+
+	/* name-based handlers see the same values */
+	assert_ptr_equal(calldata_ptr(&cd, "source"), &source);
+	assert_true(calldata_float(&cd, "volume") == 0.5);
+	assert_int_equal(calldata_int(&cd, "flags"), 42);
+	assert_true(calldata_bool(&cd, "enabled"));
+
+	/* handlers modifying in/out parameters keep the layout intact */
+	calldata_set_float(&cd, "volume", 0.25);
+	calldata_set_string(&cd, "extra", "value");
+	assert_true(calldata_has_signature(&cd, &test_signature));
+	assert_true(calldata_sig_float(&cd, &same_signature, 1) == 0.25);
+	assert_string_equal(calldata_string(&cd, "extra"), "value");
+
+	/* the other signature falls back to names */
+	assert_ptr_equal(calldata_sig_ptr(&cd, &other_signature, 1), &source);
+	assert_int_equal(calldata_sig_int(&cd, &other_signature, 0), 42);
+
+	/* wrong types are rejected */
+	bool enabled;
+	assert_false(calldata_sig_get_bool(&cd, &test_signature, 2, &enabled));
+	assert_false(calldata_sig_get_bool(&cd, &test_signature, 7, &enabled));
+}
+
+static void calldata_signature_fallback_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	uint8_t stack[CALLDATA_SIGNATURE_STACK_SIZE];
+	calldata_t cd;
+	int source;
+
+	/* calldata built by name */
+	calldata_init(&cd);
+	calldata_sig_set_int(&cd, &test_signature, 2, 7);
+	calldata_set_ptr(&cd, "source", &source);
+	assert_false(calldata_has_signature(&cd, &test_signature));
+	assert_int_equal(calldata_sig_int(&cd, &test_signature, 2), 7);
+	assert_ptr_equal(calldata_sig_ptr(&cd, &test_signature, 0), &source);
+	assert_false(calldata_sig_bool(&cd, &test_signature, 3));
+	calldata_free(&cd);
+
+	/* a parameter changing size moves everything after it */
+	calldata_init_signature(&cd, &test_signature, stack, sizeof(stack));
+	calldata_sig_set_int(&cd, &test_signature, 2, 7);
+	calldata_set_string(&cd, "volume", "loud");
+	assert_false(calldata_has_signature(&cd, &test_signature));
+	assert_int_equal(calldata_sig_int(&cd, &test_signature, 2), 7);
+	calldata_sig_set_int(&cd, &test_signature, 2, 8);
+	assert_int_equal(calldata_int(&cd, "flags"), 8);
+
+	/* stack too small for the signature */
+	calldata_init_signature(&cd, &test_signature, stack, 32);
+	assert_false(calldata_has_signature(&cd, &test_signature));
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(calldata_signature_test),
+		cmocka_unit_test(calldata_signature_fallback_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,73 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+
+static void check_roi(const struct obs_encoder_roi *roi, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom,
+		      float priority)
+{
+	assert_int_equal(roi->left, left);
+	assert_int_equal(roi->top, top);
+	assert_int_equal(roi->right, right);
+	assert_int_equal(roi->bottom, bottom);
+	assert_true(roi->priority == priority);
+}
+
+static void scene_roi_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	// topmost first, 1920x1080 canvas
+	const struct obs_roi_item items[] = {
+		{OBS_ROI_ITEM_TEXT, 100.0f, 900.0f, 700.0f, 1000.0f},
+		{OBS_ROI_ITEM_NONE, 1500.0f, 60.0f, 1860.0f, 300.0f},
+		// partially outside the canvas
+		{OBS_ROI_ITEM_CAMERA, 1440.0f, 720.0f, 2100.0f, 1200.0f},
+		// too small once scaled
+		{OBS_ROI_ITEM_TEXT, 10.0f, 10.0f, 30.0f, 30.0f},
+		// too small to be a background, acts as a plain item
+		{OBS_ROI_ITEM_BACKGROUND, 0.0f, 0.0f, 200.0f, 200.0f},
+		{OBS_ROI_ITEM_BACKGROUND, 0.0f, 0.0f, 1920.0f, 1080.0f},
+		// hidden by the background
+		{OBS_ROI_ITEM_NONE, 0.0f, 0.0f, 1920.0f, 1080.0f},
+	};
+	const size_t num_items = sizeof(items) / sizeof(items[0]);
+	struct obs_encoder_roi roi[sizeof(items) / sizeof(items[0])];
+
+	size_t count = obs_roi_from_scene_items(roi, items, num_items, 1920, 1080, 1280, 720);
+	assert_int_equal(count, 5);
+
+	check_roi(&roi[0], 66, 600, 466, 666, 0.06f);
+	check_roi(&roi[1], 1000, 40, 1240, 200, 0.0f);
+	check_roi(&roi[2], 960, 480, 1280, 720, 0.1f);
+	check_roi(&roi[3], 0, 0, 133, 133, 0.0f);
+	check_roi(&roi[4], 0, 0, 1280, 720, -0.06f);
+}
+
+static void scene_roi_empty_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	// nothing worth prioritizing, no need to cut anything out
+	const struct obs_roi_item items[] = {
+		{OBS_ROI_ITEM_NONE, 0.0f, 0.0f, 1920.0f, 1080.0f},
+		{OBS_ROI_ITEM_BACKGROUND, 400.0f, 400.0f, 800.0f, 800.0f},
+	};
+	struct obs_encoder_roi roi[2];
+
+	assert_int_equal(obs_roi_from_scene_items(roi, items, 2, 1920, 1080, 1920, 1080), 0);
+	assert_int_equal(obs_roi_from_scene_items(roi, items, 2, 0, 0, 1920, 1080), 0);
+	assert_int_equal(obs_roi_from_scene_items(roi, NULL, 0, 1920, 1080, 1920, 1080), 0);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(scene_roi_test),
+		cmocka_unit_test(scene_roi_empty_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
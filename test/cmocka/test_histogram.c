@@ -0,0 +1,68 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/histogram.h>
+
+static void histogram_bucket_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	// values below the sub-bucket count map exactly
+	for (uint64_t i = 0; i < HISTOGRAM_SUB_BUCKETS; i++)
+		assert_int_equal(histogram_bucket_value(histogram_bucket_idx(i)), i);
+
+	// larger values map to a bucket whose upper bound is within ~6%
+	for (uint64_t val = 17; val < 100000000000ULL; val = val * 3 + 1) {
+		uint64_t bound = histogram_bucket_value(histogram_bucket_idx(val));
+		assert_true(bound >= val);
+		assert_true(bound - val <= val / HISTOGRAM_SUB_BUCKETS + 1);
+	}
+
+	assert_true(histogram_bucket_idx(UINT64_MAX) < HISTOGRAM_BUCKETS);
+}
+
+static void histogram_percentile_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct histogram h;
+	histogram_init(&h);
+
+	assert_int_equal(histogram_percentile(&h, 50.0), 0);
+
+	for (uint64_t i = 1; i <= 1000; i++)
+		histogram_record(&h, i * 1000);
+
+	assert_int_equal(h.count, 1000);
+	assert_int_equal(h.min, 1000);
+	assert_int_equal(h.max, 1000000);
+	assert_int_equal(histogram_mean(&h), 500500);
+
+	uint64_t p50 = histogram_percentile(&h, 50.0);
+	uint64_t p99 = histogram_percentile(&h, 99.0);
+	assert_true(p50 >= 500000 && p50 <= 500000 + 500000 / HISTOGRAM_SUB_BUCKETS);
+	assert_true(p99 >= 990000 && p99 <= 1000000);
+	assert_int_equal(histogram_percentile(&h, 100.0), 1000000);
+
+	struct histogram other;
+	histogram_init(&other);
+	histogram_record(&other, 5);
+	histogram_merge(&h, &other);
+	assert_int_equal(h.count, 1001);
+	assert_int_equal(h.min, 5);
+
+	histogram_reset(&h);
+	assert_int_equal(h.count, 0);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(histogram_bucket_test),
+		cmocka_unit_test(histogram_percentile_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,548 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <limits.h>
+#include <cmocka.h>
+#ifdef HAVE_JANSSON
+#include <jansson.h>
+#endif
+
+#include <obs-data.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+static obs_data_t *create_filter(int idx)
+{
+	obs_data_t *filter = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+
+	obs_data_set_string(settings, "color", "#ffffff");
+	obs_data_set_double(settings, "opacity", 0.75 + idx * 0.01);
+	obs_data_set_obj(filter, "settings", settings);
+	obs_data_set_string(filter, "id", "color_filter_v2");
+	obs_data_set_string(filter, "name", "Color Correction");
+	obs_data_set_bool(filter, "enabled", true);
+
+	obs_data_release(settings);
+	return filter;
+}
+
+static obs_data_t *create_source(int idx)
+{
+	obs_data_t *source = obs_data_create();
+	obs_data_t *settings = obs_data_create();
+	obs_data_t *hotkeys = obs_data_create();
+	obs_data_array_t *filters = obs_data_array_create();
+	obs_data_array_t *empty = obs_data_array_create();
+	char name[64];
+
+	snprintf(name, sizeof(name), "Source %d", idx);
+	obs_data_set_string(source, "name", name);
+	obs_data_set_string(source, "id", "image_source");
+	obs_data_set_int(source, "mixers", 255);
+	obs_data_set_double(source, "volume", 1.0);
+	obs_data_set_int(source, "sync", -idx * 1000LL);
+	obs_data_set_bool(source, "muted", idx % 2 == 0);
+
+	snprintf(name, sizeof(name), "/home/user/images/image_%d.png", idx);
+	obs_data_set_string(settings, "file", name);
+	obs_data_set_bool(settings, "unload", false);
+	obs_data_set_obj(source, "settings", settings);
+
+	for (int i = 0; i < 2; i++) {
+		obs_data_t *filter = create_filter(i);
+		obs_data_array_push_back(filters, filter);
+		obs_data_release(filter);
+	}
+	obs_data_set_array(source, "filters", filters);
+
+	obs_data_set_array(hotkeys, "libobs.show_scene_item", empty);
+	obs_data_set_obj(source, "hotkeys", hotkeys);
+
+	obs_data_array_release(empty);
+	obs_data_array_release(filters);
+	obs_data_release(hotkeys);
+	obs_data_release(settings);
+	return source;
+}
+
+static obs_data_t *create_collection(int num_sources)
+{
+	obs_data_t *collection = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+
+	for (int i = 0; i < num_sources; i++) {
+		obs_data_t *source = create_source(i);
+		obs_data_array_push_back(sources, source);
+		obs_data_release(source);
+	}
+
+	obs_data_set_string(collection, "name", "Benchmark");
+	obs_data_set_string(collection, "current_scene", "Scene");
+	obs_data_set_array(collection, "sources", sources);
+
+	obs_data_array_release(sources);
+	return collection;
+}
+
+static bool data_equal(obs_data_t *a, obs_data_t *b);
+
+static bool arrays_equal(obs_data_array_t *a, obs_data_array_t *b)
+{
+	size_t count = obs_data_array_count(a);
+	bool equal = count == obs_data_array_count(b);
+
+	for (size_t i = 0; equal && i < count; i++) {
+		obs_data_t *obj_a = obs_data_array_item(a, i);
+		obs_data_t *obj_b = obs_data_array_item(b, i);
+		equal = data_equal(obj_a, obj_b);
+		obs_data_release(obj_a);
+		obs_data_release(obj_b);
+	}
+
+	return equal;
+}
+
+static bool items_equal(obs_data_item_t *a, obs_data_item_t *b)
+{
+	enum obs_data_type type = obs_data_item_gettype(a);
+	bool equal = true;
+
+	if (type != obs_data_item_gettype(b))
+		return false;
+
+	if (type == OBS_DATA_STRING) {
+		equal = strcmp(obs_data_item_get_string(a), obs_data_item_get_string(b)) == 0;
+
+	} else if (type == OBS_DATA_NUMBER) {
+		equal = obs_data_item_numtype(a) == obs_data_item_numtype(b) &&
+			obs_data_item_get_int(a) == obs_data_item_get_int(b) &&
+			obs_data_item_get_double(a) == obs_data_item_get_double(b);
+
+	} else if (type == OBS_DATA_BOOLEAN) {
+		equal = obs_data_item_get_bool(a) == obs_data_item_get_bool(b);
+
+	} else if (type == OBS_DATA_OBJECT) {
+		obs_data_t *obj_a = obs_data_item_get_obj(a);
+		obs_data_t *obj_b = obs_data_item_get_obj(b);
+		equal = data_equal(obj_a, obj_b);
+		obs_data_release(obj_a);
+		obs_data_release(obj_b);
+
+	} else if (type == OBS_DATA_ARRAY) {
+		obs_data_array_t *array_a = obs_data_item_get_array(a);
+		obs_data_array_t *array_b = obs_data_item_get_array(b);
+		equal = arrays_equal(array_a, array_b);
+		obs_data_array_release(array_a);
+		obs_data_array_release(array_b);
+	}
+
+	return equal;
+}
+
+static bool data_equal(obs_data_t *a, obs_data_t *b)
+{
+	size_t count_a = 0, count_b = 0;
+	obs_data_item_t *item;
+	bool equal = true;
+
+	for (item = obs_data_first(b); item; obs_data_item_next(&item))
+		count_b++;
+
+	for (item = obs_data_first(a); item; obs_data_item_next(&item)) {
+		obs_data_item_t *other = obs_data_item_byname(b, obs_data_item_get_name(item));
+
+		equal = equal && other && items_equal(item, other);
+		obs_data_item_release(&other);
+		count_a++;
+	}
+
+	return equal && count_a == count_b;
+}
+
+static void binary_roundtrip_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = create_collection(10);
+	obs_data_array_t *empty = obs_data_array_create();
+	obs_data_t *empty_obj = obs_data_create();
+
+	obs_data_set_string(data, "empty", "");
+	obs_data_set_string(data, "utf8", "\xc3\xa9\xe2\x82\xac");
+	obs_data_set_int(data, "min", LLONG_MIN);
+	obs_data_set_int(data, "max", LLONG_MAX);
+	obs_data_set_double(data, "double", -1.5e300);
+	obs_data_set_array(data, "empty_array", empty);
+	obs_data_set_obj(data, "empty_obj", empty_obj);
+	obs_data_set_default_int(data, "default_only", 5);
+
+	size_t size;
+	void *buf = obs_data_get_binary(data, &size);
+	assert_non_null(buf);
+
+	obs_data_t *loaded = obs_data_create_from_binary(buf, size);
+	assert_non_null(loaded);
+	assert_false(obs_data_has_user_value(loaded, "default_only"));
+
+	obs_data_erase(data, "default_only");
+	assert_true(data_equal(data, loaded));
+
+	obs_data_release(loaded);
+	bfree(buf);
+	obs_data_array_release(empty);
+	obs_data_release(empty_obj);
+	obs_data_release(data);
+}
+
+static void binary_corrupt_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = create_collection(3);
+	size_t size;
+	uint8_t *buf = obs_data_get_binary(data, &size);
+	uint8_t *copy = bmalloc(size);
+
+	/* truncated data must be rejected */
+	for (size_t i = 0; i < size; i += 7)
+		assert_null(obs_data_create_from_binary(buf, i));
+
+	/* flipped bytes must never crash or hang */
+	for (size_t i = 0; i < size; i++) {
+		memcpy(copy, buf, size);
+		copy[i] ^= 0xFF;
+		obs_data_release(obs_data_create_from_binary(copy, size));
+	}
+
+	/* newer versions are rejected */
+	memcpy(copy, buf, size);
+	copy[4] = 0xFF;
+	assert_null(obs_data_create_from_binary(copy, size));
+
+	bfree(copy);
+	bfree(buf);
+	obs_data_release(data);
+}
+
+static void binary_file_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const char *path = "test_obs_data.bin";
+	obs_data_t *data = create_collection(100);
+
+	assert_true(obs_data_save_binary_safe(data, path, "tmp", NULL));
+
+	obs_data_t *loaded = obs_data_create_from_binary_file(path);
+	assert_non_null(loaded);
+	assert_true(data_equal(data, loaded));
+
+	obs_data_release(loaded);
+	obs_data_release(data);
+	os_unlink(path);
+
+	assert_null(obs_data_create_from_binary_file(path));
+}
+
+static void json_expect(const char *json, const char *compact, const char *pretty)
+{
+	obs_data_t *data = obs_data_create_from_json(json);
+
+	if (!compact) {
+		assert_null(data);
+		return;
+	}
+
+	assert_non_null(data);
+	assert_string_equal(obs_data_get_json(data), compact);
+	if (pretty)
+		assert_string_equal(obs_data_get_json_pretty(data), pretty);
+	obs_data_release(data);
+}
+
+static void json_parse_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	json_expect("{}", "{}", "{}");
+	json_expect(" { \"a\" : 1 , \"b\":-2.5e3,\"c\":true,\"d\":false,\"e\":null,"
+		    "\"f\":\"x\\n\\u00e9\\ud83d\\ude00\\/\"}",
+		    "{\"a\":1,\"b\":-2500.0,\"c\":true,\"d\":false,\"f\":\"x\\n\xc3\xa9\xf0\x9f\x98\x80/\"}", NULL);
+
+	/* only objects are kept in arrays */
+	json_expect("{\"o\":{\"x\":{}},\"arr\":[{\"a\":1},2,\"s\",[{}],{}],\"e\":[]}",
+		    "{\"o\":{\"x\":{}},\"arr\":[{\"a\":1},{}],\"e\":[]}",
+		    "{\n    \"o\": {\n        \"x\": {}\n    },\n    \"arr\": [\n        {\n            \"a\": 1\n"
+		    "        },\n        {}\n    ],\n    \"e\": []\n}");
+
+	json_expect("[1, 2]", "{}", NULL);
+	json_expect("{\"a\":9223372036854775807,\"b\":-9223372036854775808,\"c\":0.1,\"d\":1e-7}",
+		    "{\"a\":9223372036854775807,\"b\":-9223372036854775808,\"c\":0.10000000000000001,"
+		    "\"d\":9.9999999999999995e-8}",
+		    NULL);
+	json_expect("{\"k\":\"\\u0001\\\"\\\\\\t\"}", "{\"k\":\"\\u0001\\\"\\\\\\t\"}", NULL);
+
+	/* errors */
+	json_expect("", NULL, NULL);
+	json_expect("1", NULL, NULL);
+	json_expect("{\"a\":1,}", NULL, NULL);
+	json_expect("{\"a\":1}x", NULL, NULL);
+	json_expect("{\"a\":1,\"a\":2}", NULL, NULL);
+	json_expect("{\"a\":01}", NULL, NULL);
+	json_expect("{\"a\":9223372036854775808}", NULL, NULL);
+	json_expect("{\"a\":1e999}", NULL, NULL);
+	json_expect("{\"a\":\"\\u0000\"}", NULL, NULL);
+	json_expect("{\"a\":\"\\ud800\"}", NULL, NULL);
+	json_expect("{\"a\":\"\xff\"}", NULL, NULL);
+	json_expect("{\"a\":\"\x01\"}", NULL, NULL);
+	json_expect("{\"a\":[1,]}", NULL, NULL);
+	json_expect("{\"a\":\"abc", NULL, NULL);
+}
+
+#ifdef HAVE_JANSSON
+/* The previous implementation, converting through a jansson tree */
+static void jansson_add_item(obs_data_t *data, const char *key, json_t *json);
+
+static void jansson_add_object_data(obs_data_t *data, json_t *jobj)
+{
+	const char *key;
+	json_t *jitem;
+
+	json_object_foreach (jobj, key, jitem) {
+		jansson_add_item(data, key, jitem);
+	}
+}
+
+static void jansson_add_item(obs_data_t *data, const char *key, json_t *json)
+{
+	if (json_is_object(json)) {
+		obs_data_t *obj = obs_data_create();
+		jansson_add_object_data(obj, json);
+		obs_data_set_obj(data, key, obj);
+		obs_data_release(obj);
+
+	} else if (json_is_array(json)) {
+		obs_data_array_t *array = obs_data_array_create();
+		size_t idx;
+		json_t *jitem;
+
+		json_array_foreach (json, idx, jitem) {
+			if (!json_is_object(jitem))
+				continue;
+
+			obs_data_t *obj = obs_data_create();
+			jansson_add_object_data(obj, jitem);
+			obs_data_array_push_back(array, obj);
+			obs_data_release(obj);
+		}
+
+		obs_data_set_array(data, key, array);
+		obs_data_array_release(array);
+
+	} else if (json_is_string(json)) {
+		obs_data_set_string(data, key, json_string_value(json));
+	} else if (json_is_integer(json)) {
+		obs_data_set_int(data, key, json_integer_value(json));
+	} else if (json_is_real(json)) {
+		obs_data_set_double(data, key, json_real_value(json));
+	} else if (json_is_boolean(json)) {
+		obs_data_set_bool(data, key, json_is_true(json));
+	}
+}
+
+static obs_data_t *jansson_load(const char *str)
+{
+	json_t *root = json_loads(str, JSON_REJECT_DUPLICATES, NULL);
+	obs_data_t *data = NULL;
+
+	if (root) {
+		data = obs_data_create();
+		jansson_add_object_data(data, root);
+		json_decref(root);
+	}
+
+	return data;
+}
+
+static json_t *jansson_from_data(obs_data_t *data)
+{
+	json_t *json = json_object();
+	obs_data_item_t *item;
+
+	for (item = obs_data_first(data); item; obs_data_item_next(&item)) {
+		const char *name = obs_data_item_get_name(item);
+		enum obs_data_type type = obs_data_item_gettype(item);
+
+		if (!obs_data_item_has_user_value(item))
+			continue;
+
+		if (type == OBS_DATA_STRING) {
+			json_object_set_new(json, name, json_string(obs_data_item_get_string(item)));
+		} else if (type == OBS_DATA_NUMBER) {
+			if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT)
+				json_object_set_new(json, name, json_integer(obs_data_item_get_int(item)));
+			else
+				json_object_set_new(json, name, json_real(obs_data_item_get_double(item)));
+		} else if (type == OBS_DATA_BOOLEAN) {
+			json_object_set_new(json, name, json_boolean(obs_data_item_get_bool(item)));
+		} else if (type == OBS_DATA_OBJECT) {
+			obs_data_t *obj = obs_data_item_get_obj(item);
+			json_object_set_new(json, name, jansson_from_data(obj));
+			obs_data_release(obj);
+		} else if (type == OBS_DATA_ARRAY) {
+			obs_data_array_t *array = obs_data_item_get_array(item);
+			json_t *jarray = json_array();
+
+			for (size_t i = 0; i < obs_data_array_count(array); i++) {
+				obs_data_t *obj = obs_data_array_item(array, i);
+				json_array_append_new(jarray, jansson_from_data(obj));
+				obs_data_release(obj);
+			}
+
+			json_object_set_new(json, name, jarray);
+			obs_data_array_release(array);
+		}
+	}
+
+	return json;
+}
+
+static char *jansson_save(obs_data_t *data, size_t flags)
+{
+	json_t *root = jansson_from_data(data);
+	char *str = json_dumps(root, flags | JSON_PRESERVE_ORDER);
+	json_decref(root);
+	return str;
+}
+
+/* output must be identical to what jansson generated */
+static void json_jansson_compat_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = create_collection(100);
+	obs_data_set_string(data, "escapes", "\"\\/\b\f\n\r\t\x01\x1f\x7f \xc3\xa9");
+	obs_data_set_string(data, "invalid_utf8", "\xff");
+	obs_data_set_double(data, "big", 1.5e300);
+	obs_data_set_double(data, "small", -2.5e-300);
+	obs_data_set_double(data, "whole", 3.0);
+
+	char *expected = jansson_save(data, JSON_COMPACT);
+	assert_string_equal(obs_data_get_json(data), expected);
+	free(expected);
+
+	expected = jansson_save(data, JSON_INDENT(4));
+	assert_string_equal(obs_data_get_json_pretty(data), expected);
+
+	obs_data_t *from_jansson = jansson_load(expected);
+	obs_data_t *from_json = obs_data_create_from_json(expected);
+	assert_non_null(from_json);
+	assert_true(data_equal(from_jansson, from_json));
+	free(expected);
+
+	obs_data_release(from_json);
+	obs_data_release(from_jansson);
+	obs_data_release(data);
+}
+#endif
+
+static void cow_clone_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	long allocs = bnum_allocs();
+	obs_data_t *data = create_collection(4);
+	obs_data_t *expected = create_collection(4);
+	obs_data_t *clone = obs_data_clone(data);
+	assert_true(data_equal(clone, data));
+
+	/* writes through the clone don't show up in the original */
+	obs_data_array_t *sources = obs_data_get_array(clone, "sources");
+	obs_data_t *source = obs_data_array_item(sources, 1);
+	obs_data_array_t *filters = obs_data_get_array(source, "filters");
+	obs_data_t *filter = obs_data_array_item(filters, 0);
+	obs_data_t *settings = obs_data_get_obj(filter, "settings");
+
+	obs_data_set_string(settings, "color", "#000000");
+	obs_data_erase(source, "muted");
+	obs_data_array_erase(filters, 1);
+	obs_data_set_string(clone, "name", "Clone");
+
+	assert_true(data_equal(data, expected));
+	assert_false(data_equal(clone, data));
+	assert_int_equal(obs_data_array_count(filters), 1);
+
+	obs_data_release(settings);
+	obs_data_release(filter);
+	obs_data_array_release(filters);
+	obs_data_release(source);
+	obs_data_array_release(sources);
+
+	/* and writes to the original don't show up in the clone */
+	obs_data_t *clone2 = obs_data_clone(data);
+	sources = obs_data_get_array(data, "sources");
+	source = obs_data_array_item(sources, 2);
+	obs_data_item_t *item = obs_data_item_byname(source, "volume");
+	obs_data_item_set_double(&item, 0.5);
+	obs_data_item_release(&item);
+	obs_data_release(source);
+	obs_data_array_release(sources);
+
+	assert_true(data_equal(clone2, expected));
+	assert_false(data_equal(data, expected));
+
+	obs_data_clear(clone2);
+	assert_false(obs_data_has_user_value(clone2, "name"));
+	assert_true(obs_data_has_user_value(data, "name"));
+
+	obs_data_release(clone2);
+	obs_data_release(clone);
+	obs_data_release(expected);
+	obs_data_release(data);
+	assert_int_equal(bnum_allocs(), allocs);
+}
+
+static void cow_apply_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	long allocs = bnum_allocs();
+	obs_data_t *src = create_source(0);
+	obs_data_t *target = obs_data_create();
+
+	obs_data_apply(target, src);
+	assert_true(data_equal(target, src));
+
+	obs_data_t *settings = obs_data_get_obj(target, "settings");
+	obs_data_set_bool(settings, "unload", true);
+	obs_data_release(settings);
+
+	settings = obs_data_get_obj(src, "settings");
+	assert_false(obs_data_get_bool(settings, "unload"));
+	obs_data_release(settings);
+
+	/* nested values are still released with the last clone */
+	obs_data_release(src);
+	assert_string_equal(obs_data_get_string(target, "id"), "image_source");
+	obs_data_release(target);
+	assert_int_equal(bnum_allocs(), allocs);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(binary_roundtrip_test),
+		cmocka_unit_test(binary_corrupt_test),
+		cmocka_unit_test(binary_file_test),
+		cmocka_unit_test(json_parse_test),
+#ifdef HAVE_JANSSON
+		cmocka_unit_test(json_jansson_compat_test),
+#endif
+		cmocka_unit_test(cow_clone_test),
+		cmocka_unit_test(cow_apply_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,223 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <cmocka.h>
+
+#include <util/profiler.h>
+#include <util/threading.h>
+#include <util/platform.h>
+
+static const char *tree_root = "tree_root";
+static const char *tree_child_a = "tree_child_a";
+static const char *tree_child_b = "tree_child_b";
+static const char *mismatch_root = "mismatch_root";
+static const char *mismatch_inner = "mismatch_inner";
+static const char *trace_root = "trace \"root\"";
+static const char *trace_early = "trace_early";
+
+static const char *trace_json = "test_profiler_trace.json";
+
+struct find_data {
+	const char *name;
+	profiler_snapshot_entry_t *entry;
+};
+
+static bool find_entry(void *data, profiler_snapshot_entry_t *entry)
+{
+	struct find_data *find = data;
+	if (profiler_snapshot_entry_name(entry) != find->name)
+		return true;
+
+	find->entry = entry;
+	return false;
+}
+
+static profiler_snapshot_entry_t *find_root(profiler_snapshot_t *snap, const char *name)
+{
+	struct find_data find = {name, NULL};
+	profiler_snapshot_enumerate_roots(snap, find_entry, &find);
+	return find.entry;
+}
+
+static profiler_snapshot_entry_t *find_child(profiler_snapshot_entry_t *entry, const char *name)
+{
+	struct find_data find = {name, NULL};
+	profiler_snapshot_enumerate_children(entry, find_entry, &find);
+	return find.entry;
+}
+
+static void *tree_thread(void *data)
+{
+	os_set_thread_name("tree thread");
+
+	for (int i = 0; i < 10; i++) {
+		profile_start(tree_root);
+		profile_start(tree_child_a);
+		profile_end(tree_child_a);
+		profile_start(tree_child_b);
+		profile_end(tree_child_b);
+		profile_end(tree_root);
+	}
+
+	/* ending the outer call also ends the inner one */
+	profile_start(mismatch_root);
+	profile_start(mismatch_inner);
+	profile_end(mismatch_root);
+
+	UNUSED_PARAMETER(data);
+	return NULL;
+}
+
+static void profiler_tree_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	profiler_snapshot_t *snap;
+	profiler_snapshot_entry_t *root, *child;
+	pthread_t thread;
+
+	pthread_create(&thread, NULL, tree_thread, NULL);
+	pthread_join(thread, NULL);
+
+	snap = profile_snapshot_create();
+
+	root = find_root(snap, tree_root);
+	assert_non_null(root);
+	assert_int_equal(profiler_snapshot_entry_overall_count(root), 10);
+	assert_int_equal(profiler_snapshot_num_children(root), 2);
+
+	child = find_child(root, tree_child_a);
+	assert_non_null(child);
+	assert_int_equal(profiler_snapshot_entry_overall_count(child), 10);
+	child = find_child(root, tree_child_b);
+	assert_non_null(child);
+	assert_int_equal(profiler_snapshot_entry_overall_count(child), 10);
+
+	root = find_root(snap, mismatch_root);
+	assert_non_null(root);
+	assert_int_equal(profiler_snapshot_entry_overall_count(root), 1);
+	child = find_child(root, mismatch_inner);
+	assert_non_null(child);
+	assert_int_equal(profiler_snapshot_entry_overall_count(child), 1);
+
+	profile_snapshot_free(snap);
+}
+
+struct trace_events {
+	os_event_t *recorded;
+	os_event_t *exit;
+};
+
+static void *trace_thread(void *data)
+{
+	struct trace_events *events = data;
+
+	os_set_thread_name("trace thread");
+
+	for (int i = 0; i < 3; i++) {
+		profile_start(trace_root);
+		os_sleep_ms(1);
+		profile_end(trace_root);
+	}
+
+	os_event_signal(events->recorded);
+	os_event_wait(events->exit);
+	return NULL;
+}
+
+static void profiler_trace_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct trace_events events;
+	pthread_t thread;
+	char *json;
+
+	/* nothing is kept until trace capture is enabled */
+	profile_start(trace_early);
+	profile_end(trace_early);
+	assert_true(profiler_trace_dump_json(trace_json, 0, UINT64_MAX));
+	json = os_quick_read_utf8_file(trace_json);
+	assert_non_null(json);
+	assert_null(strstr(json, trace_early));
+	bfree(json);
+
+	profiler_set_trace_history(1024);
+
+	profile_start(trace_early);
+	profile_end(trace_early);
+
+	uint64_t start = os_gettime_ns();
+
+	os_event_init(&events.recorded, OS_EVENT_TYPE_MANUAL);
+	os_event_init(&events.exit, OS_EVENT_TYPE_MANUAL);
+	pthread_create(&thread, NULL, trace_thread, &events);
+	os_event_wait(events.recorded);
+
+	assert_true(profiler_trace_dump_json(trace_json, start, os_gettime_ns()));
+	json = os_quick_read_utf8_file(trace_json);
+	assert_non_null(json);
+	assert_non_null(strstr(json, "\"traceEvents\":["));
+	assert_non_null(strstr(json, "\"args\":{\"name\":\"trace thread\"}"));
+	assert_non_null(strstr(json, "\"ph\":\"X\""));
+	assert_non_null(strstr(json, "\"name\":\"trace \\\"root\\\"\""));
+	assert_null(strstr(json, trace_early));
+	bfree(json);
+
+	/* calls outside the window are left out */
+	assert_true(profiler_trace_dump_json(trace_json, 0, start - 1));
+	json = os_quick_read_utf8_file(trace_json);
+	assert_non_null(json);
+	assert_null(strstr(json, "trace \\\"root\\\""));
+	assert_non_null(strstr(json, trace_early));
+	bfree(json);
+
+	/* and so are the calls of threads that have exited */
+	os_event_signal(events.exit);
+	pthread_join(thread, NULL);
+	os_event_destroy(events.recorded);
+	os_event_destroy(events.exit);
+
+	assert_true(profiler_trace_dump_json(trace_json, 0, os_gettime_ns()));
+	json = os_quick_read_utf8_file(trace_json);
+	assert_non_null(json);
+	assert_null(strstr(json, "trace thread"));
+	assert_non_null(strstr(json, trace_early));
+	bfree(json);
+
+	/* and disabling trace capture frees what was kept */
+	profiler_set_trace_history(0);
+	assert_true(profiler_trace_dump_json(trace_json, 0, UINT64_MAX));
+	json = os_quick_read_utf8_file(trace_json);
+	assert_non_null(json);
+	assert_null(strstr(json, trace_early));
+	bfree(json);
+
+	os_unlink(trace_json);
+}
+
+static int setup(void **state)
+{
+	UNUSED_PARAMETER(state);
+	profiler_start();
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	UNUSED_PARAMETER(state);
+	profiler_stop();
+	profiler_free();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(profiler_tree_test),
+		cmocka_unit_test(profiler_trace_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
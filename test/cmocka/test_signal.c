@@ -0,0 +1,298 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <cmocka.h>
+
+#include <callback/signal.h>
+#include <util/threading.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+struct counter {
+	volatile long calls;
+	signal_handler_t *handler;
+	void *other;
+};
+
+static void count_cb(void *data, calldata_t *params)
+{
+	struct counter *c = data;
+	os_atomic_inc_long(&c->calls);
+	UNUSED_PARAMETER(params);
+}
+
+static void remove_self_cb(void *data, calldata_t *params)
+{
+	count_cb(data, params);
+	signal_handler_remove_current();
+}
+
+static void disconnect_other_cb(void *data, calldata_t *params)
+{
+	struct counter *c = data;
+	count_cb(data, params);
+	signal_handler_disconnect(c->handler, "test", count_cb, c->other);
+}
+
+static void connect_other_cb(void *data, calldata_t *params)
+{
+	struct counter *c = data;
+	count_cb(data, params);
+	signal_handler_connect(c->handler, "test", count_cb, c->other);
+}
+
+static void remove_self_connect_other_cb(void *data, calldata_t *params)
+{
+	remove_self_cb(data, params);
+	connect_other_cb(data, params);
+}
+
+static void global_cb(void *data, const char *signal, calldata_t *params)
+{
+	if (strcmp(signal, "test") == 0)
+		count_cb(data, params);
+}
+
+static void signal_connect_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = signal_handler_create();
+	struct counter a = {0}, global = {0};
+
+	assert_true(signal_handler_add(handler, "void test(int val)"));
+	assert_false(signal_handler_add(handler, "void test(int val)"));
+
+	signal_handler_connect(handler, "test", count_cb, &a);
+	signal_handler_connect(handler, "test", count_cb, &a);
+	signal_handler_connect_global(handler, global_cb, &global);
+
+	signal_handler_signal(handler, "test", NULL);
+	signal_handler_signal(handler, "missing", NULL);
+	assert_int_equal(a.calls, 1);
+	assert_int_equal(global.calls, 1);
+
+	signal_handler_disconnect(handler, "test", count_cb, &a);
+	signal_handler_disconnect_global(handler, global_cb, &global);
+	signal_handler_signal(handler, "test", NULL);
+	assert_int_equal(a.calls, 1);
+	assert_int_equal(global.calls, 1);
+
+	signal_handler_destroy(handler);
+}
+
+static void signal_modify_during_emit_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = signal_handler_create();
+	struct counter self = {0}, first = {0}, other = {0}, added = {0};
+
+	signal_handler_add(handler, "void test()");
+
+	/* callbacks disconnected during an emit are skipped straight away */
+	first.handler = handler;
+	first.other = &other;
+	signal_handler_connect(handler, "test", remove_self_cb, &self);
+	signal_handler_connect(handler, "test", disconnect_other_cb, &first);
+	signal_handler_connect(handler, "test", count_cb, &other);
+
+	signal_handler_signal(handler, "test", NULL);
+	signal_handler_signal(handler, "test", NULL);
+	assert_int_equal(self.calls, 1);
+	assert_int_equal(first.calls, 2);
+	assert_int_equal(other.calls, 0);
+
+	/* callbacks connected during an emit are called from the next one */
+	signal_handler_disconnect(handler, "test", disconnect_other_cb, &first);
+	first.other = &added;
+	signal_handler_connect(handler, "test", connect_other_cb, &first);
+
+	signal_handler_signal(handler, "test", NULL);
+	assert_int_equal(added.calls, 0);
+	signal_handler_signal(handler, "test", NULL);
+	assert_int_equal(added.calls, 1);
+
+	signal_handler_destroy(handler);
+}
+
+static void signal_ref_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	signal_handler_t *handler = signal_handler_create();
+	struct counter a = {0}, b = {0};
+
+	signal_handler_add(handler, "void test()");
+	signal_handler_connect_ref(handler, "test", count_cb, &a);
+	signal_handler_connect_ref(handler, "test", remove_self_cb, &b);
+
+	/* both callbacks hold references, the handler stays alive */
+	signal_handler_destroy(handler);
+	signal_handler_signal(handler, "test", NULL);
+	assert_int_equal(a.calls, 1);
+	assert_int_equal(b.calls, 1);
+
+	signal_handler_disconnect(handler, "test", count_cb, &a);
+
+	/* a callback that removed itself is left out by the connect from
+	 * within the same emit, its reference is still released */
+	long allocs = bnum_allocs();
+	struct counter c = {0};
+	handler = signal_handler_create();
+	c.handler = handler;
+	c.other = &a;
+
+	signal_handler_add(handler, "void test()");
+	signal_handler_connect_ref(handler, "test", remove_self_connect_other_cb, &c);
+	signal_handler_destroy(handler);
+	signal_handler_signal(handler, "test", NULL);
+	assert_int_equal(c.calls, 2);
+	assert_int_equal(bnum_allocs(), allocs);
+}
+
+#define STRESS_EMITTERS 3
+#define STRESS_CONNECTORS 3
+#define STRESS_ITERATIONS 1000
+
+enum slot_state {
+	SLOT_DISCONNECTED,
+	SLOT_CONNECTING,
+	SLOT_CONNECTED,
+	SLOT_DISCONNECTING,
+};
+
+/* a callback connected and disconnected over and over by one thread */
+struct stress_slot {
+	volatile long state;
+	volatile long in_call;
+	volatile long calls;
+	volatile long bad_calls;
+};
+
+struct stress {
+	signal_handler_t *handler;
+	struct stress_slot slots[STRESS_CONNECTORS];
+	volatile long next_slot;
+	volatile long connectors_left;
+	volatile long emits;
+	volatile long bad_disconnects;
+};
+
+static void stress_cb(void *data, calldata_t *params)
+{
+	struct stress_slot *slot = data;
+
+	os_atomic_inc_long(&slot->in_call);
+	if (os_atomic_load_long(&slot->state) == SLOT_DISCONNECTED)
+		os_atomic_inc_long(&slot->bad_calls);
+	os_atomic_inc_long(&slot->calls);
+	os_atomic_dec_long(&slot->in_call);
+
+	UNUSED_PARAMETER(params);
+}
+
+static void stress_global_cb(void *data, const char *signal, calldata_t *params)
+{
+	stress_cb(data, params);
+	UNUSED_PARAMETER(signal);
+}
+
+static void *stress_emit_thread(void *data)
+{
+	struct stress *stress = data;
+
+	while (os_atomic_load_long(&stress->connectors_left)) {
+		signal_handler_signal(stress->handler, "test", NULL);
+		os_atomic_inc_long(&stress->emits);
+	}
+
+	return NULL;
+}
+
+static void *stress_connect_thread(void *data)
+{
+	struct stress *stress = data;
+	long idx = os_atomic_inc_long(&stress->next_slot) - 1;
+	struct stress_slot *slot = &stress->slots[idx];
+
+	for (long i = 0; i < STRESS_ITERATIONS; i++) {
+		os_atomic_store_long(&slot->state, SLOT_CONNECTING);
+		if (i % 3 == 0)
+			signal_handler_connect_global(stress->handler, stress_global_cb, slot);
+		else if (i % 3 == 1)
+			signal_handler_connect_ref(stress->handler, "test", stress_cb, slot);
+		else
+			signal_handler_connect(stress->handler, "test", stress_cb, slot);
+		os_atomic_store_long(&slot->state, SLOT_CONNECTED);
+
+		/* an emit that started after connecting has to call it */
+		long emits = os_atomic_load_long(&stress->emits);
+		while (os_atomic_load_long(&stress->emits) < emits + STRESS_EMITTERS + 1)
+			os_sleep_ms(0);
+
+		os_atomic_store_long(&slot->state, SLOT_DISCONNECTING);
+		if (i % 3 == 0)
+			signal_handler_disconnect_global(stress->handler, stress_global_cb, slot);
+		else
+			signal_handler_disconnect(stress->handler, "test", stress_cb, slot);
+		os_atomic_store_long(&slot->state, SLOT_DISCONNECTED);
+
+		/* once disconnect returns the callback can't still be running */
+		if (os_atomic_load_long(&slot->in_call))
+			os_atomic_inc_long(&stress->bad_disconnects);
+	}
+
+	return NULL;
+}
+
+/* Emits from several threads while other threads keep connecting and
+ * disconnecting.  Callbacks must only be called while connected, which
+ * ASan would also catch as use after free. */
+static void signal_concurrent_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	pthread_t emitters[STRESS_EMITTERS];
+	pthread_t connectors[STRESS_CONNECTORS];
+	struct stress stress = {0};
+	long allocs = bnum_allocs();
+
+	stress.handler = signal_handler_create();
+	signal_handler_add(stress.handler, "void test()");
+
+	stress.connectors_left = STRESS_CONNECTORS;
+	for (size_t i = 0; i < STRESS_EMITTERS; i++)
+		assert_int_equal(pthread_create(&emitters[i], NULL, stress_emit_thread, &stress), 0);
+	for (size_t i = 0; i < STRESS_CONNECTORS; i++)
+		assert_int_equal(pthread_create(&connectors[i], NULL, stress_connect_thread, &stress), 0);
+	for (size_t i = 0; i < STRESS_CONNECTORS; i++) {
+		pthread_join(connectors[i], NULL);
+		os_atomic_dec_long(&stress.connectors_left);
+	}
+	for (size_t i = 0; i < STRESS_EMITTERS; i++)
+		pthread_join(emitters[i], NULL);
+
+	for (size_t i = 0; i < STRESS_CONNECTORS; i++) {
+		assert_true(stress.slots[i].calls >= STRESS_ITERATIONS);
+		assert_int_equal(stress.slots[i].bad_calls, 0);
+	}
+	assert_int_equal(stress.bad_disconnects, 0);
+
+	/* references taken by connect_ref were all released by disconnect */
+	signal_handler_destroy(stress.handler);
+	assert_int_equal(bnum_allocs(), allocs);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(signal_connect_test),
+		cmocka_unit_test(signal_modify_during_emit_test),
+		cmocka_unit_test(signal_ref_test),
+		cmocka_unit_test(signal_concurrent_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
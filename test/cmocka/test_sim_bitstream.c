@@ -0,0 +1,146 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs-avc.h>
+#include <util/bmem.h>
+
+#include "sim-bitstream.h"
+#include "rtmp-hevc.h"
+#include "rtmp-av1.h"
+
+static const struct sim_video_params params = {
+	.width = 1278,
+	.height = 718,
+	.fps_num = 60,
+	.fps_den = 1,
+	.bframes = 2,
+	.full_range = false,
+};
+
+static void h264_header_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	DARRAY(uint8_t) data;
+	uint8_t *header;
+	size_t size;
+
+	da_init(data);
+	sim_write_h264_headers(&data.da, &params);
+
+	size = obs_parse_avc_header(&header, data.array, data.num);
+	assert_true(size > 0);
+
+	/* avcC: version, profile (High), constraints and level from the SPS */
+	assert_int_equal(header[0], 1);
+	assert_int_equal(header[1], 100);
+	assert_memory_equal(header + 1, data.array + 5, 3);
+	assert_int_equal(header[5], 0xe1);
+
+	/* the SPS is copied as is, followed by one PPS */
+	size_t sps_size = header[6] << 8 | header[7];
+	assert_true(sps_size > 4);
+	assert_memory_equal(header + 8, data.array + 4, sps_size);
+
+	uint8_t *pps = header + 8 + sps_size;
+	size_t pps_size = pps[1] << 8 | pps[2];
+	assert_int_equal(pps[0], 1);
+	assert_int_equal(pps[3] & 0x1f, 8);
+
+	/* High profile extension: 4:2:0, 8 bit, parsed back from the SPS */
+	uint8_t *ext = pps + 3 + pps_size;
+	assert_int_equal(ext - header + 4, size);
+	assert_int_equal(ext[0], 0xfd);
+	assert_int_equal(ext[1], 0xf8);
+	assert_int_equal(ext[2], 0xf8);
+	assert_int_equal(ext[3], 0);
+
+	bfree(header);
+	da_free(data);
+}
+
+static void hevc_header_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	DARRAY(uint8_t) data;
+	uint8_t *header;
+	size_t size;
+
+	da_init(data);
+	sim_write_hevc_headers(&data.da, &params);
+
+	size = obs_parse_hevc_header(&header, data.array, data.num);
+	assert_true(size > 23);
+
+	/* hvcC: version, Main profile, compatible with Main and Main 10 */
+	assert_int_equal(header[0], 1);
+	assert_int_equal(header[1], 1);
+	assert_int_equal(header[2], 0x60);
+
+	/* 4:2:0 and 8 bit luma and chroma, parsed from the SPS */
+	assert_int_equal(header[16], 0xfd);
+	assert_int_equal(header[17], 0xf8);
+	assert_int_equal(header[18], 0xf8);
+
+	/* one VPS, SPS and PPS each, in that order */
+	static const uint8_t types[] = {32, 33, 34};
+	uint8_t *array = header + 23;
+
+	assert_int_equal(header[22], 3);
+	for (size_t i = 0; i < 3; i++) {
+		assert_int_equal(array[0] & 0x3f, types[i]);
+		assert_int_equal(array[1] << 8 | array[2], 1);
+
+		size_t nal_size = array[3] << 8 | array[4];
+		assert_true(nal_size > 2);
+		assert_int_equal((array[5] >> 1) & 0x3f, types[i]);
+		array += 5 + nal_size;
+	}
+	assert_int_equal(array - header, size);
+
+	bfree(header);
+	da_free(data);
+}
+
+static void av1_header_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	DARRAY(uint8_t) data;
+	uint8_t *header;
+	size_t size;
+
+	da_init(data);
+	sim_write_av1_sequence_header(&data.da, &params);
+
+	size = obs_parse_av1_header(&header, data.array, data.num);
+	assert_int_equal(size, 4 + data.num);
+
+	/* av1C: marker and version, Main profile and the level of the
+	 * sequence header, which starts after 24 bits of the payload */
+	assert_int_equal(header[0], 0x81);
+	assert_int_equal(header[1] >> 5, 0);
+	assert_int_equal(header[1] & 0x1f, data.array[5] >> 3);
+
+	/* main tier, 8 bit, 4:2:0 */
+	assert_int_equal(header[2], 0x0c);
+	assert_int_equal(header[3], 0);
+	assert_memory_equal(header + 4, data.array, data.num);
+
+	bfree(header);
+	da_free(data);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(h264_header_test),
+		cmocka_unit_test(hevc_header_test),
+		cmocka_unit_test(av1_header_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
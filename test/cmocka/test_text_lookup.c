@@ -0,0 +1,143 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <cmocka.h>
+
+#include <util/text-lookup.h>
+#include <util/platform.h>
+#include <util/bmem.h>
+
+static const char *default_ini = "test_text_lookup_en.ini";
+static const char *locale_ini = "test_text_lookup_de.ini";
+static const char *cache_bin = "test_text_lookup.bin";
+
+static void write_file(const char *path, const char *text)
+{
+	assert_true(os_quick_write_utf8_file(path, text, strlen(text), false));
+}
+
+static void expect_string(lookup_t *lookup, const char *key, const char *expected)
+{
+	const char *val = NULL;
+
+	if (!expected) {
+		assert_false(text_lookup_getstr(lookup, key, &val));
+		return;
+	}
+
+	assert_true(text_lookup_getstr(lookup, key, &val));
+	assert_string_equal(val, expected);
+}
+
+static void expect_contents(lookup_t *lookup)
+{
+	expect_string(lookup, "Hello", "Hallo");
+	expect_string(lookup, "Bye", "Goodbye");
+	expect_string(lookup, "Escaped", "line\none \"quoted\"");
+	expect_string(lookup, "Missing", NULL);
+	expect_string(lookup, "", NULL);
+}
+
+static void remove_files(void)
+{
+	os_unlink(default_ini);
+	os_unlink(locale_ini);
+	os_unlink(cache_bin);
+}
+
+static void compiled_lookup_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const char *paths[] = {default_ini, locale_ini};
+	lookup_t *lookup;
+
+	write_file(default_ini, "Hello=\"Hello\"\nBye=\"Goodbye\"\n# comment\nEscaped=\"line\\none \\\"quoted\\\"\"\n");
+	write_file(locale_ini, "Hello=\"Hallo\"\n");
+	os_unlink(cache_bin);
+
+	/* first load parses the files and writes the cache */
+	lookup = text_lookup_create_compiled(cache_bin, paths, 2);
+	assert_non_null(lookup);
+	expect_contents(lookup);
+	text_lookup_destroy(lookup);
+	assert_true(os_file_exists(cache_bin));
+
+	/* second load maps the cache */
+	lookup = text_lookup_create_compiled(cache_bin, paths, 2);
+	assert_non_null(lookup);
+	expect_contents(lookup);
+
+	/* added files override the compiled table */
+	write_file(locale_ini, "Bye=\"Tschuess\"\n");
+	assert_true(text_lookup_add(lookup, locale_ini));
+	expect_string(lookup, "Bye", "Tschuess");
+	expect_string(lookup, "Hello", "Hallo");
+	text_lookup_destroy(lookup);
+
+	/* the changed source invalidates the cache */
+	lookup = text_lookup_create_compiled(cache_bin, paths, 2);
+	expect_string(lookup, "Bye", "Tschuess");
+	expect_string(lookup, "Hello", "Hello");
+	text_lookup_destroy(lookup);
+
+	/* as does a different set of sources */
+	lookup = text_lookup_create_compiled(cache_bin, paths, 1);
+	expect_string(lookup, "Bye", "Goodbye");
+	text_lookup_destroy(lookup);
+
+	/* a missing first file fails like text_lookup_create */
+	os_unlink(default_ini);
+	assert_null(text_lookup_create_compiled(cache_bin, paths, 2));
+
+	remove_files();
+}
+
+static void compiled_corrupt_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const char *paths[] = {default_ini};
+	lookup_t *lookup;
+	const void *map;
+	uint8_t *data;
+	uint32_t slots;
+	size_t size;
+
+	write_file(default_ini, "Hello=\"Hello\"\nBye=\"Goodbye\"\n");
+	lookup = text_lookup_create_compiled(cache_bin, paths, 1);
+	text_lookup_destroy(lookup);
+
+	map = os_map_file(cache_bin, &size);
+	assert_non_null(map);
+	data = bmemdup(map, size);
+	os_unmap_file(map, size);
+
+	/* truncated */
+	write_file(cache_bin, "OBSL");
+	lookup = text_lookup_create_compiled(cache_bin, paths, 1);
+	expect_string(lookup, "Hello", "Hello");
+	text_lookup_destroy(lookup);
+
+	/* first slot pointing past the strings */
+	slots = data[24] | (data[25] << 8) | (data[26] << 16) | ((uint32_t)data[27] << 24);
+	memset(data + slots, 0x7f, 4);
+	assert_true(os_quick_write_utf8_file(cache_bin, (const char *)data, size, false));
+	lookup = text_lookup_create_compiled(cache_bin, paths, 1);
+	expect_string(lookup, "Bye", "Goodbye");
+	text_lookup_destroy(lookup);
+
+	bfree(data);
+	remove_files();
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(compiled_lookup_test),
+		cmocka_unit_test(compiled_corrupt_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,321 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <cmocka.h>
+
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+struct receiver {
+	uint32_t width;
+	uint32_t height;
+	volatile long frames;
+	const uint8_t *last_data;
+	bool uniform;
+};
+
+static void receive_video(void *param, struct video_data *frame)
+{
+	struct receiver *rx = param;
+	const uint8_t *y = frame->data[0];
+
+	/* a uniform frame stays uniform however it is scaled */
+	for (uint32_t row = 0; row < rx->height; row += rx->height / 8) {
+		const uint8_t *line = y + (size_t)row * frame->linesize[0];
+		if (line[0] != 100 || line[rx->width - 1] != 100)
+			rx->uniform = false;
+	}
+
+	rx->last_data = y;
+	os_atomic_inc_long(&rx->frames);
+}
+
+static video_t *open_video(uint32_t width, uint32_t height)
+{
+	struct video_output_info info = {
+		.name = "test",
+		.format = VIDEO_FORMAT_I420,
+		.fps_num = 1000,
+		.fps_den = 1,
+		.width = width,
+		.height = height,
+		.cache_size = 4,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+	};
+	video_t *video = NULL;
+
+	assert_int_equal(video_output_open(&video, &info), VIDEO_OUTPUT_SUCCESS);
+	return video;
+}
+
+static void connect_receiver(video_t *video, struct receiver *rx, uint32_t width, uint32_t height)
+{
+	struct video_scale_info conversion = {
+		.format = VIDEO_FORMAT_I420,
+		.width = width,
+		.height = height,
+		.range = VIDEO_RANGE_PARTIAL,
+		.colorspace = VIDEO_CS_709,
+	};
+
+	rx->width = width;
+	rx->height = height;
+	rx->frames = 0;
+	rx->uniform = true;
+	assert_true(video_output_connect(video, &conversion, receive_video, rx));
+}
+
+static void fill_frame(struct video_frame *frame, uint32_t width, uint32_t height)
+{
+	memset(frame->data[0], 100, (size_t)frame->linesize[0] * height);
+	memset(frame->data[1], 128, (size_t)frame->linesize[1] * height / 2);
+	memset(frame->data[2], 128, (size_t)frame->linesize[2] * height / 2);
+	UNUSED_PARAMETER(width);
+}
+
+static void push_frames(video_t *video, int count, struct receiver *last)
+{
+	const struct video_output_info *info = video_output_get_info(video);
+	long first = last->frames;
+
+	for (int i = 0; i < count; i++) {
+		struct video_frame frame;
+
+		/* a failed lock repeats the last frame, so leave room in the
+		 * cache for the frame still being output */
+		while (first + i - os_atomic_load_long(&last->frames) > (long)info->cache_size - 2)
+			os_sleep_ms(0);
+
+		assert_true(video_output_lock_frame(video, &frame, 1, os_gettime_ns()));
+		fill_frame(&frame, info->width, info->height);
+		video_output_unlock_frame(video);
+	}
+
+	while (os_atomic_load_long(&last->frames) < first + count)
+		os_sleep_ms(0);
+}
+
+static void pyramid_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	video_t *video = open_video(1920, 1080);
+	struct receiver full, rx720, rx720_b, rx480, rx360;
+
+	connect_receiver(video, &full, 1920, 1080);
+	connect_receiver(video, &rx720, 1280, 720);
+	connect_receiver(video, &rx720_b, 1280, 720);
+	connect_receiver(video, &rx480, 852, 480);
+	connect_receiver(video, &rx360, 640, 360);
+
+	push_frames(video, 3, &rx360);
+
+	assert_int_equal(full.frames, 3);
+	assert_int_equal(rx720.frames, 3);
+	assert_int_equal(rx480.frames, 3);
+	assert_true(full.uniform && rx720.uniform && rx720_b.uniform && rx480.uniform && rx360.uniform);
+
+	/* inputs wanting the same size share one scaled frame */
+	assert_ptr_equal(rx720.last_data, rx720_b.last_data);
+
+	/* removing a rung relinks the smaller ones */
+	video_output_disconnect(video, receive_video, &rx480);
+	video_output_disconnect(video, receive_video, &rx720);
+	push_frames(video, 3, &rx360);
+	assert_int_equal(rx360.frames, 6);
+	assert_int_equal(rx720_b.frames, 6);
+	assert_int_equal(rx480.frames, 3);
+	assert_true(rx720_b.uniform && rx360.uniform);
+
+	video_output_close(video);
+}
+
+struct holder {
+	video_t *video;
+	struct video_data frames[8];
+	bool held[8];
+	volatile long count;
+};
+
+static void hold_video(void *param, struct video_data *frame)
+{
+	struct holder *holder = param;
+	long idx = holder->count;
+
+	holder->frames[idx] = *frame;
+	holder->held[idx] = video_output_hold_frame(holder->video, frame);
+	os_atomic_inc_long(&holder->count);
+}
+
+static bool output_frame(video_t *video, struct holder *holder, struct video_frame *frame)
+{
+	long count = holder->count;
+
+	if (!video_output_lock_frame(video, frame, 1, os_gettime_ns()))
+		return false;
+
+	video_output_unlock_frame(video);
+
+	while (os_atomic_load_long(&holder->count) == count)
+		os_sleep_ms(0);
+	return true;
+}
+
+static void hold_frame_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	video_t *video = open_video(64, 64);
+	const struct video_output_info *info = video_output_get_info(video);
+	struct video_scale_info conversion = {VIDEO_FORMAT_I420, 64, 64, VIDEO_RANGE_PARTIAL, VIDEO_CS_709};
+	struct holder holder = {.video = video};
+	struct video_frame frame;
+
+	assert_true(video_output_connect(video, &conversion, hold_video, &holder));
+
+	/* held frames are not reused, so every frame gets a new one */
+	for (size_t i = 0; i < info->cache_size; i++) {
+		assert_true(output_frame(video, &holder, &frame));
+		assert_true(holder.held[i]);
+		for (size_t j = 0; j < i; j++)
+			assert_ptr_not_equal(holder.frames[i].data[0], holder.frames[j].data[0]);
+	}
+
+	/* with every frame held, new frames are skipped */
+	assert_false(video_output_lock_frame(video, &frame, 1, os_gettime_ns()));
+	assert_int_equal(video_output_get_skipped_frames(video), 1);
+
+	/* frames become available again in output order */
+	video_output_release_frame(video, &holder.frames[1]);
+	assert_false(video_output_lock_frame(video, &frame, 1, os_gettime_ns()));
+	video_output_release_frame(video, &holder.frames[0]);
+	assert_true(video_output_lock_frame(video, &frame, 1, os_gettime_ns()));
+	assert_ptr_equal(frame.data[0], holder.frames[0].data[0]);
+	video_output_unlock_frame(video);
+
+	while (os_atomic_load_long(&holder.count) == (long)info->cache_size)
+		os_sleep_ms(0);
+
+	for (size_t i = 2; i <= info->cache_size; i++)
+		video_output_release_frame(video, &holder.frames[i]);
+	video_output_disconnect(video, hold_video, &holder);
+	video_output_close(video);
+}
+
+static void shared_scaled_frame_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	video_t *video = open_video(64, 64);
+	struct video_scale_info scaled = {VIDEO_FORMAT_I420, 32, 32, VIDEO_RANGE_PARTIAL, VIDEO_CS_709};
+	struct holder first = {.video = video};
+	struct holder second = {.video = video};
+	struct video_frame frame;
+
+	assert_true(video_output_connect(video, &scaled, hold_video, &first));
+	assert_true(video_output_connect(video, &scaled, hold_video, &second));
+
+	/* both inputs hold the same scaled frame */
+	assert_true(output_frame(video, &second, &frame));
+	assert_int_equal(first.count, 1);
+	assert_true(first.held[0]);
+	assert_true(second.held[0]);
+	assert_ptr_equal(first.frames[0].data[0], second.frames[0].data[0]);
+
+	/* held frames are never scaled into again */
+	for (size_t i = 1; i < 6; i++) {
+		assert_true(output_frame(video, &second, &frame));
+		assert_true(second.held[i]);
+		for (size_t j = 0; j < i; j++)
+			assert_ptr_not_equal(second.frames[i].data[0], second.frames[j].data[0]);
+	}
+
+	for (size_t i = 0; i < 6; i++)
+		video_output_release_frame(video, &first.frames[i]);
+
+	/* frames still held when the conversion goes away are freed on
+	 * release */
+	video_output_disconnect(video, hold_video, &first);
+	video_output_disconnect(video, hold_video, &second);
+
+	for (size_t i = 0; i < 6; i++)
+		video_output_release_frame(video, &second.frames[i]);
+
+	video_output_close(video);
+}
+
+struct hashes {
+	uint64_t hash[8];
+	volatile long count;
+};
+
+static void hash_video(void *param, struct video_data *frame)
+{
+	struct hashes *hashes = param;
+
+	hashes->hash[hashes->count] = frame->hash;
+	os_atomic_inc_long(&hashes->count);
+}
+
+static void output_filled_frame(video_t *video, struct hashes *hashes, uint8_t luma)
+{
+	struct video_frame frame;
+	long count = hashes->count;
+
+	assert_true(video_output_lock_frame(video, &frame, 1, os_gettime_ns()));
+	memset(frame.data[0], luma, (size_t)frame.linesize[0] * 64);
+	memset(frame.data[1], 128, (size_t)frame.linesize[1] * 32);
+	memset(frame.data[2], 128, (size_t)frame.linesize[2] * 32);
+	video_output_unlock_frame(video);
+
+	while (os_atomic_load_long(&hashes->count) == count)
+		os_sleep_ms(0);
+}
+
+static void duplicate_detection_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	video_t *video = open_video(64, 64);
+	struct video_scale_info conversion = {VIDEO_FORMAT_I420, 64, 64, VIDEO_RANGE_PARTIAL, VIDEO_CS_709};
+	struct hashes hashes = {0};
+
+	assert_true(video_output_connect(video, &conversion, hash_video, &hashes));
+
+	output_filled_frame(video, &hashes, 16);
+	assert_int_equal(hashes.hash[0], 0);
+
+	/* the same content in different cached frames hashes the same */
+	video_output_inc_duplicate_detection(video);
+	output_filled_frame(video, &hashes, 16);
+	output_filled_frame(video, &hashes, 16);
+	output_filled_frame(video, &hashes, 17);
+	output_filled_frame(video, &hashes, 16);
+	assert_true(hashes.hash[1] != 0);
+	assert_true(hashes.hash[1] == hashes.hash[2]);
+	assert_true(hashes.hash[3] != hashes.hash[2]);
+	assert_true(hashes.hash[4] == hashes.hash[1]);
+
+	video_output_dec_duplicate_detection(video);
+	output_filled_frame(video, &hashes, 16);
+	assert_int_equal(hashes.hash[5], 0);
+
+	video_output_disconnect(video, hash_video, &hashes);
+	video_output_close(video);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(pyramid_test),
+		cmocka_unit_test(hold_frame_test),
+		cmocka_unit_test(shared_scaled_frame_test),
+		cmocka_unit_test(duplicate_detection_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
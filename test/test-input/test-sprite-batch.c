@@ -0,0 +1,164 @@
+#include <obs-module.h>
+#include <util/platform.h>
+
+/* Draws a grid of small colored quads, either one draw call per quad or
+ * merged with gs_sprite_batch, and logs the draw calls issued per frame. */
+
+#define GRID_CX 640
+#define GRID_CY 360
+#define QUAD_SIZE 8.0f
+
+struct sprite_batch_test {
+	obs_source_t *source;
+	gs_sprite_batch_t *batch;
+	uint32_t count;
+	bool batched;
+
+	uint64_t draw_calls;
+	uint64_t frames;
+	uint64_t last_log_time;
+};
+
+static const char *sprite_batch_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Sprite Batch Benchmark (Test)";
+}
+
+static void sprite_batch_update(void *data, obs_data_t *settings)
+{
+	struct sprite_batch_test *sbt = data;
+
+	sbt->count = (uint32_t)obs_data_get_int(settings, "count");
+	sbt->batched = obs_data_get_bool(settings, "batched");
+	sbt->draw_calls = 0;
+	sbt->frames = 0;
+}
+
+static void *sprite_batch_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct sprite_batch_test *sbt = bzalloc(sizeof(struct sprite_batch_test));
+	sbt->source = source;
+
+	obs_enter_graphics();
+	sbt->batch = gs_sprite_batch_create(0);
+	obs_leave_graphics();
+
+	sprite_batch_update(sbt, settings);
+	return sbt;
+}
+
+static void sprite_batch_destroy(void *data)
+{
+	struct sprite_batch_test *sbt = data;
+
+	obs_enter_graphics();
+	gs_sprite_batch_destroy(sbt->batch);
+	obs_leave_graphics();
+
+	bfree(sbt);
+}
+
+static void sprite_batch_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "count", 1000);
+	obs_data_set_default_bool(settings, "batched", true);
+}
+
+static obs_properties_t *sprite_batch_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	obs_properties_add_int(props, "count", "Quad count", 1, 100000, 1);
+	obs_properties_add_bool(props, "batched", "Batched");
+	return props;
+}
+
+static inline uint32_t quad_color(uint32_t i)
+{
+	return 0xFF000000 | (i * 2654435761u & 0xFFFFFF);
+}
+
+static inline void quad_pos(uint32_t i, float *x, float *y)
+{
+	const uint32_t per_row = (uint32_t)(GRID_CX / QUAD_SIZE);
+	*x = (float)(i % per_row) * QUAD_SIZE;
+	*y = (float)((i / per_row) % (uint32_t)(GRID_CY / QUAD_SIZE)) * QUAD_SIZE;
+}
+
+static void sprite_batch_render(void *data, gs_effect_t *unused)
+{
+	struct sprite_batch_test *sbt = data;
+	gs_effect_t *solid = obs_get_base_effect(OBS_EFFECT_SOLID);
+	gs_eparam_t *color = gs_effect_get_param_by_name(solid, "color");
+	uint64_t start = gs_get_draw_call_count();
+	float x, y;
+
+	if (sbt->batched) {
+		struct vec4 white;
+		vec4_set(&white, 1.0f, 1.0f, 1.0f, 1.0f);
+		gs_effect_set_vec4(color, &white);
+
+		for (uint32_t i = 0; i < sbt->count; i++) {
+			quad_pos(i, &x, &y);
+			gs_sprite_batch_add(sbt->batch, x, y, QUAD_SIZE, QUAD_SIZE, NULL, quad_color(i));
+		}
+
+		while (gs_effect_loop(solid, "SolidColored"))
+			gs_sprite_batch_draw(sbt->batch);
+		gs_sprite_batch_clear(sbt->batch);
+	} else {
+		for (uint32_t i = 0; i < sbt->count; i++) {
+			gs_effect_set_color(color, quad_color(i));
+			quad_pos(i, &x, &y);
+
+			gs_matrix_push();
+			gs_matrix_translate3f(x, y, 0.0f);
+			while (gs_effect_loop(solid, "Solid"))
+				gs_draw_sprite(NULL, 0, (uint32_t)QUAD_SIZE, (uint32_t)QUAD_SIZE);
+			gs_matrix_pop();
+		}
+	}
+
+	sbt->draw_calls += gs_get_draw_call_count() - start;
+	sbt->frames++;
+
+	uint64_t now = os_gettime_ns();
+	if (now - sbt->last_log_time >= 5000000000ULL) {
+		blog(LOG_INFO, "[sprite batch test] %s: %u quads, %.1f draw calls per frame",
+		     sbt->batched ? "batched" : "unbatched", sbt->count, (double)sbt->draw_calls / (double)sbt->frames);
+		sbt->draw_calls = 0;
+		sbt->frames = 0;
+		sbt->last_log_time = now;
+	}
+
+	UNUSED_PARAMETER(unused);
+}
+
+static uint32_t sprite_batch_width(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return GRID_CX;
+}
+
+static uint32_t sprite_batch_height(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return GRID_CY;
+}
+
+struct obs_source_info sprite_batch_test = {
+	.id = "sprite_batch_test",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.get_name = sprite_batch_getname,
+	.create = sprite_batch_create,
+	.destroy = sprite_batch_destroy,
+	.update = sprite_batch_update,
+	.get_defaults = sprite_batch_defaults,
+	.get_properties = sprite_batch_properties,
+	.video_render = sprite_batch_render,
+	.get_width = sprite_batch_width,
+	.get_height = sprite_batch_height,
+};